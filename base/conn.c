@@ -31,6 +31,21 @@
 
 //#define MEMLINK_EXIT abort()
 
+// bytes of rbuf/wbuf of all connections, changed by all threads
+static volatile long long conn_bufmem = 0;
+
+void
+conn_buffer_mem_add(long long size)
+{
+    __sync_add_and_fetch(&conn_bufmem, size);
+}
+
+long long
+conn_buffer_mem()
+{
+    return conn_bufmem;
+}
+
 /**
  * @param conn
  * @param newflag EV_READ or EV_WRITE
@@ -164,6 +179,7 @@ conn_event_read(int fd, short event, void *arg)
             char *newbuf = (char *)zz_malloc(rlen + conn->rsize);
             memcpy(newbuf, conn->rbuf, conn->rlen);
             conn->rsize += rlen;
+            conn_buffer_mem_add(rlen);
             zz_free(conn->rbuf);
             conn->rbuf = newbuf;
         }
@@ -206,11 +222,13 @@ conn_event_read(int fd, short event, void *arg)
         int mlen = datalen + sizeof(int);
 
         if (conn->rlen >= mlen) {
-            conn->ready(conn, conn->rbuf, mlen);
+            ret = conn->ready(conn, conn->rbuf, mlen);
             memmove(conn->rbuf, conn->rbuf + mlen, conn->rlen - mlen);
             conn->rlen -= mlen;
 
             zz_check(conn->rbuf);
+            if (ret == CONN_READY_WAIT)
+                break;
         }else{
             break;
         }
@@ -284,6 +302,7 @@ conn_create(int svrfd, int connsize)
     memset(conn, 0, connsize); 
     conn->rbuf    = (char *)zz_malloc(CONN_MAX_READ_LEN);
     conn->rsize   = CONN_MAX_READ_LEN;
+    conn_buffer_mem_add(CONN_MAX_READ_LEN);
     conn->sock    = newfd;
     conn->destroy = conn_destroy;
     conn->wrote   = conn_wrote;    
@@ -323,6 +342,7 @@ conn_client_create(char *svrip, int svrport, int connsize)
     memset(conn, 0x0, connsize);
     conn->rbuf     = (char *)zz_malloc(CONN_MAX_READ_LEN);
     conn->rsize    = CONN_MAX_READ_LEN;
+    conn_buffer_mem_add(CONN_MAX_READ_LEN);
     conn->sock     = cltfd;
     conn->destroy  = conn_destroy;
     conn->wrote    = conn_wrote;
@@ -355,9 +375,11 @@ conn_destroy(Conn *conn)
 
     if (conn->wbuf) {
         zz_free(conn->wbuf);
+        conn_buffer_mem_add(-conn->wsize);
     }
     if (conn->rbuf) {
         zz_free(conn->rbuf);
+        conn_buffer_mem_add(-conn->rsize);
     }
     event_del(&conn->evt);
     
@@ -402,9 +424,11 @@ conn_destroy_udp(Conn *conn)
 {
     if (conn->wbuf) {
         zz_free(conn->wbuf);
+        conn_buffer_mem_add(-conn->wsize);
     }
     if (conn->rbuf) {
         zz_free(conn->rbuf);
+        conn_buffer_mem_add(-conn->rsize);
     }
     event_del(&conn->evt);
      close(conn->sock);
@@ -443,11 +467,14 @@ conn_write_buffer(Conn *conn, int size)
         return conn->wbuf;
     }
 
-    if (conn->wbuf != NULL)
+    if (conn->wbuf != NULL) {
         zz_free(conn->wbuf);
+        conn_buffer_mem_add(-conn->wsize);
+    }
 
     conn->wbuf  = zz_malloc(size);
     conn->wsize = size;
+    conn_buffer_mem_add(size);
     conn->wlen  = conn->wpos = 0;
 
     return conn->wbuf;
@@ -464,6 +491,7 @@ conn_write_buffer_append(Conn *conn, void *data, int datalen)
             memcpy(newdata, conn->wbuf, conn->wlen);
         }
         zz_free(conn->wbuf);
+        conn_buffer_mem_add(newsize - conn->wsize);
         conn->wsize = newsize;
         conn->wbuf  = newdata;
     }
@@ -633,6 +661,7 @@ conn_create_udp(int sock, int connsize)
     memset(conn, 0, connsize); 
     conn->rbuf    = (char *)zz_malloc(CONN_MAX_READ_LEN);
     conn->rsize   = CONN_MAX_READ_LEN;
+    conn_buffer_mem_add(CONN_MAX_READ_LEN);
     conn->sock    = sock;
     conn->destroy = conn_destroy;
     
@@ -6,6 +6,8 @@
 #include <sys/time.h>
 
 #define CONN_MAX_READ_LEN   1024
+// returned by ready when the reply is sent later, the next command waits
+#define CONN_READY_WAIT     1
 
 #define CONN_MEMBER \
     int     sock;\
@@ -62,5 +64,7 @@ Conn*   conn_create_udp(int sock, int connsize);
 void    conn_destroy_delay(Conn *conn);
 void    conn_event_read(int fd, short event, void *arg);
 void    conn_event_write(int fd, short event, void *arg);
+void    conn_buffer_mem_add(long long size);
+long long conn_buffer_mem();
 
 #endif
@@ -23,8 +23,8 @@
 #include "defines.h"
 
 
-int 
-tcp_socket_server(char *host, int port)
+static int 
+tcp_socket_listen(char *host, int port, int reuseport)
 {
     int fd;
     int ret;
@@ -38,6 +38,22 @@ tcp_socket_server(char *host, int port)
     }
 
     tcp_server_setopt(fd);
+    if (reuseport) {
+#ifdef SO_REUSEPORT
+        int flag = 1;
+        ret = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof(flag));
+#else
+        ret = -1;
+        errno = ENOPROTOOPT;
+#endif
+        if (ret == -1) {
+            char errbuf[1024];
+            strerror_r(errno, errbuf, 1024);
+            DERROR("setsockopt SO_REUSEPORT error: %s\n",  errbuf);
+            close(fd);
+            return -1;
+        }
+    }
     
     struct sockaddr_in  sin;
 
@@ -72,6 +88,22 @@ tcp_socket_server(char *host, int port)
     return fd;
 }
 
+int 
+tcp_socket_server(char *host, int port)
+{
+    return tcp_socket_listen(host, port, 0);
+}
+
+/**
+ * one of the listening sockets of a port, the kernel spreads connections
+ * between them. -1 when SO_REUSEPORT is unavailable
+ */
+int 
+tcp_socket_server_reuseport(char *host, int port)
+{
+    return tcp_socket_listen(host, port, 1);
+}
+
 int
 udp_sock_server(char *host, int port)
 {
@@ -4,6 +4,7 @@
 #include <stdio.h>
 
 int tcp_socket_server(char *host, int port);
+int tcp_socket_server_reuseport(char *host, int port);
 int	tcp_socket_connect(char *host, int port, int timeout, int block);
 int tcp_server_setopt(int fd);
 int udp_sock_server(char *host, int port);
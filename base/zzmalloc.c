@@ -97,6 +97,34 @@ zz_free_dbg(void *ptr, char *file, int line)
     free(b);
 }
 
+/**
+ * aligned memory, freed by zz_free_align. no debug guard, the address 
+ * itself is aligned
+ */
+void*
+zz_memalign(size_t align, size_t size)
+{
+    void *ptr;
+#ifdef TCMALLOC
+    ptr = tc_memalign(align, size);
+#else
+    if (posix_memalign(&ptr, align, size) != 0) {
+        ptr = NULL;
+    }
+#endif
+    if (NULL == ptr) {
+        DERROR("memalign error!\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+void
+zz_free_align(void *ptr)
+{
+    zz_free_default(ptr);
+}
+
 char*
 zz_strdup(char *s)
 {
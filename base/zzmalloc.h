@@ -9,6 +9,8 @@ void	zz_free_default(void *ptr);
 void    zz_free_dbg(void *ptr, char *file, int line);
 void    zz_check_dbg(void *ptr, char *file, int line);
 char*   zz_strdup(char *s);
+void*   zz_memalign(size_t align, size_t size);
+void    zz_free_align(void *ptr);
 
 #ifdef DEBUGMEM
 #define zz_malloc(size) zz_malloc_dbg(size);
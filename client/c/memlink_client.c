@@ -967,14 +967,20 @@ memlink_result_parse(char *retdata, MemLinkResult *result)
     MemLinkItem *item = NULL;
     for (i = 0; i < count; i++) {
         item = &result->items[i];
-        item->valuesize = valuesize;
         item->attrsize = attrsize;
-        memcpy(item->value, vdata, valuesize);
-        attr_binary2string(attrformat, attrnum, vdata + valuesize, attrsize, item->attr);
+        // valuesize 0 means variable length value: len(1B) + value
+        if (valuesize == 0) {
+            item->valuesize = *(uint8_t*)vdata;
+            vdata += sizeof(char);
+        }else{
+            item->valuesize = valuesize;
+        }
+        memcpy(item->value, vdata, item->valuesize);
+        attr_binary2string(attrformat, attrnum, vdata + item->valuesize, attrsize, item->attr);
         if (i > 0) {
             result->items[i-1].next = &(result->items[i]);
         }
-        vdata += valuesize + attrsize;
+        vdata += item->valuesize + attrsize;
     }
 
 
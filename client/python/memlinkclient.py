@@ -278,8 +278,8 @@ def memlinkstat_print(self):
 MemLinkStat.__str__ = memlinkstat_print
 
 def memlinkstatsys_print(self):
-    s = 'keys:%d\nvalues:%d\nblocks:%d\ndata_all:%d\nht_mem:%d\npool.mem:%d\npool_blocks:%d\nall_mem:%d\nlogver:%d\nlogline:%d\n' % \
-        (self.keys, self.values, self.blocks, self.data_all, self.ht_mem, self.pool_mem, self.pool_blocks, self.all_mem, self.logver, self.logline)
+    s = 'keys:%d\nvalues:%d\nblocks:%d\ndata_all:%d\nht_mem:%d\npool.mem:%d\npool_blocks:%d\nall_mem:%d\nlogver:%d\nlogline:%d\nslab_mem:%d\nhugepage_mem:%d\nmem_used:%d\nevicted_keys:%d\ncold_keys:%d\ncold_mem:%d\n' % \
+        (self.keys, self.values, self.blocks, self.data_all, self.ht_mem, self.pool_mem, self.pool_blocks, self.all_mem, self.logver, self.logline, self.slab_mem, self.hugepage_mem, self.mem_used, self.evicted_keys, self.cold_keys, self.cold_mem)
 
     return s
 
@@ -0,0 +1,734 @@
+/**
+ * 冷数据存储
+ * 长时间未访问的key的数据链写入数据目录下内存映射的追加文件, 或压缩后留在内存,
+ * 访问时由table_find读回内存
+ * @file coldstore.c
+ * @ingroup memlink
+ * @{
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include "logfile.h"
+#include "zzmalloc.h"
+#include "utils.h"
+#include "quicklz.h"
+#include "coldstore.h"
+#include "datablock.h"
+#include "myconfig.h"
+#include "runtime.h"
+#include "common.h"
+
+#define COLD_ALIGN(n)       (((n) + 7) & ~(uint64_t)7)
+#define COLD_GEN            4   // records are 8 aligned, bit 2 of position << 1 is free
+#define COLD_POS(node)      ((uint64_t)(((node)->cold & ~(uintptr_t)7) >> 1))
+#define COLD_MEM(node)      ((ColdRecord*)((node)->cold & ~(uintptr_t)3))
+
+// used with g_runtime->mutex
+static qlz_state_compress   qlz_cstate;
+static qlz_state_decompress qlz_dstate;
+
+/**
+ * map the file again when it must grow for need bytes more
+ */
+static int
+coldstore_grow(ColdStore *cs, uint64_t need)
+{
+    uint64_t size = cs->size;
+    char     *map;
+
+    while (size < cs->end + need) {
+        size += COLDSTORE_GROW;
+    }
+    if (size == cs->size) {
+        return 0;
+    }
+    if (ftruncate(cs->fd, size) < 0) {
+        char errbuf[1024];
+        strerror_r(errno, errbuf, 1024);
+        DERROR("ftruncate %s error: %s\n", cs->path, errbuf);
+        return MEMLINK_ERR_IO;
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, cs->fd, 0);
+    if (map == MAP_FAILED) {
+        char errbuf[1024];
+        strerror_r(errno, errbuf, 1024);
+        DERROR("mmap %s error: %s\n", cs->path, errbuf);
+        return MEMLINK_ERR_IO;
+    }
+    if (cs->map) {
+        munmap(cs->map, cs->size);
+    }
+    cs->map  = map;
+    cs->size = size;
+
+    return 0;
+}
+
+/**
+ * cold store file is rebuilt from memory, the old one is truncated
+ */
+ColdStore*
+coldstore_create(char *path)
+{
+    ColdStore *cs = (ColdStore*)zz_malloc(sizeof(ColdStore));
+    if (NULL == cs) {
+        DERROR("malloc ColdStore error!\n");
+        MEMLINK_EXIT;
+        return NULL;
+    }
+    memset(cs, 0, sizeof(ColdStore));
+    snprintf(cs->path, PATH_MAX, "%s", path);
+
+    cs->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (cs->fd < 0) {
+        char errbuf[1024];
+        strerror_r(errno, errbuf, 1024);
+        DERROR("open %s error: %s\n", path, errbuf);
+        zz_free(cs);
+        return NULL;
+    }
+    if (coldstore_grow(cs, COLDSTORE_GROW) < 0) {
+        close(cs->fd);
+        zz_free(cs);
+        return NULL;
+    }
+    return cs;
+}
+
+void
+coldstore_destroy(ColdStore *cs)
+{
+    if (cs->next) {
+        unlink(cs->next->path);
+        coldstore_destroy(cs->next);
+    }
+    if (cs->map) {
+        munmap(cs->map, cs->size);
+    }
+    close(cs->fd);
+    zz_free(cs);
+}
+
+/**
+ * the file holding the record of a cold node, cs or the file compacted to
+ */
+static ColdStore*
+coldstore_file(ColdStore *cs, HashNode *node)
+{
+    if (cs->next && (node->cold & COLD_GEN) != cs->gen) {
+        return cs->next;
+    }
+    return cs;
+}
+
+ColdRecord*
+coldstore_record(ColdStore *cs, HashNode *node)
+{
+    if (hashnode_cold_in_mem(node)) {
+        return COLD_MEM(node);
+    }
+    return (ColdRecord*)(coldstore_file(cs, node)->map + COLD_POS(node));
+}
+
+static int
+coldstore_is_integer(Table *tb)
+{
+    return tb->valuetype >= MEMLINK_VALUE_INT && tb->valuetype <= MEMLINK_VALUE_ULONG &&
+           (tb->valuesize == 4 || tb->valuesize == 8);
+}
+
+/**
+ * values of items as zigzag varint of the difference to the previous one,
+ * small for sortlist and ids inserted in order. attrs follow, count * attrsize
+ * @return bytes written to out, at most count * (10 + attrsize)
+ */
+static uint32_t
+coldstore_delta_encode(Table *tb, char *items, uint32_t count, unsigned char *out)
+{
+    int             datalen = tb->valuesize + tb->attrsize;
+    unsigned char   *pos = out;
+    int64_t         v, prev = 0;
+    uint64_t        d;
+    uint32_t        i;
+
+    for (i = 0; i < count; i++) {
+        char *value = items + (size_t)i * datalen;
+        if (tb->valuesize == 4) {
+            int32_t  v4;
+            memcpy(&v4, value, 4);
+            v = (tb->valuetype == MEMLINK_VALUE_INT) ? v4 : (int64_t)(uint32_t)v4;
+        }else{
+            memcpy(&v, value, 8);
+        }
+        d = (uint64_t)v - (uint64_t)prev;
+        d = (d << 1) ^ (uint64_t)((int64_t)d >> 63);
+        while (d >= 0x80) {
+            *pos++ = (d & 0x7f) | 0x80;
+            d >>= 7;
+        }
+        *pos++ = d;
+        prev = v;
+    }
+    for (i = 0; i < count; i++) {
+        memcpy(pos, items + (size_t)i * datalen + tb->valuesize, tb->attrsize);
+        pos += tb->attrsize;
+    }
+    return pos - out;
+}
+
+static void
+coldstore_delta_decode(Table *tb, unsigned char *in, uint32_t count, char *items)
+{
+    int             datalen = tb->valuesize + tb->attrsize;
+    int64_t         v = 0;
+    uint64_t        d;
+    uint32_t        i;
+    int             shift;
+
+    for (i = 0; i < count; i++) {
+        d = 0;
+        shift = 0;
+        while (*in & 0x80) {
+            d |= (uint64_t)(*in++ & 0x7f) << shift;
+            shift += 7;
+        }
+        d |= (uint64_t)*in++ << shift;
+        v = (int64_t)((uint64_t)v + ((d >> 1) ^ -(d & 1)));
+        if (tb->valuesize == 4) {
+            int32_t v4 = (int32_t)v;
+            memcpy(items + (size_t)i * datalen, &v4, 4);
+        }else{
+            memcpy(items + (size_t)i * datalen, &v, 8);
+        }
+    }
+    for (i = 0; i < count; i++) {
+        memcpy(items + (size_t)i * datalen + tb->valuesize, in, tb->attrsize);
+        in += tb->attrsize;
+    }
+}
+
+/**
+ * compress value|attr items, delta coded first for integer values
+ * @return buffer of *len bytes, NULL when not smaller than items
+ */
+static char*
+coldstore_encode(Table *tb, char *items, uint32_t count, uint32_t *len, uint32_t *codec)
+{
+    size_t  rawlen = (size_t)count * (tb->valuesize + tb->attrsize);
+    char    *src = items, *delta = NULL, *out;
+    size_t  srclen = rawlen, clen;
+
+    *codec = 0;
+    if (coldstore_is_integer(tb)) {
+        delta  = zz_malloc((size_t)count * (10 + tb->attrsize));
+        srclen = coldstore_delta_encode(tb, items, count, (unsigned char*)delta);
+        if (srclen < rawlen) {
+            src = delta;
+            *codec |= COLD_CODEC_DELTA;
+        }else{
+            srclen = rawlen;
+        }
+    }
+    out  = zz_malloc(srclen + 400);
+    clen = qlz_compress(src, out, srclen, &qlz_cstate);
+    if (clen < srclen) {
+        *codec |= COLD_CODEC_QLZ;
+        *len = clen;
+        if (delta) {
+            zz_free(delta);
+        }
+        return out;
+    }
+    zz_free(out);
+    if (*codec & COLD_CODEC_DELTA) {
+        *len = srclen;
+        return delta;
+    }
+    if (delta) {
+        zz_free(delta);
+    }
+    return NULL;
+}
+
+static int
+coldstore_decode(Table *tb, ColdRecord *rec, char *items)
+{
+    size_t  rawlen = (size_t)rec->count * rec->datalen;
+    char    *delta = rec->data;
+
+    if (rec->codec & COLD_CODEC_QLZ) {
+        size_t size = qlz_size_decompressed(rec->data);
+        if ((rec->codec & COLD_CODEC_DELTA) ? size > rec->count * (size_t)(10 + tb->attrsize) :
+                                              size != rawlen) {
+            return MEMLINK_ERR_IO;
+        }
+        if (rec->codec & COLD_CODEC_DELTA) {
+            delta = zz_malloc(size);
+            qlz_decompress(rec->data, delta, &qlz_dstate);
+        }else{
+            qlz_decompress(rec->data, items, &qlz_dstate);
+        }
+    }
+    if (rec->codec & COLD_CODEC_DELTA) {
+        coldstore_delta_decode(tb, (unsigned char*)delta, rec->count, items);
+        if (delta != rec->data) {
+            zz_free(delta);
+        }
+    }
+    return MEMLINK_OK;
+}
+
+/**
+ * value|attr items of a record, decompressed to *buf which caller frees
+ * @return NULL when the record is broken
+ */
+char*
+coldstore_items(Table *tb, ColdRecord *rec, char **buf)
+{
+    *buf = NULL;
+    if (rec->codec == 0) {
+        return rec->data;
+    }
+    *buf = zz_malloc((size_t)rec->count * rec->datalen);
+    if (coldstore_decode(tb, rec, *buf) != MEMLINK_OK) {
+        zz_free(*buf);
+        *buf = NULL;
+        return NULL;
+    }
+    return *buf;
+}
+
+/**
+ * copy items of node to pos, value|attr in file like dump, column layout too
+ */
+static void
+coldstore_copy_items(Table *tb, HashNode *node, char *pos)
+{
+    DataBlock   *dbk;
+    char        *itemdata;
+    int         datalen = tb->valuesize + tb->attrsize;
+    int         i;
+
+    for (dbk = node->data; dbk; dbk = dbk->next) {
+        itemdata = dbk->data;
+        for (i = 0; i < dbk->data_count; i++) {
+            if (dataitem_have_data(tb, dbk, itemdata, 0)) {
+                if (tb->layout == MEMLINK_LAYOUT_COLUMN) {
+                    memcpy(pos, itemdata, tb->valuesize);
+                    memcpy(pos + tb->valuesize, dataitem_attr(tb, dbk, itemdata), tb->attrsize);
+                }else{
+                    memcpy(pos, itemdata, datalen);
+                }
+                pos += datalen;
+            }
+            itemdata += dataitem_step(tb);
+        }
+    }
+}
+
+/**
+ * write items of node to the cold store, or compress them in memory for a
+ * table not cold, DataBlocks go back to pool. caller holds g_runtime->mutex
+ */
+int
+coldstore_spill(ColdStore *cs, Table *tb, HashNode *node)
+{
+    ColdStore   *to = NULL;
+    DataBlock   *dbk, *tmp;
+    ColdRecord  *rec;
+    char        *itemdata, *items, *enc = NULL;
+    uint32_t    count = 0, clen = 0, codec = 0;
+    uint64_t    size;
+    int         datalen = tb->valuesize + tb->attrsize;
+    int         i;
+
+    if (hashnode_is_cold(node) || NULL == node->data) {
+        return MEMLINK_ERR_PARAM;
+    }
+    for (dbk = node->data; dbk; dbk = dbk->next) {
+        itemdata = dbk->data;
+        for (i = 0; i < dbk->data_count; i++) {
+            if (dataitem_have_data(tb, dbk, itemdata, 0)) {
+                count++;
+            }
+            itemdata += dataitem_step(tb);
+        }
+    }
+    if (count == 0) {
+        return MEMLINK_ERR_PARAM;
+    }
+
+    if (tb->compress) {
+        items = zz_malloc((size_t)count * datalen);
+        coldstore_copy_items(tb, node, items);
+        enc = coldstore_encode(tb, items, count, &clen, &codec);
+        zz_free(items);
+        // not smaller, kept in blocks if not cold. it is not compressed
+        // again until idle for another compress_time
+        if (NULL == enc && !tb->cold) {
+            hashnode_idle_reset(tb, node, time(NULL));
+            return MEMLINK_ERR_PARAM;
+        }
+    }
+    size = COLD_ALIGN(sizeof(ColdRecord) + (enc ? clen : (uint64_t)count * datalen));
+    // the old file is only read while compacting
+    to = cs->next ? cs->next : cs;
+    if (tb->cold) {
+        if (coldstore_grow(to, size) < 0) {
+            if (enc) {
+                zz_free(enc);
+            }
+            return MEMLINK_ERR_IO;
+        }
+        rec = (ColdRecord*)(to->map + to->end);
+    }else{
+        rec = (ColdRecord*)zz_malloc(size);
+    }
+    if (enc) {
+        memcpy(rec->data, enc, clen);
+        zz_free(enc);
+    }else{
+        coldstore_copy_items(tb, node, rec->data);
+    }
+    rec->size    = size;
+    rec->count   = count;
+    rec->datalen = datalen;
+    rec->hash    = node->hash;
+    rec->clen    = clen;
+    rec->codec   = codec;
+
+    hashnode_index_free(tb, node);
+    dbk = node->data;
+    // cold mark first and a barrier before the link is detached, a reader
+    // loading node->data as NULL sees the mark and reads the node back
+    if (tb->cold) {
+        node->cold = to->end << 1 | to->gen | 1;
+        to->end  += size;
+        cs->live += size;
+        cs->keys++;
+        if (to != cs) {
+            to->live += size;
+            to->keys++;
+        }
+    }else{
+        node->cold = (uintptr_t)rec | 3;
+        tb->compress_mem += size;
+        tb->compress_keys++;
+        mem_used_inc(size);
+    }
+    __sync_synchronize();
+    *(DataBlock * volatile *)&node->data = NULL;
+    node->used = rec->count;
+    node->all  = rec->count;
+    while (dbk) {
+        tmp = dbk;
+        dbk = dbk->next;
+        datablock_put(tb, tmp);
+    }
+
+    return MEMLINK_OK;
+}
+
+/**
+ * the record is not used by node any more
+ */
+static void
+coldstore_release(ColdStore *cs, Table *tb, HashNode *node, ColdRecord *rec)
+{
+    if (hashnode_cold_in_mem(node)) {
+        tb->compress_mem -= rec->size;
+        tb->compress_keys--;
+        mem_used_dec(rec->size);
+        zz_free(rec);
+    }else{
+        ColdStore *f = coldstore_file(cs, node);
+        if (f != cs) {
+            f->live -= rec->size;
+            f->keys--;
+        }
+        cs->live -= rec->size;
+        cs->keys--;
+    }
+}
+
+/**
+ * read items of a cold node back to full DataBlocks, the same as dump load.
+ * called by read threads from table_find too, they take g_runtime->mutex and
+ * wait for the write in progress, then block writers for the decompression.
+ * compaction only holds the mutex for short steps, see coldstore_compact_step
+ */
+int
+coldstore_load(ColdStore *cs, Table *tb, HashNode *node)
+{
+    DataBlock   *head = NULL, *dbk = NULL, *newdbk;
+    char        *itemdata = NULL, *pos, *buf = NULL;
+    uint32_t    i;
+    int         blockmax;
+    int         ret = MEMLINK_OK;
+
+    pthread_mutex_lock(&g_runtime->mutex);
+    // loaded by another reader while waiting
+    if (!hashnode_is_cold(node)) {
+        goto coldstore_load_over;
+    }
+    ColdRecord *rec = coldstore_record(cs, node);
+    if (rec->hash != node->hash || rec->datalen != tb->valuesize + tb->attrsize) {
+        DERROR("cold record error of %s.%s at %llu\n", tb->name, hashnode_key(node),
+                (unsigned long long)COLD_POS(node));
+        ret = MEMLINK_ERR_IO;
+        goto coldstore_load_over;
+    }
+    pos = coldstore_items(tb, rec, &buf);
+    if (NULL == pos) {
+        DERROR("cold record decompress error of %s.%s\n", tb->name, hashnode_key(node));
+        ret = MEMLINK_ERR_IO;
+        goto coldstore_load_over;
+    }
+    blockmax = datablock_max_size(tb, rec->count);
+    for (i = 0; i < rec->count; i++) {
+        if (i % blockmax == 0) {
+            newdbk = datablock_get(tb, rec->count - i > blockmax ? blockmax : rec->count - i);
+            if (dbk == NULL) {
+                head = newdbk;
+            }else{
+                dbk->next = newdbk;
+            }
+            newdbk->prev = dbk;
+            dbk = newdbk;
+            itemdata = dbk->data;
+        }
+        if (tb->layout == MEMLINK_LAYOUT_COLUMN) {
+            memcpy(itemdata, pos, tb->valuesize);
+            memcpy(dataitem_attr(tb, dbk, itemdata), pos + tb->valuesize, tb->attrsize);
+        }else{
+            memcpy(itemdata, pos, rec->datalen);
+        }
+        if (dataitem_check_data(tb, dbk, itemdata) == MEMLINK_VALUE_VISIBLE) {
+            dbk->visible_count++;
+        }else{
+            dbk->tagdel_count++;
+        }
+        pos += rec->datalen;
+        itemdata += dataitem_step(tb);
+    }
+    if (buf) {
+        zz_free(buf);
+    }
+
+    node->used = rec->count;
+    node->all  = rec->count;
+    node->data = head;
+    __sync_synchronize();
+    coldstore_release(cs, tb, node, rec);
+    node->data_tail = dbk;
+    hashnode_index_update(tb, node);
+
+coldstore_load_over:
+    pthread_mutex_unlock(&g_runtime->mutex);
+    return ret;
+}
+
+/**
+ * record of a removed cold node is dead
+ */
+void
+coldstore_drop(ColdStore *cs, Table *tb, HashNode *node)
+{
+    coldstore_release(cs, tb, node, coldstore_record(cs, node));
+    node->cold = 0;
+}
+
+/**
+ * spill nodes of tb not accessed for cold_time seconds, or compress_time when
+ * the table is only compressed, walk bunks from
+ * *bunk and stop after maxtime us. caller holds g_runtime->mutex
+ * @return 1 when bunks left, 0 when the whole table is walked
+ */
+int
+coldstore_spill_step(ColdStore *cs, Table *tb, uint32_t *bunk, int maxtime)
+{
+    HashIndex   *hi = tb->index[0];
+    HashNode    *node;
+    struct timeval start, end;
+    time_t      now = time(NULL);
+    uint32_t    idle = tb->cold ? g_cf->cold_time : g_cf->compress_time;
+
+    // bunks move while rehashing, try again next time
+    if (tb->rehashidx >= 0) {
+        return 0;
+    }
+    gettimeofday(&start, NULL);
+    while (*bunk < hi->size) {
+        for (node = hi->bunks[*bunk]; node; node = node->next) {
+            if (!hashnode_is_cold(node) && node->data && node->used > 0 &&
+                hashnode_idle(tb, node, now) >= idle) {
+                if (coldstore_spill(cs, tb, node) == MEMLINK_ERR_IO) {
+                    return 0;
+                }
+            }
+        }
+        (*bunk)++;
+        if ((*bunk & 63) == 0) {
+            gettimeofday(&end, NULL);
+            if (timediff(&start, &end) >= maxtime) {
+                break;
+            }
+        }
+    }
+    return *bunk < hi->size;
+}
+
+/**
+ * start to copy live records to a new file when more than half of the file 
+ * is dead. new records go to the new file, coldstore_compact_step moves the
+ * old ones in short steps. caller holds g_runtime->mutex
+ * @return 1 when compacting, 0 when not needed
+ */
+int
+coldstore_compact_start(ColdStore *cs)
+{
+    ColdStore   *newcs;
+
+    if (cs->next) {
+        return 1;
+    }
+    if (cs->end < COLDSTORE_COMPACT_MIN || cs->live * 2 > cs->end) {
+        return 0;
+    }
+    newcs = (ColdStore*)zz_malloc(sizeof(ColdStore));
+    if (NULL == newcs) {
+        DERROR("malloc ColdStore error!\n");
+        MEMLINK_EXIT;
+        return MEMLINK_ERR_MEM;
+    }
+    memset(newcs, 0, sizeof(ColdStore));
+    snprintf(newcs->path, PATH_MAX, "%s.tmp", cs->path);
+    newcs->gen = cs->gen ^ COLD_GEN;
+    newcs->fd  = open(newcs->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (newcs->fd < 0) {
+        char errbuf[1024];
+        strerror_r(errno, errbuf, 1024);
+        DERROR("open %s error: %s\n", newcs->path, errbuf);
+        zz_free(newcs);
+        return MEMLINK_ERR_IO;
+    }
+    if (coldstore_grow(newcs, cs->live + COLDSTORE_GROW) < 0) {
+        close(newcs->fd);
+        unlink(newcs->path);
+        zz_free(newcs);
+        return MEMLINK_ERR_IO;
+    }
+    DNOTE("start compact cold store, end:%llu, live:%llu, keys:%u\n", 
+            (unsigned long long)cs->end, (unsigned long long)cs->live, cs->keys);
+    cs->next = newcs;
+
+    return 1;
+}
+
+/**
+ * move records of cold nodes of tb in the old file to the compacted one, 
+ * walk bunks of both indexes from *bunk and stop after maxtime us. 
+ * nodes moved by rehash may be missed, coldstore_compact_finish waits 
+ * for them in the next walk. caller holds g_runtime->mutex
+ * @return 1 when bunks left, 0 when the whole table is walked
+ */
+int
+coldstore_compact_step(ColdStore *cs, Table *tb, uint32_t *bunk, int maxtime)
+{
+    ColdStore   *newcs = cs->next;
+    ColdRecord  *rec;
+    HashIndex   *hi;
+    HashNode    *node;
+    struct timeval start, end;
+    uint32_t    b;
+
+    if (NULL == newcs || !tb->cold) {
+        return 0;
+    }
+    gettimeofday(&start, NULL);
+    while (*bunk < tb->index[0]->size + tb->index[1]->size) {
+        hi = tb->index[0];
+        b  = *bunk;
+        if (b >= hi->size) {
+            b -= hi->size;
+            hi = tb->index[1];
+        }
+        for (node = hi->bunks[b]; node; node = node->next) {
+            if (!hashnode_is_cold(node) || hashnode_cold_in_mem(node) || 
+                coldstore_file(cs, node) != cs)
+                continue;
+            rec = coldstore_record(cs, node);
+            if (coldstore_grow(newcs, rec->size) < 0) {
+                return 0;
+            }
+            memcpy(newcs->map + newcs->end, rec, rec->size);
+            node->cold = newcs->end << 1 | newcs->gen | 1;
+            newcs->end  += rec->size;
+            newcs->live += rec->size;
+            newcs->keys++;
+        }
+        (*bunk)++;
+        if ((*bunk & 63) == 0) {
+            gettimeofday(&end, NULL);
+            if (timediff(&start, &end) >= maxtime) {
+                break;
+            }
+        }
+    }
+    return *bunk < tb->index[0]->size + tb->index[1]->size;
+}
+
+/**
+ * switch to the compacted file when no record is left in the old one.
+ * the file is only a spill area rebuilt at start, so when rename fails the 
+ * mapping of the new file is still used and the old file is emptied.
+ * caller holds g_runtime->mutex
+ * @return 1 when records are left in the old file, 0 when switched or not compacting
+ */
+int
+coldstore_compact_finish(ColdStore *cs)
+{
+    ColdStore   *newcs = cs->next;
+
+    if (NULL == newcs) {
+        return 0;
+    }
+    if (newcs->keys != cs->keys) {
+        DINFO("cold store compacting, keys left:%u\n", cs->keys - newcs->keys);
+        return 1;
+    }
+    DNOTE("compact cold store %llu => %llu bytes, keys:%u\n", (unsigned long long)cs->end,
+            (unsigned long long)newcs->end, newcs->keys);
+
+    if (rename(newcs->path, cs->path) < 0) {
+        char errbuf[1024];
+        strerror_r(errno, errbuf, 1024);
+        DERROR("rename %s error: %s\n", newcs->path, errbuf);
+        if (ftruncate(cs->fd, 0) < 0) {
+            strerror_r(errno, errbuf, 1024);
+            DERROR("ftruncate %s error: %s\n", cs->path, errbuf);
+        }
+        unlink(newcs->path);
+    }
+    munmap(cs->map, cs->size);
+    close(cs->fd);
+    cs->fd   = newcs->fd;
+    cs->map  = newcs->map;
+    cs->size = newcs->size;
+    cs->end  = newcs->end;
+    cs->live = newcs->live;
+    cs->gen  = newcs->gen;
+    cs->next = NULL;
+    zz_free(newcs);
+
+    return 0;
+}
+
+/**
+ * @}
+ */
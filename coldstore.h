@@ -0,0 +1,50 @@
+#ifndef MEMLINK_COLDSTORE_H
+#define MEMLINK_COLDSTORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include "hashtable.h"
+
+#define COLD_CODEC_DELTA    1  // integer values as zigzag varint deltas, then attrs
+#define COLD_CODEC_QLZ      2  // QuickLZ over the items or the deltas
+
+// items of one spilled HashNode, value|attr each like the dump file
+typedef struct _memlink_coldrecord
+{
+    uint64_t    size;    // record bytes with head, 8 aligned
+    uint32_t    count;   // item count
+    uint32_t    datalen; // valuesize + attrsize
+    uint32_t    hash;    // node->hash, checked when loaded
+    uint32_t    clen;    // bytes of data when compressed
+    uint32_t    codec;   // COLD_CODEC_xxx bits, 0 means items are not compressed
+    char        data[0];
+}ColdRecord;
+
+// append only segment file mapped to memory, records are faulted back by table_find
+typedef struct _memlink_coldstore
+{
+    char        path[PATH_MAX];
+    int         fd;
+    char        *map;
+    uint64_t    size;  // bytes of file and map
+    uint64_t    end;   // next record position
+    uint64_t    live;  // bytes of records still referenced by HashNode, with next
+    uint32_t    keys;  // HashNode in cold store, with next
+    uint32_t    gen;   // COLD_GEN bit of node->cold for records of this file
+    struct _memlink_coldstore *next; // file compacted to, new records go there
+}ColdStore;
+
+ColdStore*	coldstore_create(char *path);
+void		coldstore_destroy(ColdStore *cs);
+int			coldstore_spill(ColdStore *cs, Table *tb, HashNode *node);
+int			coldstore_load(ColdStore *cs, Table *tb, HashNode *node);
+void		coldstore_drop(ColdStore *cs, Table *tb, HashNode *node);
+ColdRecord*	coldstore_record(ColdStore *cs, HashNode *node);
+char*		coldstore_items(Table *tb, ColdRecord *rec, char **buf);
+int			coldstore_spill_step(ColdStore *cs, Table *tb, uint32_t *bunk, int maxtime);
+int			coldstore_compact_start(ColdStore *cs);
+int			coldstore_compact_step(ColdStore *cs, Table *tb, uint32_t *bunk, int maxtime);
+int			coldstore_compact_finish(ColdStore *cs);
+
+#endif
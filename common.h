@@ -164,8 +164,21 @@
 #define HASHTABLE_MAX_TABLE			1000
 // Table名称最大长度
 #define HASHTABLE_TABLE_NAME_SIZE	64
-/// HashTable中桶的数量
-#define HASHTABLE_BUNKNUM           1000000
+/// 每个Table哈希索引的初始桶数量，必须是2的幂
+#define HASHTABLE_INDEX_INIT_SIZE   16
+/// 每次写操作渐进式rehash迁移的桶数量
+#define HASHTABLE_REHASH_STEP       4
+/// key数量少于桶数量的1/8时rehash到较小的索引
+#define HASHTABLE_SHRINK_RATIO      8
+/// 长度小于此值的key直接保存在HashNode中
+#define HASHNODE_KEY_INLINE         16
+/// HashNode slab的初始和最大节点数
+#define HASHNODE_SLAB_MIN           16
+#define HASHNODE_SLAB_MAX           4096
+/// 按位置查找时, 位置不小于此值才使用DataBlock位置索引
+#define BLOCKINDEX_MIN_POS          1000
+/// 位置索引中每隔多少个DataBlock记录一项
+#define BLOCKINDEX_STEP             8
 /// 最大允许的attr项数
 #define HASHTABLE_ATTR_MAX_BIT      32
 #define HASHTABLE_ATTR_MAX_BYTE     4
@@ -191,6 +204,76 @@
 // 按value排序的列表
 #define MEMLINK_SORTLIST    3
 
+// 数据块中value和attr交错存放
+#define MEMLINK_LAYOUT_ROW      0
+// 数据块中所有value在前, 所有attr在后
+#define MEMLINK_LAYOUT_COLUMN   1
+
+// 数据块的slab使用普通页
+#define MEMLINK_HUGEPAGE_NO         0
+// slab从2M对齐的区域分配, madvise(MADV_HUGEPAGE)使用透明大页
+#define MEMLINK_HUGEPAGE_THP        1
+// slab从hugetlbfs大页分配(MAP_HUGETLB), 失败时使用透明大页
+#define MEMLINK_HUGEPAGE_HUGETLB    2
+
+// 超过max_mem时不淘汰key, 写操作返回MEMLINK_ERR_MEM
+#define MEMLINK_EVICT_NONE          0
+// 超过max_mem时淘汰最久未访问的key(近似LRU)
+#define MEMLINK_EVICT_LRU           1
+// 超过max_mem时淘汰访问频率最低的key(近似LFU)
+#define MEMLINK_EVICT_LFU           2
+/// 每次淘汰时随机抽样的key数量
+#define MEMLINK_EVICT_SAMPLES       5
+/// 淘汰时最多探测的随机位置数, 每个位置最多看MEMLINK_EVICT_WINDOW个连续的bunk
+#define MEMLINK_EVICT_PROBES        (MEMLINK_EVICT_SAMPLES * 4)
+#define MEMLINK_EVICT_WINDOW        HASHTABLE_INDEX_INIT_SIZE
+/// 每个写操作最多淘汰的key数量
+#define MEMLINK_EVICT_MAX_KEYS      16
+/// LFU计数的初始值, 对数增长因子和衰减周期(分钟)
+#define MEMLINK_LFU_INIT            5
+#define MEMLINK_LFU_LOG_FACTOR      10
+#define MEMLINK_LFU_DECAY_TIME      1
+
+/// 冷存储文件每次增长的字节数
+#define COLDSTORE_GROW              (16 * 1024 * 1024)
+/// 冷存储文件超过此大小且一半以上记录已失效时压缩
+#define COLDSTORE_COMPACT_MIN       (64 * 1024 * 1024)
+/// 后台每隔多少秒检查一次需要移到冷存储的key
+#define COLDSTORE_SCAN_INTERVAL     60
+
+/// 变长值内存区每次分配的大小, 也是对齐的边界
+#define VALUEARENA_CHUNK_SIZE       (64 * 1024)
+/// 变长值内存区超过存活数据两倍加上此大小时整理
+#define VALUEARENA_COMPACT_MIN      (1024 * 1024)
+/// 后台每隔多少秒检查一次变长值内存区是否需要整理
+#define VALUEARENA_SCAN_INTERVAL    10
+/// 变长值去重字典的初始槽数, 须为2的幂
+#define VALUEARENA_DICT_INIT_SIZE   1024
+
+/// 可注册的读线程数上限, 每个读线程一个epoch槽
+#define EPOCH_SLOT_MAX              64
+/// 每批延迟释放的对象数, 一批满时封存并尝试回收
+#define EPOCH_BATCH_SIZE            256
+
+/// 读线程每隔多少秒统计一次负载, 检查是否迁移空闲连接
+#define READ_LOAD_INTERVAL          1
+/// 分配新连接时每个已有连接折算的负载, 微秒/秒
+#define READ_CONN_LOAD              1000
+/// 读线程负载超过此值(微秒/秒), 且是最空闲线程的READ_MIGRATE_RATIO倍时迁出空闲连接
+#define READ_MIGRATE_MIN_LOAD       100000
+#define READ_MIGRATE_RATIO          2
+/// 每次最多迁出的空闲连接数
+#define READ_MIGRATE_MAX            8
+/// 等待执行线程处理的读命令数上限, 超过时在读线程执行
+#define EXEC_JOB_MAX                1024
+
+/// block_table中数据块的最大数据项数
+#define MEMLINK_BLOCK_COUNT_MAX     4096
+/// 一个表的数据块大小最多有多少种
+#define MEMLINK_BLOCK_SIZES_MAX     32
+/// 超过block_data_count最大值的数据块只给数据项数不少于块大小这么多倍的链表使用
+#define MEMLINK_BLOCK_ADAPT_RATE    4
+
 // 查找排序列表时，每次每次跳过多少个block
 #define MEMLINK_SORTLIST_LOOKUP_STEP    10
 
@@ -208,6 +291,8 @@
 #define MEMLINK_VALUE_FLOAT8        6 
 #define MEMLINK_VALUE_STRING        7 
 #define MEMLINK_VALUE_OBJ           8
+/// 变长字符串, 数据项里只存指向表的值内存区的指针, 不支持排序列表
+#define MEMLINK_VALUE_VSTRING       9
 
 #define MEMLINK_SORTLIST_ORDER_ASC  0x00010000
 #define MEMLINK_SORTLIST_ORDER_DESC 0x00020000
@@ -225,9 +310,6 @@
 #define MEMLINK_CMP_RANGE   1
 #define MEMLINK_CMP_EQUAL   2
 
-// 内存限制检查间隔时间，秒
-#define MEM_CHECK_INTERVAL	3
-
 
 #define STATE_INIT			200 
 #define STATE_DATAOK		201
@@ -321,6 +403,13 @@ typedef struct _ht_stat_sys
 
     int logver;
     int logline;
+
+    unsigned int   slab_mem;     // KB, slabs of DataBlock in use
+    unsigned int   hugepage_mem; // KB, slab memory backed by huge pages
+    unsigned int   mem_used;     // KB, memory counted for max_mem
+    unsigned int   evicted_keys; // keys evicted since start
+    unsigned int   cold_keys;    // keys in cold store
+    unsigned int   cold_mem;     // KB, live records in cold store file
 }MemLinkStatSys;
 
 typedef MemLinkStatSys	HashTableStatSys;
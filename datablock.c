@@ -7,6 +7,16 @@
  */
 
 #include <math.h>
+#include <limits.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define MEMLINK_SCAN_AVX2
+#include <immintrin.h>
+#endif
 #include "datablock.h"
 #include "hashtable.h"
 #include "logfile.h"
@@ -15,6 +25,7 @@
 #include "zzmalloc.h"
 #include "serial.h"
 #include "runtime.h"
+#include "valuearena.h"
 
 /**
  * 检查dataitem_check的返回值是否符合kind
@@ -43,9 +54,9 @@ dataitem_check_kind(int ret, int kind)
  * @param kind
  */
 inline int 
-dataitem_have_data(Table *tb, HashNode *node, char *itemdata, unsigned char kind)
+dataitem_have_data(Table *tb, DataBlock *dbk, char *itemdata, unsigned char kind)
 {
-    char *attrdata  = itemdata + tb->valuesize;
+    char *attrdata  = dataitem_attr(tb, dbk, itemdata);
     
     if (kind == MEMLINK_VALUE_VISIBLE) { // find visible
         if ((*attrdata & (unsigned char)0x03) == 1) {
@@ -86,18 +97,18 @@ dataitem_check(char *itemdata, int valuesize)
  * check value type
  */
 inline int
-dataitem_check_data(Table *tb, HashNode *node, char *itemdata)
+dataitem_check_data(Table *tb, DataBlock *dbk, char *itemdata)
 {
-    return dataitem_check(itemdata, tb->valuesize);
+    return dataitem_check(dataitem_attr(tb, dbk, itemdata), 0);
 }
 
 
 int
 dataitem_skip2pos(Table *tb, HashNode *node, DataBlock *dbk, int skip, unsigned char kind)
 {
-    int datalen = tb->valuesize + tb->attrsize;
-    int i;
-    char *data;
+    AttrMatch am;
+    uint64_t  mask;
+    int i, c;
     
     //DINFO("skip2pos, skip:%d, data count:%d\n", skip, dbk->data_count);
     //if (skip < 0 || skip > g_cf->block_data_count[g_cf->block_data_count_items - 1]) { // last
@@ -105,21 +116,38 @@ dataitem_skip2pos(Table *tb, HashNode *node, DataBlock *dbk, int skip, unsigned
         return -1;
     }
 
-    data = dbk->data;
-    for (i = 0; i < dbk->data_count; i++) {
-        if (skip == 0)
-            return i;
-        if (dataitem_have_data(tb, node, data, kind)) {
-            skip--;
+    if (skip == 0)
+        return 0;
+
+    attrmatch_init(tb, &am, kind, NULL, NULL);
+    for (i = 0; i < dbk->data_count; i += 64) {
+        mask = datablock_scan(tb, dbk, i, &am);
+        c = __builtin_popcountll(mask);
+        if (c < skip) {
+            skip -= c;
+            continue;
         }
-        data += datalen;
+        // position after the skip-th item
+        while (--skip > 0) {
+            mask &= mask - 1;
+        }
+        return i + __builtin_ctzll(mask) + 1;
     }
-    
-    if (skip == 0)
-        return i;
     return -1;  
 }
 
+/**
+ * value of an item is the same as value of a command
+ */
+static inline int
+dataitem_equal(Table *tb, char *itemdata, void *value)
+{
+    if (table_is_vstring(tb)) {
+        return valuearena_equal(&tb->varena, itemdata, value);
+    }
+    return memcmp(value, itemdata, tb->valuesize) == 0;
+}
+
 /**
  * find one data in link of datablock
  * @param node
@@ -131,14 +159,14 @@ char*
 dataitem_lookup(Table *tb, HashNode *node, void *value, DataBlock **dbk)
 {
     int i;
-    int datalen = tb->valuesize + tb->attrsize;
+    int datalen = dataitem_step(tb);
     DataBlock *root = node->data;
 
     while (root) {
         char *data = root->data;
         //DINFO("root: %p, data: %p, next: %p\n", root, data, root->next);
         for (i = 0; i < root->data_count; i++) {
-            if (dataitem_have_data(tb, node, data, 0) && memcmp(value, data, tb->valuesize) == 0) {
+            if (dataitem_have_data(tb, root, data, 0) && dataitem_equal(tb, data, value)) {
                 if (dbk) {
                     *dbk = root;
                 }
@@ -162,14 +190,14 @@ int
 dataitem_lookup_pos(Table *tb, HashNode *node, void *value, DataBlock **dbk)
 {
     int i;
-    int datalen = tb->valuesize + tb->attrsize;
+    int datalen = dataitem_step(tb);
     DataBlock *root = node->data;
 
     while (root) {
         char *data = root->data;
         //DINFO("root: %p, data: %p, next: %p\n", root, data, root->next);
         for (i = 0; i < root->data_count; i++) {
-            if (dataitem_have_data(tb, node, data, 0) && memcmp(value, data, tb->valuesize) == 0) {
+            if (dataitem_have_data(tb, root, data, 0) && dataitem_equal(tb, data, value)) {
                 if (dbk) {
                     *dbk = root;
                 }
@@ -182,39 +210,72 @@ dataitem_lookup_pos(Table *tb, HashNode *node, void *value, DataBlock **dbk)
     return MEMLINK_ERR_NOVAL;
 }
 
-inline int 
-sortlist_valuecmp(unsigned char type, void *v1, void *v2, int size)
+/*
+ * 数值类型比较, 用比较结果相减而不是值相减, 避免溢出和截断.
+ * 数据块中的value不一定对齐, 先拷贝出来
+ */
+#define VALUECMP_NUMBER(name, type) \
+static int \
+name(void *v1, void *v2, int size) \
+{ \
+    type a, b; \
+    memcpy(&a, v1, sizeof(type)); \
+    memcpy(&b, v2, sizeof(type)); \
+    return (a > b) - (a < b); \
+}
+
+VALUECMP_NUMBER(valuecmp_int4, int32_t)
+VALUECMP_NUMBER(valuecmp_uint4, uint32_t)
+VALUECMP_NUMBER(valuecmp_int8, int64_t)
+VALUECMP_NUMBER(valuecmp_uint8, uint64_t)
+VALUECMP_NUMBER(valuecmp_float4, float)
+VALUECMP_NUMBER(valuecmp_float8, double)
+
+static int
+valuecmp_string(void *v1, void *v2, int size)
+{
+    //DINFO("compare string: %s, %s, size:%d\n", (char*)v1, (char*)v2, size);
+    return strncmp(v1, v2, size);
+}
+
+static int
+valuecmp_binary(void *v1, void *v2, int size)
+{
+    return memcmp(v1, v2, size);
+}
+
+/**
+ * comparator of a value type, set to Table.valuecmp at table create
+ */
+ValueCmpFunc
+sortlist_valuecmp_func(unsigned char type)
 {
-    //DINFO("value type:%d\n", type);
     switch(type) {
         case MEMLINK_VALUE_INT:
-            return *(int*)v1 - *(int*)v2; 
+            return valuecmp_int4;
         case MEMLINK_VALUE_UINT:
-            return *(unsigned int*)v1 - *(unsigned int*)v2; 
+            return valuecmp_uint4;
         case MEMLINK_VALUE_LONG:
-            return *(long*)v1 - *(long*)v2; 
+            return valuecmp_int8;
         case MEMLINK_VALUE_ULONG:
-            return *(unsigned long*)v1 - *(unsigned long*)v2; 
-        case MEMLINK_VALUE_FLOAT: {
-            float v = *(float*)v1 - *(float*)v2; 
-            if ((v > 0 && v < 0.00001) || (v < 0 && v > 0.00001))
-                return 0;
-            return (int)v; 
-        }
-        case MEMLINK_VALUE_DOUBLE: {
-            double v = *(double*)v1 - *(double*)v2; 
-            if ((v > 0 && v < 0.00001) || (v < 0 && v > 0.00001))
-                return 0;
-            return (int)v;
-        }
+            return valuecmp_uint8;
+        case MEMLINK_VALUE_FLOAT:
+            return valuecmp_float4;
+        case MEMLINK_VALUE_DOUBLE:
+            return valuecmp_float8;
         case MEMLINK_VALUE_STRING:
-            //DINFO("compare string: %s, %s, size:%d\n", (char*)v1, (char*)v2, size);
-            return strncmp(v1, v2, size);
+            return valuecmp_string;
         default:
-            return memcmp(v1, v2, size);
+            return valuecmp_binary;
     }
 }
 
+int 
+sortlist_valuecmp(unsigned char type, void *v1, void *v2, int size)
+{
+    return sortlist_valuecmp_func(type)(v1, v2, size);
+}
+
 /**
  * 和DataBlockz中第一个数据比较
  */
@@ -230,9 +291,9 @@ sortlist_datablock_check(Table *tb, HashNode *node, DataBlock *dbk, void *value,
         data = dbk->data;
         for (i = 0; i < dbk->data_count; i++) {
             //DINFO("check first to last i:%d, node value:%d, value:%d\n", i, *(int*)data, *(int*)value);
-            if (dataitem_have_data(tb, node, data, kind)) {
+            if (dataitem_have_data(tb, dbk, data, kind)) {
                 *pos = i;
-                ret = sortlist_valuecmp(tb->valuetype, value, data, tb->valuesize);
+                ret = tb->valuecmp(value, data, tb->valuesize);
                 //DINFO("ret: %d\n", ret);
                 //memcpy(buf, data, node->valuesize);
                 //DINFO("1 valuecmp: %s %s, ret:%d\n", (char*)value, buf, ret);
@@ -245,9 +306,9 @@ sortlist_datablock_check(Table *tb, HashNode *node, DataBlock *dbk, void *value,
         data = dbk->data + (dbk->data_count - 1) * datalen;
         for (i = dbk->data_count - 1; i >= 0; i--) {
             //DINFO("check last to first i:%d\n", i);
-            if (dataitem_have_data(tb, node, data, kind)) {
+            if (dataitem_have_data(tb, dbk, data, kind)) {
                 *pos = i;
-                ret = sortlist_valuecmp(tb->valuetype, value, data, tb->valuesize);
+                ret = tb->valuecmp(value, data, tb->valuesize);
                 //DINFO("ret: %d\n", ret);
                 //memcpy(buf, data, node->valuesize);
                 //DINFO("1 valuecmp: %s %s, ret:%d\n", (char*)value, buf, ret);
@@ -281,8 +342,8 @@ sortlist_datablock_check_all(Table *tb, HashNode *node, DataBlock *dbk, void *va
     if (direction == MEMLINK_FIND_ASC) {
         data = dbk->data;
         for (i = 0; i < dbk->data_count; i++) {
-            if (dataitem_have_data(tb, node, data, kind)) {
-                ret = sortlist_valuecmp(tb->valuetype, value, data, tb->valuesize);
+            if (dataitem_have_data(tb, dbk, data, kind)) {
+                ret = tb->valuecmp(value, data, tb->valuesize);
                 if (cmptype == MEMLINK_CMP_RANGE) {
                     if (ret <= 0)
                         return i;
@@ -299,8 +360,8 @@ sortlist_datablock_check_all(Table *tb, HashNode *node, DataBlock *dbk, void *va
     }else{
         data = dbk->data + (dbk->data_count - 1)* datalen;
         for (i = dbk->data_count - 1; i >= 0; i--) {
-            if (dataitem_have_data(tb, node, data, kind)) {
-                ret = sortlist_valuecmp(tb->valuetype, value, data, tb->valuesize);
+            if (dataitem_have_data(tb, dbk, data, kind)) {
+                ret = tb->valuecmp(value, data, tb->valuesize);
                 if (cmptype == MEMLINK_CMP_RANGE) {
                     if (ret >= 0) {
                         return i + 1;
@@ -319,16 +380,75 @@ sortlist_datablock_check_all(Table *tb, HashNode *node, DataBlock *dbk, void *va
     return MEMLINK_ERR_NOVAL;
 }
 
+/**
+ * DataBlock capacities of a table: block_data_count, cut or extended to the
+ * max in block_table. sizes over block_data_count double up to the max.
+ * no block is bigger than MEMPOOL_BLOCK_MAX bytes
+ */
+void
+datablock_init_sizes(Table *tb)
+{
+    int max  = myconfig_block_max(tb->name);
+    int gmax = g_cf->block_data_count[g_cf->block_data_count_items - 1];
+    int itemmax = (MEMPOOL_BLOCK_MAX - sizeof(DataBlock)) / (tb->valuesize + tb->attrsize);
+    int n = 0, i;
+
+    for (i = 0; i < g_cf->block_data_count_items && n < MEMLINK_BLOCK_SIZES_MAX; i++) {
+        if (max > 0 && g_cf->block_data_count[i] >= max) 
+            break;
+        tb->block_count[n++] = g_cf->block_data_count[i];
+    }
+    if (max > 0) {
+        while (n > 0 && n < MEMLINK_BLOCK_SIZES_MAX - 1 && tb->block_count[n - 1] >= gmax &&
+               tb->block_count[n - 1] * 2 < max) {
+            tb->block_count[n] = tb->block_count[n - 1] * 2;
+            n++;
+        }
+        tb->block_count[n++] = max;
+    }
+    // a block must fit in a slab, the biggest size is cut to the most items that fit
+    for (i = 0; i < n && tb->block_count[i] <= itemmax; i++);
+    if (i < n) {
+        DNOTE("block size of table %s is cut from %d to %d\n", tb->name, tb->block_count[n - 1], itemmax);
+        if (i == 0 || tb->block_count[i - 1] < itemmax) {
+            tb->block_count[i++] = itemmax;
+        }
+        n = i;
+    }
+    tb->block_count_items = n;
+
+    for (i = 0; i < n && tb->block_count[i] <= gmax; i++);
+    tb->block_count_base = i > 0 ? i : 1;
+}
+
+/**
+ * biggest DataBlock a list of used items can use. small lists stay in
+ * sizes of block_data_count, a bigger size needs MEMLINK_BLOCK_ADAPT_RATE
+ * times more items in the list
+ */
 int
-datablock_suitable_size(int blocksize)
+datablock_max_size(Table *tb, int used)
 {
+    int i = tb->block_count_base - 1;
+
+    while (i + 1 < tb->block_count_items && 
+           tb->block_count[i + 1] * MEMLINK_BLOCK_ADAPT_RATE <= used) {
+        i++;
+    }
+    return tb->block_count[i];
+}
+
+int
+datablock_suitable_size(Table *tb, int used, int blocksize)
+{
+    int max = datablock_max_size(tb, used);
     int i;
 
-    for (i = 0; i < g_cf->block_data_count_items; i++) {
-        if (blocksize <= g_cf->block_data_count[i])
-            return g_cf->block_data_count[i];
+    for (i = 0; i < tb->block_count_items && tb->block_count[i] < max; i++) {
+        if (blocksize <= tb->block_count[i])
+            return tb->block_count[i];
     }
-    return g_cf->block_data_count[g_cf->block_data_count_items - 1];
+    return max;
 }
 
 int
@@ -337,7 +457,7 @@ datablock_last_valid_pos(Table *tb, HashNode *node, DataBlock *dbk, int kind, in
     char* data = dbk->data + (dbk->data_count - 1) * datalen;
     int i;
     for (i = dbk->data_count - 1; i >= 0; i--) {
-        if (dataitem_have_data(tb, node, data, kind)) {
+        if (dataitem_have_data(tb, dbk, data, kind)) {
             return i + 1;
         }
         data -= datalen;
@@ -362,6 +482,403 @@ datablock_step_skip(DataBlock *bk, int step)
 }
 
 
+/**
+ * 创建数据链的块索引, 每bindex->step个数据块一段, 段数留出一半空位给尾部增长.
+ * 调用者需持有写锁. 索引发布后各段的大小不再改变, 写线程只用一个字的写入修改
+ * 段的第一个数据块和计数, 读线程不加锁查找
+ */
+static BlockIndex*
+blockindex_create(Table *tb, HashNode *node)
+{
+    DataBlock   *root;
+    BlockIndex  *bindex;
+    uint32_t    blocks = 0, step, size, i = 0, k;
+
+    for (root = node->data; root; root = root->next) {
+        blocks++;
+    }
+    if (blocks <= BLOCKINDEX_STEP) {
+        return NULL;
+    }
+    // index_slot of DataBlock is 16 bits
+    step = BLOCKINDEX_STEP;
+    if (blocks / step >= USHRT_MAX / 2) {
+        step = blocks / (USHRT_MAX / 2 - 1) + 1;
+    }
+    size = (blocks - 1) / step + 1;
+    size = size + size / 2 + 1;
+
+    uint32_t mem = sizeof(BlockIndex) + sizeof(BlockIndexItem) * size + sizeof(uint32_t) * 2 * (size + 1);
+    bindex = (BlockIndex*)zz_malloc(mem);
+    memset(bindex, 0, mem);
+    bindex->mem     = mem;
+    bindex->size    = size;
+    bindex->count   = (blocks - 1) / step + 1;
+    bindex->step    = step;
+    bindex->dirty_lo = UINT_MAX;
+    bindex->vtree   = (uint32_t*)&bindex->items[size];
+    bindex->ttree   = bindex->vtree + size + 1;
+    tb->bindex_mem += mem;
+    mem_used_inc(mem);
+
+    for (root = node->data; root; root = root->next, i++) {
+        BlockIndexItem *item = &bindex->items[i / step];
+        if (i % step == 0) {
+            item->dbk = root;
+        }
+        item->visible += root->visible_count;
+        item->tagdel  += root->tagdel_count;
+        root->index_slot = i / step + 1;
+    }
+    // fenwick trees of the segment counts
+    for (i = 1; i <= size; i++) {
+        bindex->vtree[i] += bindex->items[i - 1].visible;
+        bindex->ttree[i] += bindex->items[i - 1].tagdel;
+        k = i + (i & -i);
+        if (k <= size) {
+            bindex->vtree[k] += bindex->vtree[i];
+            bindex->ttree[k] += bindex->ttree[i];
+        }
+        bindex->visible += bindex->items[i - 1].visible;
+        bindex->tagdel  += bindex->items[i - 1].tagdel;
+    }
+
+    return bindex;
+}
+
+static inline void
+blockindex_tree_add(uint32_t *tree, uint32_t size, uint32_t k, uint32_t n)
+{
+    if (n == 0) {
+        return;
+    }
+    for (k++; k <= size; k += k & -k) {
+        __sync_add_and_fetch(&tree[k], n);
+    }
+}
+
+static inline uint32_t
+blockindex_tree_value(BlockIndex *bindex, uint32_t k, unsigned char kind)
+{
+    if (kind == MEMLINK_VALUE_VISIBLE) {
+        return bindex->vtree[k];
+    }else if (kind == MEMLINK_VALUE_TAGDEL) {
+        return bindex->ttree[k];
+    }
+    return bindex->vtree[k] + bindex->ttree[k];
+}
+
+/**
+ * 前k段的数据项数
+ */
+static uint32_t
+blockindex_sum(BlockIndex *bindex, uint32_t k, unsigned char kind)
+{
+    uint32_t n = 0;
+
+    for (; k > 0; k -= k & -k) {
+        n += blockindex_tree_value(bindex, k, kind);
+    }
+    return n;
+}
+
+/**
+ * 找到数据项数之和不大于pos的最后一段
+ * @param startn 此段之前的数据项数
+ */
+static uint32_t
+blockindex_search(BlockIndex *bindex, uint32_t pos, unsigned char kind, uint32_t *startn)
+{
+    uint32_t k = 0, bit = 1, n;
+
+    while (bit * 2 <= bindex->size) {
+        bit *= 2;
+    }
+    for (; bit > 0; bit /= 2) {
+        if (k + bit <= bindex->size) {
+            n = blockindex_tree_value(bindex, k + bit, kind);
+            if (n <= pos) {
+                k   += bit;
+                pos -= n;
+            }
+        }
+    }
+    if (k >= bindex->count) {
+        k = bindex->count - 1;
+    }
+    *startn = blockindex_sum(bindex, k, kind);
+    return k;
+}
+
+/**
+ * 释放块索引, 读线程离开后才真正释放
+ */
+static void
+blockindex_free(Table *tb, BlockIndex *bindex)
+{
+    tb->bindex_mem -= bindex->mem;
+    mem_used_dec(bindex->mem);
+    epoch_retire(g_runtime->epoch, bindex, NULL, 0, epoch_zz_free);
+}
+
+/**
+ * 重新统计被修改的段. 从第一个被修改段之前有数据块的段开始, 到最后一个被修改段之后
+ * 有数据块的段为止, 之间的数据块重新平均分到这些段中, 新数据块在这里得到index_slot.
+ * 尾部的数据块多了就使用后面空的段
+ * @return 数据链和索引对不上, 或数据块太多时返回MEMLINK_ERR_PARAM, 需要重建
+ */
+static int
+blockindex_fold(Table *tb, HashNode *node, BlockIndex *bindex)
+{
+    uint32_t    s = bindex->dirty_lo, e = bindex->dirty_hi + 1;
+    uint32_t    m = 0, c, k, n, i, end_old;
+    uint32_t    visible, tagdel;
+    DataBlock   *start, *end, *dbk, *head;
+
+    while (s > 0 && bindex->items[s].dbk == NULL) {
+        s--;
+    }
+    while (e < bindex->count && bindex->items[e].dbk == NULL) {
+        e++;
+    }
+    start = s == 0 ? node->data : bindex->items[s].dbk;
+    end   = e < bindex->count ? bindex->items[e].dbk : NULL;
+    for (dbk = start; dbk != end; dbk = dbk->next) {
+        if (NULL == dbk) {
+            return MEMLINK_ERR_PARAM;
+        }
+        m++;
+    }
+    end_old = e;
+    if (e == bindex->count && m > (e - s) * bindex->step) {
+        e = s + (m - 1) / bindex->step + 1;
+        if (e > bindex->size) {
+            e = bindex->size;
+        }
+    }
+    c = e - s;
+    if (m == 0 || m > c * bindex->step * 4) {
+        return MEMLINK_ERR_PARAM;
+    }
+
+    dbk = start;
+    for (k = s; k < e; k++) {
+        // segment k has blocks [ceil(k * m / c), ceil((k + 1) * m / c)) of the window
+        n = ((k - s + 1) * m + c - 1) / c - ((k - s) * m + c - 1) / c;
+        head    = n > 0 ? dbk : NULL;
+        visible = tagdel = 0;
+        for (i = 0; i < n; i++, dbk = dbk->next) {
+            dbk->index_slot = k + 1;
+            visible += dbk->visible_count;
+            tagdel  += dbk->tagdel_count;
+        }
+        if (k < end_old && bindex->items[k].dbk == NULL) {
+            bindex->nulls--;
+        }
+        // readers see the head before the counts, both are right after the write
+        if (head == NULL) {
+            bindex->nulls++;
+        }
+        bindex->items[k].dbk = head;
+        blockindex_tree_add(bindex->vtree, bindex->size, k, visible - bindex->items[k].visible);
+        blockindex_tree_add(bindex->ttree, bindex->size, k, tagdel - bindex->items[k].tagdel);
+        bindex->visible += visible - bindex->items[k].visible;
+        bindex->tagdel  += tagdel - bindex->items[k].tagdel;
+        bindex->items[k].visible = visible;
+        bindex->items[k].tagdel  = tagdel;
+    }
+    if (e > bindex->count) {
+        __sync_synchronize();
+        bindex->count = e;
+    }
+    return MEMLINK_OK;
+}
+
+/**
+ * 释放HashNode的块索引, 整条数据链被释放或重建前调用
+ */
+void
+hashnode_index_free(Table *tb, HashNode *node)
+{
+    BlockIndex  *bindex = node->bindex;
+
+    if (bindex) {
+        node->bindex = NULL;
+        blockindex_free(tb, bindex);
+    }
+    // background clean of this node starts again from head
+    if (tb->clean_node == node) {
+        tb->clean_next = NULL;
+    }
+    node->qhead = node->qtail = 0;
+}
+
+/**
+ * 写操作修改数据块之前调用, 记下数据块所在的段.
+ * 被修改数据块前后新加的数据块不需要记, 它们在两个被记下的段之间
+ */
+void
+hashnode_index_touch(Table *tb, HashNode *node, DataBlock *dbk)
+{
+    BlockIndex  *bindex = node->bindex;
+    uint32_t    k;
+
+    if (NULL == bindex || NULL == dbk) {
+        return;
+    }
+    // blocks added by current write have no slot yet
+    while (dbk && (dbk->index_slot == 0 || dbk->index_slot > bindex->count)) {
+        dbk = dbk->prev;
+    }
+    k = dbk ? dbk->index_slot - 1 : 0;
+    if (k < bindex->dirty_lo) {
+        bindex->dirty_lo = k;
+    }
+    if (k > bindex->dirty_hi) {
+        bindex->dirty_hi = k;
+    }
+}
+
+/**
+ * 所有改变数据链的操作结束前调用, 重新统计被修改的段.
+ * 没有索引的长数据链在这里创建索引, 读线程不创建
+ */
+void
+hashnode_index_update(Table *tb, HashNode *node)
+{
+    BlockIndex  *bindex = node->bindex;
+
+    if (bindex) {
+        if (bindex->dirty_lo > bindex->dirty_hi) {
+            return;
+        }
+        if (blockindex_fold(tb, node, bindex) == MEMLINK_OK && bindex->nulls * 4 <= bindex->count &&
+            bindex->visible + bindex->tagdel == node->used) {
+            bindex->dirty_lo = UINT_MAX;
+            bindex->dirty_hi = 0;
+            return;
+        }
+        DINFO("rebuild block index of %s, nulls:%u, count:%u\n", hashnode_key(node), bindex->nulls, bindex->count);
+    }else if (node->used < BLOCKINDEX_MIN_POS) {
+        return;
+    }
+    // readers still in the old index find it until they leave
+    node->bindex = blockindex_create(tb, node);
+    __sync_synchronize();
+    if (bindex) {
+        blockindex_free(tb, bindex);
+    }
+}
+
+/**
+ * 数据块从数据链中移除, 放回内存池之前调用
+ */
+void
+hashnode_index_release(Table *tb, HashNode *node, DataBlock *dbk)
+{
+    BlockIndex  *bindex = node->bindex;
+
+    hashnode_index_touch(tb, node, dbk);
+    // the segment is counted again at the end of the write
+    if (bindex && dbk->index_slot > 0 && dbk->index_slot <= bindex->count &&
+        bindex->items[dbk->index_slot - 1].dbk == dbk) {
+        bindex->items[dbk->index_slot - 1].dbk = NULL;
+        bindex->nulls++;
+    }
+    if (tb->clean_next == dbk) {
+        tb->clean_next = NULL;
+    }
+    // head or tail of a queue may change, free items there are not known
+    node->qhead = node->qtail = 0;
+}
+
+/**
+ * 通过位置索引找到查找pos的起始数据块, 段的第一个数据块被释放时向前找.
+ * 不加锁, 读线程在epoch中使用索引, 和写操作同时进行时计数可能差几项
+ * @param startn 起始数据块之前的数据项数
+ * @return 起始数据块
+ */
+static DataBlock*
+hashnode_index_start(Table *tb, HashNode *node, int pos, unsigned char kind, int *startn)
+{
+    DataBlock       *root = node->data;
+    BlockIndex      *bindex;
+    uint32_t        k, n;
+
+    *startn = 0;
+    if (pos < BLOCKINDEX_MIN_POS) {
+        return root;
+    }
+
+    bindex = node->bindex;
+    if (bindex) {
+        DataBlock *head = NULL;
+
+        k = blockindex_search(bindex, pos, kind, &n);
+        while (k > 0 && (head = bindex->items[k].dbk) == NULL) {
+            k--;
+            n = blockindex_sum(bindex, k, kind);
+        }
+        if (k > 0 && head && n <= pos) {
+            root    = head;
+            *startn = n;
+        }
+    }
+
+    return root;
+}
+
+/**
+ * 通过块索引找到按值查找的起始数据块: 第一个数据小于value的最后一个索引块.
+ * 没有数据块的段跳过, 不加锁
+ */
+static DataBlock*
+hashnode_index_find(Table *tb, HashNode *node, void *value, int kind, int datalen)
+{
+    DataBlock       *root = node->data;
+    BlockIndex      *bindex;
+    int             low, high, mid, m, pos;
+    int             ret = 0, found = -1;
+    DataBlock       *head, *foundbk = NULL;
+
+    if (node->used < BLOCKINDEX_MIN_POS) {
+        return root;
+    }
+
+    bindex = node->bindex;
+    if (bindex) {
+        low  = 0;
+        high = bindex->count - 1;
+        while (low <= high) {
+            mid = (low + high) / 2;
+            // skip segments without block and blocks without data of kind
+            for (m = mid; m >= low; m--) {
+                head = bindex->items[m].dbk;
+                if (head == NULL)
+                    continue;
+                ret = sortlist_datablock_check(tb, node, head, value, kind,
+                                            datalen, MEMLINK_FIND_ASC, &pos);
+                if (ret != MEMLINK_ERR_NOVAL)
+                    break;
+            }
+            if (m < low) {
+                low = mid + 1;
+            }else if (ret > 0) {
+                found   = m;
+                foundbk = head;
+                low     = mid + 1;
+            }else{
+                high    = m - 1;
+            }
+        }
+        if (found > 0) {
+            root = foundbk;
+        }
+    }
+
+    return root;
+}
+
 /**
  * find a value position
  * @param node  node with the list
@@ -375,13 +892,14 @@ int
 sortlist_lookup(Table *tb, HashNode *node, int step, void *value, int kind, DataBlock **dbk)
 {
     int ret, pos = 0;
-    int datalen = tb->valuesize + tb->attrsize;
-    DataBlock *checkbk = node->data;
+    int datalen = dataitem_step(tb);
+    DataBlock *checkbk;
 
     if (NULL == node->data) {
         *dbk = NULL;
         return MEMLINK_ERR_NOVAL;
     }
+    checkbk = hashnode_index_find(tb, node, value, kind, datalen);
     // find in datablock list
     while (checkbk) {
         DINFO("checkbk: %p, next: %p\n", checkbk, checkbk->next);
@@ -435,7 +953,7 @@ int
 sortlist_lookup_valid(Table *tb, HashNode *node, int step, void *value, int kind, DataBlock **dbk)
 {
     int ret, pos = 0;
-    int datalen = tb->valuesize + tb->attrsize;
+    int datalen = dataitem_step(tb);
     DataBlock *checkbk = node->data;
     //DataBlock *startbk = node->data;
 
@@ -460,6 +978,7 @@ sortlist_lookup_valid(Table *tb, HashNode *node, int step, void *value, int kind
         }
         return pos + 1;
     }
+    checkbk = hashnode_index_find(tb, node, value, kind, datalen);
 
     // find in datablock list
     while (checkbk) {
@@ -505,36 +1024,450 @@ sortlist_lookup_valid_found:
     return 0;
 }
 
+/**
+ * first 4 bytes of attr for block summary, without real del and tag del bit
+ */
+static inline unsigned int
+dataitem_attr_head(Table *tb, char *attr)
+{
+    unsigned int v = 0;
+
+    memcpy(&v, attr, tb->attrsize < sizeof(v) ? tb->attrsize : sizeof(v));
+    ((unsigned char*)&v)[0] &= 0xfc;
+    return v;
+}
+
+// attr_or and attr_and of a DataBlock, read and swapped together
+typedef union _memlink_attrsum
+{
+    struct {
+        unsigned int attror;
+        unsigned int attrand;
+    };
+    uint64_t    sum;
+}AttrSum;
+
+// summary never has the low 2 bits of attr byte 0, bit 0 marks it computed
+#define attrsum_valid(as)   (((unsigned char*)&(as).attror)[0] & 0x01)
+
+/**
+ * a new item attr is written in dbk, keep the block attr summary.
+ * before the summary is computed attr_and counts the writes, a reader 
+ * computing it fails its swap and does not keep a summary without the item
+ */
+void
+datablock_attr_add(Table *tb, DataBlock *dbk, char *attr)
+{
+    unsigned int v = dataitem_attr_head(tb, attr);
+    AttrSum      old, as;
+
+    do {
+        old.sum = dbk->attr_sum;
+        as      = old;
+        if (attrsum_valid(as)) {
+            as.attror  |= v;
+            as.attrand &= v;
+            if (as.sum == old.sum) {
+                return;
+            }
+        }else{
+            as.attrand++;
+        }
+    } while (!__sync_bool_compare_and_swap(&dbk->attr_sum, old.sum, as.sum));
+}
+
+/**
+ * check if any item in dbk may match (attr & attrflag) == attrval. 
+ * block attr summary is computed at the first check
+ * @return MEMLINK_FALSE means no item match
+ */
+int
+datablock_attr_match(Table *tb, HashNode *node, DataBlock *dbk, char *attrval, char *attrflag)
+{
+    unsigned int flag = dataitem_attr_head(tb, attrflag);
+    unsigned int val  = dataitem_attr_head(tb, attrval) & flag;
+    unsigned int attror, attrand;
+    AttrSum      old, as;
+
+    if (flag == 0) {
+        return MEMLINK_TRUE;
+    }
+    old.sum = dbk->attr_sum;
+    if (!attrsum_valid(old)) {
+        int  i;
+
+        as.attror  = 0;
+        as.attrand = UINT_MAX;
+        for (i = 0; i < dbk->data_count; i++) {
+            char *attr = datablock_item_attr(tb, dbk, i);
+            if (*attr & 0x01) { // have data
+                unsigned int v = dataitem_attr_head(tb, attr);
+                as.attror  |= v;
+                as.attrand &= v;
+            }
+        }
+        ((unsigned char*)&as.attror)[0] |= 0x01;
+        // an item written while counting changed attr_and, check the items
+        if (!__sync_bool_compare_and_swap(&dbk->attr_sum, old.sum, as.sum)) {
+            as.sum = dbk->attr_sum;
+            if (!attrsum_valid(as)) {
+                return MEMLINK_TRUE;
+            }
+        }
+        old = as;
+    }
+    attror  = old.attror;
+    attrand = old.attrand;
+    ((unsigned char*)&attror)[0] &= 0xfc;
+
+    // a 1 bit in val needs some item with it, a 0 bit in val needs some item without it
+    if ((val & ~attror) != 0 || (~val & flag & attrand) != 0) {
+        return MEMLINK_FALSE;
+    }
+    return MEMLINK_TRUE;
+}
+
+/*
+ * attr scan kernels. each item is tested with one word compare:
+ * (attr head & flag) == val, the kind bits of attr byte 0 are folded in flag/val.
+ * bit i of the result is item i. n <= 64, every item must be readable with width bytes
+ */
+typedef uint64_t (*attr_scan_func)(char *attr, int datalen, int n, int width, 
+                                    uint64_t flag, uint64_t val);
+
+static uint64_t
+attr_scan_scalar(char *attr, int datalen, int n, int width, uint64_t flag, uint64_t val)
+{
+    uint64_t mask = 0;
+    uint64_t v;
+    uint32_t v4;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (width == 4) {
+            memcpy(&v4, attr, sizeof(v4));
+            v = v4;
+        }else{
+            memcpy(&v, attr, sizeof(v));
+        }
+        if ((v & flag) == val) {
+            mask |= (uint64_t)1 << i;
+        }
+        attr += datalen;
+    }
+    return mask;
+}
+
+#ifdef __SSE2__
+static inline uint32_t
+attr_load4(char *attr)
+{
+    uint32_t v;
+    memcpy(&v, attr, sizeof(v));
+    return v;
+}
+
+static uint64_t
+attr_scan_sse2(char *attr, int datalen, int n, int width, uint64_t flag, uint64_t val)
+{
+    uint64_t mask = 0;
+    int i = 0;
+
+    // no gather in sse2, only 4 byte heads are packed 4 items per compare
+    if (width == 4) {
+        __m128i f = _mm_set1_epi32((int)flag);
+        __m128i v = _mm_set1_epi32((int)val);
+        for (; i + 4 <= n; i += 4) {
+            __m128i x = _mm_set_epi32(attr_load4(attr + datalen * 3), attr_load4(attr + datalen * 2),
+                                      attr_load4(attr + datalen), attr_load4(attr));
+            x = _mm_cmpeq_epi32(_mm_and_si128(x, f), v);
+            mask |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(x)) << i;
+            attr += datalen * 4;
+        }
+    }
+    if (i < n) {
+        mask |= attr_scan_scalar(attr, datalen, n - i, width, flag, val) << i;
+    }
+    return mask;
+}
+#endif
+
+#ifdef MEMLINK_SCAN_AVX2
+__attribute__((target("avx2"))) static uint64_t
+attr_scan_avx2(char *attr, int datalen, int n, int width, uint64_t flag, uint64_t val)
+{
+    uint64_t mask = 0;
+    int i = 0;
+
+    if (width == 4) {
+        __m256i f   = _mm256_set1_epi32((int)flag);
+        __m256i v   = _mm256_set1_epi32((int)val);
+        __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), 
+                                         _mm256_set1_epi32(datalen));
+        for (; i + 8 <= n; i += 8) {
+            __m256i x = _mm256_i32gather_epi32((const int*)attr, idx, 1);
+            x = _mm256_cmpeq_epi32(_mm256_and_si256(x, f), v);
+            mask |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(x)) << i;
+            attr += datalen * 8;
+        }
+    }else{
+        __m256i f   = _mm256_set1_epi64x((long long)flag);
+        __m256i v   = _mm256_set1_epi64x((long long)val);
+        __m128i idx = _mm_setr_epi32(0, datalen, datalen * 2, datalen * 3);
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_i32gather_epi64((const long long*)attr, idx, 1);
+            x = _mm256_cmpeq_epi64(_mm256_and_si256(x, f), v);
+            mask |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(x)) << i;
+            attr += datalen * 4;
+        }
+    }
+    if (i < n) {
+        mask |= attr_scan_scalar(attr, datalen, n - i, width, flag, val) << i;
+    }
+    return mask;
+}
+#endif
+
+static attr_scan_func attr_scan_kernel = NULL;
+
+static attr_scan_func
+attr_scan_select(void)
+{
+#ifdef MEMLINK_SCAN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return attr_scan_avx2;
+    }
+#endif
+#ifdef __SSE2__
+    return attr_scan_sse2;
+#else
+    return attr_scan_scalar;
+#endif
+}
+
+/**
+ * prepare a matcher for datablock_scan
+ * @param kind      MEMLINK_VALUE_*
+ * @param attrval   binary attr value, NULL for kind only
+ * @param attrflag  binary attr flag from attr_array2_binary_flag
+ */
+void
+attrmatch_init(Table *tb, AttrMatch *am, unsigned char kind, char *attrval, char *attrflag)
+{
+    unsigned char *f, *v;
+    uint32_t f4 = 0, v4 = 0;
+    int  i;
+
+    am->width    = tb->attrsize <= 4 ? 4 : 8;
+    am->headsize = tb->attrsize < am->width ? tb->attrsize : am->width;
+    am->tail     = (am->width - am->headsize + dataitem_attr_step(tb) - 1) / dataitem_attr_step(tb);
+    am->attrval  = attrval;
+    am->attrflag = attrflag;
+    am->flag     = 0;
+    am->val      = 0;
+   
+    if (am->width == 4) {
+        f = (unsigned char*)&f4;
+        v = (unsigned char*)&v4;
+    }else{
+        f = (unsigned char*)&am->flag;
+        v = (unsigned char*)&am->val;
+    }
+    if (attrval) {
+        for (i = 0; i < am->headsize; i++) {
+            f[i] = attrflag[i];
+            v[i] = attrval[i] & attrflag[i];
+        }
+    }
+    switch (kind) {
+    case MEMLINK_VALUE_VISIBLE:
+        f[0] |= 0x03;
+        v[0] |= 0x01;
+        break;
+    case MEMLINK_VALUE_TAGDEL:
+        f[0] |= 0x03;
+        v[0] |= 0x03;
+        break;
+    case MEMLINK_VALUE_ALL:
+        f[0] |= 0x01;
+        v[0] |= 0x01;
+        break;
+    case MEMLINK_VALUE_REMOVED:
+        f[0] |= 0x01;
+        break;
+    default: // val bit out of flag, nothing match
+        f[0] = (f[0] & 0xfc) | 0x01;
+        v[0] = (v[0] & 0xfc) | 0x02;
+        break;
+    }
+    if (am->width == 4) {
+        am->flag = f4;
+        am->val  = v4;
+    }
+}
+
+/**
+ * test items [start, start + 64) of dbk
+ * @return bit i is set if item start + i has the kind and attr of am
+ */
+uint64_t
+datablock_scan(Table *tb, DataBlock *dbk, int start, AttrMatch *am)
+{
+    int      datalen = dataitem_attr_step(tb);
+    int      n = dbk->data_count - start;
+    int      safe;
+    char     *attr = datablock_item_attr(tb, dbk, start);
+    uint64_t mask = 0;
+
+    if (n <= 0) {
+        return 0;
+    }
+    if (n > 64) {
+        n = 64;
+    }
+    if (attr_scan_kernel == NULL) {
+        attr_scan_kernel = attr_scan_select();
+    }
+    // the last am->tail items have head word past the block end, copy them out first
+    safe = dbk->data_count - am->tail - start;
+    if (safe > n) {
+        safe = n;
+    }else if (safe < 0) {
+        safe = 0;
+    }
+    if (safe > 0) {
+        mask = attr_scan_kernel(attr, datalen, safe, am->width, am->flag, am->val);
+    }
+    if (safe < n) {
+        char buf[8] = {0};
+        int  i;
+        for (i = safe; i < n; i++) {
+            memcpy(buf, attr + i * datalen, am->headsize);
+            mask |= attr_scan_scalar(buf, 0, 1, am->width, am->flag, am->val) << i;
+        }
+    }
+
+    if (am->attrval && tb->attrsize > am->width) {
+        uint64_t m = mask;
+        while (m) {
+            int  i = __builtin_ctzll(m);
+            int  k;
+            char *a = attr + i * datalen;
+            m &= m - 1;
+            for (k = am->width; k < tb->attrsize; k++) {
+                if ((a[k] & am->attrflag[k]) != am->attrval[k]) {
+                    mask &= ~((uint64_t)1 << i);
+                    break;
+                }
+            }
+        }
+    }
+    return mask;
+}
+
 /**
  * copy a value, attr to special address
- * @param node  HashNode be copied
+ * @param dbk   DataBlock of addr
  * @param addr  to address
  * @param value copied value
  * @param attr  copied attr, binary
  */
 int
-dataitem_copy(Table *tb, HashNode *node, char *addr, void *value, void *attr)
+dataitem_copy(Table *tb, DataBlock *dbk, char *addr, void *value, void *attr)
 {
     //char *m = attr;
     //*m = *m | (*addr & 0x03);
 
     //DINFO("dataitem_copy valuesize: %d, attrsize: %d\n", node->valuesize, node->attrsize);
     memcpy(addr, value, (size_t)tb->valuesize);
-    memcpy(addr + tb->valuesize, attr, tb->attrsize);
+    memcpy(dataitem_attr(tb, dbk, addr), attr, tb->attrsize);
     
     return MEMLINK_OK;
 }
 
+/**
+ * write an item into a removed slot of a block readers can see. value and
+ * attr go first while the slot still reads as removed, the mask byte last
+ */
+void
+dataitem_publish(Table *tb, DataBlock *dbk, char *addr, void *value, void *attr)
+{
+    char *attrdata = dataitem_attr(tb, dbk, addr);
+
+    memcpy(addr, value, (size_t)tb->valuesize);
+    if (tb->attrsize > 1) {
+        memcpy(attrdata + 1, (char*)attr + 1, tb->attrsize - 1);
+    }
+    __sync_synchronize();
+    *(volatile char*)attrdata = *(char*)attr;
+}
+
+/**
+ * copy an item to another address, the 2 datablocks may be the same one
+ */
+void
+dataitem_move(Table *tb, DataBlock *tobk, char *todata, DataBlock *frombk, char *fromdata)
+{
+    if (tb->layout == MEMLINK_LAYOUT_COLUMN) {
+        memmove(todata, fromdata, tb->valuesize);
+        memmove(dataitem_attr(tb, tobk, todata), dataitem_attr(tb, frombk, fromdata), tb->attrsize);
+    }else{
+        memmove(todata, fromdata, tb->valuesize + tb->attrsize);
+    }
+}
+
+/**
+ * copy count items from frombk to tobk, item positions are not changed in the 2 datablocks
+ */
+void
+datablock_copy_items(Table *tb, DataBlock *tobk, int topos, DataBlock *frombk, int frompos, int count)
+{
+    if (count <= 0)
+        return;
+    if (tb->layout == MEMLINK_LAYOUT_COLUMN) {
+        memcpy(datablock_item(tb, tobk, topos), datablock_item(tb, frombk, frompos), 
+                count * tb->valuesize);
+        memcpy(datablock_item_attr(tb, tobk, topos), datablock_item_attr(tb, frombk, frompos), 
+                count * tb->attrsize);
+    }else{
+        int datalen = tb->valuesize + tb->attrsize;
+        memcpy(tobk->data + topos * datalen, frombk->data + frompos * datalen, count * datalen);
+    }
+}
+
+/**
+ * copy an item to buf as value|attr, the format of reply and dump file.
+ * value of MEMLINK_VALUE_VSTRING is len|bytes
+ * @return bytes copied
+ */
+int
+dataitem_pack(Table *tb, DataBlock *dbk, char *itemdata, char *buf)
+{
+    if (table_is_vstring(tb)) {
+        int len = valuearena_pack(itemdata, buf);
+        memcpy(buf + len, dataitem_attr(tb, dbk, itemdata), tb->attrsize);
+        return len + tb->attrsize;
+    }
+    if (tb->layout == MEMLINK_LAYOUT_COLUMN) {
+        memcpy(buf, itemdata, tb->valuesize);
+        memcpy(buf + tb->valuesize, dataitem_attr(tb, dbk, itemdata), tb->attrsize);
+    }else{
+        memcpy(buf, itemdata, tb->valuesize + tb->attrsize);
+    }
+    return tb->valuesize + tb->attrsize;
+}
+
 /**
  * set attr to a value
  */
 int
-dataitem_copy_attr(Table *tb, HashNode *node, char *addr, char *attrflag, char *attr)
+dataitem_copy_attr(Table *tb, DataBlock *dbk, char *addr, char *attrflag, char *attr)
 {
     //char *m = attr;
     //*m = *m | (*addr & 0x03);
     int i;
-    char *attraddr = addr + tb->valuesize;
+    char *attraddr = dataitem_attr(tb, dbk, addr);
     //char buf[128];
     //DINFO("copy_attr before: %s\n", formatb(addr, node->attrsize, buf, 128)); 
 
@@ -555,53 +1488,34 @@ dataitem_lookup_pos_attr(Table *tb, HashNode *node, int pos, unsigned char kind,
                         char *attrval, char *attrflag, DataBlock **dbk, int *dbkpos)
 {
     DataBlock *root = node->data;
-
+    AttrMatch am;
+    uint64_t  mask;
     int n = 0, startn = 0;
-    int i, k;
-    int datalen = tb->valuesize + tb->attrsize;
-    
+    int i, c;
+
+    attrmatch_init(tb, &am, kind, attrval, attrflag);
     while (root) {
         startn = n;
-        char *itemdata = root->data;
 
-        for (i = 0; i < root->data_count; i++) {
-            if (dataitem_have_data(tb, node, itemdata, kind)) {
-                char *attrdata = itemdata + tb->valuesize;    
-                
-                /*char buf[64], buf2[64], buf3[64];
-                DINFO("i: %d, attrdata: %s, attrflag: %s, attrval: %s\n", i, 
-                        formatb(attrdata, node->attrsize, buf, 64), 
-                        formatb(attrflag, node->attrsize, buf2, 64),
-                        formatb(attrval, node->attrsize, buf3, 64));
-                */ 
-                for (k = 0; k < tb->attrsize; k++) {
-                    //DINFO("check k:%d, attrdata:%x, attrflag:%x, attrval:%x\n", k, attrdata[k], attrflag[k], attrval[k]);
-                    if ((attrdata[k] & attrflag[k]) != attrval[k]) {
-                        break;
-                    }
-                }
-                if (k < tb->attrsize) { // not equal
-                    //DINFO("not equal.\n");
-                    itemdata += datalen;
-                    continue;
-                }
-
-                if (n >= pos) {
-                    *dbk  = root;
-                    //*addr = itemdata;
-                    *dbkpos = i;
-                    return startn;
-                    //return i;
-                }
-                n += 1;
-            }
-            itemdata += datalen;
+        if (!datablock_attr_match(tb, node, root, attrval, attrflag)) {
+            root = root->next;
+            continue;
         }
-        /*
-        if (n >= pos) {
-            *dbk = root;
+        for (i = 0; i < root->data_count; i += 64) {
+            mask = datablock_scan(tb, root, i, &am);
+            c = __builtin_popcountll(mask);
+            if (n + c <= pos) {
+                n += c;
+                continue;
+            }
+            // the (pos - n)th match in this word
+            for (; n < pos; n++) {
+                mask &= mask - 1;
+            }
+            *dbk    = root;
+            *dbkpos = i + __builtin_ctzll(mask);
             return startn;
-        }*/
+        }
 
         root = root->next;
     }
@@ -620,7 +1534,7 @@ datablock_print(Table *tb, HashNode *node, DataBlock *dbk)
     char valuebuf[2048];
     char attrbuf[2048];
     int  i, ret;
-    int  datalen   = tb->valuesize + tb->attrsize;
+    int  datalen   = dataitem_step(tb);
     char *itemdata = dbk->data; 
     //char format[128];
     char delinfo[32] = "";
@@ -639,7 +1553,7 @@ datablock_print(Table *tb, HashNode *node, DataBlock *dbk)
         }else{
             DINFO("i: %03d, no data, attr: %s\n", i, formath(itemdata + node->valuesize, node->attrsize, buf1, 128));
         }*/
-        ret = dataitem_check_data(tb, node, itemdata);
+        ret = dataitem_check_data(tb, dbk, itemdata);
         if (ret == MEMLINK_VALUE_TAGDEL) { // tagdel
             strcpy(delinfo, "del");
         }else if (ret == MEMLINK_VALUE_REMOVED){
@@ -648,7 +1562,7 @@ datablock_print(Table *tb, HashNode *node, DataBlock *dbk)
             delinfo[0] = 0;
         }
            
-        formath(itemdata + tb->valuesize, tb->attrsize, attrbuf, bufsize);
+        formath(dataitem_attr(tb, dbk, itemdata), tb->attrsize, attrbuf, bufsize);
         switch(tb->valuetype) {
             case MEMLINK_VALUE_INT4:
                 DINFO("i:%03d, value:%d, attr:%s\t%s\n", i, *(int*)itemdata, attrbuf, delinfo);
@@ -675,6 +1589,16 @@ datablock_print(Table *tb, HashNode *node, DataBlock *dbk)
                 formath(itemdata, tb->valuesize, valuebuf, bufsize);
                 DINFO("i:%03d, value:%s, attr:%s\t%s\n", i, valuebuf, attrbuf, delinfo);
                 break;
+            case MEMLINK_VALUE_VSTRING:
+                if (ret == MEMLINK_VALUE_REMOVED) {
+                    valuebuf[0] = 0;
+                }else{
+                    unsigned char *v = valuearena_value(itemdata);
+                    memcpy(valuebuf, v + 1, v[0]);
+                    valuebuf[v[0]] = 0;
+                }
+                DINFO("i:%03d, value:%s, attr:%s\t%s\n", i, valuebuf, attrbuf, delinfo);
+                break;
             default:
                 return MEMLINK_ERR;
         }
@@ -689,7 +1613,7 @@ datablock_print(Table *tb, HashNode *node, DataBlock *dbk)
 int
 datablock_del(Table *tb, HashNode *node, DataBlock *dbk, char *data)
 {
-    char *mdata = data + tb->valuesize;
+    char *mdata = dataitem_attr(tb, dbk, data);
     unsigned char v = *mdata & 0x02;
 
     *mdata &= 0xfe;
@@ -709,7 +1633,7 @@ datablock_del(Table *tb, HashNode *node, DataBlock *dbk, char *data)
 int
 datablock_del_restore(Table *tb, HashNode *node, DataBlock *dbk, char *data)
 {
-    char *mdata = data + tb->valuesize;
+    char *mdata = dataitem_attr(tb, dbk, data);
     unsigned char v = *mdata & 0x02;
 
     *mdata |= 0x01;
@@ -719,23 +1643,26 @@ datablock_del_restore(Table *tb, HashNode *node, DataBlock *dbk, char *data)
         dbk->visible_count++;
     }
     node->used++;
+    datablock_attr_add(tb, dbk, mdata);
 
     return 0;
 }
 /**
  * 在数据链中找到某位置所在数据块, 
+ * @param tb
  * @param node 
  * @param pos
  * @param kind
  * @param dbk 指定位置所在数据块
  */
 int
-datablock_lookup_pos(HashNode *node, int pos, unsigned char kind, DataBlock **dbk)
+datablock_lookup_pos(Table *tb, HashNode *node, int pos, unsigned char kind, DataBlock **dbk)
 {
-    DataBlock *root = node->data;
+    DataBlock *root;
 
     int n = 0, startn = 0;
     
+    root = hashnode_index_start(tb, node, pos, kind, &n);
     while (root) {
         startn = n;
         //modify by lanwenhong
@@ -763,11 +1690,12 @@ datablock_lookup_pos(HashNode *node, int pos, unsigned char kind, DataBlock **db
  * find a position in datablock link
  */
 int
-datablock_lookup_valid_pos(HashNode *node, int pos, unsigned char kind, DataBlock **dbk)
+datablock_lookup_valid_pos(Table *tb, HashNode *node, int pos, unsigned char kind, DataBlock **dbk)
 {
-    DataBlock *root = node->data;
+    DataBlock *root;
     int n = 0, startn = 0;
     
+    root = hashnode_index_start(tb, node, pos, kind, &n);
     while (root) {
         startn = n;
         if (kind == MEMLINK_VALUE_VISIBLE) {
@@ -820,7 +1748,7 @@ datablock_new_copy_small(HashNode *node, void *value, void *attr)
 int
 datablock_check_null(Table *tb, HashNode *node, DataBlock *dbk, int skipn, void *value, void *attr)
 {
-    int datalen     = tb->valuesize + tb->attrsize;
+    int datalen     = dataitem_step(tb);
     int count       = dbk->visible_count + dbk->tagdel_count;
     char *fromdata  = dbk->data;
     int i, n = 0;
@@ -832,15 +1760,16 @@ datablock_check_null(Table *tb, HashNode *node, DataBlock *dbk, int skipn, void
 
     for (i = 0; i < dbk->data_count; i++) {
         if (n == skipn) {
-            if (dataitem_have_data(tb, node, fromdata, MEMLINK_VALUE_ALL) == MEMLINK_FALSE) {
-                dataitem_copy(tb, node, fromdata, value, attr);
+            if (dataitem_have_data(tb, dbk, fromdata, MEMLINK_VALUE_ALL) == MEMLINK_FALSE) {
+                datablock_attr_add(tb, dbk, attr);
+                dataitem_publish(tb, dbk, fromdata, value, attr);
                 dbk->visible_count++;
                 node->used++;
                 return 1;
             }
             return 0;
         }
-        if (dataitem_have_data(tb, node, fromdata, MEMLINK_VALUE_ALL) == MEMLINK_TRUE) {
+        if (dataitem_have_data(tb, dbk, fromdata, MEMLINK_VALUE_ALL) == MEMLINK_TRUE) {
             n++;
         }
 
@@ -856,11 +1785,11 @@ datablock_check_null_pos(Table *tb, HashNode *node, DataBlock *dbk, int pos, voi
     if (pos < 0 || pos > dbk->data_count) {
         return 0;
     }
-    int datalen     = tb->valuesize + tb->attrsize;
-    char *fromdata  = dbk->data + datalen * pos;
+    char *fromdata  = datablock_item(tb, dbk, pos);
 
-    if (dataitem_have_data(tb, node, fromdata, MEMLINK_VALUE_ALL) == MEMLINK_FALSE) {
-        dataitem_copy(tb, node, fromdata, value, attr);
+    if (dataitem_have_data(tb, dbk, fromdata, MEMLINK_VALUE_ALL) == MEMLINK_FALSE) {
+        datablock_attr_add(tb, dbk, attr);
+        dataitem_publish(tb, dbk, fromdata, value, attr);
         dbk->visible_count++;
         node->used++;
         return 1;
@@ -879,37 +1808,40 @@ datablock_check_null_pos(Table *tb, HashNode *node, DataBlock *dbk, int pos, voi
 DataBlock*
 datablock_new_copy(Table *tb, HashNode *node, DataBlock *dbk, int skipn, void *value, void *attr)
 {
-    int datalen = tb->valuesize + tb->attrsize;
+    int step    = dataitem_step(tb);
 
     if (dbk == NULL) {
-        DataBlock *newbk = mempool_get2(g_runtime->mpool, 1, datalen);
+        DataBlock *newbk = datablock_get(tb, 1);
         if (value != NULL) {
-            dataitem_copy(tb, node, newbk->data, value, attr);
+            dataitem_copy(tb, newbk, newbk->data, value, attr);
             newbk->visible_count++;
         }
         return newbk;
     }
 
     int dbksize = dbk->visible_count + dbk->tagdel_count;
-    int newsize = datablock_suitable_size(dbksize + 1);
-    DataBlock *newbk = mempool_get2(g_runtime->mpool, newsize, datalen);
+    int newsize = datablock_suitable_size(tb, node->used, dbksize + 1);
+    if (newsize < dbksize) {
+        newsize = dbksize;
+    }
+    DataBlock *newbk = datablock_get(tb, newsize);
 
     DINFO("create newbk:%p, dbk:%p\n", newbk, dbk);
     int  n = 0;
     char *todata     = newbk->data;
-    char *end_todata = newbk->data + newbk->data_count * datalen;
+    char *end_todata = newbk->data + newbk->data_count * step;
     char *fromdata   = dbk->data;
     
     int i, ret;
     for (i = 0; i < dbk->data_count; i++) {
-        ret = dataitem_check_data(tb, node, fromdata);
+        ret = dataitem_check_data(tb, dbk, fromdata);
         if (ret != MEMLINK_VALUE_REMOVED) {
             if (todata >= end_todata) {
                 break;
             }
             if (n == skipn) {
-                dataitem_copy(tb, node, todata, value, attr);
-                todata += datalen;
+                dataitem_copy(tb, newbk, todata, value, attr);
+                todata += step;
                 n++;
                 newbk->visible_count++;
 
@@ -917,8 +1849,8 @@ datablock_new_copy(Table *tb, HashNode *node, DataBlock *dbk, int skipn, void *v
                     break;
                 }
             }
-            memcpy(todata, fromdata, datalen);    
-            todata += datalen;
+            dataitem_move(tb, newbk, todata, dbk, fromdata);
+            todata += step;
             n++;
 
             if (ret == MEMLINK_VALUE_VISIBLE) {
@@ -927,11 +1859,11 @@ datablock_new_copy(Table *tb, HashNode *node, DataBlock *dbk, int skipn, void *v
                 newbk->tagdel_count++;
             }
         }
-        fromdata += datalen;
+        fromdata += step;
     }
 
     if (n <= skipn && todata < end_todata) {
-        dataitem_copy(tb, node, todata, value, attr);
+        dataitem_copy(tb, newbk, todata, value, attr);
         newbk->visible_count++;
     }
     newbk->next = dbk->next;
@@ -940,6 +1872,50 @@ datablock_new_copy(Table *tb, HashNode *node, DataBlock *dbk, int skipn, void *v
     return newbk;
 }
 
+/**
+ * insert an item into a free slot of the block in place, after the last
+ * item when pos < 0, else into the removed slot at pos
+ * @return MEMLINK_OK when filled, MEMLINK_ERR when the block must be copied
+ */
+int
+datablock_fill_pos(Table *tb, DataBlock *dbk, int pos, void *value, void *attr)
+{
+    int  step = dataitem_step(tb);
+    char *posdata;
+    int  i;
+
+    if (dbk == NULL || dbk->visible_count + dbk->tagdel_count >= dbk->data_count) {
+        return MEMLINK_ERR;
+    }
+    if (pos < 0) { // append
+        posdata = datablock_item(tb, dbk, dbk->data_count - 1);
+        for (i = dbk->data_count - 1; i >= 0; i--) {
+            if (dataitem_check_data(tb, dbk, posdata) != MEMLINK_VALUE_REMOVED) {
+                break;
+            }
+            posdata -= step;
+        }
+        if (i == dbk->data_count - 1) {
+            return MEMLINK_ERR;
+        }
+        posdata += step;
+        DINFO("copy value 2.1 %d\n", i + 1);
+    }else if (pos < dbk->data_count) {
+        posdata = datablock_item(tb, dbk, pos);
+        if (dataitem_check_data(tb, dbk, posdata) != MEMLINK_VALUE_REMOVED) {
+            return MEMLINK_ERR;
+        }
+        DINFO("copy value 2.2 %d\n", pos);
+    }else{
+        return MEMLINK_ERR;
+    }
+    datablock_attr_add(tb, dbk, attr);
+    dataitem_publish(tb, dbk, posdata, value, attr);
+    dbk->visible_count++;
+
+    return MEMLINK_OK;
+}
+
 /**
  * create a new datablock, and copy part of data in old datablock by pos
  * @param node hashnode with the list
@@ -952,12 +1928,12 @@ datablock_new_copy(Table *tb, HashNode *node, DataBlock *dbk, int skipn, void *v
 DataBlock*
 datablock_new_copy_pos(Table *tb, HashNode *node, DataBlock *dbk, int pos, void *value, void *attr)
 {
-    int datalen = tb->valuesize + tb->attrsize;
+    int step    = dataitem_step(tb);
     if (dbk == NULL) { // create new datablock
-        DataBlock *newbk = mempool_get2(g_runtime->mpool, 1, datalen); 
+        DataBlock *newbk = datablock_get(tb, 1); 
         if (value != NULL) {
             DINFO("copy value 1. %s\n", (char*)value);
-            dataitem_copy(tb, node, newbk->data, value, attr);
+            dataitem_copy(tb, newbk, newbk->data, value, attr);
             newbk->visible_count++;
         }
         return newbk;
@@ -965,40 +1941,16 @@ datablock_new_copy_pos(Table *tb, HashNode *node, DataBlock *dbk, int pos, void
     zz_check(dbk);
     //DINFO("pos:%d, data_count:%d\n", pos, dbk->data_count);
     int dbksize = dbk->visible_count + dbk->tagdel_count;
-    if (pos < 0) { // append
-        if (dbksize < dbk->data_count) {
-            int  i;
-            char *posdata = dbk->data + (dbk->data_count - 1) * datalen;
-            for (i = dbk->data_count - 1; i >= 0; i--) {
-                if (dataitem_check_data(tb, node, posdata) != MEMLINK_VALUE_REMOVED) {
-                    /*if (i == dbk->data_count - 1) { // datablock last have data, break
-                        break;
-                    }else*/ if (i < dbk->data_count - 1) {
-                        DINFO("copy value 2.1 %s\n", (char*)value);
-                        posdata += datalen;
-                        dataitem_copy(tb, node, posdata, value, attr);
-                        dbk->visible_count++;
-                        return dbk;
-                    }
-                }
-                posdata -= datalen;
-            }
-        }
-    }else if (pos < dbk->data_count) {
-        char *posdata = dbk->data + pos * datalen;
-        if (dataitem_check_data(tb, node, posdata) == MEMLINK_VALUE_REMOVED) { // copy data
-            DINFO("copy value 2.2 %s\n", (char*)value);
-            dataitem_copy(tb, node, posdata, value, attr);
-            dbk->visible_count++;
-            return dbk;
-        }
-    }
 
     int  n = 0;
-    int  newsize     = datablock_suitable_size(dbksize + 1);
-    DataBlock *newbk = mempool_get2(g_runtime->mpool, newsize, datalen);
+    int  newsize     = datablock_suitable_size(tb, node->used, dbksize + 1);
+    // a full block over the max size of the list keeps its size, the last item moves out
+    if (newsize < dbksize) {
+        newsize = dbksize;
+    }
+    DataBlock *newbk = datablock_get(tb, newsize);
     char *todata     = newbk->data;
-    char *end_todata = newbk->data + newbk->data_count * datalen;
+    char *end_todata = newbk->data + newbk->data_count * step;
     char *fromdata   = dbk->data;
     int  i, ret;
     int  iscopy = 0;
@@ -1006,8 +1958,8 @@ datablock_new_copy_pos(Table *tb, HashNode *node, DataBlock *dbk, int pos, void
     for (i = 0; i < dbk->data_count; i++) {
         if (i == pos) {
             DINFO("copy value 3. %d, %s\n", i, (char*)value);
-            dataitem_copy(tb, node, todata, value, attr);
-            todata += datalen;
+            dataitem_copy(tb, newbk, todata, value, attr);
+            todata += step;
             n++;
             newbk->visible_count++;
             iscopy = 1;
@@ -1015,13 +1967,13 @@ datablock_new_copy_pos(Table *tb, HashNode *node, DataBlock *dbk, int pos, void
                 break;
             }
         }
-        ret = dataitem_check_data(tb, node, fromdata);
+        ret = dataitem_check_data(tb, dbk, fromdata);
         if (ret != MEMLINK_VALUE_REMOVED) {
             if (todata >= end_todata) {
                 break;
             }
-            memcpy(todata, fromdata, datalen);    
-            todata += datalen;
+            dataitem_move(tb, newbk, todata, dbk, fromdata);
+            todata += step;
             n++;
             if (ret == MEMLINK_VALUE_VISIBLE) {
                 newbk->visible_count++;
@@ -1029,12 +1981,12 @@ datablock_new_copy_pos(Table *tb, HashNode *node, DataBlock *dbk, int pos, void
                 newbk->tagdel_count++;
             }
         }
-        fromdata += datalen;
+        fromdata += step;
     }
 
     if (iscopy == 0 && todata < end_todata) {
         DINFO("copy value 4. %d, %s\n", i, (char*)value);
-        dataitem_copy(tb, node, todata, value, attr);
+        dataitem_copy(tb, newbk, todata, value, attr);
         newbk->visible_count++;
     }
     newbk->next = dbk->next;
@@ -1059,16 +2011,16 @@ datablock_copy(DataBlock *tobk, DataBlock *frombk, int datalen)
 inline int
 datablock_copy_used(Table *tb, HashNode *node, DataBlock *tobk, int topos, DataBlock *frombk)
 {
-    int  datalen   = tb->valuesize + tb->attrsize;
+    int  datalen   = dataitem_step(tb);
     char *fromdata = frombk->data;
-    char *todata   = tobk->data + topos * datalen;
+    char *todata   = datablock_item(tb, tobk, topos);
     //char *todata_end = tobk->data + tobk->data_count * datalen;
     int  i, ret;
     
     for (i = 0; i < frombk->data_count; i++) {
-        ret = dataitem_check_data(tb, node, fromdata);
+        ret = dataitem_check_data(tb, frombk, fromdata);
         if (ret != MEMLINK_VALUE_REMOVED) {
-            memcpy(todata, fromdata, datalen);
+            dataitem_move(tb, tobk, todata, frombk, fromdata);
             todata += datalen;
             topos++;
             if (ret == MEMLINK_VALUE_VISIBLE) {
@@ -1102,8 +2054,7 @@ datablock_copy_used_blocks(Table *tb, HashNode *node, DataBlock *tobk, int topos
 int
 datablock_resize(Table *tb, HashNode *node, DataBlock *dbk)
 {
-    int blockmax = g_cf->block_data_count[g_cf->block_data_count_items - 1];
-    int datalen  = tb->valuesize + tb->attrsize;  
+    int blockmax = datablock_max_size(tb, node->used);
     int dbksize  = dbk->visible_count + dbk->tagdel_count;
     int prevsize = 0;
     int nextsize = 0;
@@ -1126,40 +2077,40 @@ datablock_resize(Table *tb, HashNode *node, DataBlock *dbk)
 
     DataBlock *start = NULL, *end = NULL;
     int  num = 0;
-    int  newsize = datablock_suitable_size(dbksize);
+    int  newsize = datablock_suitable_size(tb, node->used, dbksize);
 
 
     //DINFO("newsize:%d\n", newsize);
     if (prevsize > 0 && nextsize > 0 && prevsize + dbksize + nextsize < blockmax) {
-        newsize = datablock_suitable_size(prevsize + dbksize + nextsize);
+        newsize = datablock_suitable_size(tb, node->used, prevsize + dbksize + nextsize);
         start = dbk->prev;
         end   = dbk->next;
         num   = 3;
         node->all = node->all - prevdcnt - dbkdcnt - nextdcnt + newsize;
         DINFO("merge 3 block, newsize:%d\n", newsize);
     }else if (prevsize > 0 && prevsize + dbksize < blockmax) {
-        newsize = datablock_suitable_size(prevsize + dbksize);
+        newsize = datablock_suitable_size(tb, node->used, prevsize + dbksize);
         start = dbk->prev;
         end   = dbk;
         num   = 2;
         node->all = node->all - prevdcnt - dbkdcnt + newsize;
         DINFO("merge prev, prevsize:%d, newsize:%d\n", prevsize, newsize);
     }else if (nextsize > 0 && dbksize + nextsize < blockmax) {
-        newsize = datablock_suitable_size(dbksize + nextsize);
+        newsize = datablock_suitable_size(tb, node->used, dbksize + nextsize);
         start = dbk;
         end   = dbk->next;
         num   = 2;
         node->all = node->all - dbkdcnt - nextdcnt + newsize;
         DINFO("merge next: nextsize:%d, newsize:%d\n", nextsize, newsize);
-    }else if (newsize < dbk->data_count) {
+    }else if (newsize >= dbksize && newsize < dbk->data_count) {
         int rate = (int)ceil(g_cf->block_data_reduce * dbk->data_count);
         int checksize = 1;
         int i;
 
         //checksize = datablock_suitable_size(dbkdcnt - 1);
-        for (i = 0; i < g_cf->block_data_count_items; i++) {
-            if (g_cf->block_data_count[i] < dbkdcnt)
-                checksize = g_cf->block_data_count[i];
+        for (i = 0; i < tb->block_count_items; i++) {
+            if (tb->block_count[i] < dbkdcnt)
+                checksize = tb->block_count[i];
         }
         DINFO("checksize: %d\n", checksize);
         if (checksize - dbksize >= rate) {
@@ -1174,7 +2125,7 @@ datablock_resize(Table *tb, HashNode *node, DataBlock *dbk)
     //DINFO("start:%p end:%p num:%d\n", start, end, num); 
     if (start) {
         //DINFO("start->next:%p\n", start->next);
-        DataBlock *newbk = mempool_get2(g_runtime->mpool, newsize, datalen);
+        DataBlock *newbk = datablock_get(tb, newsize);
         //DINFO("resize newbk:%p, count:%d\n", newbk, newbk->data_count);
         //DINFO("1 newbk prev:%p, next:%p\n", newbk->prev, newbk->next);
         datablock_copy_used_blocks(tb, node, newbk, 0, start, num);   
@@ -1201,7 +2152,8 @@ datablock_resize(Table *tb, HashNode *node, DataBlock *dbk)
         for (i = 0; i < num; i++) {
             //DINFO("mem put:%p, i:%d, num:%d\n", start, i, num);
             tmp = start->next; 
-            mempool_put2(g_runtime->mpool, start, datalen);
+            hashnode_index_release(tb, node, start);
+            datablock_put(tb, start);
             start = tmp;
         }
         //DINFO("after resize ...\n");
@@ -1212,17 +2164,47 @@ datablock_resize(Table *tb, HashNode *node, DataBlock *dbk)
 }
 
 
+/**
+ * 从表的内存池分配count个数据项的数据块, 计入tb->block_mem
+ */
+DataBlock*
+datablock_get(Table *tb, int count)
+{
+    int datalen = tb->valuesize + tb->attrsize;
+
+    tb->block_mem += sizeof(DataBlock) + count * datalen;
+    return mempool_get2(g_runtime->mpool, count, datalen);
+}
+
+static void
+datablock_free_func(void *ptr, void *owner, uint32_t datalen)
+{
+    mempool_put2((MemPool*)owner, (DataBlock*)ptr, datalen);
+}
+
+/**
+ * 数据块放回内存池, 读线程离开后才真正放回, 之前数据块内容和next指针都不变
+ */
+void
+datablock_put(Table *tb, DataBlock *dbk)
+{
+    int datalen = tb->valuesize + tb->attrsize;
+
+    tb->block_mem -= sizeof(DataBlock) + dbk->data_count * datalen;
+    epoch_retire(g_runtime->epoch, dbk, g_runtime->mpool, datalen, datablock_free_func);
+}
+
 /**
  * free datablock
  */
 int
-datablock_free(DataBlock *headbk, DataBlock *tobk, int datalen)
+datablock_free(Table *tb, DataBlock *headbk, DataBlock *tobk)
 {
     DataBlock   *tmp;
 
     while (headbk && headbk != tobk) {
         tmp = headbk->next;
-        mempool_put(g_runtime->mpool, headbk, sizeof(DataBlock) + headbk->data_count * datalen);
+        datablock_put(tb, headbk);
         headbk = tmp;
     }
     return MEMLINK_OK;
@@ -1232,13 +2214,13 @@ datablock_free(DataBlock *headbk, DataBlock *tobk, int datalen)
  * free datablock from backend, by loop dbk->prev pointer
  */
 int
-datablock_free_inverse(DataBlock *startbk, DataBlock *endbk, int datalen)
+datablock_free_inverse(Table *tb, DataBlock *startbk, DataBlock *endbk)
 {
     DataBlock   *tmp;
 
     while (startbk && startbk != endbk) {
         tmp = startbk->prev;
-        mempool_put(g_runtime->mpool, startbk, sizeof(DataBlock) + startbk->data_count * datalen);
+        datablock_put(tb, startbk);
         startbk = tmp;
     }
     return MEMLINK_OK;
@@ -2,50 +2,109 @@
 #define MEMLINK_DATABLOCK_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include "hashtable.h"
 
+/**
+ * item matcher of datablock_scan, built by attrmatch_init
+ */
+typedef struct _memlink_attr_match {
+    uint64_t    flag; // attr head word flag, kind bits folded in
+    uint64_t    val;
+    int         width; // 4 or 8 bytes attr head word
+    int         headsize;
+    int         tail; // items at block end whose head word is out of the block
+    char        *attrval; // attr bytes after the head word
+    char        *attrflag;
+}AttrMatch;
+
 int         dataitem_check_kind(int ret, int kind);
-int         dataitem_have_data(Table *, HashNode *node, char *itemdata, unsigned char kind);
+int         dataitem_have_data(Table *, DataBlock *dbk, char *itemdata, unsigned char kind);
 int         dataitem_check(char *itemdata, int valuesize);
-int         dataitem_check_data(Table*, HashNode *node, char *itemdata);
+int         dataitem_check_data(Table*, DataBlock *dbk, char *itemdata);
 char*       dataitem_lookup(Table*,HashNode *node, void *value, DataBlock **dbk);
 int         dataitem_lookup_pos(Table*,HashNode *node, void *value, DataBlock **dbk);
-int         dataitem_copy(Table*,HashNode *node, char *addr, void *value, void *attr);
-int         dataitem_copy_attr(Table*, HashNode *node, char *addr, char *attrflag, char *attr);
+int         dataitem_copy(Table*, DataBlock *dbk, char *addr, void *value, void *attr);
+void        dataitem_publish(Table*, DataBlock *dbk, char *addr, void *value, void *attr);
+int         dataitem_copy_attr(Table*, DataBlock *dbk, char *addr, char *attrflag, char *attr);
+void        dataitem_move(Table*, DataBlock *tobk, char *todata, DataBlock *frombk, char *fromdata);
+int         dataitem_pack(Table*, DataBlock *dbk, char *itemdata, char *buf);
 int         dataitem_lookup_pos_attr(Table *tb, HashNode *node, int pos, unsigned char kind, 
 						char *attrval, char *attrflag, DataBlock **dbk, int *dbkpos);
 int         dataitem_skip2pos(Table *,HashNode *node, DataBlock *dbk, int skip, unsigned char kind);
 
-int         datablock_suitable_size(int blocksize);
+void        datablock_init_sizes(Table*);
+int         datablock_max_size(Table*, int used);
+int         datablock_suitable_size(Table*, int used, int blocksize);
 int         datablock_print(Table *, HashNode *node, DataBlock *dbk);
 int         datablock_del(Table*, HashNode *node, DataBlock *dbk, char *data);
 int         datablock_del_restore(Table*, HashNode *node, DataBlock *dbk, char *data);
-int         datablock_lookup_pos(HashNode *node, int pos, unsigned char kind, DataBlock **dbk);
-int         datablock_lookup_valid_pos(HashNode *node, int pos, unsigned char kind, DataBlock **dbk);
+int         datablock_lookup_pos(Table*, HashNode *node, int pos, unsigned char kind, DataBlock **dbk);
+int         datablock_lookup_valid_pos(Table*, HashNode *node, int pos, unsigned char kind, DataBlock **dbk);
+void        hashnode_index_touch(Table*, HashNode *node, DataBlock *dbk);
+void        hashnode_index_update(Table*, HashNode *node);
+void        hashnode_index_free(Table*, HashNode *node);
+void        hashnode_index_release(Table*, HashNode *node, DataBlock *dbk);
+void        datablock_attr_add(Table*, DataBlock *dbk, char *attr);
+int         datablock_attr_match(Table*, HashNode *node, DataBlock *dbk, char *attrval, char *attrflag);
+void        attrmatch_init(Table*, AttrMatch *am, unsigned char kind, char *attrval, char *attrflag);
+uint64_t    datablock_scan(Table*, DataBlock *dbk, int start, AttrMatch *am);
 int         datablock_check_idle(HashNode *node, DataBlock *dbk, int skipn, void *value, void *attr);
 int         datablock_check_null_pos(Table*, HashNode *node, DataBlock *dbk, int pos, void *value, void *attr);
 DataBlock*  datablock_new_copy(Table*, HashNode *node, DataBlock *dbk, int skipn, void *value, void *attr);
+int         datablock_fill_pos(Table*, DataBlock *dbk, int pos, void *value, void *attr);
 DataBlock*  datablock_new_copy_pos(Table*, HashNode *node, DataBlock *dbk, int pos, void *value, void *attr);
 int         datablock_copy(DataBlock *tobk, DataBlock *frombk, int datalen);
+void        datablock_copy_items(Table*, DataBlock *tobk, int topos, DataBlock *frombk, int frompos, int count);
 int         datablock_copy_used(Table*, HashNode *node, DataBlock *tobk, int topos, DataBlock *frombk);
 int			datablock_copy_used_blocks(Table *, HashNode *node, DataBlock *tobk, int topos, 
 								DataBlock *frombk, int blockcount);
-int         datablock_free(DataBlock *headbk, DataBlock *tobk, int datalen);
-int         datablock_free_inverse(DataBlock *startbk, DataBlock *endbk, int datalen);
+int         datablock_free(Table*, DataBlock *headbk, DataBlock *tobk);
+int         datablock_free_inverse(Table*, DataBlock *startbk, DataBlock *endbk);
+DataBlock*  datablock_get(Table*, int count);
+void        datablock_put(Table*, DataBlock *dbk);
 
 int			datablock_resize(Table*, HashNode *node, DataBlock *dbk);
 
 int         attr_array2_binary_flag(unsigned char *attrformat, unsigned int *attrarray, 
                                     int attrnum, int attrsize, char *attrval, char *attrflag);
 
+ValueCmpFunc sortlist_valuecmp_func(unsigned char type);
 int         sortlist_valuecmp(unsigned char type, void *v1, void *v2, int size);
 int         sortlist_lookup(Table*,HashNode *node, int step, void *value, int kind, DataBlock **dbk);
 int         sortlist_lookup_valid(Table*, HashNode *node, int step, void *value, int kind, DataBlock **dbk);
 
+/*
+ * item address in DataBlock. itemdata always points to the value of an item.
+ * MEMLINK_LAYOUT_ROW:    value|attr value|attr ...
+ * MEMLINK_LAYOUT_COLUMN: value value ... attr attr ...
+ */
+#define		dataitem_step(tb) \
+			((tb)->layout == MEMLINK_LAYOUT_COLUMN ? (tb)->valuesize : (tb)->valuesize + (tb)->attrsize)
+
+#define		dataitem_attr_step(tb) \
+			((tb)->layout == MEMLINK_LAYOUT_COLUMN ? (tb)->attrsize : (tb)->valuesize + (tb)->attrsize)
+
+#define		datablock_item(tb,dbk,i)	((dbk)->data + (i) * dataitem_step(tb))
+
+#define		datablock_item_attr(tb,dbk,i) \
+			((tb)->layout == MEMLINK_LAYOUT_COLUMN ? \
+			 (dbk)->data + (dbk)->data_count * (tb)->valuesize + (i) * (tb)->attrsize : \
+			 (dbk)->data + (i) * ((tb)->valuesize + (tb)->attrsize) + (tb)->valuesize)
 
+#define		dataitem_attr(tb,dbk,itemdata) \
+			((tb)->layout == MEMLINK_LAYOUT_COLUMN ? \
+			 datablock_item_attr(tb, dbk, ((itemdata) - (dbk)->data) / (tb)->valuesize) : \
+			 (itemdata) + (tb)->valuesize)
+
+// fetch the next DataBlock of a chain walk early
+#define		datablock_prefetch(dbk)		__builtin_prefetch(dbk)
+
+// items of newdbk are written before it is linked, readers walk the link without lock
 #define		datablock_link_prev(node,dbk,newdbk) \
 			do{\
 				newdbk->prev = dbk->prev;\
+				__sync_synchronize();\
 				if (dbk->prev) { \
 					dbk->prev->next = newdbk;\
 				}else{ \
@@ -56,6 +115,7 @@ int         sortlist_lookup_valid(Table*, HashNode *node, int step, void *value,
 #define		datablock_link_next(node,dbk,newdbk) \
 			do{\
 				newdbk->next = dbk->next;\
+				__sync_synchronize();\
 				if (dbk->next) { \
 					dbk->next->prev = newdbk;\
 				}else{ \
@@ -66,12 +126,13 @@ int         sortlist_lookup_valid(Table*, HashNode *node, int step, void *value,
 #define		datablock_link_both(node,dbk,newdbk) \
 			do{\
 				newdbk->prev = dbk->prev;\
+				newdbk->next = dbk->next;\
+				__sync_synchronize();\
 				if (dbk->prev) { \
 					dbk->prev->next = newdbk;\
 				}else{ \
 					node->data = newdbk;\
 				}\
-				newdbk->next = dbk->next;\
 				if (dbk->next) { \
 					dbk->next->prev = newdbk;\
 				}else{ \
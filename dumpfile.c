@@ -26,6 +26,7 @@
 #include "common.h"
 #include "datablock.h"
 #include "runtime.h"
+#include "valuearena.h"
 #include "zzmalloc.h"
 
 
@@ -97,12 +98,12 @@ dumpfile(HashTable *ht)
 {
     Table       *tb;
     HashNode    *node;
+    TableIter   iter;
 
     char        tmpfile[PATH_MAX];
     char        dumpfile[PATH_MAX];
     char        dumpfilemd5[PATH_MAX];
     char        dumpfilemd5tmp[PATH_MAX];
-    int         i;
     long long   size = 0;
     struct timeval start, end;
     
@@ -151,7 +152,8 @@ dumpfile(HashTable *ht)
             ffwrite(tb->name, keylen, 1, fp);
             ffwrite(&tb->listtype, sizeof(char), 1, fp);
             ffwrite(&tb->valuetype, sizeof(char), 1, fp);
-            ffwrite(&tb->valuesize, sizeof(char), 1, fp);
+            uint8_t valuesize = table_is_vstring(tb) ? tb->varena.maxsize : tb->valuesize;
+            ffwrite(&valuesize, sizeof(char), 1, fp);
             ffwrite(&tb->sortfield, sizeof(char), 1, fp);
             ffwrite(&tb->attrsize, sizeof(char), 1, fp);
             ffwrite(&tb->attrnum, sizeof(char), 1, fp);
@@ -160,49 +162,70 @@ dumpfile(HashTable *ht)
             }
             datalen = tb->valuesize + tb->attrsize;
 
-            for (i = 0; i < HASHTABLE_BUNKNUM; i++) {
-                node = tb->nodes[i];
-                nodeflag = 1; 
-                while (NULL != node) {
-                    ffwrite(&nodeflag, sizeof(char), 1, fp);
-                    DINFO("start dump key:%s, len:%d, used:%u, datalen:%d\n", 
-                            node->key, (uint32_t)strlen(node->key), node->used, datalen);
-                    keylen = strlen(node->key);
-                    ffwrite(&keylen, sizeof(char), 1, fp);
-                    //DINFO("dump keylen: %d\n", keylen);
-                    ffwrite(node->key, keylen, 1, fp);
-                    ffwrite(&node->used, sizeof(int), 1, fp);
-                    
-                    long long ckpos = ftell(fp);
-                    used = 0;
-                    DataBlock *dbk = node->data;
-                    while (dbk) {
-                        char *itemdata = dbk->data;
-                        for (n = 0; n < dbk->data_count; n++) {
-                            if (dataitem_have_data(tb, node, itemdata, 0)) {    
+            nodeflag = 1; 
+            table_iter_init(tb, &iter);
+            while ((node = table_iter_next(&iter)) != NULL) {
+                ffwrite(&nodeflag, sizeof(char), 1, fp);
+                DINFO("start dump key:%s, len:%d, used:%u, datalen:%d\n", 
+                        hashnode_key(node), node->keylen, node->used, datalen);
+                keylen = node->keylen;
+                ffwrite(&keylen, sizeof(char), 1, fp);
+                //DINFO("dump keylen: %d\n", keylen);
+                ffwrite(hashnode_key(node), keylen, 1, fp);
+                ffwrite(&node->used, sizeof(int), 1, fp);
+                
+                long long ckpos = ftell(fp);
+                used = 0;
+                // items in cold store are already value|attr, compressed ones are decompressed
+                if (hashnode_is_cold(node)) {
+                    ColdRecord *rec = coldstore_record(g_runtime->coldstore, node);
+                    char *buf, *items = coldstore_items(tb, rec, &buf);
+                    if (NULL == items) {
+                        DERROR("cold record of %s.%s error!\n", tb->name, hashnode_key(node));
+                        MEMLINK_EXIT;
+                    }
+                    ffwrite(items, (size_t)rec->count * datalen, 1, fp);
+                    if (buf) {
+                        zz_free(buf);
+                    }
+                    dump_count += rec->count;
+                    used += rec->count;
+                }
+                DataBlock *dbk = node->data;
+                while (dbk) {
+                    char *itemdata = dbk->data;
+                    for (n = 0; n < dbk->data_count; n++) {
+                        if (dataitem_have_data(tb, dbk, itemdata, 0)) {    
+                            // 变长值写len|bytes, 后面是属性
+                            if (table_is_vstring(tb)) {
+                                unsigned char *v = valuearena_value(itemdata);
+                                ffwrite(v, 1 + v[0], 1, fp);
+                                ffwrite(dataitem_attr(tb, dbk, itemdata), tb->attrsize, 1, fp);
+                            // 列式布局下value与属性分开存放, 文件里仍按value|attr写
+                            }else if (tb->layout == MEMLINK_LAYOUT_COLUMN) {
+                                ffwrite(itemdata, tb->valuesize, 1, fp);
+                                ffwrite(dataitem_attr(tb, dbk, itemdata), tb->attrsize, 1, fp);
+                            }else{
                                 ffwrite(itemdata, datalen, 1, fp);
-                                dump_count += 1;
-                                used++;
                             }
-                            itemdata += datalen;
+                            dump_count += 1;
+                            used++;
                         }
-                        dbk = dbk->next;
+                        itemdata += dataitem_step(tb);
                     }
-                    if (used != node->used) {
-                        DWARNING("data used error, node->used:%d, used:%d in %s.%s\n", 
-                                node->used, used, tb->name, node->key);
-                        long long mypos = ftell(fp);
-                        fseek(fp, ckpos, SEEK_SET);
-                        ffwrite(&used, sizeof(int), 1, fp);
-                        fseek(fp, mypos, SEEK_SET);
-                    }
-                    node = node->next;
+                    dbk = dbk->next;
                 }
-                if (tb->nodes[i] != NULL) {
-                    nodeflag = 0;
-                    ffwrite(&nodeflag, sizeof(char), 1, fp);
+                if (used != node->used) {
+                    DWARNING("data used error, node->used:%d, used:%d in %s.%s\n", 
+                            node->used, used, tb->name, hashnode_key(node));
+                    long long mypos = ftell(fp);
+                    fseek(fp, ckpos, SEEK_SET);
+                    ffwrite(&used, sizeof(int), 1, fp);
+                    fseek(fp, mypos, SEEK_SET);
                 }
             }
+            nodeflag = 0;
+            ffwrite(&nodeflag, sizeof(char), 1, fp);
             tb = tb->next;
         }
     }
@@ -331,7 +354,7 @@ dumpfile_load(HashTable *ht, char *filename, int localdump)
     int           i;
     int           datalen;
     int           load_count = 0;
-    unsigned int  block_data_count_max = g_cf->block_data_count[g_cf->block_data_count_items - 1];
+    unsigned int  block_data_count_max;
     
     Table   *tb;
 
@@ -387,6 +410,7 @@ dumpfile_load(HashTable *ht, char *filename, int localdump)
             DataBlock   *newdbk;
             char        *itemdata = NULL;
 
+            block_data_count_max = datablock_max_size(tb, itemnum);
             for (i = 0; i < itemnum; i++) {
                 //DINFO("i: %d\n", i);
                 if (i % block_data_count_max == 0) {
@@ -401,9 +425,9 @@ dumpfile_load(HashTable *ht, char *filename, int localdump)
                        }*/
 
                     if (itemnum - i > block_data_count_max) {
-                        newdbk = mempool_get2(g_runtime->mpool, block_data_count_max, datalen); 
+                        newdbk = datablock_get(tb, block_data_count_max); 
                     }else{
-                        newdbk = mempool_get2(g_runtime->mpool, itemnum-i, datalen); 
+                        newdbk = datablock_get(tb, itemnum-i); 
                     }
 
                     if (NULL == newdbk) {
@@ -422,8 +446,22 @@ dumpfile_load(HashTable *ht, char *filename, int localdump)
 
                     itemdata = dbk->data;
                 }
-                ret = ffread(itemdata, datalen, 1, fp);
-                ret = dataitem_check_data(tb, node, itemdata);
+                if (table_is_vstring(tb)) {
+                    unsigned char vlen;
+                    char          value[256] = {0};
+                    ret = ffread(&vlen, sizeof(char), 1, fp);
+                    if (vlen > 0) {
+                        ret = ffread(value, vlen, 1, fp);
+                    }
+                    valuearena_put(&tb->varena, value, itemdata);
+                    ret = ffread(dataitem_attr(tb, dbk, itemdata), attrsize, 1, fp);
+                }else if (tb->layout == MEMLINK_LAYOUT_COLUMN) {
+                    ret = ffread(itemdata, valuesize, 1, fp);
+                    ret = ffread(dataitem_attr(tb, dbk, itemdata), attrsize, 1, fp);
+                }else{
+                    ret = ffread(itemdata, datalen, 1, fp);
+                }
+                ret = dataitem_check_data(tb, dbk, itemdata);
                 if (ret == MEMLINK_VALUE_VISIBLE) {
                     dbk->visible_count++;
                 }else{
@@ -435,10 +473,11 @@ dumpfile_load(HashTable *ht, char *filename, int localdump)
                   memcpy(buf, itemdata, node->valuesize);
                   DINFO("load value: %s\n", buf);*/
 
-                itemdata += datalen;
+                itemdata += dataitem_step(tb);
                 load_count += 1;
             }
             node->data_tail = dbk;
+            hashnode_index_update(tb, node);
 
         }
     }
@@ -0,0 +1,235 @@
+/**
+ * 基于epoch的延迟释放
+ * 读线程不加锁遍历HashNode和DataBlock链, 写线程摘下的数据块, 节点和表先放入
+ * 当前批次, 批次封存时记下全局epoch并把全局epoch加一. 所有读线程都已离开
+ * 该epoch后批次中的对象才真正释放. 写线程从不等待读线程
+ * 插入到活动数据块的空位时先写值和属性, 再加内存屏障, 最后写标记字节, 读线程
+ * 看不到写了一半的数据项. 块满了, 或要在块中移动数据项时才复制到新数据块, 写完
+ * 后再链入. 删除, 弹出, 标记删除, 改属性只改单个数据项的标记和属性, 读线程看到
+ * 修改前或修改后的数据项, 块的计数可能和数据项差几项
+ * @file epoch.c
+ * @ingroup memlink
+ * @{
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "logfile.h"
+#include "zzmalloc.h"
+#include "epoch.h"
+
+__thread int epoch_slot = -1;
+
+Epoch*
+epoch_create()
+{
+    Epoch *e = (Epoch*)zz_malloc(sizeof(Epoch));
+    if (NULL == e) {
+        DERROR("malloc Epoch error!\n");
+        return NULL;
+    }
+    memset(e, 0, sizeof(Epoch));
+    e->global = 1;
+
+    return e;
+}
+
+static void
+epoch_batch_free(RetireBatch *batch)
+{
+    uint32_t i;
+
+    for (i = 0; i < batch->count; i++) {
+        batch->items[i].func(batch->items[i].ptr, batch->items[i].owner, batch->items[i].arg);
+    }
+}
+
+/**
+ * free all pending objects, no read thread is running
+ */
+void
+epoch_destroy(Epoch *e)
+{
+    RetireBatch *batch;
+
+    if (NULL == e)
+        return;
+
+    // objects retired by free functions are freed at once
+    e->reclaiming = 1;
+    while (e->sealed || e->current) {
+        if (e->sealed) {
+            batch = e->sealed;
+            e->sealed = batch->next;
+            if (NULL == e->sealed) {
+                e->sealed_tail = NULL;
+            }
+        }else{
+            batch = e->current;
+            e->current = NULL;
+        }
+        epoch_batch_free(batch);
+        zz_free(batch);
+    }
+    if (e->spare) {
+        zz_free(e->spare);
+    }
+    zz_free(e);
+}
+
+/**
+ * give the calling read thread a slot, called once when the thread starts
+ */
+int
+epoch_register(Epoch *e)
+{
+    int i;
+
+    if (NULL == e || epoch_slot >= 0)
+        return epoch_slot;
+
+    i = __sync_fetch_and_add(&e->nslots, 1);
+    if (i >= EPOCH_SLOT_MAX) {
+        DERROR("too many read threads for epoch: %d\n", i);
+        MEMLINK_EXIT;
+    }
+    e->slots[i].active = 0;
+    epoch_slot = i;
+    DINFO("epoch slot %d registered\n", i);
+
+    return i;
+}
+
+/**
+ * the current batch gets the global epoch, then the global epoch moves on.
+ * __sync_fetch_and_add is a full barrier, objects of the batch are unlinked
+ * before any reader sees the new epoch
+ */
+static void
+epoch_seal(Epoch *e)
+{
+    RetireBatch *batch = e->current;
+
+    batch->epoch = e->global;
+    batch->next  = NULL;
+    if (e->sealed_tail) {
+        e->sealed_tail->next = batch;
+    }else{
+        e->sealed = batch;
+    }
+    e->sealed_tail = batch;
+    e->current = NULL;
+    __sync_fetch_and_add(&e->global, 1);
+}
+
+/**
+ * free batches sealed before the oldest epoch of active readers.
+ * caller holds g_runtime->mutex
+ * @return objects freed
+ */
+int
+epoch_reclaim(Epoch *e)
+{
+    RetireBatch *batch;
+    uint64_t    min, active;
+    int         i, n = 0;
+
+    if (NULL == e || e->reclaiming || e->pending == 0)
+        return 0;
+
+    e->reclaiming = 1;
+    if (e->current && e->current->count > 0) {
+        epoch_seal(e);
+    }
+    min = e->global;
+    for (i = 0; i < e->nslots && i < EPOCH_SLOT_MAX; i++) {
+        active = e->slots[i].active;
+        if (active > 0 && active < min) {
+            min = active;
+        }
+    }
+    while (e->sealed && e->sealed->epoch < min) {
+        batch = e->sealed;
+        e->sealed = batch->next;
+        if (NULL == e->sealed) {
+            e->sealed_tail = NULL;
+        }
+        epoch_batch_free(batch);
+        e->pending -= batch->count;
+        n += batch->count;
+        if (e->spare) {
+            zz_free(batch);
+        }else{
+            e->spare = batch;
+        }
+    }
+    e->reclaiming = 0;
+    if (n > 0) {
+        DINFO("epoch reclaim %d, pending:%llu, min:%llu, global:%llu\n", n,
+                (unsigned long long)e->pending, (unsigned long long)min, (unsigned long long)e->global);
+    }
+
+    return n;
+}
+
+/**
+ * free ptr when no read thread can see it any more. ptr is already unlinked
+ * from tables. caller holds g_runtime->mutex
+ * @param owner,arg passed to func
+ */
+void
+epoch_retire(Epoch *e, void *ptr, void *owner, uint32_t arg, EpochFreeFunc func)
+{
+    RetireBatch *batch;
+    Retired     *r;
+
+    if (NULL == e) {
+        func(ptr, owner, arg);
+        return;
+    }
+    // no read thread at all, nobody holds ptr. the barrier orders the unlink
+    // before the check against a thread registering now. in reclaim ptr is a
+    // part of an object readers have left, like blocks of a destroyed table
+    __sync_synchronize();
+    if (e->nslots == 0 || e->reclaiming) {
+        func(ptr, owner, arg);
+        return;
+    }
+
+    batch = e->current;
+    if (NULL == batch) {
+        if (e->spare) {
+            batch = e->spare;
+            e->spare = NULL;
+        }else{
+            batch = (RetireBatch*)zz_malloc(sizeof(RetireBatch) + sizeof(Retired) * EPOCH_BATCH_SIZE);
+            if (NULL == batch) {
+                DERROR("malloc RetireBatch error!\n");
+                MEMLINK_EXIT;
+            }
+        }
+        batch->count = 0;
+        batch->next  = NULL;
+        e->current   = batch;
+    }
+    r = &batch->items[batch->count++];
+    r->ptr   = ptr;
+    r->owner = owner;
+    r->arg   = arg;
+    r->func  = func;
+    e->pending++;
+
+    if (batch->count == EPOCH_BATCH_SIZE) {
+        epoch_seal(e);
+        epoch_reclaim(e);
+    }
+}
+
+void
+epoch_zz_free(void *ptr, void *owner, uint32_t arg)
+{
+    zz_free(ptr);
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,79 @@
+#ifndef MEMLINK_EPOCH_H
+#define MEMLINK_EPOCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "common.h"
+
+// free function of a retired object, called by epoch_reclaim with g_runtime->mutex held
+typedef void (*EpochFreeFunc)(void *ptr, void *owner, uint32_t arg);
+
+// active epoch of a read thread, 0 when it is between commands. one cache line each
+typedef struct _memlink_epochslot
+{
+    volatile uint64_t   active;
+    char                pad[64 - sizeof(uint64_t)];
+}EpochSlot;
+
+typedef struct _memlink_retired
+{
+    void            *ptr;
+    void            *owner;
+    EpochFreeFunc   func;
+    uint32_t        arg;
+}Retired;
+
+// objects retired while global was epoch, freed when no reader is active in it
+typedef struct _memlink_retirebatch
+{
+    struct _memlink_retirebatch *next;
+    uint64_t        epoch;
+    uint32_t        count;
+    Retired         items[0];
+}RetireBatch;
+
+typedef struct _memlink_epoch
+{
+    volatile uint64_t   global;
+    EpochSlot           slots[EPOCH_SLOT_MAX];
+    volatile int        nslots;   // registered read threads
+    RetireBatch         *current; // filled by epoch_retire
+    RetireBatch         *sealed;  // oldest first
+    RetireBatch         *sealed_tail;
+    RetireBatch         *spare;
+    uint64_t            pending;  // retired objects not freed yet
+    int                 reclaiming;
+}Epoch;
+
+extern __thread int epoch_slot;
+
+Epoch*  epoch_create();
+void    epoch_destroy(Epoch *e);
+int     epoch_register(Epoch *e);
+void    epoch_retire(Epoch *e, void *ptr, void *owner, uint32_t arg, EpochFreeFunc func);
+int     epoch_reclaim(Epoch *e);
+void    epoch_zz_free(void *ptr, void *owner, uint32_t arg);
+
+/**
+ * a read thread enters before it looks at any table, and exits after the
+ * reply is built. objects unlinked before the enter are never seen
+ */
+static inline void
+epoch_enter(Epoch *e)
+{
+    if (e && epoch_slot >= 0) {
+        e->slots[epoch_slot].active = e->global;
+        __sync_synchronize();
+    }
+}
+
+static inline void
+epoch_exit(Epoch *e)
+{
+    if (e && epoch_slot >= 0) {
+        __sync_synchronize();
+        e->slots[epoch_slot].active = 0;
+    }
+}
+
+#endif
@@ -194,11 +194,14 @@ test_stat_sys()
 \tconn_write: %u\n\tconn_sync: %u\n \
 \tthreads: %u\n\tpid: %u\n \
 \tuptime: %u\n\tbit: %u\n \
-\tlast_dump: %u\n", \
+\tlast_dump: %u\n\tslab_mem: %u\n\thugepage_mem: %u\n\tmem_used: %u\n\tevicted_keys: %u\n \
+\tcold_keys: %u\n\tcold_mem: %u\n", \
            stat.version, stat.keys, stat.values, stat.blocks, stat.data_all, \
            stat.ht_mem, stat.pool_mem, stat.pool_blocks, stat.all_mem, \
            stat.conn_read, stat.conn_write, stat.conn_sync, stat.threads, \
-           stat.pid, stat.uptime, stat.bit, stat.last_dump \
+           stat.pid, stat.uptime, stat.bit, stat.last_dump, \
+           stat.slab_mem, stat.hugepage_mem, stat.mem_used, stat.evicted_keys, \
+           stat.cold_keys, stat.cold_mem \
           );
 
     return 1;
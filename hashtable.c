@@ -17,6 +17,8 @@
 #include "datablock.h"
 #include "common.h"
 #include "runtime.h"
+#include "coldstore.h"
+#include "valuearena.h"
 
 
 /**
@@ -81,30 +83,58 @@ hashtable_clear_all(HashTable *ht)
     Table *tb, *tbnext;
     for (i = 0; i < HASHTABLE_MAX_TABLE; i++) {
         tb = ht->tables[i]; 
+        ht->tables[i] = NULL;
         while (tb) {
             tbnext = tb->next;
-            table_destroy(tb);
-            tb = tb->next;
+            table_retire(tb);
+            tb = tbnext;
         }
     }
+    ht->table_count = 0;
 }
 
 /**
- * hash函数
+ * key的hash函数, MurmurHash64A, 每次处理8字节
+ * 返回完整的32位hash, 保存在HashNode中
  */
 uint32_t
 hashtable_node_hash(char *str, int len)
 {
-    //BKDR Hash
-    uint32_t seed = 131;
-    uint32_t hash = 0;
-    int i;
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int      r = 47;
+    uint64_t h = 0x5bd1e995 ^ (len * m);
+    uint64_t k;
+    const unsigned char *data = (const unsigned char*)str;
+    const unsigned char *end  = data + (len & ~7);
 
-    for (i = 0; i < len; i++) {   
-        hash = hash * seed + (*str++);
-    }   
+    while (data != end) {
+        memcpy(&k, data, sizeof(uint64_t));
+        data += sizeof(uint64_t);
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    switch (len & 7) {
+    case 7: h ^= (uint64_t)data[6] << 48;
+    case 6: h ^= (uint64_t)data[5] << 40;
+    case 5: h ^= (uint64_t)data[4] << 32;
+    case 4: h ^= (uint64_t)data[3] << 24;
+    case 3: h ^= (uint64_t)data[2] << 16;
+    case 2: h ^= (uint64_t)data[1] << 8;
+    case 1: h ^= (uint64_t)data[0];
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
 
-    return (hash & 0x7FFFFFFF) % HASHTABLE_BUNKNUM;
+    return (uint32_t)(h ^ (h >> 32));
 }
 uint32_t
 hashtable_table_hash(char *str, int len)
@@ -176,6 +206,11 @@ hashtable_create_table(HashTable *ht, char *name, int valuesize,
     if (ht->table_count >= HASHTABLE_MAX_TABLE) {
         return MEMLINK_ERR_TABLE_TOO_MANY; 
     }
+    // variable length values are not ordered
+    if (valuetype == MEMLINK_VALUE_VSTRING && 
+        (listtype == MEMLINK_SORTLIST || valuesize <= 0 || valuesize > 255)) {
+        return MEMLINK_ERR_PARAM;
+    }
     int      namelen = strlen(name);
     uint32_t hash    = hashtable_table_hash(name, namelen);
     Table    *tb     = ht->tables[hash];
@@ -196,6 +231,273 @@ hashtable_create_table(HashTable *ht, char *name, int valuesize,
     return MEMLINK_OK;
 }
 
+// index[1] when not rehashing, no bunk and never freed
+static HashIndex hashindex_none;
+
+static HashIndex*
+hashindex_create(uint32_t size)
+{
+    HashIndex *hi = (HashIndex*)zz_malloc(sizeof(HashIndex));
+
+    hi->bunks = (HashNode**)zz_malloc(sizeof(HashNode*) * size);
+    memset(hi->bunks, 0, sizeof(HashNode*) * size);
+    mem_used_inc(sizeof(HashNode*) * size);
+    hi->size  = size;
+    hi->used  = 0;
+    return hi;
+}
+
+static void
+hashindex_free(HashIndex *hi)
+{
+    if (hi == &hashindex_none)
+        return;
+    zz_free(hi->bunks);
+    mem_used_dec(sizeof(HashNode*) * hi->size);
+    zz_free(hi);
+}
+
+static void
+hashindex_free_func(void *ptr, void *owner, uint32_t arg)
+{
+    HashIndex *hi = (HashIndex*)ptr;
+
+    zz_free(hi->bunks);
+    zz_free(hi);
+}
+
+/**
+ * move at most n non-empty bunks from index[0] to index[1]. 
+ * rehash is spread across write operations, so there is no long pause 
+ * when a table grows. a moved node is relinked in index[1] under readers,
+ * rehash_seq is odd meanwhile and a reader missing a key looks again.
+ * the finished index takes the place of index[0] as a whole, the old one 
+ * is retired
+ */
+static void
+table_rehash_step(Table *tb, int n)
+{
+    HashIndex   *from = tb->index[0];
+    HashIndex   *to   = tb->index[1];
+    int         empty = n * 10; // max empty bunks visited in one step
+    HashNode    *node, *next;
+    uint32_t    h;
+
+    if (tb->rehashidx < 0)
+        return;
+
+    tb->rehash_seq++;
+    __sync_synchronize();
+    while (n > 0 && tb->rehashidx < from->size) {
+        node = from->bunks[tb->rehashidx];
+        if (NULL == node) {
+            tb->rehashidx++;
+            if (--empty == 0)
+                break;
+            continue;
+        }
+        while (node) {
+            next = node->next;
+            h = node->hash & (to->size - 1);
+            node->next = to->bunks[h];
+            to->bunks[h] = node;
+            from->used--;
+            to->used++;
+            node = next;
+        }
+        from->bunks[tb->rehashidx] = NULL;
+        tb->rehashidx++;
+        n--;
+    }
+
+    if (tb->rehashidx >= from->size) {
+        DINFO("table %s rehash complete, size:%u, used:%u\n", tb->name, to->size, to->used);
+        tb->index[0] = to;
+        tb->index[1] = &hashindex_none;
+        tb->rehashidx = -1;
+        // readers may still look at the old bunks
+        mem_used_dec(sizeof(HashNode*) * from->size);
+        epoch_retire(g_runtime->epoch, from, NULL, 0, hashindex_free_func);
+    }
+    __sync_synchronize();
+    tb->rehash_seq++;
+}
+
+/**
+ * start a rehash to a twice large index when node count reach bunk count
+ */
+static void
+table_expand_check(Table *tb)
+{
+    if (tb->rehashidx >= 0)
+        return;
+    if (tb->index[0]->used < tb->index[0]->size)
+        return;
+
+    DINFO("table %s start rehash, size:%u, used:%u\n", tb->name, 
+            tb->index[0]->size, tb->index[0]->used);
+    tb->index[1] = hashindex_create(tb->index[0]->size * 2);
+    tb->rehashidx = 0;
+    tb->rehashes++;
+}
+
+/**
+ * start a rehash to a smaller index when less than 1/HASHTABLE_SHRINK_RATIO
+ * of bunk count are used, so random bunks of the index are seldom empty
+ */
+static void
+table_shrink_check(Table *tb)
+{
+    uint32_t size = HASHTABLE_INDEX_INIT_SIZE;
+
+    if (tb->rehashidx >= 0 || tb->index[0]->size <= HASHTABLE_INDEX_INIT_SIZE)
+        return;
+    if ((uint64_t)tb->index[0]->used * HASHTABLE_SHRINK_RATIO >= tb->index[0]->size)
+        return;
+
+    while (size < tb->index[0]->used * 2) {
+        size *= 2;
+    }
+    DINFO("table %s start shrink rehash, size:%u, used:%u, new size:%u\n", tb->name, 
+            tb->index[0]->size, tb->index[0]->used, size);
+    tb->index[1] = hashindex_create(size);
+    tb->rehashidx = 0;
+    tb->rehashes++;
+}
+
+/**
+ * get a HashNode from the table arena. slabs grow from HASHNODE_SLAB_MIN 
+ * to HASHNODE_SLAB_MAX nodes, so small tables stay small.
+ */
+static HashNode*
+nodearena_get(NodeArena *na)
+{
+    HashNode *node;
+    NodeSlab *slab = na->slabs;
+
+    if (na->freelist) {
+        node = na->freelist;
+        na->freelist = node->next;
+    }else{
+        if (NULL == slab || slab->used >= slab->count) {
+            uint32_t count = (slab == NULL) ? HASHNODE_SLAB_MIN : slab->count * 2;
+            if (count > HASHNODE_SLAB_MAX) {
+                count = HASHNODE_SLAB_MAX;
+            }
+            slab = (NodeSlab*)zz_malloc(sizeof(NodeSlab) + sizeof(HashNode) * count);
+            if (NULL == slab) {
+                DERROR("malloc NodeSlab error!\n");
+                MEMLINK_EXIT;
+            }
+            slab->count = count;
+            slab->used  = 0;
+            slab->next  = na->slabs;
+            na->slabs   = slab;
+            na->mem    += sizeof(NodeSlab) + sizeof(HashNode) * count;
+            mem_used_inc(sizeof(NodeSlab) + sizeof(HashNode) * count);
+        }
+        node = &slab->nodes[slab->used++];
+    }
+    memset(node, 0, sizeof(HashNode));
+    return node;
+}
+
+static void
+nodearena_put(NodeArena *na, HashNode *node)
+{
+    if (node->keylen >= HASHNODE_KEY_INLINE) {
+        zz_free(node->key.ptr);
+        na->mem -= node->keylen + 1;
+        mem_used_dec(node->keylen + 1);
+    }
+    node->next   = na->freelist;
+    na->freelist = node;
+}
+
+static void
+nodearena_destroy(NodeArena *na)
+{
+    NodeSlab *slab = na->slabs, *tmp;
+
+    while (slab) {
+        tmp  = slab;
+        slab = slab->next;
+        zz_free(tmp);
+    }
+    mem_used_dec(na->mem);
+    memset(na, 0, sizeof(NodeArena));
+}
+
+uint32_t
+table_key_count(Table *tb)
+{
+    return tb->index[0]->used + tb->index[1]->used;
+}
+
+/**
+ * memory used by the bunks of hash index
+ */
+uint32_t
+table_index_mem(Table *tb)
+{
+    return sizeof(HashNode*) * (tb->index[0]->size + tb->index[1]->size);
+}
+
+/**
+ * memory used by HashNode slabs and keys stored out of node
+ */
+uint32_t
+table_node_mem(Table *tb)
+{
+    return tb->arena.mem;
+}
+
+/**
+ * all memory of a table: DataBlocks, nodes and keys, values out of line, hash index, BlockIndex
+ * and compressed items of idle keys
+ */
+uint64_t
+table_mem(Table *tb)
+{
+    return tb->block_mem + tb->arena.mem + valuearena_mem(&tb->varena) + table_index_mem(tb) + tb->bindex_mem +
+           tb->compress_mem;
+}
+
+void
+table_iter_init(Table *tb, TableIter *iter)
+{
+    iter->tb   = tb;
+    iter->idx  = 0;
+    iter->bunk = 0;
+    iter->node = NULL;
+}
+
+HashNode*
+table_iter_next(TableIter *iter)
+{
+    HashIndex *hi;
+
+    if (iter->node) {
+        iter->node = iter->node->next;
+        if (iter->node)
+            return iter->node;
+        iter->bunk++;
+    }
+
+    while (iter->idx < 2) {
+        hi = iter->tb->index[iter->idx];
+        while (iter->bunk < hi->size) {
+            iter->node = hi->bunks[iter->bunk];
+            if (iter->node)
+                return iter->node;
+            iter->bunk++;
+        }
+        iter->idx++;
+        iter->bunk = 0;
+    }
+    return NULL;
+}
+
 Table*  
 table_create(char *name, int valuesize, uint32_t *attrarray, uint8_t attrnum, 
              uint8_t listtype, uint8_t valuetype)
@@ -214,7 +516,22 @@ table_create(char *name, int valuesize, uint32_t *attrarray, uint8_t attrnum,
     tb->listtype  = listtype;
     tb->valuetype = valuetype;
     tb->valuesize = valuesize;
+    tb->valuecmp  = sortlist_valuecmp_func(valuetype);
     tb->attrnum   = attrnum;
+    // column layout needs value to find attr of an item
+    if (valuesize > 0) {
+        tb->layout = g_cf->block_layout;
+    }
+    tb->evict = myconfig_evict_mode(name);
+    tb->cold  = myconfig_cold_table(name);
+    tb->compress = myconfig_compress_table(name);
+    // item holds a pointer to the value, the value arena is not spilled
+    if (valuetype == MEMLINK_VALUE_VSTRING) {
+        valuearena_init(&tb->varena, valuesize, myconfig_intern_table(name));
+        tb->valuesize = sizeof(char*);
+        tb->cold = 0;
+        tb->compress = 0;
+    }
     
     int attrsize = 2; // tagdel 1bit, real del 1bit
     int i;
@@ -240,9 +557,10 @@ table_create(char *name, int valuesize, uint32_t *attrarray, uint8_t attrnum,
         }
     }
 
-    HashNode**  nodes = (HashNode**)zz_malloc(sizeof(HashNode*) * HASHTABLE_BUNKNUM);
-    memset(nodes, 0, sizeof(HashNode*) * HASHTABLE_BUNKNUM);
-    tb->nodes = nodes;
+    datablock_init_sizes(tb);
+    tb->index[0]  = hashindex_create(HASHTABLE_INDEX_INIT_SIZE);
+    tb->index[1]  = &hashindex_none;
+    tb->rehashidx = -1;
 
     return tb;
 }
@@ -257,6 +575,45 @@ hashtable_create_node(HashTable *ht, char *tbname, char *key)
     return table_create_node(tb, key);
 }
 
+/**
+ * free the blocks, index and cold record of a node, the node itself is kept
+ */
+static void
+hashnode_release(Table *tb, HashNode *node)
+{
+    DataBlock    *dbk = node->data;
+    DataBlock    *tmp;
+
+    hashnode_index_free(tb, node);
+    if (hashnode_is_cold(node)) {
+        coldstore_drop(g_runtime->coldstore, tb, node);
+    }
+    while (dbk) {
+        tmp = dbk;
+        dbk = dbk->next;
+        datablock_put(tb, tmp);    
+    }
+}
+
+static void
+hashnode_free_func(void *ptr, void *owner, uint32_t arg)
+{
+    nodearena_put((NodeArena*)owner, (HashNode*)ptr);
+}
+
+/**
+ * remove a node unlinked from the index. a reader may be on the node or its
+ * blocks, both go back to the arena and pool after readers leave
+ */
+int 
+hashnode_remove(Table *tb, HashNode *node)
+{
+    hashnode_release(tb, node);
+    epoch_retire(g_runtime->epoch, node, &tb->arena, 0, hashnode_free_func);
+    return MEMLINK_OK;
+}
+
+
 void 
 table_clear(Table *tb)
 {
@@ -265,64 +622,71 @@ table_clear(Table *tb)
         return;
     }
 
-    HashNode **nodes = tb->nodes;
-    int i;
+    HashNode    *node, *tmp;
+    uint32_t    i;
+    int         k;
 
-    for (i=0; i<HASHTABLE_BUNKNUM; i++) {
-        HashNode *node = nodes[i];
-        if (node) {
-            DataBlock   *dbk = node->data;
-            DataBlock   *tmp; 
-            while (dbk) {
-                tmp = dbk;
-                dbk = dbk->next;
-                zz_free(tmp);
+    for (k = 0; k < 2; k++) {
+        for (i = 0; i < tb->index[k]->size; i++) {
+            node = tb->index[k]->bunks[i];
+            while (node) {
+                tmp = node->next;
+                hashnode_release(tb, node);
+                nodearena_put(&tb->arena, node);
+                node = tmp;
             }
-            zz_free(node->key);
         }
-
-    }
-    memset(nodes, 0, sizeof(HashNode*) * HASHTABLE_BUNKNUM);
-}
-
-int 
-hashnode_remove(Table *tb, HashNode *node)
-{
-    DataBlock    *dbk = node->data;
-    DataBlock    *tmp;
-    int          datalen = tb->valuesize + tb->attrsize;
-
-    zz_free(node->key);        
-    zz_free(node);
-    
-    while (dbk) {
-        tmp = dbk;
-        dbk = dbk->next;
-        mempool_put(g_runtime->mpool, tmp, sizeof(DataBlock) + tmp->data_count * datalen);    
+        hashindex_free(tb->index[k]);
     }
-    return MEMLINK_OK;
+    nodearena_destroy(&tb->arena);
+    valuearena_clear(&tb->varena);
+    tb->index[0]  = hashindex_create(HASHTABLE_INDEX_INIT_SIZE);
+    tb->index[1]  = &hashindex_none;
+    tb->rehashidx = -1;
 }
 
-
 void 
 table_destroy(Table *tb)
 {
     HashNode *node, *tmp;
-    int i;
-    for (i = 0; i < HASHTABLE_BUNKNUM; i++) {
-        node = tb->nodes[i];
-        while (node) {
-            tmp = node->next;
-            hashnode_remove(tb, node);
-            node = tmp;
+    uint32_t i;
+    int      k;
+
+    for (k = 0; k < 2; k++) {
+        for (i = 0; i < tb->index[k]->size; i++) {
+            node = tb->index[k]->bunks[i];
+            while (node) {
+                tmp = node->next;
+                hashnode_release(tb, node);
+                nodearena_put(&tb->arena, node);
+                node = tmp;
+            }
         }
+        hashindex_free(tb->index[k]);
     }
+    nodearena_destroy(&tb->arena);
+    valuearena_clear(&tb->varena);
     if (tb->attrnum >= sizeof(void*)) {
         zz_free(tb->attrformat);
     }
     zz_free(tb);
 }
 
+static void
+table_free_func(void *ptr, void *owner, uint32_t arg)
+{
+    table_destroy((Table*)ptr);
+}
+
+/**
+ * destroy a table unlinked from the hashtable after readers leave
+ */
+void
+table_retire(Table *tb)
+{
+    epoch_retire(g_runtime->epoch, tb, NULL, 0, table_free_func);
+}
+
 inline uint8_t*
 table_attrformat(Table *tb)
 {
@@ -355,7 +719,7 @@ table_find_value(Table *tb, char *key, void *value, HashNode **node,
         ret = sortlist_lookup(tb, fnode, MEMLINK_SORTLIST_LOOKUP_STEP, value, MEMLINK_VALUE_ALL, dbk);
         if (ret < 0)
             return MEMLINK_ERR_NOVAL;
-        *data = (*dbk)->data + (tb->valuesize + tb->attrsize) * ret;
+        *data = datablock_item(tb, *dbk, ret);
     }else{ 
         char *item = dataitem_lookup(tb, fnode, value, dbk);
         if (NULL == item) {
@@ -387,28 +751,125 @@ table_find_value_pos(Table *tb, char *key, void *value, HashNode **node, DataBlo
 }
 
 
+#define EVICT_CLOCK_MASK    0xffffff
+#define EVICT_LFU_MINUTE(t) ((uint32_t)((t) / 60) & 0xffff)
+
+/**
+ * LFU counter of node after decay, one less every MEMLINK_LFU_DECAY_TIME
+ * minutes since last access
+ */
+static uint32_t
+hashnode_lfu_counter(HashNode *node, time_t now)
+{
+    uint32_t counter = node->access & 0xff;
+    uint32_t minutes = (EVICT_LFU_MINUTE(now) - (node->access >> 8)) & 0xffff;
+    uint32_t periods = minutes / MEMLINK_LFU_DECAY_TIME;
+
+    return periods >= counter ? 0 : counter - periods;
+}
+
+/**
+ * record an access of node for eviction. readers call it without write lock,
+ * a lost update only makes the sample less exact
+ */
+static void
+hashnode_touch(Table *tb, HashNode *node)
+{
+    static __thread unsigned int seed;
+    time_t   now = time(NULL);
+    uint32_t counter;
+
+    if (tb->evict != MEMLINK_EVICT_LFU) {
+        node->access = now & EVICT_CLOCK_MASK;
+        return;
+    }
+    counter = hashnode_lfu_counter(node, now);
+    if (counter < 255) { // logarithmic, hot keys grow slower
+        uint32_t base = counter > MEMLINK_LFU_INIT ? counter - MEMLINK_LFU_INIT : 0;
+        if (base == 0 || rand_r(&seed) % (base * MEMLINK_LFU_LOG_FACTOR + 1) == 0) {
+            counter++;
+        }
+    }
+    node->access = EVICT_LFU_MINUTE(now) << 8 | counter;
+}
+
+/**
+ * lookup a key in both index, index[0] first, then index[1] when rehashing.
+ * hash and key length are compared before the key bytes.
+ */
+static HashNode*
+table_lookup(Table *tb, char *key, int keylen, uint32_t hash)
+{
+    HashIndex   *hi;
+    HashNode    *node;
+    uint32_t    seq;
+    int         k;
+
+    // readers walk without lock, a chain relinked by the rehash step under
+    // them may end before the key. a miss is only sure when no step ran
+    do {
+        while ((seq = tb->rehash_seq) & 1);
+        __sync_synchronize();
+        for (k = 0; k < 2; k++) {
+            hi = tb->index[k];
+            if (hi->size == 0)
+                break;
+            node = hi->bunks[hash & (hi->size - 1)];
+            while (node) {
+                if (node->hash == hash && node->keylen == keylen && 
+                    memcmp(key, hashnode_key(node), keylen) == 0) {
+                    return node;
+                }
+                node = node->next;
+            }
+        }
+        __sync_synchronize();
+    } while (seq != tb->rehash_seq);
+    return NULL;
+}
+
 int
 table_create_node(Table *tb, char *key)
 {
     int         keylen = strlen(key);
     uint32_t    hash   = hashtable_node_hash(key, keylen);
-    HashNode    *node  = tb->nodes[hash];
+    HashNode    *node;
+    HashIndex   *hi;
   
-    //DINFO("hashtable_create_node call ... %s, %p, hash: %d\n", key, node, hash);
-    while (node) {
-        if (strcmp(node->key, key) == 0) {
-            return MEMLINK_ERR_EKEY;
-        }
-        node = node->next;
+    table_rehash_step(tb, HASHTABLE_REHASH_STEP);
+    //DINFO("hashtable_create_node call ... %s, hash: %d\n", key, hash);
+    if (keylen > HASHTABLE_KEY_MAX) {
+        return MEMLINK_ERR_KEY;
     }
+    if (table_lookup(tb, key, keylen, hash) != NULL) {
+        return MEMLINK_ERR_EKEY;
+    }
+    table_expand_check(tb);
     
-    node = (HashNode*)zz_malloc(sizeof(HashNode));
-    memset(node, 0, sizeof(HashNode));
-    
-    node->key  = zz_strdup(key);
-    node->data = NULL;
-    node->next = tb->nodes[hash];
-    tb->nodes[hash] = node;
+    node = nodearena_get(&tb->arena);
+    node->data   = NULL;
+    node->hash   = hash;
+    node->keylen = keylen;
+    if (tb->evict == MEMLINK_EVICT_LFU) {
+        node->access = EVICT_LFU_MINUTE(time(NULL)) << 8 | MEMLINK_LFU_INIT;
+    }else if (tb->evict || table_has_cold(tb)) {
+        node->access = time(NULL) & EVICT_CLOCK_MASK;
+    }
+    if (keylen < HASHNODE_KEY_INLINE) {
+        memcpy(node->key.buf, key, keylen + 1);
+    }else{
+        node->key.ptr = zz_strdup(key);
+        tb->arena.mem += keylen + 1;
+        mem_used_inc(keylen + 1);
+    }
+
+    // new node always go to the new index when rehashing
+    hi = (tb->rehashidx >= 0) ? tb->index[1] : tb->index[0];
+    hash &= hi->size - 1;
+    node->next = hi->bunks[hash];
+    __sync_synchronize();
+    hi->bunks[hash] = node;
+    hi->used++;
 
     return MEMLINK_OK;    
 }
@@ -429,17 +890,17 @@ hashtable_clear_key(HashTable *ht, char *tbname, char *key)
     
     DataBlock   *dbk = node->data;
     DataBlock   *tmp;
-    int         datalen = tb->valuesize + tb->attrsize;
 
     node->data      = NULL;
     node->data_tail = NULL;
     node->used      = 0;
     node->all       = 0;
+    hashnode_index_free(tb, node);
     
     while (dbk) {
         tmp = dbk;
         dbk = dbk->next;
-        mempool_put(g_runtime->mpool, tmp, sizeof(DataBlock) + tmp->data_count * datalen);    
+        datablock_put(tb, tmp);    
     }
     return MEMLINK_OK;
 }
@@ -447,24 +908,36 @@ hashtable_clear_key(HashTable *ht, char *tbname, char *key)
 int
 table_remove_key(Table *tb, char *key)
 {
-    int         keylen; // = strlen(key);
-    uint32_t    hash; //   = hashtable_hash(key, keylen);
-    HashNode    *node; //  = ht->bunks[hash];
-    HashNode    *last  = NULL;
+    int         keylen;
+    uint32_t    hash, bunk;
+    HashNode    *node = NULL;
+    HashNode    *last = NULL;
+    HashIndex   *hi   = NULL;
+    int         k;
 
     if (NULL == key) {
         return MEMLINK_ERR_KEY;
     }
+    table_rehash_step(tb, HASHTABLE_REHASH_STEP);
+
     keylen = strlen(key);
     hash   = hashtable_node_hash(key, keylen);
-    node   = tb->nodes[hash];
 
-    while (node) {
-        if (strcmp(key, node->key) == 0) {
+    for (k = 0; k < 2 && NULL == node; k++) {
+        hi   = tb->index[k];
+        if (hi->size == 0)
             break;
+        bunk = hash & (hi->size - 1);
+        node = hi->bunks[bunk];
+        last = NULL;
+        while (node) {
+            if (node->hash == hash && node->keylen == keylen && 
+                memcmp(key, hashnode_key(node), keylen) == 0) {
+                break;
+            }
+            last = node;
+            node = node->next;
         }
-        last = node;
-        node = node->next;
     }
     
     if (NULL == node) {
@@ -474,8 +947,10 @@ table_remove_key(Table *tb, char *key)
     if (last) {
         last->next = node->next;
     }else{
-        tb->nodes[hash] = node->next; 
+        hi->bunks[bunk] = node->next; 
     }
+    hi->used--;
+    table_shrink_check(tb);
     return hashnode_remove(tb, node);
 }
 
@@ -503,7 +978,7 @@ hashtable_remove_table(HashTable *ht, char *tbname)
     }else{
         ht->tables[hash] = tb->next; 
     }
-    table_destroy(tb);
+    table_retire(tb);
     ht->table_count--;
 
     return MEMLINK_OK;
@@ -533,6 +1008,116 @@ hashtable_remove_key(HashTable *ht, char *tbname, char *key)
     return table_remove_key(tb, key);
 }
 
+/**
+ * seconds since last access of node, for cold store
+ */
+uint32_t
+hashnode_idle(Table *tb, HashNode *node, time_t now)
+{
+    if (tb->evict == MEMLINK_EVICT_LFU) {
+        return ((EVICT_LFU_MINUTE(now) - (node->access >> 8)) & 0xffff) * 60;
+    }
+    return (now - node->access) & EVICT_CLOCK_MASK;
+}
+
+/**
+ * idle time of node starts again without counting an access, for a key the
+ * cold scan keeps in memory. LFU counter keeps the decay so far
+ */
+void
+hashnode_idle_reset(Table *tb, HashNode *node, time_t now)
+{
+    if (tb->evict == MEMLINK_EVICT_LFU) {
+        node->access = EVICT_LFU_MINUTE(now) << 8 | hashnode_lfu_counter(node, now);
+        return;
+    }
+    node->access = now & EVICT_CLOCK_MASK;
+}
+
+/**
+ * bigger means colder, the key to evict first
+ */
+static uint32_t
+hashnode_evict_score(Table *tb, HashNode *node, time_t now)
+{
+    if (tb->evict == MEMLINK_EVICT_LRU) {
+        return (now - node->access) & EVICT_CLOCK_MASK;
+    }
+    return 255 - hashnode_lfu_counter(node, now);
+}
+
+/**
+ * sample keys at random bunks of tables with eviction, the coldest of
+ * MEMLINK_EVICT_SAMPLES keys is chosen in at most MEMLINK_EVICT_PROBES windows. name and key are copied out for 
+ * table_remove_key and the sync log.
+ * @return MEMLINK_ERR_NOKEY when no table has key to evict
+ */
+int
+hashtable_evict_key(HashTable *ht, char *tbname, char *key)
+{
+    Table       *tables[HASHTABLE_MAX_TABLE];
+    Table       *tb, *victb = NULL;
+    HashNode    *node, *victim = NULL;
+    uint32_t    score, maxscore = 0;
+    int         count = 0, samples = 0, tries = 0;
+    int         i;
+    time_t      now = time(NULL);
+
+    for (i = 0; i < HASHTABLE_MAX_TABLE; i++) {
+        for (tb = ht->tables[i]; tb; tb = tb->next) {
+            if (tb->evict != MEMLINK_EVICT_NONE && table_key_count(tb) > 0) {
+                tables[count++] = tb;
+            }
+        }
+    }
+    if (count == 0) {
+        return MEMLINK_ERR_NOKEY;
+    }
+
+    while (samples < MEMLINK_EVICT_SAMPLES && tries < MEMLINK_EVICT_PROBES) {
+        tries++;
+        tb = tables[random() % count];
+        // index[1] holds the bunks moved by rehash, bunks of index[0] 
+        // before rehashidx are empty
+        HashIndex *hi   = tb->index[0];
+        uint32_t  start = 0;
+        if (tb->rehashidx >= 0) {
+            if (random() % (tb->index[0]->used + tb->index[1]->used) >= tb->index[0]->used) {
+                hi = tb->index[1];
+            }else{
+                start = tb->rehashidx;
+            }
+        }
+        if (hi->used == 0) {
+            continue;
+        }
+        // a short window from a random bunk, an index is at least 
+        // 1/HASHTABLE_SHRINK_RATIO used, so the whole index is never walked
+        uint32_t bunk = start + random() % (hi->size - start);
+        uint32_t n;
+        for (n = 1; n < MEMLINK_EVICT_WINDOW && hi->bunks[bunk] == NULL; n++) {
+            bunk = (bunk + 1) & (hi->size - 1);
+        }
+        for (node = hi->bunks[bunk]; node && samples < MEMLINK_EVICT_SAMPLES; node = node->next) {
+            score = hashnode_evict_score(tb, node, now);
+            if (victim == NULL || score > maxscore) {
+                victim   = node;
+                victb    = tb;
+                maxscore = score;
+            }
+            samples++;
+        }
+    }
+    if (NULL == victim) {
+        return MEMLINK_ERR_NOKEY;
+    }
+    strcpy(tbname, victb->name);
+    memcpy(key, hashnode_key(victim), victim->keylen);
+    key[victim->keylen] = 0;
+
+    return MEMLINK_OK;
+}
+
 
 /**
  * 通过key找到一个HashNode
@@ -542,37 +1127,67 @@ table_find(Table *tb, char *key)
 {
     int         keylen = strlen(key);
     uint32_t    hash   = hashtable_node_hash(key, keylen);
-    HashNode    *node  = tb->nodes[hash];
-
-    while (node) {
-        if (strcmp(key, node->key) == 0) {
-            return node;
+    HashNode    *node  = table_lookup(tb, key, keylen, hash);
+
+    if (node && (tb->evict || table_has_cold(tb))) {
+        hashnode_touch(tb, node);
+        // read back under write lock, readers and writers see the whole link.
+        // a read thread here waits for the running write command and blocks 
+        // writers while the record is decompressed, a cost paid once per cold key
+        if (hashnode_is_cold(node)) {
+            coldstore_load(g_runtime->coldstore, tb, node);
         }
-        node = node->next;
     }
-    return NULL;
+    return node;
 }
 
-int
-hashtable_insert_binattr(HashTable *ht, char *tbname, char *key, void *value, void *attr, int pos)
+/**
+ * 通过key找到一个HashNode, 不记录访问也不读回冷数据, 不用写锁.
+ * node->used在冷数据中也是数据项数
+ */
+HashNode*
+table_peek(Table *tb, char *key)
 {
-    Table *tb = hashtable_find_table(ht, tbname);
-    if (NULL == tb) {
-        return MEMLINK_ERR_NOTABLE;
+    int keylen = strlen(key);
+
+    return table_lookup(tb, key, keylen, hashtable_node_hash(key, keylen));
+}
+
+/**
+ * 读线程在table_find之后没读到数据. 冷数据写出时先设冷标记再摘下数据链, 
+ * 数据链空了而有冷标记时读回来
+ * @return 1 读回了数据, 调用者重新查找
+ */
+static int
+table_node_recheck(Table *tb, HashNode *node)
+{
+    __sync_synchronize();
+    if (!hashnode_is_cold(node)) {
+        return 0;
     }
+    return coldstore_load(g_runtime->coldstore, tb, node) == MEMLINK_OK;
+}
+
+/**
+ * 读线程取node的数据链, 被写出到冷数据时读回来
+ */
+static DataBlock*
+table_node_data(Table *tb, HashNode *node)
+{
+    DataBlock *dbk;
+
+    do {
+        dbk = *(DataBlock * volatile *)&node->data;
+    } while (dbk == NULL && table_node_recheck(tb, node));
+
+    return dbk;
+}
 
+static int
+hashnode_insert_binattr(Table *tb, HashNode *node, void *value, void *attr, int pos)
+{
     int ret     = 0;
-    HashNode *node = table_find(tb, key);
-    if (NULL == node) {
-        //DINFO("not found node for key:%s\n", key);
-        //return MEMLINK_ERR_NOKEY;
-        ret = table_create_node(tb, key);
-        if (ret != MEMLINK_OK)
-            return ret;
-        node = table_find(tb, key);
-    }
     DataBlock *dbk = node->data;
-    int datalen = tb->valuesize + tb->attrsize;
     int dbkpos  = 0; 
 
     if (tb->listtype == MEMLINK_SORTLIST) {
@@ -586,17 +1201,18 @@ hashtable_insert_binattr(HashTable *ht, char *tbname, char *key, void *value, vo
             dbkpos = -1;
             //DNOTE("insert last skip:%d, dbkpos:%d\n", pos, dbkpos);
         }else{
-            ret = datablock_lookup_valid_pos(node, pos, MEMLINK_VALUE_ALL, &dbk);
+            ret = datablock_lookup_valid_pos(tb, node, pos, MEMLINK_VALUE_ALL, &dbk);
             dbkpos = dataitem_skip2pos(tb, node, dbk, pos - ret, MEMLINK_VALUE_ALL);
             //DNOTE("pos:%d, dbk:%p, dbkpos:%d, skipn:%d\n", pos, dbk, dbkpos, pos - ret);
         }
     }
+    hashnode_index_touch(tb, node, dbk);
 
     DataBlock   *newbk   = NULL;
-    int         blockmax = g_cf->block_data_count[g_cf->block_data_count_items - 1];
+    int         blockmax = datablock_max_size(tb, node->used);
     int         oldfull  = 0;
     
-    if (dbk && dbk->data_count == blockmax && \
+    if (dbk && dbk->data_count >= blockmax && \
         dbk->visible_count + dbk->tagdel_count == dbk->data_count) {
         oldfull = 1;
     }
@@ -604,20 +1220,23 @@ hashtable_insert_binattr(HashTable *ht, char *tbname, char *key, void *value, vo
     //if (oldfull && (pos == 0 || pos > blockmax)) { // insert at first or last
     if (oldfull && (dbkpos < 0 || (dbk == node->data && dbkpos == 0))) {
         //DINFO("insert first or last ...\n");
-        int newsize = datablock_suitable_size(1);
-        newbk = mempool_get2(g_runtime->mpool, newsize, datalen);
-        dataitem_copy(tb, node, newbk->data, value, attr);
+        int newsize = datablock_suitable_size(tb, node->used, 1);
+        newbk = datablock_get(tb, newsize);
+        dataitem_copy(tb, newbk, newbk->data, value, attr);
         
         newbk->visible_count = 1;
         
+        // the block is complete before readers can reach it
         if (dbkpos == 0) {
+            newbk->next = dbk;
+            __sync_synchronize();
             node->data  = newbk;
             dbk->prev   = newbk;
-            newbk->next = dbk;
         }else{
-            node->data_tail = newbk;
-            dbk->next   = newbk;
             newbk->prev = dbk;
+            __sync_synchronize();
+            dbk->next   = newbk;
+            node->data_tail = newbk;
         }
         node->used++;
         node->all++;
@@ -627,6 +1246,10 @@ hashtable_insert_binattr(HashTable *ht, char *tbname, char *key, void *value, vo
     }
 
     node->used++;
+    // a free slot is filled in place, the block is copied only when full
+    if (!oldfull && datablock_fill_pos(tb, dbk, dbkpos, value, attr) == MEMLINK_OK) {
+        return MEMLINK_OK;
+    }
     newbk = datablock_new_copy_pos(tb, node, dbk, dbkpos, value, attr); 
     //DINFO("1 datablock new copy pos, dbk:%p, newbk:%p\n", dbk, newbk);
     if (dbk == NULL) { // the first one
@@ -636,27 +1259,25 @@ hashtable_insert_binattr(HashTable *ht, char *tbname, char *key, void *value, vo
     }
     zz_check(newbk);
 
-    if (newbk == dbk) { // not create new datablock
-        return MEMLINK_OK;
-    }
-    
     node->all = node->all - dbk->data_count + newbk->data_count;
     //if (dbk->visible_count + dbk->tagdel_count == dbk->data_count) {
     if (oldfull) {
         DataBlock   *dbknext = dbk->next;
         DataBlock   *newbk2;
-        char        *lastdata = dbk->data + (dbk->data_count - 1) * datalen;
+        char        *lastdata = datablock_item(tb, dbk, dbk->data_count - 1);
         
-        if (dbknext && dbknext->data_count == blockmax && \
-                dbknext->visible_count + dbknext->tagdel_count == blockmax) {
-            int newsize = datablock_suitable_size(1);
-            newbk2 = mempool_get2(g_runtime->mpool, newsize, datalen);
-            dataitem_copy(tb, node, newbk2->data, lastdata, lastdata + tb->valuesize);
+        hashnode_index_touch(tb, node, dbknext);
+        if (dbknext && dbknext->data_count >= blockmax && \
+                dbknext->visible_count + dbknext->tagdel_count == dbknext->data_count) {
+            int newsize = datablock_suitable_size(tb, node->used, 1);
+            newbk2 = datablock_get(tb, newsize);
+            dataitem_copy(tb, newbk2, newbk2->data, lastdata, dataitem_attr(tb, dbk, lastdata));
             newbk2->visible_count = 1;
 
             newbk2->next  = dbknext;
             newbk2->prev  = newbk;
             newbk->next   = newbk2;
+            __sync_synchronize();
             dbknext->prev = newbk2;
 
             if (dbk->prev) {
@@ -665,52 +1286,72 @@ hashtable_insert_binattr(HashTable *ht, char *tbname, char *key, void *value, vo
                 node->data = newbk;
             }
             node->all += newbk2->data_count;
-            mempool_put2(g_runtime->mpool, dbk, datalen);
+            hashnode_index_release(tb, node, dbk);
+            datablock_put(tb, dbk);
         }else{
-            newbk2 = datablock_new_copy_pos(tb, node, dbknext, 0, lastdata, lastdata + tb->valuesize);
+            newbk2 = datablock_new_copy_pos(tb, node, dbknext, 0, lastdata, dataitem_attr(tb, dbk, lastdata));
             //DINFO("2 datablock new copy pos, dbk:%p, newbk:%p\n", dbk, newbk);
-            if (newbk2 == dbknext) {
-                newbk->next   = dbknext;
-                dbknext->prev = newbk;
-                
-                datablock_link_prev(node, dbk, newbk);
+            newbk->next  = newbk2;
+            newbk2->prev = newbk;
+            __sync_synchronize();
 
-                mempool_put2(g_runtime->mpool, dbk, datalen);
+            if (dbk->prev) {
+                dbk->prev->next = newbk;
             }else{
-                newbk->next  = newbk2;
-                newbk2->prev = newbk;
-
-                if (dbk->prev) {
-                    dbk->prev->next = newbk;
-                }else{
-                    node->data = newbk;
-                }
-                if (dbknext == NULL || dbknext->next == NULL) {
-                    node->data_tail = newbk2;
-                }else{
-                    dbknext->next->prev = newbk2;
-                }
+                node->data = newbk;
+            }
+            if (dbknext == NULL || dbknext->next == NULL) {
+                node->data_tail = newbk2;
+            }else{
+                dbknext->next->prev = newbk2;
+            }
 
-                if (dbknext) {
-                    node->all = node->all - dbknext->data_count + newbk2->data_count;
-                }else{
-                    node->all += newbk2->data_count;
-                }
-                mempool_put2(g_runtime->mpool, dbk, datalen);
-                if (dbknext) {
-                    mempool_put2(g_runtime->mpool, dbknext, datalen);
-                }
+            if (dbknext) {
+                node->all = node->all - dbknext->data_count + newbk2->data_count;
+            }else{
+                node->all += newbk2->data_count;
+            }
+            hashnode_index_release(tb, node, dbk);
+            datablock_put(tb, dbk);
+            if (dbknext) {
+                hashnode_index_release(tb, node, dbknext);
+                datablock_put(tb, dbknext);
             }
             zz_check(newbk2);
         }
         return MEMLINK_OK;
     }else{
         datablock_link_both(node, dbk, newbk);
-        mempool_put2(g_runtime->mpool, dbk, datalen);
+        hashnode_index_release(tb, node, dbk);
+        datablock_put(tb, dbk);
         return MEMLINK_OK;
     }
 }
 
+int
+hashtable_insert_binattr(HashTable *ht, char *tbname, char *key, void *value, void *attr, int pos)
+{
+    Table *tb = hashtable_find_table(ht, tbname);
+    if (NULL == tb) {
+        return MEMLINK_ERR_NOTABLE;
+    }
+
+    int ret     = 0;
+    HashNode *node = table_find(tb, key);
+    if (NULL == node) {
+        //DINFO("not found node for key:%s\n", key);
+        //return MEMLINK_ERR_NOKEY;
+        ret = table_create_node(tb, key);
+        if (ret != MEMLINK_OK)
+            return ret;
+        node = table_find(tb, key);
+    }
+    ret = hashnode_insert_binattr(tb, node, value, attr, pos);
+    hashnode_index_update(tb, node);
+
+    return ret;
+}
+
 /**
  * add new value at a specially position
  */
@@ -743,7 +1384,27 @@ hashtable_insert(HashTable *ht, char *tbname, char *key, void *value, uint32_t *
     //DINFO("attrsize:%d attr:%s\n", tb->attrsize, formatb(attr, tb->attrsize, buf, sizeof(buf)));
 
     //printh(attr, node->attrsize);
-    return hashtable_insert_binattr(ht, tbname, key, value, attr, pos);
+    if (!table_is_vstring(tb)) {
+        return hashtable_insert_binattr(ht, tbname, key, value, attr, pos);
+    }
+
+    HashNode *node = table_find(tb, key);
+    if (NULL == node) {
+        ret = table_create_node(tb, key);
+        if (ret != MEMLINK_OK)
+            return ret;
+        node = table_find(tb, key);
+    }
+    // the item keeps a pointer to the copy in value arena, put only when
+    // nothing can fail
+    char vref[sizeof(char*)];
+    ret = valuearena_put(&tb->varena, value, vref);
+    if (ret != MEMLINK_OK)
+        return ret;
+    ret = hashnode_insert_binattr(tb, node, vref, attr, pos);
+    hashnode_index_update(tb, node);
+
+    return ret;
 }
 
 
@@ -808,21 +1469,31 @@ hashtable_move(HashTable *ht, char *tbname, char *key, void *value, int pos)
     }
     
     DINFO("move find dbk:%p\n", dbk);
-    char *mdata = item + tb->valuesize;
+    char *mdata = dataitem_attr(tb, dbk, item);
     memcpy(attr, mdata, tb->attrsize);  
+    // moved item points to the same value
+    char vref[sizeof(char*)];
+    if (table_is_vstring(tb)) {
+        memcpy(vref, item, tb->valuesize);
+        value = vref;
+    }
 
+    hashnode_index_touch(tb, node, dbk);
     datablock_del(tb, node, dbk, item);
+    hashnode_index_update(tb, node);
 
     //hashtable_print(ht, key);
     int retv = hashtable_insert_binattr(ht, tbname, key, value, attr, pos);
     if (retv != MEMLINK_OK) {
         datablock_del_restore(tb, node, dbk, item);
+        hashnode_index_update(tb, node);
         return retv;
     }
    
     // remove null block
     //DINFO("dbk:%p, count:%d, prev:%p, dbk->next:%p\n", dbk, dbk->tagdel_count + dbk->visible_count, prev, dbk->next);
     if (dbk->data_count > 0) {
+        hashnode_index_touch(tb, node, dbk);
         if (dbk->tagdel_count + dbk->visible_count == 0) {
             if (dbk->prev) {
                 dbk->prev->next = dbk->next;
@@ -838,7 +1509,8 @@ hashtable_move(HashTable *ht, char *tbname, char *key, void *value, int pos)
             node->all -= dbk->data_count;
 
             //mempool_put(g_runtime->mpool, dbk, sizeof(DataBlock) + dbk->data_count * (node->valuesize + node->attrsize));
-            mempool_put2(g_runtime->mpool, dbk, tb->valuesize + tb->attrsize);
+            hashnode_index_release(tb, node, dbk);
+            datablock_put(tb, dbk);
         }else{
             //DINFO("try start resize.\n");
             //hashnode_check(node);
@@ -849,6 +1521,7 @@ hashtable_move(HashTable *ht, char *tbname, char *key, void *value, int pos)
             //hashtable_print(ht, key);
         }
     }
+    hashnode_index_update(tb, node);
     
     return MEMLINK_OK;
 }
@@ -874,7 +1547,8 @@ hashtable_del(HashTable *ht, char *tbname, char *key, void *value)
         DINFO("table_del find value error! %s\n", key);
         return ret;
     }
-    char *data = item + tb->valuesize;
+    hashnode_index_touch(tb, node, dbk);
+    char *data = dataitem_attr(tb, dbk, item);
     uint8_t v = *data & 0x3; 
 
     *data &= 0xfe;
@@ -886,7 +1560,6 @@ hashtable_del(HashTable *ht, char *tbname, char *key, void *value)
         }
         node->used--;
     }
-    int datalen = tb->valuesize + tb->attrsize;
     int dbksize = dbk->visible_count + dbk->tagdel_count;
 
     if (dbksize == 0) {
@@ -903,12 +1576,14 @@ hashtable_del(HashTable *ht, char *tbname, char *key, void *value)
             node->data_tail = prev;
         }
         node->all -= dbk->data_count;
-        mempool_put2(g_runtime->mpool, dbk, datalen);
+        hashnode_index_release(tb, node, dbk);
+        datablock_put(tb, dbk);
     }else{
         //DINFO("before resize, used:%d, all:%d\n", node->used, node->all);
         datablock_resize(tb, node, dbk);
         //DINFO("after resize, used:%d, all:%d\n", node->used, node->all);
     }
+    hashnode_index_update(tb, node);
 
     return MEMLINK_OK;
 }
@@ -952,13 +1627,15 @@ hashtable_sortlist_mdel(HashTable *ht, char *tbname, char *key, uint8_t kind, vo
     //table_print(ht, key);
 
     DINFO("lookup pos:%d, dbk:%p\n", pos, dbk);
-    int datalen = tb->valuesize + tb->attrsize;
+    // blocks changed are between the first and the last one
+    hashnode_index_touch(tb, node, dbk);
+    int step    = dataitem_step(tb);
     int i;
     char *attr;
     while (dbk) {
         //DINFO("find in dbk:%p\n", dbk);
         //datablock_print(node, dbk);
-        item = (char*)dbk->data + pos * datalen;
+        item = datablock_item(tb, dbk, pos);
         for (i = pos; i < dbk->data_count; i++) { 
             if (pos > 0)
                 pos = 0;
@@ -967,10 +1644,10 @@ hashtable_sortlist_mdel(HashTable *ht, char *tbname, char *key, uint8_t kind, vo
             memcpy(mybuf, item, tb->valuesize);
             DINFO("try del val:%s, max:%s\n", mybuf, (char*)valmax);
 
-            ret = dataitem_check_data(tb, node, item);
+            ret = dataitem_check_data(tb, dbk, item);
             //if (ret != MEMLINK_VALUE_REMOVED) {
             if (dataitem_check_kind(ret, kind)) {
-                char *attrdata = item + tb->valuesize;
+                char *attrdata = dataitem_attr(tb, dbk, item);
                 if (attrnum > 0) {
                     int k;
                     for (k = 0; k < tb->attrsize; k++) {
@@ -979,13 +1656,13 @@ hashtable_sortlist_mdel(HashTable *ht, char *tbname, char *key, uint8_t kind, vo
                         }
                     }
                     if (k < tb->attrsize) { // not equal
-                        item += datalen;
+                        item += step;
                         continue;
                     }
                 }
 
                 if (((char*)valmax)[0] != 0 && 
-                     sortlist_valuecmp(tb->valuetype, valmax, item, tb->valuesize) <= 0) {
+                     tb->valuecmp(valmax, item, tb->valuesize) <= 0) {
         
                     char mybuf[32] = {0};
                     memcpy(mybuf, item, tb->valuesize);
@@ -994,7 +1671,7 @@ hashtable_sortlist_mdel(HashTable *ht, char *tbname, char *key, uint8_t kind, vo
                     goto table_sortlist_mdel_over;
                 }
  
-                attr = item + tb->valuesize;
+                attr = attrdata;
                 *attr &= 0xfe;
 
                 if (ret == MEMLINK_VALUE_VISIBLE) {
@@ -1019,11 +1696,12 @@ hashtable_sortlist_mdel(HashTable *ht, char *tbname, char *key, uint8_t kind, vo
                         node->data_tail = prev;
                     }
                     node->all -= dbk->data_count;
-                    mempool_put(g_runtime->mpool, dbk, sizeof(DataBlock) + dbk->data_count * datalen);
+                    hashnode_index_release(tb, node, dbk);
+                    datablock_put(tb, dbk);
                     break;
                 }
             }
-            item += datalen;
+            item += step;
         }
         if (nextdbk) {
             dbk = nextdbk;
@@ -1033,6 +1711,8 @@ hashtable_sortlist_mdel(HashTable *ht, char *tbname, char *key, uint8_t kind, vo
         }
     }
 table_sortlist_mdel_over:
+    hashnode_index_touch(tb, node, dbk ? dbk : node->data_tail);
+    hashnode_index_update(tb, node);
     return MEMLINK_OK;
 }
 
@@ -1058,11 +1738,12 @@ hashtable_tag(HashTable *ht, char *tbname, char *key, void *value, uint8_t tag)
     }
     //DINFO("tag: %d, %d\n", tag, tag<<1);
     
-    char *data = item + tb->valuesize;
+    char *data = dataitem_attr(tb, dbk, item);
     uint8_t v = *data & 0x3; 
 
     //DINFO("tag v:%x\n", v);
     if ( (v & 0x01) == 1) { // data not real delete
+        hashnode_index_touch(tb, node, dbk);
         //DINFO("tag data:%x\n", *data);
         if (tag == MEMLINK_TAG_DEL) {
             *data |= 0x02; 
@@ -1082,6 +1763,7 @@ hashtable_tag(HashTable *ht, char *tbname, char *key, void *value, uint8_t tag)
     }else{
         return MEMLINK_ERR_REMOVED;
     }
+    hashnode_index_update(tb, node);
 
     return MEMLINK_OK;
 }
@@ -1099,8 +1781,9 @@ hashtable_attr(HashTable *ht, char *tbname, char *key, void *value, uint32_t *at
 
     char        *item = NULL;
     HashNode    *node = NULL;
+    DataBlock   *dbk  = NULL;
 
-    int  ret = table_find_value(tb, key, value, &node, NULL, &item);
+    int  ret = table_find_value(tb, key, value, &node, &dbk, &item);
     if (ret < 0) {
         return ret;
     }
@@ -1126,7 +1809,8 @@ hashtable_attr(HashTable *ht, char *tbname, char *key, void *value, uint32_t *at
         return MEMLINK_ERR_ATTR;
     }
     //DINFO("array2flag: %s\n", formatb(attrflag, flen, buf, 128));
-    dataitem_copy_attr(tb, node, item, attrflag, attr);
+    dataitem_copy_attr(tb, dbk, item, attrflag, attr);
+    datablock_attr_add(tb, dbk, dataitem_attr(tb, dbk, item));
 
     return MEMLINK_OK;
 }
@@ -1142,8 +1826,9 @@ hashtable_attr_inc(HashTable *ht, char *tbname, char *key, void *value,
 
     char        *item = NULL;
     HashNode    *node = NULL;
+    DataBlock   *dbk  = NULL;
 
-    int  ret = table_find_value(tb, key, value, &node, NULL, &item);
+    int  ret = table_find_value(tb, key, value, &node, &dbk, &item);
     if (ret < 0) {
         return ret;
     }
@@ -1154,7 +1839,8 @@ hashtable_attr_inc(HashTable *ht, char *tbname, char *key, void *value,
 
     uint32_t attrvals[HASHTABLE_ATTR_MAX_ITEM] = {0};
     
-    ret = attr_binary2array(table_attrformat(tb), attrnum, item+tb->valuesize, attrvals);
+    char *attrdata = dataitem_attr(tb, dbk, item);
+    ret = attr_binary2array(table_attrformat(tb), attrnum, attrdata, attrvals);
     if (ret <= 0) {
         return MEMLINK_ERR_ATTR;
     }
@@ -1169,11 +1855,30 @@ hashtable_attr_inc(HashTable *ht, char *tbname, char *key, void *value,
     if (ret <= 0) {
         return MEMLINK_ERR_ATTR;
     }
-    memcpy(item+tb->valuesize, attrbin, tb->attrsize);
+    memcpy(attrdata, attrbin, tb->attrsize);
+    datablock_attr_add(tb, dbk, attrdata);
 
     return MEMLINK_OK;
 }
 
+/**
+ * append an item to reply as value|attr
+ */
+static inline void
+conn_write_dataitem(Conn *conn, Table *tb, DataBlock *dbk, char *itemdata)
+{
+    if (table_is_vstring(tb)) {
+        unsigned char *v = valuearena_value(itemdata);
+        conn_write_buffer_append(conn, v, 1 + v[0]);
+        conn_write_buffer_append(conn, dataitem_attr(tb, dbk, itemdata), tb->attrsize);
+    }else if (tb->layout == MEMLINK_LAYOUT_COLUMN) {
+        conn_write_buffer_append(conn, itemdata, tb->valuesize);
+        conn_write_buffer_append(conn, dataitem_attr(tb, dbk, itemdata), tb->attrsize);
+    }else{
+        conn_write_buffer_append(conn, itemdata, tb->valuesize + tb->attrsize);
+    }
+}
+
 int
 hashtable_range(HashTable *ht, char *tbname, char *key, uint8_t kind, 
             uint32_t *attrarray, int attrnum, 
@@ -1216,7 +1921,7 @@ hashtable_range(HashTable *ht, char *tbname, char *key, uint8_t kind,
     conn->wlen += CMD_REPLY_HEAD_LEN;
     //DINFO("valuesize:%d, attrsize:%d, attrnum:%d\n", node->valuesize, node->attrsize, node->attrnum);
     uint8_t wchar;
-    wchar = tb->valuesize;
+    wchar = table_reply_valuesize(tb);
     conn_write_buffer_append(conn, &wchar, sizeof(char));
     conn_write_buffer_append(conn, &tb->attrsize, sizeof(char));
     wchar = tb->attrnum;
@@ -1226,21 +1931,25 @@ hashtable_range(HashTable *ht, char *tbname, char *key, uint8_t kind,
     }
 
     DataBlock *dbk = NULL;
-    int datalen = tb->valuesize + tb->attrsize;
     int dbkpos  = 0;
 
     //gettimeofday(&start, NULL);
+table_range_lookup:
     if (attrnum > 0) {
         startn = dataitem_lookup_pos_attr(tb, node, frompos, kind, attrval, attrflag, &dbk, &dbkpos);
         DINFO("dataitem_lookup_pos_attr startn:%d, dbkpos:%d\n", startn, dbkpos);
         if (startn < 0) { // out of range
+            if (table_node_recheck(tb, node))
+                goto table_range_lookup;
             ret = MEMLINK_OK;
             goto table_range_over;
         }
     }else{
-        startn = datablock_lookup_pos(node, frompos, kind, &dbk);
+        startn = datablock_lookup_pos(tb, node, frompos, kind, &dbk);
         DINFO("datablock_lookup_pos startn:%d, dbk:%p\n", startn, dbk);
         if (startn < 0) { // out of range
+            if (table_node_recheck(tb, node))
+                goto table_range_lookup;
             ret = MEMLINK_OK;
             goto table_range_over;
         }
@@ -1252,6 +1961,9 @@ hashtable_range(HashTable *ht, char *tbname, char *key, uint8_t kind,
     //DNOTE("lookup: %d\n", timediff(&start, &end));
     //gettimeofday(&start, NULL);
 
+    AttrMatch am;
+    attrmatch_init(tb, &am, kind, attrnum > 0 ? attrval : NULL, attrflag);
+
     n = 0; 
     while (dbk) {
         //DINFO("dbk:%p, count:%d\n", dbk, dbk->data_count);
@@ -1259,41 +1971,30 @@ hashtable_range(HashTable *ht, char *tbname, char *key, uint8_t kind,
             DINFO("data_count is 0, dbk:%p\n", dbk);
             break;
         }
+        if (attrnum > 0 && !datablock_attr_match(tb, node, dbk, attrval, attrflag)) {
+            dbkpos = 0;
+            dbk = dbk->next;
+            continue;
+        }
 
-        char *itemdata = dbk->data + dbkpos * datalen;
         int  i;
-        for (i = dbkpos; i < dbk->data_count; i++) {
-            if (dbkpos > 0)
-                dbkpos = 0;
-
-            //modify by lanwenhong
-            if (dataitem_have_data(tb, node, itemdata, kind)) {
-                char *attrdata = itemdata + tb->valuesize;
-                if (attrnum > 0) {
-                    int k;
-                    for (k = 0; k < tb->attrsize; k++) {
-                        if ((attrdata[k] & attrflag[k]) != attrval[k]) {
-                            break;
-                        }
-                    }
-                    if (k < tb->attrsize) { // not equal
-                        //DINFO("not equal.\n");
-                        itemdata += datalen;
-                        continue;
-                    }
-                }
+        for (i = dbkpos; i < dbk->data_count; i += 64) {
+            uint64_t mask = datablock_scan(tb, dbk, i, &am);
+            while (mask) {
+                char *itemdata = datablock_item(tb, dbk, i + __builtin_ctzll(mask));
+                mask &= mask - 1;
                 /*char buf[128];
                 snprintf(buf, node->valuesize + 1, "%s", itemdata);
                 DINFO("\tok, copy item ... i:%d, value:%s\n", i, buf);*/
                  
-                conn_write_buffer_append(conn, itemdata, datalen);
+                conn_write_dataitem(conn, tb, dbk, itemdata);
                 n += 1;
                 if (n >= len) {
                     goto table_range_over;
                 }
             }
-            itemdata += datalen;
         }
+        dbkpos = 0;
         dbk = dbk->next;
     }
     ret = MEMLINK_OK;
@@ -1349,10 +2050,12 @@ hashtable_sortlist_range(HashTable *ht, char *tbname, char *key, uint8_t kind,
     }
 
     DataBlock *dbk = NULL;
-    int datalen = tb->valuesize + tb->attrsize;
+    int datalen = dataitem_step(tb);
     int dbkpos = 0;
 
-    dbkpos = sortlist_lookup(tb, node, MEMLINK_SORTLIST_LOOKUP_STEP, valmin, MEMLINK_VALUE_ALL, &dbk);
+    do {
+        dbkpos = sortlist_lookup(tb, node, MEMLINK_SORTLIST_LOOKUP_STEP, valmin, MEMLINK_VALUE_ALL, &dbk);
+    } while (dbk == NULL && table_node_recheck(tb, node));
     //DINFO("dbk:%p, dbkpos:%d, kind:%d\n", dbk, dbkpos, kind);
     
     int n = 0; 
@@ -1364,15 +2067,15 @@ hashtable_sortlist_range(HashTable *ht, char *tbname, char *key, uint8_t kind,
             DINFO("data_count is 0, dbk:%p\n", dbk);
             break;
         }
-        char *itemdata = dbk->data + dbkpos * datalen;
+        char *itemdata = datablock_item(tb, dbk, dbkpos);
         int  i;
         for (i = dbkpos; i < dbk->data_count; i++) {
             if (dbkpos > 0)
                 dbkpos = 0;
 
-            if (dataitem_have_data(tb, node, itemdata, kind)) {
+            if (dataitem_have_data(tb, dbk, itemdata, kind)) {
                 if (valfirst != 0 && 
-                    (ret = sortlist_valuecmp(tb->valuetype, valmax, itemdata, tb->valuesize)) <= 0) {
+                    (ret = tb->valuecmp(valmax, itemdata, tb->valuesize)) <= 0) {
                     /*char mybuf[32] = {0};
                     memcpy(mybuf, itemdata, node->valuesize);
                     DINFO("copy end, ret:%d, val:%s, max:%s, %d\n", ret, mybuf, (char*)valmax, 
@@ -1382,7 +2085,7 @@ hashtable_sortlist_range(HashTable *ht, char *tbname, char *key, uint8_t kind,
                     goto table_sortlist_range_over;
                 }
                 if (attrnum > 0) {
-                    char *attrdata = itemdata + tb->valuesize;
+                    char *attrdata = dataitem_attr(tb, dbk, itemdata);
                     int k;
                     for (k = 0; k < tb->attrsize; k++) {
                         if ((attrdata[k] & attrflag[k]) != attrval[k]) {
@@ -1394,7 +2097,7 @@ hashtable_sortlist_range(HashTable *ht, char *tbname, char *key, uint8_t kind,
                         continue;
                     }
                 }
-                conn_write_buffer_append(conn, itemdata, datalen);
+                conn_write_dataitem(conn, tb, dbk, itemdata);
                 n += 1;
             }
             itemdata += datalen;
@@ -1419,20 +2122,22 @@ hashnode_clean(Table *tb, HashNode *node)
 
     DataBlock   *dbk = node->data;
     int         dlen = tb->valuesize + tb->attrsize;
+    int         step = dataitem_step(tb);
 
     if (NULL == dbk)
         return MEMLINK_OK;
         
-    DINFO("=== table clean:%s used:%d all:%d ===\n", node->key, node->used, node->all);
+    DINFO("=== table clean:%s used:%d all:%d ===\n", hashnode_key(node), node->used, node->all);
+    hashnode_index_free(tb, node);
     if (node->used == 0) { // remove all datablock
         DataBlock *tmp;
         while (dbk) {
             tmp = dbk; 
             dbk = dbk->next;
-            mempool_put(g_runtime->mpool, tmp, sizeof(DataBlock) + tmp->data_count * dlen);
+            datablock_put(tb, tmp);
         }
         node->all  = 0;
-        node->data = NULL;
+        node->data = node->data_tail = NULL;
         return MEMLINK_OK;
     }
 
@@ -1448,17 +2153,18 @@ hashnode_clean(Table *tb, HashNode *node)
     char      *newdbk_pos = NULL;
     int          count = 0;
     int          ret;
-    int       blockmax = g_cf->block_data_count[g_cf->block_data_count_items - 1];
+    int       blockmax = datablock_max_size(tb, node->used);
 
     while (dbk) {
+        datablock_prefetch(dbk->next);
         itemdata = dbk->data;
         for (i = 0; i < dbk->data_count; i++) {
-            ret = dataitem_check_data(tb, node, itemdata);
+            ret = dataitem_check_data(tb, dbk, itemdata);
             if (ret != MEMLINK_VALUE_REMOVED) {
                 if (newdbk == NULL || newdbk_pos >= newdbk_end) {
                     newlast    = newdbk;
-                    newdbk     = mempool_get2(g_runtime->mpool, blockmax, dlen);
-                    newdbk_end = newdbk->data + blockmax * dlen;
+                    newdbk     = datablock_get(tb, blockmax);
+                    newdbk_end = datablock_item(tb, newdbk, blockmax);
                     newdbk_pos = newdbk->data;
 
                     newdbk->next = NULL;
@@ -1476,15 +2182,15 @@ hashnode_clean(Table *tb, HashNode *node)
                 memcpy(buf, itemdata, node->valuesize);
                 DINFO("clean copy item: %s\n", buf);
                 */
-                memcpy(newdbk_pos, itemdata, dlen);
-                newdbk_pos += dlen;
+                dataitem_move(tb, newdbk, newdbk_pos, dbk, itemdata);
+                newdbk_pos += step;
                 if (ret == MEMLINK_VALUE_TAGDEL) {
                     newdbk->tagdel_count++;
                 }else{
                     newdbk->visible_count++;
                 }
             }
-            itemdata += dlen;
+            itemdata += step;
         }
         if (count > 0 && count % g_cf->block_clean_num == 0) { // clean num arrivied
             newdbk->next = dbk->next;
@@ -1502,55 +2208,211 @@ hashnode_clean(Table *tb, HashNode *node)
             }
             linklast = newdbk;
             
-            datablock_free(oldbk, dbk, dlen);
+            datablock_free(tb, oldbk, dbk);
 
             // copy last datablock content to new link
-            DataBlock *newdbk2  = mempool_get2(g_runtime->mpool, blockmax, dlen);
+            DataBlock *newdbk2  = datablock_get(tb, blockmax);
             datablock_copy(newdbk2, newdbk, dlen);
-            newdbk_pos = newdbk2->data + (newdbk2->tagdel_count + newdbk2->visible_count) * dlen;
-            newdbk_end = newdbk2->data + blockmax * dlen;
+            newdbk_pos = datablock_item(tb, newdbk2, newdbk2->tagdel_count + newdbk2->visible_count);
+            newdbk_end = datablock_item(tb, newdbk2, blockmax);
 
             newdbk  = newdbk2;
             newroot = newdbk2;
             newlast = NULL;
         }
-        dbk = dbk->next;
+        dbk = dbk->next;
+    }
+
+    if (linklast == NULL) {
+        oldbk = node->data;
+        node->data = newroot;
+    }else{
+        //oldbk = linklast->next;
+        oldbk = linklast;
+        linklast->prev->next = newroot;
+        newroot->prev = linklast->prev;
+    }
+    node->data_tail = newdbk;
+
+    datablock_free(tb, oldbk, dbk);
+    node->all = dataall;
+    hashnode_index_update(tb, node);
+
+    return MEMLINK_OK;
+
+
+}
+
+/**
+ * 后台清理的一步: 从上次结束的数据块开始, 把数据项合并到新的数据块, 去掉真删除的数据项.
+ * 最多处理maxblocks个数据块, 用时超过maxtime微秒就结束. 调用者需持有写锁.
+ * 两步之间数据链可能被修改, 下一步开始的数据块被释放时从头开始
+ * @return 1 还没有清理完, MEMLINK_OK 已清理完
+ */
+int
+hashtable_clean_step(HashTable *ht, char *tbname, char *key, int maxblocks, int maxtime)
+{
+    Table *tb = hashtable_find_table(ht, tbname);
+    if (NULL == tb) {
+        return MEMLINK_ERR_NOTABLE;
+    }
+    HashNode *node = table_find(tb, key);
+    if (NULL == node) {
+        return MEMLINK_ERR_NOKEY;
+    }
+
+    int         step = dataitem_step(tb);
+    int         blockmax = datablock_max_size(tb, node->used);
+    DataBlock   *dbk, *first = NULL, *tmp;
+    DataBlock   *newroot = NULL, *newdbk = NULL;
+    char        *newdbk_pos = NULL, *newdbk_end = NULL;
+    char        *itemdata;
+    int         i, ret, n = 0, walk = 0;
+    int         dataall = 0;
+    struct timeval start, end;
+
+    if (tb->clean_node != node) {
+        tb->clean_node = node;
+        tb->clean_next = NULL;
+    }
+    dbk = tb->clean_next ? tb->clean_next : node->data;
+    // a partly filled block is merged again with the following blocks
+    if (maxblocks < 2) {
+        maxblocks = 2;
+    }
+    gettimeofday(&start, NULL);
+
+    while (dbk) {
+        datablock_prefetch(dbk->next);
+        // full block without removed item, skip if nothing to merge with
+        if (dbk->data_count == blockmax && 
+            dbk->visible_count + dbk->tagdel_count == blockmax) {
+            if (first) {
+                if (newdbk_pos >= newdbk_end) { // new blocks are all full, stop here
+                    break;
+                }
+            }else{
+                dbk = dbk->next;
+                if (++walk % 64 == 0) {
+                    gettimeofday(&end, NULL);
+                    if (timediff(&start, &end) >= maxtime) {
+                        break;
+                    }
+                }
+                continue;
+            }
+        }
+        if (first == NULL) {
+            first = dbk;
+        }
+        itemdata = dbk->data;
+        for (i = 0; i < dbk->data_count; i++) {
+            ret = dataitem_check_data(tb, dbk, itemdata);
+            if (ret != MEMLINK_VALUE_REMOVED) {
+                if (newdbk == NULL || newdbk_pos >= newdbk_end) {
+                    tmp        = newdbk;
+                    newdbk     = datablock_get(tb, blockmax);
+                    newdbk_end = datablock_item(tb, newdbk, blockmax);
+                    newdbk_pos = newdbk->data;
+
+                    newdbk->next = NULL;
+                    newdbk->prev = tmp;
+                    if (tmp) {
+                        tmp->next = newdbk; 
+                    }else{
+                        newroot = newdbk;
+                    }
+                    dataall += blockmax;
+                }
+                dataitem_move(tb, newdbk, newdbk_pos, dbk, itemdata);
+                newdbk_pos += step;
+                if (ret == MEMLINK_VALUE_TAGDEL) {
+                    newdbk->tagdel_count++;
+                }else{
+                    newdbk->visible_count++;
+                }
+            }
+            itemdata += step;
+        }
+        dataall -= dbk->data_count;
+        dbk = dbk->next;
+        if (++n >= maxblocks) {
+            break;
+        }
+        // half of maxtime is left for releasing merged blocks
+        if (n % 16 == 0) {
+            gettimeofday(&end, NULL);
+            if (timediff(&start, &end) >= maxtime / 2) {
+                break;
+            }
+        }
+    }
+
+    if (first) { // replace blocks from first to dbk with new blocks
+        DataBlock *before = first->prev;
+
+        if (newroot) {
+            newroot->prev = before;
+            newdbk->next  = dbk;
+            if (before) {
+                before->next = newroot;
+            }else{
+                node->data = newroot;
+            }
+            if (dbk) {
+                dbk->prev = newdbk;
+            }else{
+                node->data_tail = newdbk;
+            }
+        }else{
+            if (before) {
+                before->next = dbk;
+            }else{
+                node->data = dbk;
+            }
+            if (dbk) {
+                dbk->prev = before;
+            }else{
+                node->data_tail = before;
+            }
+        }
+        while (first != dbk) {
+            tmp = first->next;
+            hashnode_index_release(tb, node, first);
+            datablock_put(tb, first);
+            first = tmp;
+        }
+        node->all += dataall;
+        hashnode_index_update(tb, node);
     }
 
-    if (linklast == NULL) {
-        oldbk = node->data;
-        node->data = newroot;
+    if (NULL == dbk) {
+        tb->clean_node = NULL;
+        tb->clean_next = NULL;
+        return MEMLINK_OK;
+    }
+    if (newdbk && newdbk_pos < newdbk_end) {
+        tb->clean_next = newdbk;
     }else{
-        //oldbk = linklast->next;
-        oldbk = linklast;
-        linklast->prev->next = newroot;
-        newroot->prev = linklast->prev;
+        tb->clean_next = dbk;
     }
-    node->data_tail = newdbk;
-
-    datablock_free(oldbk, dbk, dlen);
-    node->all = dataall;
-
-    return MEMLINK_OK;
-
-
+    return 1;
 }
+
 int
 hashtable_clean_all(HashTable *ht)
 {
     Table *tb = NULL;
     HashNode *node;
-    int i, k;
+    TableIter iter;
+    int k;
     
     for (k = 0; k < HASHTABLE_MAX_TABLE; k++) { 
         tb = ht->tables[k];
         while (tb) {
-            for (i = 0; i < HASHTABLE_BUNKNUM; i++) {
-                node = tb->nodes[i];
-                while (node) {
-                    hashnode_clean(tb, node);
-                    node = node->next;
-                }
+            table_iter_init(tb, &iter);
+            while ((node = table_iter_next(&iter)) != NULL) {
+                hashnode_clean(tb, node);
             }
             tb = tb->next;
         }
@@ -1571,13 +2433,11 @@ hashtable_clean(HashTable *ht, char *tbname, char *key)
         return hashnode_clean(tb, node);
     }else{
         HashNode *node;
-        int i;
-        for (i = 0; i < HASHTABLE_BUNKNUM; i++) {
-            node = tb->nodes[i];
-            while (node) {
-                hashnode_clean(tb, node);
-                node = node->next;
-            }
+        TableIter iter;
+
+        table_iter_init(tb, &iter);
+        while ((node = table_iter_next(&iter)) != NULL) {
+            hashnode_clean(tb, node);
         }
     }
     return 0;
@@ -1592,39 +2452,29 @@ hashtable_stat_table(HashTable *ht, char *tbname, HashTableStatSys *stat)
     }
 
     HashNode    *node;
-    int i;
+    TableIter   iter;
     int keys    = 0;//统计memlink中key的数量
     int blocks  = 0;//统计memlink中分配的存储块数量
     int dataall = 0;//统计memlink中小块的数量
     int datau   = 0;//统计memlink中value的数量
     int memu    = 0;//统计memlink中hash talbe占用的内存总量
-    int datalen = tb->attrsize + tb->valuesize;
 
     //DINFO("sizeof DataBlock:%d, HashNode:%d\n", sizeof(DataBlock), sizeof(HashNode));
-    for (i = 0; i < HASHTABLE_BUNKNUM; i++) {
-        node = tb->nodes[i];
-        if (node) {
-            memu += strlen(node->key) + 1;
-            if (tb->attrnum >= sizeof(void*)) {
-                memu += tb->attrnum + 1;
-            }
-        }
-        while (node) {
-            keys++;    
-            datau   += node->used;
-            dataall += node->all;
-            DataBlock *dbk = node->data;
-            
-            while (dbk != NULL) {
-                blocks++;
-                dbk = dbk->next;
-                
-                memu += sizeof(DataBlock);
-                memu += datalen * dbk->data_count;
-            }
-            
-            memu += sizeof(HashNode);    
-            node = node->next;
+    if (tb->attrnum >= sizeof(void*)) {
+        memu += tb->attrnum + 1;
+    }
+    memu += table_mem(tb);
+
+    table_iter_init(tb, &iter);
+    while ((node = table_iter_next(&iter)) != NULL) {
+        keys++;    
+        datau   += node->used;
+        dataall += node->all;
+        DataBlock *dbk = node->data;
+        
+        while (dbk != NULL) {
+            blocks++;
+            dbk = dbk->next;
         }
     }
     //MemPool *mp = g_runtime->mpool;
@@ -1644,6 +2494,7 @@ hashtable_stat_sys(HashTable *ht, HashTableStatSys *stat)
 {
     Table       *tb = NULL;
     HashNode    *node;
+    TableIter   iter;
     int i, k;
     int keys    = 0;//统计memlink中key的数量
     int blocks  = 0;//统计memlink中分配的存储块数量
@@ -1657,18 +2508,13 @@ hashtable_stat_sys(HashTable *ht, HashTableStatSys *stat)
         if (tb == NULL) 
             continue;
         while (tb) {
-            for (i = 0; i < HASHTABLE_BUNKNUM; i++) {
-                node = tb->nodes[i];
-                if (node) {
-                    memu += strlen(node->key) + 1 + tb->attrnum;
-                }
-                while (node) {
-                    keys++;    
-                    datau   += node->used;
-                    dataall += node->all;
-                    memu += sizeof(HashNode);    
-                    node = node->next;
-                }
+            memu += table_index_mem(tb);
+            memu += table_node_mem(tb);
+            table_iter_init(tb, &iter);
+            while ((node = table_iter_next(&iter)) != NULL) {
+                keys++;    
+                datau   += node->used;
+                dataall += node->all;
             }
             tb = tb->next;
         }
@@ -1707,7 +2553,7 @@ hashtable_stat(HashTable *ht, char *tbname, char *key, HashTableStat *stat)
         return MEMLINK_ERR_NOKEY;
     }
 
-    stat->valuesize = tb->valuesize;
+    stat->valuesize = table_is_vstring(tb) ? tb->varena.maxsize : tb->valuesize;
     stat->attrsize  = tb->attrsize;
     stat->data      = node->all;
     stat->data_used = node->used;
@@ -1717,7 +2563,7 @@ hashtable_stat(HashTable *ht, char *tbname, char *key, HashTableStat *stat)
     int blockmem = 0;
     int blockall = 0;
 
-    DataBlock *dbk = node->data;
+    DataBlock *dbk = table_node_data(tb, node);
     while(dbk) {
         blockmem += sizeof(DataBlock) + (tb->attrsize + tb->valuesize) * dbk->data_count;
         blocks++;
@@ -1763,41 +2609,28 @@ hashtable_count(HashTable *ht, char *tbname, char *key, uint32_t *attrarray, int
     }
 
     if (attrnum > 0) {
-        int i, ret, k;
-        int datalen = tb->valuesize + tb->attrsize;
-        DataBlock *dbk = node->data;
+        int i;
+        AttrMatch vam, tam;
+        DataBlock *dbk = table_node_data(tb, node);
+
+        attrmatch_init(tb, &vam, MEMLINK_VALUE_VISIBLE, attrval, attrflag);
+        attrmatch_init(tb, &tam, MEMLINK_VALUE_TAGDEL, attrval, attrflag);
         while (dbk) {
             if (dbk->data_count == 0) {
                 break;
             }
-            char *itemdata = dbk->data;
-            for (i = 0; i < dbk->data_count; i++) {
-                //DINFO("dbk:%p node:%p, itemdata:%p\n", dbk, node, itemdata);
-                ret = dataitem_check_data(tb, node, itemdata);
-                if (ret != MEMLINK_VALUE_REMOVED) {
-                    char *attrdata = itemdata + tb->valuesize;
-                    // check attr equal
-                    for (k = 0; k < tb->attrsize; k++) {
-                        if ((attrdata[k] & attrflag[k]) != attrval[k]) {
-                            break;
-                        }
-                    }
-                    if (k < tb->attrsize) { // not equal
-                        itemdata += datalen;
-                        continue;
-                    }
-                    if (ret == MEMLINK_VALUE_VISIBLE) {
-                        vcount ++;
-                    }else{
-                        mcount ++;
-                    }
-                }
-                itemdata += datalen;
+            if (!datablock_attr_match(tb, node, dbk, attrval, attrflag)) {
+                dbk = dbk->next;
+                continue;
+            }
+            for (i = 0; i < dbk->data_count; i += 64) {
+                vcount += __builtin_popcountll(datablock_scan(tb, dbk, i, &vam));
+                mcount += __builtin_popcountll(datablock_scan(tb, dbk, i, &tam));
             }
             dbk = dbk->next;
         }
     }else{
-        DataBlock *dbk = node->data;
+        DataBlock *dbk = table_node_data(tb, node);
         while (dbk) {
             vcount += dbk->visible_count;
             mcount += dbk->tagdel_count;
@@ -1834,10 +2667,12 @@ hashtable_sortlist_count(HashTable *ht, char *tbname, char *key, uint32_t *attra
     }
     
     if (((char*)valmin)[0] == 0) {
-        dbk = node->data;
+        dbk = table_node_data(tb, node);
         pos = 0;
     }else{
-        ret = sortlist_lookup(tb, node, MEMLINK_SORTLIST_LOOKUP_STEP, valmin, MEMLINK_VALUE_ALL, &dbk);
+        do {
+            ret = sortlist_lookup(tb, node, MEMLINK_SORTLIST_LOOKUP_STEP, valmin, MEMLINK_VALUE_ALL, &dbk);
+        } while (ret < 0 && table_node_recheck(tb, node));
         if (ret < 0)
             return ret;
         pos = ret;
@@ -1851,20 +2686,20 @@ hashtable_sortlist_count(HashTable *ht, char *tbname, char *key, uint32_t *attra
     char firstval = ((char*)valmax)[0];
     DINFO("max first value:%d, dbk:%p pos:%d\n", firstval, dbk, pos);
     int i, k;
-    int datalen = tb->valuesize + tb->attrsize;
+    int datalen = dataitem_step(tb);
     while (dbk) {
         if (dbk->data_count == 0) {
             break;
         }
-        char *itemdata = dbk->data + pos * datalen;
+        char *itemdata = datablock_item(tb, dbk, pos);
         for (i = pos; i < dbk->data_count; i++) {
             //DINFO("dbk:%p node:%p, itemdata:%p\n", dbk, node, itemdata);
             if (pos > 0)
                 pos = 0;
-            ret = dataitem_check_data(tb, node, itemdata);
+            ret = dataitem_check_data(tb, dbk, itemdata);
             if (ret != MEMLINK_VALUE_REMOVED) {
                 if (firstval != 0 && 
-                    sortlist_valuecmp(tb->valuetype, valmax, itemdata, tb->valuesize) <= 0) {
+                    tb->valuecmp(valmax, itemdata, tb->valuesize) <= 0) {
                     /*char mybuf[128] = {0};
                     memcpy(mybuf, itemdata, node->valuesize);
                     DINFO("count end, ret:%d, val:%s, max:%s\n", ret, mybuf, (char*)valmax);
@@ -1873,7 +2708,7 @@ hashtable_sortlist_count(HashTable *ht, char *tbname, char *key, uint32_t *attra
                 }
                 
                 if (attrnum > 0) {
-                    char *attrdata = itemdata + tb->valuesize;
+                    char *attrdata = dataitem_attr(tb, dbk, itemdata);
                     for (k = 0; k < tb->attrsize; k++) {
                         if ((attrdata[k] & attrflag[k]) != attrval[k]) {
                             break;
@@ -1902,173 +2737,160 @@ table_sortlist_count_over:
     return MEMLINK_OK;
 }
 
-int 
-hashtable_lpush(HashTable *ht, char *tbname, char *key, void *value, uint32_t *attrarray, char attrnum)
+/**
+ * 队列的数据块按环形缓冲使用: lpush写到第一个数据块中第一个数据项前的空位, 
+ * rpush写到最后一个数据块中最后一个数据项后的空位, 没有空位时才在两端加新块.
+ * 空位上的数据项最后写标记字节, 新块写好数据项后才链入.
+ * 两端的空位数记在node->qhead, node->qtail中, 数据链被其它写操作改变时清零.
+ * pop只清除数据项的标记, 数据块空了就释放, 不复制数据项, 也不需要清理
+ */
+static int
+hashnode_queue_push(Table *tb, HashNode *node, void *value, void *attr, int left)
 {
-    return hashtable_insert(ht, tbname, key, value, attrarray, attrnum, 0);
-}
+    DataBlock   *dbk = left ? node->data : node->data_tail;
+    char        *itemdata;
+    int         newsize;
+
+    hashnode_index_touch(tb, node, dbk);
+    if (dbk && left && node->qhead > 0) {
+        node->qhead--;
+        itemdata = datablock_item(tb, dbk, node->qhead);
+        goto queue_push_publish;
+    }
+    if (dbk && !left && node->qtail > 0) {
+        itemdata = datablock_item(tb, dbk, dbk->data_count - node->qtail);
+        node->qtail--;
+        goto queue_push_publish;
+    }
+
+    // a new block grows with the queue, up to the max size of the table.
+    // it is complete before it is linked
+    newsize = datablock_suitable_size(tb, node->used, node->used + 1);
+    dbk = datablock_get(tb, newsize);
+    itemdata = left ? datablock_item(tb, dbk, newsize - 1) : dbk->data;
+    dataitem_copy(tb, dbk, itemdata, value, attr);
+    datablock_attr_add(tb, dbk, attr);
+    dbk->visible_count = 1;
+    if (left) {
+        dbk->next = node->data;
+        __sync_synchronize();
+        if (node->data) {
+            node->data->prev = dbk;
+        }else{
+            node->data_tail = dbk;
+            node->qtail = 0;
+        }
+        node->data  = dbk;
+        node->qhead = newsize - 1;
+    }else{
+        dbk->prev = node->data_tail;
+        __sync_synchronize();
+        if (node->data_tail) {
+            node->data_tail->next = dbk;
+        }else{
+            node->data  = dbk;
+            node->qhead = 0;
+        }
+        node->data_tail = dbk;
+        node->qtail = newsize - 1;
+    }
+    node->all += newsize;
+    node->used++;
 
-int 
-hashtable_rpush(HashTable *ht, char *tbname, char *key, void *value, uint32_t *attrarray, char attrnum)
-{
-    return hashtable_insert(ht, tbname, key, value, attrarray, attrnum, INT_MAX);
-}
+    return MEMLINK_OK;
 
-// pop value from head. queue not support tagdel, attr
-int
-hashtable_lpop(HashTable *ht, char *tbname, char *key, int num, Conn *conn)
-{
-    int ret = MEMLINK_OK;
-    int idx = 0;
-    char *wbuf = NULL;
+queue_push_publish:
+    // the slot is in a block readers can see
+    datablock_attr_add(tb, dbk, attr);
+    dataitem_publish(tb, dbk, itemdata, value, attr);
+    dbk->visible_count++;
+    node->used++;
 
-    if (num <= 0) {
-        ret =  MEMLINK_ERR_PARAM;
-        goto table_lpop_end;
-    }
+    return MEMLINK_OK;
+}
 
+static int
+hashtable_push(HashTable *ht, char *tbname, char *key, void *value, uint32_t *attrarray, 
+               char attrnum, int left)
+{
     Table *tb = hashtable_find_table(ht, tbname);
     if (NULL == tb) {
-        ret = MEMLINK_ERR_NOTABLE;
-        goto table_lpop_end;
+        return MEMLINK_ERR_NOTABLE;
     }
-
-    HashNode    *node;
-    node = table_find(tb, key);
-    if (NULL == node) {
-        DINFO("table_find not found node for key:%s\n", key);
-        ret = MEMLINK_ERR_NOKEY;
-        goto table_lpop_end;
+    if (tb->listtype != MEMLINK_QUEUE) {
+        return hashtable_insert(ht, tbname, key, value, attrarray, attrnum, left ? 0 : INT_MAX);
     }
 
-    int  wlen = CMD_REPLY_HEAD_LEN + 3 + tb->attrnum + (tb->valuesize + tb->attrsize) * num;
-    DINFO("range wlen: %d\n", wlen);
-    if (conn) {
-        //DINFO("conn is true.\n");
-        wbuf = conn_write_buffer(conn, wlen);
+    char attr[HASHTABLE_ATTR_MAX_ITEM * HASHTABLE_ATTR_MAX_BYTE] = {0};
+    int  ret;
+   
+    if (tb->attrnum != attrnum) {
+        DINFO("attr error: tb->attrnum:%d, param attrnum:%d\n", tb->attrnum, attrnum);
+        return MEMLINK_ERR_ATTR;
     }
-    idx += CMD_REPLY_HEAD_LEN;
-
-    DataBlock *dbk = node->data;
-    DataBlock *newdbk = NULL;
-    DataBlock *startdbk = dbk, *enddbk = NULL;
-    char      *itemdata;
-    int datalen = tb->valuesize + tb->attrsize;
-    int n     = 0; 
-    int i;
-    int rmn   = 0;  // delete value count in whole block
-
-    if (conn) {
-        memcpy(wbuf + idx, &tb->valuesize, sizeof(char));
-        idx += sizeof(char);
-        memcpy(wbuf + idx, &tb->attrsize, sizeof(char));
-        idx += sizeof(char);
-        uint8_t wchar;
-        wchar = tb->attrnum;
-        //memcpy(wbuf + idx, &node->attrnum, sizeof(char));
-        memcpy(wbuf + idx, &wchar, sizeof(char));
-        idx += sizeof(char);
-        if (tb->attrnum > 0) {
-            memcpy(wbuf + idx, table_attrformat(tb), tb->attrnum);
+    if (tb->attrnum > 0) {
+        ret = attr_array2binary(table_attrformat(tb), attrarray, attrnum, attr);
+        if (ret <= 0) {
+            DINFO("attr_array2binary error: %d\n", ret);
+            return MEMLINK_ERR_ATTR;
         }
-        idx += tb->attrnum;
     }else{
-        idx += 3 + tb->attrnum;
+        attr[0] = 0x01;
     }
 
-    while (dbk) {
-        itemdata = dbk->data;
-        int dbkcpnv = 0;
-        for (i = 0; i < dbk->data_count; i++) {
-            ret = dataitem_check_data(tb, node, itemdata);
-            if (ret == MEMLINK_VALUE_VISIBLE) {
-                /*char buf[128];
-                snprintf(buf, node->valuesize + 1, "%s", itemdata);
-                DINFO("\tok, copy item ... i:%d, value:%s\n", i, buf);
-                */    
-                if (conn) {
-                    memcpy(wbuf + idx, itemdata, datalen);
-                }
-                idx += datalen;
-                n += 1;
-                dbkcpnv++;
-                if (n >= num) { // copy complete!
-                    if (i < dbk->data_count - 1) {
-                        newdbk = mempool_get(g_runtime->mpool, sizeof(DataBlock) + dbk->data_count * datalen);
-                        newdbk->data_count    = dbk->data_count;
-                        newdbk->visible_count = dbk->visible_count - dbkcpnv; 
-                        char *todata = newdbk->data + datalen * (i + 1);
-                        node->data   = newdbk;
-                        newdbk->next = dbk->next;
-                        if (dbk->next) {
-                            dbk->next->prev = newdbk;
-                        }
-                        DINFO("copy todata from: %d, count:%d\n", i, dbk->data_count - i - 1);
-                        memcpy(todata, itemdata + datalen, (dbk->data_count - i - 1) * datalen);
-                        //enddbk = dbk;
-                    }else{ // current datablock is all poped
-                        rmn += dbk->data_count;
-                        node->data = dbk->next;
-                        if (dbk->next) {
-                            dbk->next->prev = NULL;
-                        }
-                    }
-                    enddbk = dbk->next; 
-
-                    if (dbk->next == NULL) {
-                        node->data_tail = newdbk;
-                    }
-                    node->all  -= rmn;
-                    node->used -= n;
-                    ret = MEMLINK_OK;
-                    goto table_lpop_over;
-                }
-            }
-            itemdata += datalen;
-        }
-        rmn += dbk->data_count;
-        dbk = dbk->next;
-    }
-    enddbk     = NULL;
-    node->all  = 0;
-    node->used = 0;
-    node->data = node->data_tail = NULL;
-    ret = MEMLINK_OK;
-    
-table_lpop_over:
-    DINFO("count: %d\n", n);
-    if (n > 0) {
-        datablock_free(startdbk, enddbk, datalen);
+    HashNode *node = table_find(tb, key);
+    if (NULL == node) {
+        ret = table_create_node(tb, key);
+        if (ret != MEMLINK_OK)
+            return ret;
+        node = table_find(tb, key);
     }
-
-table_lpop_end:
-    if (conn) {
-        memcpy(wbuf + idx, &n, sizeof(int));
-        idx += sizeof(int);
-        conn_write_buffer_head(conn, ret, idx);
-        //char bufw[4096] = {0};
-        //DINFO("bufw:%s\n", formath(conn->wbuf, conn->wlen, bufw, 4096));
+    char vref[sizeof(char*)];
+    if (table_is_vstring(tb)) {
+        ret = valuearena_put(&tb->varena, value, vref);
+        if (ret != MEMLINK_OK)
+            return ret;
+        value = vref;
     }
+    ret = hashnode_queue_push(tb, node, value, attr, left);
+    hashnode_index_update(tb, node);
 
     return ret;
 }
 
-int
-hashtable_rpop(HashTable *ht, char *tbname, char *key, int num, Conn *conn)
+int 
+hashtable_lpush(HashTable *ht, char *tbname, char *key, void *value, uint32_t *attrarray, char attrnum)
+{
+    return hashtable_push(ht, tbname, key, value, attrarray, attrnum, 1);
+}
+
+int 
+hashtable_rpush(HashTable *ht, char *tbname, char *key, void *value, uint32_t *attrarray, char attrnum)
+{
+    return hashtable_push(ht, tbname, key, value, attrarray, attrnum, 0);
+}
+
+/**
+ * pop num visible values from head or tail, tagged values passed are dropped.
+ * items are only marked removed, empty blocks are released
+ */
+static int
+hashtable_pop(HashTable *ht, char *tbname, char *key, int num, Conn *conn, int left)
 {
     int ret = MEMLINK_OK;
     int idx = 0;
+    int n   = 0; 
     char *wbuf = NULL;
-    
+
     if (num <= 0) {
         ret =  MEMLINK_ERR_PARAM;
-        goto table_rpop_end;
+        goto table_pop_end;
     }
 
     Table *tb = hashtable_find_table(ht, tbname);
     if (NULL == tb) {
         ret = MEMLINK_ERR_NOTABLE;
-        goto table_rpop_end;
+        goto table_pop_end;
     }
 
     HashNode    *node;
@@ -2076,120 +2898,128 @@ hashtable_rpop(HashTable *ht, char *tbname, char *key, int num, Conn *conn)
     if (NULL == node) {
         DINFO("table_find not found node for key:%s\n", key);
         ret = MEMLINK_ERR_NOKEY;
-        goto table_rpop_end;
+        goto table_pop_end;
     }
 
-    int  wlen = CMD_REPLY_HEAD_LEN + 3 + tb->attrnum + (tb->valuesize + tb->attrsize) * num;
+    int  wlen = CMD_REPLY_HEAD_LEN + 3 + tb->attrnum + table_pack_size(tb) * num + sizeof(int);
     DINFO("range wlen: %d\n", wlen);
     if (conn) {
-        //DINFO("conn is true.\n");
         wbuf = conn_write_buffer(conn, wlen);
     }
     idx += CMD_REPLY_HEAD_LEN;
 
-    DataBlock *dbk = node->data_tail;
-    DataBlock *newdbk = NULL;
-    DataBlock *startdbk = dbk, *enddbk = NULL;
+    DataBlock *dbk = left ? node->data : node->data_tail;
+    DataBlock *nextdbk;
     char      *itemdata;
-    int datalen = tb->valuesize + tb->attrsize;
-    int n     = 0; 
+    int step    = left ? dataitem_step(tb) : -dataitem_step(tb);
     int i;
-    int rmn   = 0;  // delete value count in whole block
 
     if (conn) {
-        memcpy(wbuf + idx, &tb->valuesize, sizeof(char));
+        uint8_t wchar;
+        wchar = table_reply_valuesize(tb);
+        memcpy(wbuf + idx, &wchar, sizeof(char));
         idx += sizeof(char);
         memcpy(wbuf + idx, &tb->attrsize, sizeof(char));
         idx += sizeof(char);
-        uint8_t wchar;
         wchar = tb->attrnum;
-        //memcpy(wbuf + idx, &node->attrnum, sizeof(char));
         memcpy(wbuf + idx, &wchar, sizeof(char));
         idx += sizeof(char);
         if (tb->attrnum > 0) {
             memcpy(wbuf + idx, table_attrformat(tb), tb->attrnum);
-            idx += tb->attrnum;
         }
+        idx += tb->attrnum;
     }else{
         idx += 3 + tb->attrnum;
     }
 
-    while (dbk) {
-        itemdata = dbk->data + ((dbk->data_count - 1) * datalen);
-        int dbkcpnv = 0;
-        //for (i = 0; i < dbk->data_count; i++) {
-        for (i = dbk->data_count - 1; i >= 0; i--) {
-            ret = dataitem_check_data(tb, node, itemdata);
+    // free items of the other end stay if its block is not released
+    DataBlock *otherbk = left ? node->data_tail : node->data;
+    uint16_t  qother   = left ? node->qtail : node->qhead;
+
+    i = 0;
+    while (dbk && n < num) {
+        nextdbk = left ? dbk->next : dbk->prev;
+        datablock_prefetch(nextdbk);
+        hashnode_index_touch(tb, node, dbk);
+        itemdata = left ? dbk->data : datablock_item(tb, dbk, dbk->data_count - 1);
+        for (i = 0; i < dbk->data_count && n < num; i++, itemdata += step) {
+            ret = dataitem_check_data(tb, dbk, itemdata);
+            if (ret == MEMLINK_VALUE_REMOVED) {
+                continue;
+            }
             if (ret == MEMLINK_VALUE_VISIBLE) {
-                /*char buf[128];
-                snprintf(buf, node->valuesize + 1, "%s", itemdata);
-                DINFO("\tok, copy item ... i:%d, value:%s\n", i, buf);*/
-                    
                 if (conn) {
-                    memcpy(wbuf + idx, itemdata, datalen);
+                    idx += dataitem_pack(tb, dbk, itemdata, wbuf + idx);
                 }
-                idx += datalen;
                 n += 1;
-                dbkcpnv++;
-                if (n >= num) { // copy complete!
-                    if (i > 0) {
-                        newdbk = mempool_get(g_runtime->mpool, sizeof(DataBlock) + dbk->data_count * datalen);
-                        newdbk->data_count    = dbk->data_count;
-                        newdbk->visible_count = dbk->visible_count - dbkcpnv; 
-                        node->data_tail = newdbk;
-                        newdbk->prev = dbk->prev;
-                        if (dbk->prev) {
-                            dbk->prev->next = newdbk;
-                        }
-                        DINFO("copy todata count:%d\n", i);
-                        memcpy(newdbk->data, dbk->data, i * datalen);
-                    }else{ // current datablock is all poped
-                        rmn += dbk->data_count;
-                        node->data_tail = dbk->prev;
-                        if (dbk->prev) {
-                            dbk->prev->next = NULL;
-                        }
-                    }
-                    enddbk = dbk->prev; 
-
-                    if (dbk->prev == NULL) {
-                        node->data = NULL;
-                    }
-                    node->all  -= rmn;
-                    node->used -= n;
-                    ret = MEMLINK_OK;
-                    goto table_rpop_over;
+                dbk->visible_count--;
+            }else{
+                dbk->tagdel_count--;
+            }
+            *dataitem_attr(tb, dbk, itemdata) &= 0xfe;
+            node->used--;
+        }
+        if (dbk->visible_count + dbk->tagdel_count == 0) { // current datablock is all poped
+            if (left) {
+                node->data = nextdbk;
+                if (nextdbk) {
+                    nextdbk->prev = NULL;
+                }else{
+                    node->data_tail = NULL;
+                }
+            }else{
+                node->data_tail = nextdbk;
+                if (nextdbk) {
+                    nextdbk->next = NULL;
+                }else{
+                    node->data = NULL;
                 }
             }
-            itemdata -= datalen;
+            node->all -= dbk->data_count;
+            hashnode_index_release(tb, node, dbk);
+            datablock_put(tb, dbk);
+            i = 0;
+        }
+        dbk = nextdbk;
+    }
+    // items passed in the block left at this end are all removed now
+    if (node->data) {
+        if (left) {
+            node->qhead = i;
+            node->qtail = (node->data_tail == otherbk) ? qother : 0;
+        }else{
+            node->qtail = i;
+            node->qhead = (node->data == otherbk) ? qother : 0;
         }
-        rmn += dbk->data_count;
-        dbk = dbk->prev;
     }
-    enddbk     = NULL;
-    node->all  = 0;
-    node->used = 0;
-    node->data = node->data_tail = NULL;
     ret = MEMLINK_OK;
-    
-table_rpop_over:
     DINFO("count: %d\n", n);
-    if (n > 0) {
-        datablock_free_inverse(startdbk, enddbk, datalen);
-    }
+    hashnode_index_update(tb, node);
 
-table_rpop_end:
-    if (conn) {
+table_pop_end:
+    // errors before the reply buffer is taken are replied by the caller
+    if (wbuf) {
         memcpy(wbuf + idx, &n, sizeof(int));
         idx += sizeof(int);
-
         conn_write_buffer_head(conn, ret, idx);
-        //char bufw[4096] = {0};
-        //DINFO("bufw:%s\n", formath(conn->wbuf, conn->wlen, bufw, 4096));
     }
+
     return ret;
 }
 
+// pop value from head. queue not support tagdel, attr
+int
+hashtable_lpop(HashTable *ht, char *tbname, char *key, int num, Conn *conn)
+{
+    return hashtable_pop(ht, tbname, key, num, conn, 1);
+}
+
+int
+hashtable_rpop(HashTable *ht, char *tbname, char *key, int num, Conn *conn)
+{
+    return hashtable_pop(ht, tbname, key, num, conn, 0);
+}
+
 int 
 table_check(Table *tb, char *key)
 {
@@ -2208,14 +3038,12 @@ int
 hashnode_check(Table *tb, HashNode *node)
 {
     DINFO("------ check HashNode key:%s, valuesize:%d, attrsize:%d, attrnum:%d, all:%d, used:%d\n",
-                node->key, tb->valuesize, tb->attrsize, tb->attrnum, node->all, node->used);
+                hashnode_key(node), tb->valuesize, tb->attrsize, tb->attrnum, node->all, node->used);
 
     DataBlock *dbk  = node->data;
     DataBlock *prev = NULL;
     int blocks = 0;
     
-    zz_check(node);
-    zz_check(node->key);
 
     while (dbk) {
         zz_check(dbk);
@@ -2249,7 +3077,7 @@ table_print(Table *tb, char *key)
     }
 
     DINFO("------ HashNode key:%s, valuesize:%d, attrsize:%d, attrnum:%d, all:%d, used:%d\n",
-                node->key, tb->valuesize, tb->attrsize, tb->attrnum, node->all, node->used);
+                hashnode_key(node), tb->valuesize, tb->attrsize, tb->attrnum, node->all, node->used);
 
     int i;
     unsigned char *attrformat = table_attrformat(tb);
@@ -2261,8 +3089,6 @@ table_print(Table *tb, char *key)
     DataBlock *prev = NULL;
     int blocks = 0;
     
-    zz_check(node);
-    zz_check(node->key);
 
     while (dbk) {
         zz_check(dbk);
@@ -2294,9 +3120,8 @@ hashtable_del_by_attr(HashTable *ht, char *tbname, char *key, uint32_t *attrarra
         return MEMLINK_ERR_NOTABLE;
     }
 
-    int i, k;
+    int i;
     int count = 0;
-    int datalen = 0;
     char attrval[HASHTABLE_ATTR_MAX_ITEM * HASHTABLE_ATTR_MAX_BYTE] = {0};
     char attrflag[HASHTABLE_ATTR_MAX_ITEM * HASHTABLE_ATTR_MAX_BYTE] = {0};
     HashNode *node;
@@ -2310,44 +3135,40 @@ hashtable_del_by_attr(HashTable *ht, char *tbname, char *key, uint32_t *attrarra
     if (tb->attrnum != attrnum) {
         return MEMLINK_ERR_ATTR;
     }
-    datalen = tb->valuesize + tb->attrsize;
     if (attrnum > 0) {
         attr_array2_binary_flag(table_attrformat(tb), attrarray, attrnum, tb->attrsize, attrval, attrflag);
     }
     DataBlock *root = node->data;
+    AttrMatch am;
 
+    attrmatch_init(tb, &am, MEMLINK_VALUE_ALL, attrval, attrflag);
     while (root) {
-        char *itemdata = root->data;
-
-        for (i = 0; i < root->data_count; i++) {
-            if (dataitem_have_data(tb, node, itemdata, 0)) {
-                char *attrdata = itemdata + tb->valuesize;
-
-                for (k = 0; k < tb->attrsize; k++) {
-                    if ((attrdata[k] & attrflag[k]) != attrval[k]) {
-                        break;
-                    }
+        datablock_prefetch(root->next);
+        if (!datablock_attr_match(tb, node, root, attrval, attrflag)) {
+            root = root->next;
+            continue;
+        }
+        hashnode_index_touch(tb, node, root);
+        for (i = 0; i < root->data_count; i += 64) {
+            uint64_t mask = datablock_scan(tb, root, i, &am);
+            while (mask) {
+                char *attrdata = datablock_item_attr(tb, root, i + __builtin_ctzll(mask));
+                mask &= mask - 1;
+
+                if ((attrdata[0] & 0x03) == 1) {
+                    root->visible_count--;
                 }
-                //not equal
-                if (k < tb->attrsize) {
-                    itemdata += datalen;
-                    continue;
-                } else {//equal
-                    if ((attrdata[0] & 0x03) == 1) {
-                        root->visible_count--;
-                    }
-                    if ((attrdata[0] & 0x03) == 3) {
-                        root->tagdel_count--;
-                    }
-                    attrdata[0] = attrdata[0] & 0x00;
-                    count++;
+                if ((attrdata[0] & 0x03) == 3) {
+                    root->tagdel_count--;
                 }
+                attrdata[0] = attrdata[0] & 0x00;
+                count++;
             }
-            itemdata += datalen;
         }
         root = root->next;
     }
     node->used -= count;
+    hashnode_index_update(tb, node);
 
     return count;
 }
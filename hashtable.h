@@ -2,20 +2,127 @@
 #define MEMLINK_HASHTABLE_H
 
 #include <stdio.h>
+#include <pthread.h>
+#include <time.h>
 #include "mem.h"
 #include "common.h"
 #include "conn.h"
 
+// one segment of BlockIndex, blocks from dbk to the first block of the next segment
+typedef struct _memlink_blockindex_item
+{
+    DataBlock   *dbk;     // NULL when the segment has no block
+    uint32_t    visible;  // items of the segment, also added in vtree
+    uint32_t    tagdel;
+}BlockIndexItem;
+
+// index of a long DataBlock link, kept by writers: segments changed by a write 
+// are counted again when it ends, item count before a segment is summed by fenwick trees.
+// readers search it without lock, a rebuilt index replaces it and the old one is retired
+typedef struct _memlink_blockindex
+{
+    uint32_t        count;    // segments in use
+    uint32_t        size;     // segments allocated, the tail grows into the free ones
+    uint32_t        step;     // blocks of a segment when created
+    uint32_t        nulls;    // segments without block
+    uint32_t        dirty_lo; // segments changed by current write, none if dirty_lo > dirty_hi
+    uint32_t        dirty_hi;
+    uint32_t        visible;  // items of all segments
+    uint32_t        tagdel;
+    uint32_t        mem;      // bytes allocated
+    uint32_t        *vtree;   // fenwick tree of visible count of segments, from 1
+    uint32_t        *ttree;   // fenwick tree of tagdel count of segments
+    BlockIndexItem  items[0];
+}BlockIndex;
+
 typedef struct _memlink_hashnode
 {
-    char              *key;
     DataBlock         *data; // DataBlock link
-    DataBlock         *data_tail; // DataBlock link tail
+    union {
+        DataBlock     *data_tail; // DataBlock link tail
+        uintptr_t     cold; // in cold store: record position << 1 | file gen | 1, compressed in memory: record | 3, data is NULL
+    };
     struct _memlink_hashnode  *next;
+    BlockIndex        *bindex; // built by writers for positional or sortlist lookup, read without lock
     uint32_t      used; // used data item
     uint32_t      all;  // all data item;
+    uint32_t      hash; // full hash of key, compared before key bytes
+    uint32_t      keylen:8;
+    uint32_t      access:24; // LRU: second of last access, LFU: minute << 8 | log counter
+    uint16_t      qhead; // queue: free items before the first one in head block, 0 if not known
+    uint16_t      qtail; // queue: free items after the last one in tail block, 0 if not known
+    union {
+        char      *ptr; // key not shorter than HASHNODE_KEY_INLINE
+        char      buf[HASHNODE_KEY_INLINE];
+    }key;
 }HashNode;
 
+#define hashnode_key(node) \
+	((node)->keylen < HASHNODE_KEY_INLINE ? (node)->key.buf : (node)->key.ptr)
+
+#define hashnode_is_cold(node)	((node)->cold & 1)
+#define hashnode_cold_in_mem(node)	(((node)->cold & 3) == 3)
+
+// a block of HashNode carved from one allocation
+typedef struct _memlink_nodeslab
+{
+	struct _memlink_nodeslab *next;
+	uint32_t	count; // node count in this slab
+	uint32_t	used;  // node carved from this slab
+	HashNode	nodes[0];
+}NodeSlab;
+
+// per table HashNode allocator
+typedef struct _memlink_nodearena
+{
+	NodeSlab	*slabs;
+	HashNode	*freelist; // released node, linked by next
+	uint32_t	mem;       // bytes of slabs and out of line keys
+}NodeArena;
+
+// values of a MEMLINK_VALUE_VSTRING table, aligned to VALUEARENA_CHUNK_SIZE
+typedef struct _memlink_valuechunk
+{
+	struct _memlink_valuechunk *next;
+	uint32_t	used;  // bytes carved, with this head
+	uint32_t	live;  // bytes still referenced, counted by the mark walk of compact
+	uint8_t		moved; // values are moved out by compact, freed when the pass ends
+	char		data[0];
+}ValueChunk;
+
+// out of line values, item of the table holds a pointer to len|bytes
+typedef struct _memlink_valuearena
+{
+	ValueChunk	*chunks;  // the first one is carved from
+	uint64_t	mem;      // bytes of chunks
+	uint64_t	live;     // live bytes counted by the last compact pass
+	uint16_t	maxsize;  // max value length of the table
+	uint8_t		intern;   // equal values are stored once, a mark byte is before len
+	unsigned char **dict; // interned values, open addressing, NULL is empty
+	uint32_t	dict_size; // slots, power of 2
+	uint32_t	dict_used; // values in dict
+	uint32_t	dict_dead; // slots of values purged from dict
+	// compact pass, walked in steps by valuearena_compact_step
+	uint8_t		phase;    // VALUEARENA_IDLE/MARK/MOVE/PURGE
+	uint8_t		mark;     // mark byte of interned values referenced in this pass, not 0
+	uint32_t	cursor;   // next bunk of mark and move walks, next dict slot of purge
+	uint32_t	rehashes; // Table.rehashes when the walk started
+	ValueChunk	*carve;   // carved from when the pass started, it and newer chunks are kept
+	uint64_t	counted;  // live bytes counted by the mark walk
+	uint32_t	moves;    // values moved by the pass
+}ValueArena;
+
+// bunks and size never change, a rehash makes a new index
+typedef struct _memlink_hashindex
+{
+    HashNode    **bunks;
+    uint32_t    size;  // bunk count, always power of 2
+    uint32_t    used;  // node count in this index, only for writers
+}HashIndex;
+
+// compare two values of sortlist, return <0, 0, >0
+typedef int (*ValueCmpFunc)(void *v1, void *v2, int size);
+
 typedef struct _memlink_table
 {
 	char	 name[HASHTABLE_TABLE_NAME_SIZE];
@@ -25,11 +132,51 @@ typedef struct _memlink_table
 	uint8_t	 sortfield;  // which sort? 0:value, 1-255:attr[0-254]
 	uint8_t	 attrnum;    // number of attribute format
 	uint8_t	 attrsize;   // byte of attribute
+	uint8_t	 layout;     // item layout in DataBlock: MEMLINK_LAYOUT_ROW/COLUMN
+	uint8_t	 evict;      // key eviction over max_mem: MEMLINK_EVICT_NONE/LRU/LFU
+	uint8_t	 cold;       // data link of idle key is moved to cold store
+	uint8_t	 compress;   // items of idle key are compressed, kept in memory if not cold
+	uint8_t	 block_count_items; // sizes in block_count
+	uint8_t	 block_count_base;  // sizes not bigger than max of block_data_count, any list can use
+	uint16_t block_count[MEMLINK_BLOCK_SIZES_MAX]; // DataBlock capacities, ascending
 	uint8_t	 *attrformat; // attribute format, eg: 3:4:5 => [3, 4, 5]
-	HashNode **nodes;
+	ValueCmpFunc valuecmp; // value comparator for valuetype
+	HashIndex * volatile index[2];  // swapped as a whole, index[1] has no bunk when not rehashing
+	int		 rehashidx;  // next bunk in index[0] to move, -1 means not rehashing
+	volatile uint32_t rehash_seq; // odd while a rehash step moves nodes, lookups missing a key retry
+	uint32_t rehashes;   // rehash started, bunk walks spread over steps restart when changed
+	NodeArena arena;
+	ValueArena varena;   // only used by MEMLINK_VALUE_VSTRING
+	HashNode	*clean_node; // node in background clean, changed with write lock
+	DataBlock	*clean_next; // next block of clean_node to clean, NULL means from head
+	uint64_t	block_mem;   // bytes of DataBlock in use
+	uint32_t	bindex_mem;  // bytes of BlockIndex of all nodes
+	uint64_t	compress_mem; // bytes of compressed records in memory
+	uint32_t	compress_keys; // HashNode compressed in memory
 	struct _memlink_table *next;
 }Table;
 
+#define table_is_vstring(tb)	((tb)->valuetype == MEMLINK_VALUE_VSTRING)
+
+// idle keys of the table are moved out of DataBlocks, HashNode.access is kept
+#define table_has_cold(tb)	((tb)->cold || (tb)->compress)
+
+// value size in reply head, 0 means each value is len|bytes
+#define table_reply_valuesize(tb)	(table_is_vstring(tb) ? 0 : (tb)->valuesize)
+
+// max bytes of value|attr in reply and dump file
+#define table_pack_size(tb) \
+	(table_is_vstring(tb) ? 1 + (tb)->varena.maxsize + (tb)->attrsize : (tb)->valuesize + (tb)->attrsize)
+
+// iterate all HashNode in a Table, no write allowed during iteration
+typedef struct _memlink_table_iter
+{
+	Table		*tb;
+	int			idx;
+	uint32_t	bunk;
+	HashNode	*node;
+}TableIter;
+
 
 // table name =>Table + key => Node
 typedef struct _memlink_hashtable
@@ -44,16 +191,27 @@ Table*		table_create(char *name, int valuesize, uint32_t *attrarray, uint8_t att
 						 uint8_t listtype, uint8_t valuetype);
 void		table_clear(Table *tb);
 void		table_destroy(Table *tb);
+void		table_retire(Table *tb);
 uint8_t*	table_attrformat(Table *tb);
 int         table_find_value(Table *tb, char *key, void *value, 
                              HashNode **node, DataBlock **dbk, char **data);
 int         table_find_value_pos(Table *tb, char *key, void *value, 
                              HashNode **node, DataBlock **dbk);
 HashNode*   table_find(Table *tb, char *key);
+HashNode*   table_peek(Table *tb, char *key);
 int         table_print(Table *tb, char *key);
 int         table_check(Table *tb, char *key);
 int			table_create_node(Table *tb, char *key);
 int         hashnode_check(Table*, HashNode *node);
+int			table_remove_key(Table *tb, char *key);
+uint32_t	table_key_count(Table *tb);
+uint32_t	table_index_mem(Table *tb);
+uint32_t	table_node_mem(Table *tb);
+uint64_t	table_mem(Table *tb);
+uint32_t	hashnode_idle(Table *tb, HashNode *node, time_t now);
+void		hashnode_idle_reset(Table *tb, HashNode *node, time_t now);
+void		table_iter_init(Table *tb, TableIter *iter);
+HashNode*	table_iter_next(TableIter *iter);
 
 
 HashTable*  hashtable_create();
@@ -72,6 +230,7 @@ uint32_t	hashtable_table_hash(char *key, int len);
 int			hashtable_tables(HashTable *ht, char **data);
 int			hashtable_remove_table(HashTable *ht, char *tbname);
 int			hashtable_remove_key(HashTable *ht, char *tbname, char *key);
+int			hashtable_evict_key(HashTable *ht, char *tbname, char *key);
 int			hashtable_clear_key(HashTable *ht, char *tbname, char *key);
 
 int         hashtable_insert(HashTable *ht, char *tbname, char *key, void *value, 
@@ -91,6 +250,7 @@ int         hashtable_range(HashTable *ht, char *tbname, char *key,
                         int frompos, int len, Conn *conn);
 int         hashtable_clean(HashTable *ht, char *tbname, char *key);
 int			hashtable_clean_all(HashTable *ht);
+int			hashtable_clean_step(HashTable *ht, char *tbname, char *key, int maxblocks, int maxtime);
 int         hashtable_stat(HashTable *ht, char *tbname, char *key, HashTableStat *stat);
 int			hashtable_stat_table(HashTable *ht, char *tbname, HashTableStatSys *stat);
 int			hashtable_stat_sys(HashTable *ht, HashTableStatSys *stat);
@@ -44,6 +44,14 @@ info_sys_stat(MemLinkStatSys *stat)
     }
     stat->pool_mem = psize;
     stat->pool_blocks = mp->blocks;
+    stat->slab_mem = (unsigned long long)(mp->slabs - mp->empty_slabs) * MEMPOOL_SLAB_SIZE / 1024;
+    stat->hugepage_mem = mempool_hugepage_mem(mp);
+    stat->mem_used = mem_used_total() / 1024;
+    stat->evicted_keys = g_runtime->evicted_keys;
+    if (g_runtime->coldstore) {
+        stat->cold_keys = g_runtime->coldstore->keys;
+        stat->cold_mem  = g_runtime->coldstore->live / 1024;
+    }
 
     DNOTE("pool_mem: %d\n", stat->pool_mem);
     DNOTE("pool_mem: %d\n", stat->pool_blocks);
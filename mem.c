@@ -7,12 +7,19 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "zzmalloc.h"
 #include "logfile.h"
 #include "mem.h"
 #include "common.h"
 //MemPool *g_mpool;
 
+#define SLAB_STEP(size)     (((size) + 7) & ~7)
+#define SLAB_DATA_OFFSET    ((sizeof(MemSlab) + 15) & ~15)
+#define SLAB_OF(dbk)        ((MemSlab*)((uintptr_t)(dbk) & ~((uintptr_t)MEMPOOL_SLAB_SIZE - 1)))
+
 MemPool*    
 mempool_create()
 {
@@ -33,28 +40,242 @@ mempool_create()
         return NULL;
     }
     memset(mp->freemem, 0, sizeof(MemItem) * mp->size);
+
+    mp->sizemap = (unsigned short*)zz_malloc(sizeof(short) * (MEMPOOL_SLAB_BLOCK_MAX + 1));
+    if (NULL == mp->sizemap) {
+        DERROR("malloc sizemap error!\n");
+        zz_free(mp->freemem);
+        zz_free(mp);
+        return NULL;
+    }
+    memset(mp->sizemap, 0, sizeof(short) * (MEMPOOL_SLAB_BLOCK_MAX + 1));
    
     //g_mpool = mp;
 
     return mp;
 }
 
+/**
+ * find the MemItem of blocksize, create it if not exist
+ * slab sizes are looked up in sizemap, others are scanned
+ */
+static int
+mempool_item(MemPool *mp, int blocksize)
+{
+    int i;
+
+    if (blocksize <= MEMPOOL_SLAB_BLOCK_MAX && mp->sizemap[blocksize] > 0)
+        return mp->sizemap[blocksize] - 1;
+
+    for (i = 0; i < mp->used; i++) {
+        if (mp->freemem[i].memsize == blocksize)
+            return i;
+    }
+    if (mp->used >= mp->size && mempool_expand(mp) == -1)
+        return -1;
+
+    i = mp->used;
+    memset(&mp->freemem[i], 0, sizeof(MemItem));
+    mp->freemem[i].memsize = blocksize;
+    mp->used += 1;
+    if (blocksize <= MEMPOOL_SLAB_BLOCK_MAX)
+        mp->sizemap[blocksize] = i + 1;
+
+    return i;
+}
+
+/**
+ * anonymous memory aligned to size
+ */
+static char*
+mempool_map(size_t size)
+{
+    char *mem = mmap(NULL, size * 2, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == mem) {
+        DERROR("mmap %zu error!\n", size);
+        return NULL;
+    }
+    char *start = (char*)(((uintptr_t)mem + size - 1) & ~((uintptr_t)size - 1));
+    if (start > mem)
+        munmap(mem, start - mem);
+    munmap(start + size, mem + size - start);
+
+    return start;
+}
+
+/**
+ * carve a slab from the huge page arena, map a new arena when it is used up
+ */
+static char*
+mempool_arena_slab(MemPool *mp)
+{
+    char *mem = NULL;
+
+    if (NULL == mp->arena || mp->arena >= mp->arena_end) {
+#ifdef MAP_HUGETLB
+        if (mp->hugepage == MEMLINK_HUGEPAGE_HUGETLB) {
+            mem = mmap(NULL, MEMPOOL_ARENA_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (MAP_FAILED == mem) {
+                DWARNING("mmap hugetlb error, use transparent huge page.\n");
+                mp->hugepage = MEMLINK_HUGEPAGE_THP;
+                mem = NULL;
+            }
+        }
+#endif
+        if (NULL == mem) {
+            mem = mempool_map(MEMPOOL_ARENA_SIZE);
+            if (NULL == mem)
+                return NULL;
+#ifdef MADV_HUGEPAGE
+            if (madvise(mem, MEMPOOL_ARENA_SIZE, MADV_HUGEPAGE) != 0) {
+                DWARNING("madvise MADV_HUGEPAGE error.\n");
+            }else{
+                mp->hugemem += MEMPOOL_ARENA_SIZE;
+            }
+#endif
+        }else{
+            mp->hugemem += MEMPOOL_ARENA_SIZE;
+        }
+        mp->arena     = mem;
+        mp->arena_end = mem + MEMPOOL_ARENA_SIZE;
+        mp->mem      += MEMPOOL_ARENA_SIZE;
+    }
+    mem = mp->arena;
+    mp->arena += MEMPOOL_SLAB_SIZE;
+
+    return mem;
+}
+
+/**
+ * a MEMPOOL_SLAB_SIZE aligned slab, reuse a released one first
+ */
+static MemSlab*
+mempool_slab_new(MemPool *mp, int item)
+{
+    MemSlab *slab = mp->empty;
+
+    if (slab) {
+        mp->empty = slab->next;
+        mp->empty_slabs--;
+        if (mp->hugepage == MEMLINK_HUGEPAGE_NO)
+            mp->mem += MEMPOOL_SLAB_SIZE - sysconf(_SC_PAGESIZE);
+    }else{
+        if (mp->hugepage != MEMLINK_HUGEPAGE_NO) {
+            slab = (MemSlab*)mempool_arena_slab(mp);
+        }else{
+            slab = (MemSlab*)mempool_map(MEMPOOL_SLAB_SIZE);
+            mp->mem += MEMPOOL_SLAB_SIZE;
+        }
+        if (NULL == slab) {
+            DERROR("mmap slab error!\n");
+            MEMLINK_EXIT;
+            return NULL;
+        }
+        slab->link   = mp->slablist;
+        mp->slablist = slab;
+        mp->slabs++;
+    }
+    slab->prev   = NULL;
+    slab->next   = mp->freemem[item].slabs;
+    slab->data   = NULL;
+    slab->carve  = (char*)slab + SLAB_DATA_OFFSET;
+    slab->end    = (char*)slab + MEMPOOL_SLAB_SIZE;
+    slab->used   = 0;
+    slab->carved = 0;
+    slab->item   = item;
+    if (slab->next)
+        slab->next->prev = slab;
+    mp->freemem[item].slabs = slab;
+
+    return slab;
+}
+
+static inline int
+mempool_slab_full(MemSlab *slab, int step)
+{
+    return NULL == slab->data && slab->carve + step > slab->end;
+}
+
+static void
+mempool_slab_unlink(MemItem *mi, MemSlab *slab)
+{
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    }else{
+        mi->slabs = slab->next;
+    }
+    if (slab->next)
+        slab->next->prev = slab->prev;
+    slab->prev = slab->next = NULL;
+}
+
+/**
+ * give the pages of an unused slab back to system, keep it for reuse
+ */
+static void
+mempool_slab_release(MemPool *mp, MemSlab *slab)
+{
+    MemItem *mi = &mp->freemem[slab->item];
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    mempool_slab_unlink(mi, slab);
+    mi->total       -= slab->carved;
+    mi->block_count -= slab->carved;
+    mp->blocks      -= slab->carved;
+
+    // a slab in a huge page arena is kept, giving back part of it splits the huge page
+    if (mp->hugepage == MEMLINK_HUGEPAGE_NO) {
+        madvise((char*)slab + pagesize, MEMPOOL_SLAB_SIZE - pagesize, MADV_DONTNEED);
+        mp->mem -= MEMPOOL_SLAB_SIZE - pagesize;
+    }
+    slab->item = -1;
+    slab->next = mp->empty;
+    mp->empty  = slab;
+    mp->empty_slabs++;
+}
+
 DataBlock*
 mempool_get(MemPool *mp, int blocksize)
 {
     int i;
     DataBlock *dbk = NULL, *dbn;
-    int find = 0;
 
     //DNOTE("used: %d, blocsize: %d\n", mp->used, blocksize);
-    for (i = 0; i < mp->used; i++) {
-        if (mp->freemem[i].memsize == blocksize) {
-            dbk = mp->freemem[i].data;
-            find = 1;
-            break;
+    i = mempool_item(mp, blocksize);
+    if (i < 0)
+        return NULL;
+    MemItem *mi = &mp->freemem[i];
+
+    if (blocksize <= MEMPOOL_SLAB_BLOCK_MAX) {
+        int step = SLAB_STEP(blocksize);
+        MemSlab *slab = mi->slabs;
+        if (NULL == slab) {
+            slab = mempool_slab_new(mp, i);
+            if (NULL == slab)
+                return NULL;
         }
+        if (slab->data) {
+            dbk = slab->data;
+            slab->data = dbk->next;
+            mp->blocks--;
+            mi->block_count -= 1;
+        }else{
+            dbk = (DataBlock*)slab->carve;
+            slab->carve += step;
+            slab->carved++;
+            mi->total += 1;
+        }
+        slab->used++;
+        if (mempool_slab_full(slab, step))
+            mempool_slab_unlink(mi, slab);
+        memset(dbk, 0, blocksize);
+        mp->blockmem += blocksize;
+        return dbk;
     }
 
+    dbk = mi->data;
     if (NULL == dbk) {
         dbk = (DataBlock*)zz_malloc(blocksize);
         if (NULL == dbk) {
@@ -63,29 +284,19 @@ mempool_get(MemPool *mp, int blocksize)
             return NULL;
         }
         memset(dbk, 0x0, blocksize);
-        if (find != 1) {
-            if (i < mp->size) {
-                mp->freemem[i].memsize = blocksize;
-                mp->used += 1;
-            } else {
-                if (mempool_expand(mp) == -1)
-                    return NULL; 
-
-                mp->freemem[mp->used].memsize = blocksize;
-                mp->used += 1;
-                i = mp->used;
-            }
-        }
-        mp->freemem[i].total += 1;
+        mi->total += 1;
+        mp->mem   += blocksize;
+        mp->blockmem += blocksize;
         return dbk;
     }
 
     mp->blocks--;
-    mp->freemem[i].block_count -= 1;
+    mi->block_count -= 1;
     dbn = dbk->next;
-    mp->freemem[i].data = dbn; 
+    mi->data = dbn; 
     //memset(dbk, 0, sizeof(DataBlock) + g_cf->block_data_count * blocksize);
     memset(dbk, 0, blocksize);
+    mp->blockmem += blocksize;
     //mp->freemem[i].ht_use = mp->freemem[i].ht_use + 1;
     
     return dbk;
@@ -105,36 +316,48 @@ mempool_put(MemPool *mp, DataBlock *dbk, int blocksize)
 {
     int i;
 
-    zz_check(dbk);
+    i = mempool_item(mp, blocksize);
+    if (i < 0)
+        return -2;
 
     dbk->data_count = 0;
     dbk->prev = NULL;
-    for (i = 0; i < mp->used; i++) {
-        if (mp->freemem[i].memsize == blocksize) {
-            dbk->next = mp->freemem[i].data;
-            mp->freemem[i].data = dbk; 
-            mp->blocks++;
-            mp->freemem[i].block_count += 1;
-            return 0;
+    if (blocksize <= MEMPOOL_SLAB_BLOCK_MAX) {
+        MemSlab *slab = SLAB_OF(dbk);
+        if (slab->item != i) {
+            if (slab->item < 0) {
+                DERROR("put block to released slab: %p\n", dbk);
+                return -2;
+            }
+            DERROR("slab block size error: %d, %d\n", blocksize, mp->freemem[slab->item].memsize);
+            i = slab->item;
         }
-    }
-    dbk->next = NULL;
-    if (i < mp->size) {
-        mp->freemem[i].data = dbk;
-        mp->freemem[i].memsize = blocksize;
-        mp->used += 1;
-    }else{
-        if (mempool_expand(mp) == -1)
-            return -2;
-        
-        mp->freemem[mp->used].memsize = blocksize;
-        mp->freemem[mp->used].data = dbk;
+        MemItem *mi = &mp->freemem[i];
+        int step = SLAB_STEP(mi->memsize);
 
-        mp->used += 1;
-    
-        zz_check(dbk);
+        if (mempool_slab_full(slab, step)) {
+            slab->prev = NULL;
+            slab->next = mi->slabs;
+            if (slab->next)
+                slab->next->prev = slab;
+            mi->slabs = slab;
+        }
+        dbk->next  = slab->data;
+        slab->data = dbk;
+        slab->used--;
+        mp->blockmem -= blocksize;
+        mp->blocks++;
+        mi->block_count += 1;
+        // keep one unused slab of each size against get/put thrash
+        if (slab->used == 0 && (mi->slabs != slab || slab->next != NULL))
+            mempool_slab_release(mp, slab);
+        return 0;
     }
 
+    zz_check(dbk);
+    mp->blockmem -= blocksize;
+    dbk->next = mp->freemem[i].data;
+    mp->freemem[i].data = dbk; 
     mp->blocks++;
     mp->freemem[i].block_count += 1;
     return 0;
@@ -182,8 +405,20 @@ mempool_free(MemPool *mp, int blocksize)
 
                 zz_free(tmp);
                 mp->blocks--;
+                mp->freemem[i].block_count -= 1;
+                mp->freemem[i].total -= 1;
+                mp->mem -= blocksize;
             }
             mp->freemem[i].data = NULL;
+
+            MemSlab *slab = mp->freemem[i].slabs;
+            MemSlab *next;
+            while (slab) {
+                next = slab->next;
+                if (slab->used == 0)
+                    mempool_slab_release(mp, slab);
+                slab = next;
+            }
         }
     }
 }
@@ -210,10 +445,31 @@ mempool_destroy(MemPool *mp)
         mp->freemem[i].data = NULL;
     }
 
+    MemSlab *slab = mp->slablist;
+    MemSlab *next;
+    while (slab) {
+        next = slab->link;
+        munmap(slab, MEMPOOL_SLAB_SIZE);
+        slab = next;
+    }
+
+    zz_free(mp->sizemap);
     zz_free(mp->freemem);
     zz_free(mp);
 }
 
+/**
+ * KB of slab memory in huge page arenas, counted when an arena is mapped.
+ * a thp arena is counted after madvise, the kernel may still split it
+ */
+unsigned int
+mempool_hugepage_mem(MemPool *mp)
+{
+    if (NULL == mp)
+        return 0;
+    return mp->hugemem / 1024;
+}
+
 /**
  * @}
  */
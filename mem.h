@@ -2,8 +2,20 @@
 #define MEMLINK_MEM_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 #define MEMLINK_MEM_NUM     100
+// DataBlock不大于MEMPOOL_SLAB_BLOCK_MAX时从slab中分配, DEBUGMEM下都用zz_malloc
+#define MEMPOOL_SLAB_SIZE       (128 * 1024)
+// 使用大页时slab从MEMPOOL_ARENA_SIZE对齐的区域中分配
+#define MEMPOOL_ARENA_SIZE      (2 * 1024 * 1024)
+// 表的DataBlock大小不超过MEMPOOL_BLOCK_MAX字节, 不会落到不还给系统的空闲链表中
+#define MEMPOOL_BLOCK_MAX       (MEMPOOL_SLAB_SIZE / 8)
+#ifdef DEBUGMEM
+#define MEMPOOL_SLAB_BLOCK_MAX  0
+#else
+#define MEMPOOL_SLAB_BLOCK_MAX  MEMPOOL_BLOCK_MAX
+#endif
 
 #if defined(__APPLE__) || defined(__FreeBSD__)
 #define fopen64 fopen
@@ -14,6 +26,14 @@ typedef struct _data_block
 	unsigned short		data_count; // data count in one block
     unsigned short      visible_count; // visible item count
     unsigned short      tagdel_count;  // tag delete item count, invisible
+    unsigned short      index_slot;    // item of HashNode block index + 1, 0 means none
+    union {
+        struct {
+            unsigned int    attr_or;   // OR of the first 4 attr bytes of all items
+            unsigned int    attr_and;  // AND of the first 4 attr bytes of all items
+        };
+        uint64_t            attr_sum;  // both above, changed by one compare and swap
+    };
     struct _data_block  *prev;
     struct _data_block  *next;
     char                data[0];
@@ -27,12 +47,27 @@ typedef struct _data_block_one
     char                data[0];
 }DataBlockOne;
 
+// MEMPOOL_SLAB_SIZE aligned memory, DataBlocks of one size are carved from it
+typedef struct _mem_slab
+{
+    struct _mem_slab *prev;
+    struct _mem_slab *next;
+    struct _mem_slab *link; // all slabs mapped
+    DataBlock   *data;  // free blocks in this slab
+    char        *carve; // next block never used
+    char        *end;
+    unsigned int used;  // blocks in use
+    unsigned int carved;
+    int         item;   // index of MemItem
+}MemSlab;
+
 typedef struct _mem_item
 {
     int          memsize;
-	unsigned int block_count;
+	unsigned int block_count; // free blocks
     unsigned int total;
-    DataBlock    *data;
+    DataBlock    *data; // free blocks not in slab
+    MemSlab      *slabs; // slabs with free space
 }MemItem;
 
 typedef struct _mempool
@@ -41,6 +76,17 @@ typedef struct _mempool
     int         size;  // freemem size
     int         used; // freemem used size
 	int			blocks;
+    unsigned short *sizemap; // blocksize => index of MemItem + 1, for slab blocks
+    MemSlab     *empty; // released slabs, pages given back to system
+    MemSlab     *slablist; // all slabs mapped
+    unsigned int slabs;
+    unsigned int empty_slabs;
+    long long   mem;      // bytes taken from system, in use or free
+    long long   blockmem; // bytes of blocks in use
+    int         hugepage; // MEMLINK_HUGEPAGE_*
+    char        *arena;   // huge page arena slabs are carved from
+    char        *arena_end;
+    long long   hugemem;  // bytes of arenas mapped from hugetlb or advised MADV_HUGEPAGE
 }MemPool;
 
 //extern MemPool  *g_mpool;
@@ -53,5 +99,6 @@ int         mempool_put2(MemPool *mp, DataBlock *dbk, int datalen);
 int         mempool_expand(MemPool *mp);
 void        mempool_free(MemPool *mp, int blocksize);
 void        mempool_destroy(MemPool *mp);
+unsigned int mempool_hugepage_mem(MemPool *mp);
 
 #endif
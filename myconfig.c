@@ -78,6 +78,236 @@ conf_parse_vote_ipport(void *f, char *value, int i)
     return TRUE; 
 }
 
+/**
+ * evict_table = name:lru, name:lfu, *:lru
+ */
+static int
+conf_parse_evict_table(void *f, char *value, int i)
+{
+    MyConfig *cf = (MyConfig*)f;
+
+    if (i >= EVICT_TABLE_MAX) {
+        DERROR("evict_table must not more than %d\n", EVICT_TABLE_MAX);
+        return FALSE;
+    }
+    char *sp = strchr(value, ':');
+    if (NULL == sp) {
+        DERROR("evict_table must set as table:lru or table:lfu\n");
+        return FALSE;
+    }
+    *sp = '\0';
+    char *v1 = value;
+    char *v2 = sp + 1;
+
+    while (isblank(*v1)) v1++;
+    while (isblank(*v2)) v2++;
+
+    EvictTable *et = &cf->evict_table[i];
+    if (strncmp(v2, "lru", 3) == 0) {
+        et->mode = MEMLINK_EVICT_LRU;
+    }else if (strncmp(v2, "lfu", 3) == 0) {
+        et->mode = MEMLINK_EVICT_LFU;
+    }else{
+        DERROR("evict_table mode error: %s\n", v2);
+        return FALSE;
+    }
+    snprintf(et->table, HASHTABLE_TABLE_NAME_SIZE, "%s", v1);
+    sp = et->table + strlen(et->table);
+    while (sp > et->table && isblank(*(sp - 1))) {
+        *--sp = '\0';
+    }
+    cf->evict_table_count = i + 1;
+
+    return TRUE;
+}
+
+/**
+ * eviction mode of a table, a table named in evict_table overrides *
+ */
+int
+myconfig_evict_mode(char *table)
+{
+    int mode = MEMLINK_EVICT_NONE;
+    int i;
+
+    for (i = 0; i < g_cf->evict_table_count; i++) {
+        EvictTable *et = &g_cf->evict_table[i];
+        if (strcmp(et->table, table) == 0) {
+            return et->mode;
+        }
+        if (strcmp(et->table, "*") == 0) {
+            mode = et->mode;
+        }
+    }
+    return mode;
+}
+
+/**
+ * the i-th name of a table list option, names[i] = value without blanks
+ */
+static int
+conf_table_name(char names[][HASHTABLE_TABLE_NAME_SIZE], int *count, int max,
+                char *option, char *value, int i)
+{
+    if (i >= max) {
+        DERROR("%s must not more than %d\n", option, max);
+        return FALSE;
+    }
+    while (isblank(*value)) value++;
+
+    char *name = names[i];
+    snprintf(name, HASHTABLE_TABLE_NAME_SIZE, "%s", value);
+    char *sp = name + strlen(name);
+    while (sp > name && isblank(*(sp - 1))) {
+        *--sp = '\0';
+    }
+    if (name[0] == 0) {
+        DERROR("%s name error\n", option);
+        return FALSE;
+    }
+    *count = i + 1;
+
+    return TRUE;
+}
+
+static int
+myconfig_table_listed(char names[][HASHTABLE_TABLE_NAME_SIZE], int count, char *table)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (strcmp(names[i], table) == 0 || strcmp(names[i], "*") == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * cold_table = name, name, * means all tables
+ */
+static int
+conf_parse_cold_table(void *f, char *value, int i)
+{
+    MyConfig *cf = (MyConfig*)f;
+
+    return conf_table_name(cf->cold_table, &cf->cold_table_count, COLD_TABLE_MAX,
+                           "cold_table", value, i);
+}
+
+/**
+ * intern_table = name, name, * means all tables
+ */
+static int
+conf_parse_intern_table(void *f, char *value, int i)
+{
+    MyConfig *cf = (MyConfig*)f;
+
+    return conf_table_name(cf->intern_table, &cf->intern_table_count, INTERN_TABLE_MAX,
+                           "intern_table", value, i);
+}
+
+/**
+ * compress_table = name, name, * means all tables
+ */
+static int
+conf_parse_compress_table(void *f, char *value, int i)
+{
+    MyConfig *cf = (MyConfig*)f;
+
+    return conf_table_name(cf->compress_table, &cf->compress_table_count, COMPRESS_TABLE_MAX,
+                           "compress_table", value, i);
+}
+
+/**
+ * table uses cold store or not
+ */
+int
+myconfig_cold_table(char *table)
+{
+    return myconfig_table_listed(g_cf->cold_table, g_cf->cold_table_count, table);
+}
+
+/**
+ * items of idle keys in the table are compressed or not
+ */
+int
+myconfig_compress_table(char *table)
+{
+    return myconfig_table_listed(g_cf->compress_table, g_cf->compress_table_count, table);
+}
+
+/**
+ * equal values of the table are stored once or not
+ */
+int
+myconfig_intern_table(char *table)
+{
+    return myconfig_table_listed(g_cf->intern_table, g_cf->intern_table_count, table);
+}
+
+/**
+ * block_table = name:200, *:100
+ */
+static int
+conf_parse_block_table(void *f, char *value, int i)
+{
+    MyConfig *cf = (MyConfig*)f;
+
+    if (i >= BLOCK_TABLE_MAX) {
+        DERROR("block_table must not more than %d\n", BLOCK_TABLE_MAX);
+        return FALSE;
+    }
+    char *sp = strchr(value, ':');
+    if (NULL == sp) {
+        DERROR("block_table must set as table:count\n");
+        return FALSE;
+    }
+    *sp = '\0';
+    char *v1 = value;
+    char *v2 = sp + 1;
+
+    while (isblank(*v1)) v1++;
+    while (isblank(*v2)) v2++;
+
+    BlockTable *bt = &cf->block_table[i];
+    bt->count = atoi(v2);
+    if (bt->count <= 0 || bt->count > MEMLINK_BLOCK_COUNT_MAX) {
+        DERROR("block_table count must in 1-%d: %s\n", MEMLINK_BLOCK_COUNT_MAX, v2);
+        return FALSE;
+    }
+    snprintf(bt->table, HASHTABLE_TABLE_NAME_SIZE, "%s", v1);
+    sp = bt->table + strlen(bt->table);
+    while (sp > bt->table && isblank(*(sp - 1))) {
+        *--sp = '\0';
+    }
+    cf->block_table_count = i + 1;
+
+    return TRUE;
+}
+
+/**
+ * max DataBlock capacity of a table, 0 means the max of block_data_count.
+ * a table named in block_table overrides *
+ */
+int
+myconfig_block_max(char *table)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < g_cf->block_table_count; i++) {
+        BlockTable *bt = &g_cf->block_table[i];
+        if (strcmp(bt->table, table) == 0) {
+            return bt->count;
+        }
+        if (strcmp(bt->table, "*") == 0) {
+            count = bt->count;
+        }
+    }
+    return count;
+}
+
 int
 myconfig_print(MyConfig *conf)
 {
@@ -91,9 +321,15 @@ myconfig_print(MyConfig *conf)
     DINFO("block_data_count_items: %d\n", conf->block_data_count_items);
     DINFO("dump_interval: %d\n", conf->dump_interval);
     DINFO("block_data_reduce: %f\n", conf->block_data_reduce);
+    for (i = 0; i < conf->block_table_count; i++) {
+        DINFO("block_table[%d]: %s:%d\n", i, conf->block_table[i].table, conf->block_table[i].count);
+    }
     DINFO("block_clean_cond: %f\n", conf->block_clean_cond);
     DINFO("block_clean_start: %d\n", conf->block_clean_start);
     DINFO("block_clean_num: %d\n", conf->block_clean_num);
+    DINFO("block_clean_time: %d\n", conf->block_clean_time);
+    DINFO("block_layout: %d\n", conf->block_layout);
+    DINFO("block_hugepage: %d\n", conf->block_hugepage);
     DINFO("host: %s\n", conf->host);
     DINFO("read_port: %d\n", conf->read_port);
     DINFO("write_port: %d\n", conf->write_port);
@@ -111,12 +347,29 @@ myconfig_print(MyConfig *conf)
     DINFO("heartbeat_timeout: %d\n", conf->heartbeat_timeout);
     DINFO("backup_timeout: %d\n", conf->backup_timeout);
     DINFO("thread_num: %d\n", conf->thread_num);
+    DINFO("read_reuseport: %d\n", conf->read_reuseport);
+    DINFO("exec_thread_num: %d\n", conf->exec_thread_num);
+    DINFO("exec_min_items: %d\n", conf->exec_min_items);
     DINFO("max_conn: %d\n", conf->max_conn);
     DINFO("max_read_conn: %d\n", conf->max_read_conn);
     DINFO("max_write_conn: %d\n", conf->max_write_conn);
     DINFO("max_sync_conn: %d\n", conf->max_sync_conn);
     DINFO("max_core: %d\n", conf->max_core);
     DINFO("max_mem: %lld\n", conf->max_mem);
+    for (i = 0; i < conf->evict_table_count; i++) {
+        DINFO("evict_table[%d]: %s:%d\n", i, conf->evict_table[i].table, conf->evict_table[i].mode);
+    }
+    for (i = 0; i < conf->cold_table_count; i++) {
+        DINFO("cold_table[%d]: %s\n", i, conf->cold_table[i]);
+    }
+    DINFO("cold_time: %d\n", conf->cold_time);
+    for (i = 0; i < conf->compress_table_count; i++) {
+        DINFO("compress_table[%d]: %s\n", i, conf->compress_table[i]);
+    }
+    DINFO("compress_time: %d\n", conf->compress_time);
+    for (i = 0; i < conf->intern_table_count; i++) {
+        DINFO("intern_table[%d]: %s\n", i, conf->intern_table[i]);
+    }
     DINFO("daemon: %d\n", conf->is_daemon);
     DINFO("sync_master: %s:%d\n", conf->master_sync_host, conf->master_sync_port);
     DINFO("vote_server: %s:%d\n", conf->vote_host, conf->vote_port);
@@ -152,6 +405,15 @@ myconfig_parser_load(MyConfig *cf, char *filepath, int loadflag)
     confpairs_add(roles, "backup", ROLE_BACKUP);
     confpairs_add(roles, "slave", ROLE_SLAVE);
 
+    ConfPairs   *layouts = confpairs_create(2);
+    confpairs_add(layouts, "row", MEMLINK_LAYOUT_ROW);
+    confpairs_add(layouts, "column", MEMLINK_LAYOUT_COLUMN);
+
+    ConfPairs   *hugepages = confpairs_create(3);
+    confpairs_add(hugepages, "no", MEMLINK_HUGEPAGE_NO);
+    confpairs_add(hugepages, "thp", MEMLINK_HUGEPAGE_THP);
+    confpairs_add(hugepages, "hugetlb", MEMLINK_HUGEPAGE_HUGETLB);
+
     ConfPairs   *syncmods = confpairs_create(2);
     confpairs_add(syncmods, "master-slave", MODE_MASTER_SLAVE);
     confpairs_add(syncmods, "master-backup", MODE_MASTER_BACKUP);
@@ -160,11 +422,15 @@ myconfig_parser_load(MyConfig *cf, char *filepath, int loadflag)
         confparser_add_param(cp, cf->block_data_count, "block_data_count", CONF_INT, 
                     BLOCK_DATA_COUNT_MAX, NULL);
         confparser_add_param(cp, &cf->block_data_reduce, "block_data_reduce", CONF_FLOAT, 0, NULL);
+        confparser_add_param(cp, cf, "block_table", CONF_USER, BLOCK_TABLE_MAX, conf_parse_block_table);
         confparser_add_param(cp, &cf->dump_interval, "dump_interval", CONF_INT, 0, NULL);
         confparser_add_param(cp, &cf->sync_check_interval, "sync_check_interval", CONF_INT, 0, NULL);
         confparser_add_param(cp, &cf->block_clean_cond, "block_clean_cond", CONF_FLOAT, 0, NULL);
         confparser_add_param(cp, &cf->block_clean_start, "block_clean_start", CONF_INT, 0, NULL);
         confparser_add_param(cp, &cf->block_clean_num, "block_clean_num", CONF_INT, 0, NULL);
+        confparser_add_param(cp, &cf->block_clean_time, "block_clean_time", CONF_INT, 0, NULL);
+        confparser_add_param(cp, &cf->block_layout, "block_layout", CONF_ENUM, 0, layouts);
+        confparser_add_param(cp, &cf->block_hugepage, "block_hugepage", CONF_ENUM, 0, hugepages);
         confparser_add_param(cp, cf->host, "host", CONF_STRING, 0, NULL);
         confparser_add_param(cp, &cf->read_port, "read_port", CONF_INT, 0, NULL);
         confparser_add_param(cp, &cf->write_port, "write_port", CONF_INT, 0, NULL);
@@ -179,6 +445,9 @@ myconfig_parser_load(MyConfig *cf, char *filepath, int loadflag)
         confparser_add_param(cp, &cf->log_rotate_type, "log_rotate_type", CONF_ENUM, 0, rotatetypes);
         confparser_add_param(cp, &cf->timeout, "timeout", CONF_INT, 0, NULL);
         confparser_add_param(cp, &cf->thread_num, "thread_num", CONF_INT, 0, NULL);
+        confparser_add_param(cp, &cf->read_reuseport, "read_reuseport", CONF_BOOL, 0, NULL);
+        confparser_add_param(cp, &cf->exec_thread_num, "exec_thread_num", CONF_INT, 0, NULL);
+        confparser_add_param(cp, &cf->exec_min_items, "exec_min_items", CONF_INT, 0, NULL);
         confparser_add_param(cp, &cf->write_binlog, "write_binlog", CONF_BOOL, 0, NULL);
         confparser_add_param(cp, &cf->max_conn, "max_conn", CONF_INT, 0, NULL);
         confparser_add_param(cp, &cf->max_read_conn, "max_read_conn", CONF_INT, 0, NULL);
@@ -186,6 +455,12 @@ myconfig_parser_load(MyConfig *cf, char *filepath, int loadflag)
         confparser_add_param(cp, &cf->max_sync_conn, "max_sync_conn", CONF_INT, 0, NULL);
         confparser_add_param(cp, &cf->max_core, "max_core", CONF_INT, 0, NULL);
         confparser_add_param(cp, &cf->max_mem, "max_mem", CONF_INT, 0, NULL);
+        confparser_add_param(cp, cf, "evict_table", CONF_USER, EVICT_TABLE_MAX, conf_parse_evict_table);
+        confparser_add_param(cp, cf, "cold_table", CONF_USER, COLD_TABLE_MAX, conf_parse_cold_table);
+        confparser_add_param(cp, &cf->cold_time, "cold_time", CONF_INT, 0, NULL);
+        confparser_add_param(cp, cf, "compress_table", CONF_USER, COMPRESS_TABLE_MAX, conf_parse_compress_table);
+        confparser_add_param(cp, &cf->compress_time, "compress_time", CONF_INT, 0, NULL);
+        confparser_add_param(cp, cf, "intern_table", CONF_USER, INTERN_TABLE_MAX, conf_parse_intern_table);
         confparser_add_param(cp, &cf->is_daemon, "daemon", CONF_BOOL, 0, NULL);
         confparser_add_param(cp, &cf->role, "role", CONF_ENUM, 0, roles);
         confparser_add_param(cp, cf, "sync_master", CONF_USER, 0, conf_parse_sync_ipport);
@@ -229,6 +504,8 @@ myconfig_parse_load_over:
     confpairs_destroy(rotatetypes);
     confpairs_destroy(roles);
     confpairs_destroy(syncmods);
+    confpairs_destroy(layouts);
+    confpairs_destroy(hugepages);
     confparser_destroy(cp);
 
     return retcode;
@@ -257,6 +534,7 @@ myconfig_create(char *filename)
     mcf->block_clean_cond  = 0.5;
     mcf->block_clean_start = 3;
     mcf->block_clean_num   = 100;
+    mcf->block_clean_time  = 2000;
     mcf->dump_interval = 60 * 60; // 1 hour
     mcf->sync_check_interval = 60;
     mcf->read_port  = 11001;
@@ -267,8 +545,11 @@ myconfig_create(char *filename)
     mcf->log_time   = 1440 * 60; // 24h
     mcf->log_count  = 10;
     mcf->timeout    = 30;
+    mcf->exec_min_items = 10000;
     mcf->max_conn   = 1000;
     mcf->max_mem    = 0;
+    mcf->cold_time  = 86400;
+    mcf->compress_time = 3600;
     mcf->sync_mode  = MODE_MASTER_SLAVE;
     mcf->heartbeat_timeout = 5;
     mcf->dumpfile_num_max = 20;
@@ -559,6 +840,18 @@ myconfig_change()
     snprintf(line, 512, "block_data_reduce = %0.1f\n", g_cf->block_data_reduce);
     ffwrite(line, strlen(line), 1, fp);
 
+    if (g_cf->block_table_count > 0) {
+        int i, len = snprintf(line, 512, "block_table = ");
+        for (i = 0; i < g_cf->block_table_count && len < 512; i++) {
+            len += snprintf(line + len, 512 - len, "%s%s:%d", i > 0 ? ", " : "",
+                    g_cf->block_table[i].table, g_cf->block_table[i].count);
+        }
+        if (len < 511) {
+            strcat(line, "\n");
+            ffwrite(line, strlen(line), 1, fp);
+        }
+    }
+
     snprintf(line, 512, "dump_interval = %d\n", g_cf->dump_interval);
     ffwrite(line, strlen(line), 1, fp);
 
@@ -571,6 +864,23 @@ myconfig_change()
     snprintf(line, 512, "block_clean_num = %d\n", g_cf->block_clean_num);
     ffwrite(line, strlen(line), 1, fp);
 
+    snprintf(line, 512, "block_clean_time = %d\n", g_cf->block_clean_time);
+    ffwrite(line, strlen(line), 1, fp);
+
+    if (g_cf->block_layout == MEMLINK_LAYOUT_COLUMN)
+        snprintf(line, 512, "block_layout = %s\n", "column");
+    else
+        snprintf(line, 512, "block_layout = %s\n", "row");
+    ffwrite(line, strlen(line), 1, fp);
+
+    if (g_cf->block_hugepage == MEMLINK_HUGEPAGE_THP)
+        snprintf(line, 512, "block_hugepage = %s\n", "thp");
+    else if (g_cf->block_hugepage == MEMLINK_HUGEPAGE_HUGETLB)
+        snprintf(line, 512, "block_hugepage = %s\n", "hugetlb");
+    else
+        snprintf(line, 512, "block_hugepage = %s\n", "no");
+    ffwrite(line, strlen(line), 1, fp);
+
     snprintf(line, 512, "read_port = %d\n", g_cf->read_port);
     ffwrite(line, strlen(line), 1, fp);
 
@@ -594,6 +904,15 @@ myconfig_change()
     
     snprintf(line, 512, "thread_num = %d\n", g_cf->thread_num);
     ffwrite(line, strlen(line), 1, fp);
+
+    snprintf(line, 512, "read_reuseport = %s\n", g_cf->read_reuseport ? "yes" : "no");
+    ffwrite(line, strlen(line), 1, fp);
+
+    snprintf(line, 512, "exec_thread_num = %d\n", g_cf->exec_thread_num);
+    ffwrite(line, strlen(line), 1, fp);
+
+    snprintf(line, 512, "exec_min_items = %d\n", g_cf->exec_min_items);
+    ffwrite(line, strlen(line), 1, fp);
     
     if (g_cf->write_binlog == 1)
         snprintf(line, 512, "write_binlog = %s\n", "yes");
@@ -613,6 +932,58 @@ myconfig_change()
     snprintf(line, 512, "max_core = %d\n", g_cf->max_core);
     ffwrite(line, strlen(line), 1, fp);
 
+    if (g_cf->evict_table_count > 0) {
+        int i, len = snprintf(line, 512, "evict_table = ");
+        for (i = 0; i < g_cf->evict_table_count && len < 512; i++) {
+            len += snprintf(line + len, 512 - len, "%s%s:%s", i > 0 ? ", " : "",
+                    g_cf->evict_table[i].table,
+                    g_cf->evict_table[i].mode == MEMLINK_EVICT_LFU ? "lfu" : "lru");
+        }
+        if (len < 511) {
+            strcat(line, "\n");
+            ffwrite(line, strlen(line), 1, fp);
+        }
+    }
+
+    if (g_cf->cold_table_count > 0) {
+        int i, len = snprintf(line, 512, "cold_table = ");
+        for (i = 0; i < g_cf->cold_table_count && len < 512; i++) {
+            len += snprintf(line + len, 512 - len, "%s%s", i > 0 ? ", " : "", g_cf->cold_table[i]);
+        }
+        if (len < 511) {
+            strcat(line, "\n");
+            ffwrite(line, strlen(line), 1, fp);
+        }
+    }
+
+    snprintf(line, 512, "cold_time = %d\n", g_cf->cold_time);
+    ffwrite(line, strlen(line), 1, fp);
+
+    if (g_cf->compress_table_count > 0) {
+        int i, len = snprintf(line, 512, "compress_table = ");
+        for (i = 0; i < g_cf->compress_table_count && len < 512; i++) {
+            len += snprintf(line + len, 512 - len, "%s%s", i > 0 ? ", " : "", g_cf->compress_table[i]);
+        }
+        if (len < 511) {
+            strcat(line, "\n");
+            ffwrite(line, strlen(line), 1, fp);
+        }
+    }
+
+    snprintf(line, 512, "compress_time = %d\n", g_cf->compress_time);
+    ffwrite(line, strlen(line), 1, fp);
+
+    if (g_cf->intern_table_count > 0) {
+        int i, len = snprintf(line, 512, "intern_table = ");
+        for (i = 0; i < g_cf->intern_table_count && len < 512; i++) {
+            len += snprintf(line + len, 512 - len, "%s%s", i > 0 ? ", " : "", g_cf->intern_table[i]);
+        }
+        if (len < 511) {
+            strcat(line, "\n");
+            ffwrite(line, strlen(line), 1, fp);
+        }
+    }
+
     if (g_cf->is_daemon == 1)
         snprintf(line, 512, "is_daemon = %s\n", "yes");
     else
@@ -6,23 +6,48 @@
 #include <string.h>
 #include <ctype.h>
 #include <pthread.h>
+#include "common.h"
 
 // TODO is there a pre-defined const for this?
 #define IP_ADDR_MAX_LEN         16
 #define BLOCK_DATA_COUNT_MAX    16
+#define EVICT_TABLE_MAX         16
+#define COLD_TABLE_MAX          16
+#define INTERN_TABLE_MAX        16
+#define COMPRESS_TABLE_MAX      16
+#define BLOCK_TABLE_MAX         16
 
 #define CONF_LOAD_ALL		1
 #define CONF_LOAD_DYNAMIC	2
 
+// key eviction of one table when max_mem is reached
+typedef struct _myconfig_evict
+{
+    char    table[HASHTABLE_TABLE_NAME_SIZE]; // table name, * means all tables
+    int     mode;  // MEMLINK_EVICT_LRU/LFU
+}EvictTable;
+
+// max DataBlock capacity of one table
+typedef struct _myconfig_block
+{
+    char    table[HASHTABLE_TABLE_NAME_SIZE]; // table name, * means all tables
+    int     count; // max items in one DataBlock
+}BlockTable;
+
 typedef struct _myconfig
 {
     unsigned int block_data_count[BLOCK_DATA_COUNT_MAX];
     int          block_data_count_items;
 	float		 block_data_reduce;
+    BlockTable   block_table[BLOCK_TABLE_MAX];        // tables with their own max DataBlock capacity
+    int          block_table_count;
     unsigned int dump_interval;                       // in minutes
     float        block_clean_cond;
     int          block_clean_start;
     int          block_clean_num;
+    int          block_clean_time;                    // max us of one background clean step
+    int          block_layout;                        // item layout of new table: row/column
+    int          block_hugepage;                      // huge pages for DataBlock slabs: no/thp/hugetlb
 	char		 host[IP_ADDR_MAX_LEN];
     int          read_port;
     int          write_port;
@@ -41,12 +66,25 @@ typedef struct _myconfig
     int          heartbeat_timeout;
     int          backup_timeout;
     int          thread_num;
+    int          read_reuseport;                      // each read thread accepts on its own SO_REUSEPORT socket
+    int          exec_thread_num;                     // threads running heavy read commands, 0 for none
+    int          exec_min_items;                      // items a read command visits to be heavy
     int          max_conn;                            // max connection
     int          max_read_conn;
     int          max_write_conn;
 	int		     max_sync_conn;
     int          max_core;                            // maximize core file limit
 	long long	 max_mem;	// maximize memory used
+    EvictTable   evict_table[EVICT_TABLE_MAX];        // tables evict keys when max_mem reached
+    int          evict_table_count;
+    char         cold_table[COLD_TABLE_MAX][HASHTABLE_TABLE_NAME_SIZE]; // tables use cold store, * means all
+    int          cold_table_count;
+    int          cold_time;                           // seconds without access before key moved to cold store
+    char         compress_table[COMPRESS_TABLE_MAX][HASHTABLE_TABLE_NAME_SIZE]; // tables compress items of idle keys
+    int          compress_table_count;
+    int          compress_time;                       // seconds without access before items of key compressed
+    char         intern_table[INTERN_TABLE_MAX][HASHTABLE_TABLE_NAME_SIZE]; // vstring tables store equal values once
+    int          intern_table_count;
     int          is_daemon;                           // is run with daemon
     char         role;                                // 1 means master; 0 means slave
     char         master_sync_host[IP_ADDR_MAX_LEN];
@@ -65,6 +103,11 @@ extern MyConfig *g_cf;
 MyConfig*   myconfig_create(char *filename);
 int         myconfig_change();
 int			myconfig_print(MyConfig *cf);
+int			myconfig_evict_mode(char *table);
+int			myconfig_cold_table(char *table);
+int			myconfig_intern_table(char *table);
+int			myconfig_compress_table(char *table);
+int			myconfig_block_max(char *table);
 
 int			myconfig_parser_create(MyConfig *cf, char *filepath, int loadflag);
 
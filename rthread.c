@@ -9,7 +9,9 @@
 #include <string.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <errno.h>
 #include "logfile.h"
+#include "zzmalloc.h"
 #include "rthread.h"
 #include "hashtable.h"
 #include "serial.h"
@@ -21,14 +23,17 @@
 #include "runtime.h"
 
 /**
- * Execute the read command and send response.
+ * Execute the read command, the reply is left in conn->wbuf. Called by the
+ * read thread owning the connection or by an executor thread, between
+ * epoch_enter and epoch_exit.
  *
  * @param conn connection
  * @param data command data
  * @param datalen the length of data parameter
+ * @return command
  */
-int
-rdata_ready(Conn *conn, char *data, int datalen)
+static char
+rdata_exec(Conn *conn, char *data, int datalen)
 {
     //char keybuf[512] = {0}; 
     char tbname[256] = {0};
@@ -44,19 +49,7 @@ rdata_ready(Conn *conn, char *data, int datalen)
     uint8_t   attrnum;
     uint32_t  attrarray[HASHTABLE_ATTR_MAX_ITEM] = {0};
     int    frompos, len;
-    struct timeval start, end;
-    ThreadServer *st = (ThreadServer *)conn->thread;
-    RwConnInfo *conninfo = NULL; 
-
-    int i;
-    for (i = 0; i < g_cf->max_conn; i++) {
-        conninfo = &(st->rw_conn_info[i]);
-        if (conninfo->fd == conn->sock)
-            break;
-    }
-    if (conninfo) conninfo->cmd_count++;
 
-    gettimeofday(&start, NULL);
     memcpy(&cmd, data + sizeof(int), sizeof(char));
     char buf[256] = {0};
     DINFO("data ready cmd: %d, data: %s\n", cmd, formath(data, datalen, buf, 256));
@@ -64,7 +57,7 @@ rdata_ready(Conn *conn, char *data, int datalen)
     switch(cmd) {
         case CMD_PING: {
             ret = MEMLINK_OK;
-            goto rdata_ready_error;
+            goto rdata_exec_error;
             break;
         }
         case CMD_RANGE: {
@@ -77,19 +70,17 @@ rdata_ready(Conn *conn, char *data, int datalen)
             if (frompos < 0 || len <= 0) {
                 DERROR("from or len small than 0. from:%d, len:%d\n", frompos, len);
                 ret = MEMLINK_ERR_RANGE_SIZE;
-                goto rdata_ready_error;
+                goto rdata_exec_error;
             }
 
             ret = check_table_key(tbname, key);
             if (ret < 0) {
-                goto rdata_ready_error;
+                goto rdata_exec_error;
             }
             
             ret = hashtable_range(g_runtime->ht, tbname, key, kind, attrarray, attrnum, 
                                 frompos, len, conn); 
             DINFO("table_range return: %d\n", ret);
-            ret = conn_send_buffer(conn);
-            DINFO("send return: %d\n", ret);
 
             break;
         }
@@ -107,14 +98,12 @@ rdata_ready(Conn *conn, char *data, int datalen)
 
             ret = check_table_key(tbname, key);
             if (ret < 0) {
-                goto rdata_ready_error;
+                goto rdata_exec_error;
             }
 
             ret = hashtable_sortlist_range(g_runtime->ht, tbname, key, kind, 
                                 attrarray, attrnum, valmin, valmax, conn); 
             DINFO("table_range return: %d\n", ret);
-            ret = conn_send_buffer(conn);
-            DINFO("send return: %d\n", ret);
             break;
         }
         case CMD_STAT: {
@@ -125,7 +114,7 @@ rdata_ready(Conn *conn, char *data, int datalen)
 
             ret = check_table_key(tbname, key);
             if (ret < 0) {
-                goto rdata_ready_error;
+                goto rdata_exec_error;
             }
 
             ret = hashtable_stat(g_runtime->ht, tbname, key, &stat);
@@ -136,8 +125,7 @@ rdata_ready(Conn *conn, char *data, int datalen)
             retdata = (char*)&stat;
             retlen  = sizeof(HashTableStat);
 
-            ret = conn_send_buffer_reply(conn, ret, retdata, retlen);
-            DINFO("send return: %d\n", ret);
+            ret = conn_write_buffer_reply(conn, ret, retdata, retlen);
             break;
         }
         case CMD_STAT_SYS: {
@@ -150,8 +138,7 @@ rdata_ready(Conn *conn, char *data, int datalen)
             retdata = (char*)&stat;
             retlen  = sizeof(HashTableStatSys);
 
-            ret = conn_send_buffer_reply(conn, ret, retdata, retlen);
-            DINFO("send return: %d\n", ret);
+            ret = conn_write_buffer_reply(conn, ret, retdata, retlen);
             break;
         }
         case CMD_COUNT: {
@@ -164,7 +151,7 @@ rdata_ready(Conn *conn, char *data, int datalen)
         
             ret = check_table_key(tbname, key);
             if (ret < 0) {
-                goto rdata_ready_error;
+                goto rdata_exec_error;
             }
 
             int vcount = 0, mcount = 0;
@@ -177,8 +164,7 @@ rdata_ready(Conn *conn, char *data, int datalen)
             memcpy(retrec + sizeof(int), &mcount, sizeof(int));
             //retlen = sizeof(int) + sizeof(int);
 
-            ret = conn_send_buffer_reply(conn, ret, retrec, retlen);
-            DINFO("send return: %d\n", ret);
+            ret = conn_write_buffer_reply(conn, ret, retrec, retlen);
             break;
         }
         case CMD_SL_COUNT: {
@@ -194,7 +180,7 @@ rdata_ready(Conn *conn, char *data, int datalen)
 
             ret = check_table_key(tbname, key);
             if (ret < 0) {
-                goto rdata_ready_error;
+                goto rdata_exec_error;
             }
 
             int vcount = 0, mcount = 0;
@@ -207,21 +193,18 @@ rdata_ready(Conn *conn, char *data, int datalen)
             memcpy(retrec, &vcount, sizeof(int));
             memcpy(retrec + sizeof(int), &mcount, sizeof(int));
             //retlen = sizeof(int) + sizeof(int);
-            ret = conn_send_buffer_reply(conn, ret, retrec, retlen);
-            DINFO("send return: %d\n", ret);
+            ret = conn_write_buffer_reply(conn, ret, retrec, retlen);
             break;
         }
         case CMD_TABLES: {
             DINFO("<<< cmd TABLES >>>\n");
             retlen = hashtable_tables(g_runtime->ht, &retdata);
-            ret = conn_send_buffer_reply(conn, ret, retdata, retlen);
+            ret = conn_write_buffer_reply(conn, ret, retdata, retlen);
             break;
         }
         case CMD_READ_CONN_INFO: {
             DINFO("<<< cmd READ_CONN_INFO >>>\n");
             ret = info_read_conn(conn);
-            ret = conn_send_buffer(conn);
-            DINFO("send return: %d\n", ret);
             break;
 
         }
@@ -229,45 +212,246 @@ rdata_ready(Conn *conn, char *data, int datalen)
             DINFO("<<< cmd WRITE_CONN_INFO >>>\n");
             ret = info_write_conn(conn);
             DINFO("write_conn_info return: %d\n", ret);
-            ret = conn_send_buffer(conn);
-            DINFO("send return: %d\n", ret);
             break;
         }
         case CMD_SYNC_CONN_INFO: {
             DINFO("<<< cmd SYNC_CONN_INFO >>>\n");
             ret = info_sync_conn(conn);
             DINFO("sync_conn_info return: %d\n", ret);
-            ret = conn_send_buffer(conn);
-            DINFO("send return: %d\n", ret);
             break;
         }
         case CMD_CONFIG_INFO: {
             DINFO("<<< cmd CMD_CONFIG_INFO >>>\n");
             ret = info_sys_config(conn);
-            ret = conn_send_buffer(conn);
-            DINFO("send return: %d\n", ret);
             break;
         }
         default: {
             ret = MEMLINK_ERR_CLIENT_CMD;
-            ret = conn_send_buffer_reply(conn, ret, retdata, retlen);
-            DINFO("send return: %d\n", ret);
+            ret = conn_write_buffer_reply(conn, ret, retdata, retlen);
         }
     }
 
-    gettimeofday(&end, NULL);
-    DNOTE("%s:%d cmd:%d use %u us\n", conn->client_ip, conn->client_port, cmd, timediff(&start, &end));
+    return cmd;
 
-    return 0;
+rdata_exec_error:
+    conn_write_buffer_reply(conn, ret, NULL, 0);
+
+    return cmd;
+}
+
+/**
+ * items a range or sortlist command visits at most, by the requested len
+ * and the used items of the node. 0 for other commands. the node is only
+ * peeked, a cold one is not read back here but by the executor thread,
+ * so it costs at least exec_min_items
+ */
+static uint32_t
+rdata_cost(char *data)
+{
+    char        tbname[256] = {0};
+    char        key[256] = {0};
+    char        valmin[512], valmax[512];
+    uint8_t     kind, attrnum, vminlen, vmaxlen;
+    uint32_t    attrarray[HASHTABLE_ATTR_MAX_ITEM];
+    int         frompos, len = -1;
+    char        cmd;
+    Table       *tb;
+    HashNode    *node;
+
+    memcpy(&cmd, data + sizeof(int), sizeof(char));
+    switch (cmd) {
+        case CMD_RANGE:
+            cmd_range_unpack(data, tbname, key, &kind, &attrnum, attrarray, &frompos, &len);
+            if (frompos < 0 || len <= 0)
+                return 0;
+            break;
+        case CMD_SL_RANGE:
+            cmd_sortlist_range_unpack(data, tbname, key, &kind, &attrnum, attrarray, 
+                                      valmin, &vminlen, valmax, &vmaxlen);
+            break;
+        case CMD_SL_COUNT:
+            cmd_sortlist_count_unpack(data, tbname, key, &attrnum, attrarray, 
+                                      valmin, &vminlen, valmax, &vmaxlen);
+            break;
+        default:
+            return 0;
+    }
+    if (check_table_key(tbname, key) < 0)
+        return 0;
+
+    tb = hashtable_find_table(g_runtime->ht, tbname);
+    if (NULL == tb)
+        return 0;
+    node = table_peek(tb, key);
+    if (NULL == node)
+        return 0;
+    if (hashnode_is_cold(node))
+        return g_cf->exec_min_items > 0 ? g_cf->exec_min_items : 1;
+    if (len >= 0 && len < node->used)
+        return len;
+    return node->used;
+}
+
+/**
+ * Execute the read command and send response. A heavy command goes to the
+ * executor threads when there are, the reply is sent by thserver_exec_done.
+ *
+ * @param conn connection
+ * @param data command data
+ * @param datalen the length of data parameter
+ * @return CONN_READY_WAIT if the command is given to an executor thread
+ */
+int
+rdata_ready(Conn *conn, char *data, int datalen)
+{
+    char cmd;
+    int  ret = 0;
+    struct timeval start, end;
+    ThreadServer *st = (ThreadServer *)conn->thread;
+    ExecPool *ep = g_runtime->execpool;
 
-rdata_ready_error:
-    ret = conn_send_buffer_reply(conn, ret, NULL, 0);
+    int i = thserver_conn_index(st, conn);
+    if (i >= 0) st->rw_conn_info[i].cmd_count++;
+
+    gettimeofday(&start, NULL);
+    // blocks and nodes removed by writers stay valid until the exit
+    epoch_enter(g_runtime->epoch);
+    uint32_t cost = ep && i >= 0 ? rdata_cost(data) : 0;
+    if (cost > 0 && cost >= g_cf->exec_min_items) {
+        // no timeout and no read until the reply is ready
+        event_del(&conn->evt);
+        st->slots[i].executing = 1;
+        if (execpool_add(ep, conn, data, datalen) == MEMLINK_OK) {
+            epoch_exit(g_runtime->epoch);
+            gettimeofday(&end, NULL);
+            st->busy_us += timediff(&start, &end);
+            return CONN_READY_WAIT;
+        }
+        st->slots[i].executing = 0;
+    }
+    cmd = rdata_exec(conn, data, datalen);
+    epoch_exit(g_runtime->epoch);
+
+    ret = conn_send_buffer(conn);
     gettimeofday(&end, NULL);
+    st->busy_us += timediff(&start, &end);
     DNOTE("%s:%d cmd:%d use %u us\n", conn->client_ip, conn->client_port, cmd, timediff(&start, &end));
     DINFO("send return: %d\n", ret);
 
     return 0;
 }
+
+static void*
+execpool_run(void *arg)
+{
+    ExecPool    *ep = (ExecPool*)arg;
+    ReadJob     *job;
+    Conn        *conn;
+    char        cmd;
+    struct timeval start, end;
+
+    epoch_register(g_runtime->epoch);
+    while (1) {
+        pthread_mutex_lock(&ep->locker);
+        while (NULL == ep->head) {
+            pthread_cond_wait(&ep->cond, &ep->locker);
+        }
+        job = ep->head;
+        ep->head = job->next;
+        if (NULL == ep->head) {
+            ep->tail = NULL;
+        }
+        ep->count--;
+        pthread_mutex_unlock(&ep->locker);
+
+        conn = job->conn;
+        gettimeofday(&start, NULL);
+        epoch_enter(g_runtime->epoch);
+        cmd = rdata_exec(conn, job->data, job->datalen);
+        epoch_exit(g_runtime->epoch);
+        gettimeofday(&end, NULL);
+        DNOTE("%s:%d cmd:%d exec use %u us\n", conn->client_ip, conn->client_port, cmd, timediff(&start, &end));
+
+        zz_free(job);
+        thserver_exec_done((ThreadServer*)conn->thread, conn);
+    }
+    return NULL;
+}
+
+ExecPool*
+execpool_create(int thread_num)
+{
+    ExecPool    *ep;
+    pthread_t   tid;
+    int         i, ret;
+
+    ep = (ExecPool*)zz_malloc(sizeof(ExecPool));
+    if (NULL == ep) {
+        DERROR("malloc ExecPool error!\n");
+        MEMLINK_EXIT;
+    }
+    memset(ep, 0, sizeof(ExecPool));
+    pthread_mutex_init(&ep->locker, NULL);
+    pthread_cond_init(&ep->cond, NULL);
+
+    ep->thread_num = thread_num > MEMLINK_MAX_THREADS ? MEMLINK_MAX_THREADS : thread_num;
+    for (i = 0; i < ep->thread_num; i++) {
+        ret = pthread_create(&tid, NULL, execpool_run, ep);
+        if (ret != 0) {
+            char errbuf[1024];
+            strerror_r(errno, errbuf, 1024);
+            DERROR("pthread_create error: %s\n",  errbuf);
+            MEMLINK_EXIT;
+        }
+        ret = pthread_detach(tid);
+        if (ret != 0) {
+            char errbuf[1024];
+            strerror_r(errno, errbuf, 1024);
+            DERROR("pthread_detach error: %s\n",  errbuf);
+            MEMLINK_EXIT;
+        }
+    }
+    DINFO("create ExecPool with %d threads\n", ep->thread_num);
+
+    return ep;
+}
+
+/**
+ * copy the command to a job for the executor threads
+ * @return MEMLINK_ERR_FULL if EXEC_JOB_MAX jobs are waiting
+ */
+int
+execpool_add(ExecPool *ep, Conn *conn, char *data, int datalen)
+{
+    ReadJob *job;
+
+    if (ep->count >= EXEC_JOB_MAX)
+        return MEMLINK_ERR_FULL;
+
+    job = (ReadJob*)zz_malloc(sizeof(ReadJob) + datalen);
+    if (NULL == job) {
+        DERROR("malloc ReadJob error!\n");
+        return MEMLINK_ERR_MEM;
+    }
+    job->next = NULL;
+    job->conn = conn;
+    job->datalen = datalen;
+    memcpy(job->data, data, datalen);
+
+    pthread_mutex_lock(&ep->locker);
+    if (ep->tail) {
+        ep->tail->next = job;
+    }else{
+        ep->head = job;
+    }
+    ep->tail = job;
+    ep->count++;
+    pthread_cond_signal(&ep->cond);
+    pthread_mutex_unlock(&ep->locker);
+
+    return MEMLINK_OK;
+}
+
 /**
  * @}
  */
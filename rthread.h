@@ -2,9 +2,32 @@
 #define MEMLINK_RTHREAD_H
 
 #include <stdio.h>
+#include <pthread.h>
 #include "conn.h"
 
-int rdata_ready(Conn *conn, char *data, int datalen);
+// a heavy read command, copied from the read buffer of the connection
+typedef struct _memlink_readjob
+{
+    struct _memlink_readjob *next;
+    Conn        *conn;
+    int         datalen;
+    char        data[0];
+}ReadJob;
 
-#endif
+// executor threads of heavy read commands
+typedef struct _memlink_execpool
+{
+    pthread_mutex_t locker;
+    pthread_cond_t  cond;
+    ReadJob         *head;
+    ReadJob         *tail;
+    int             count; // waiting jobs, not more than EXEC_JOB_MAX
+    int             thread_num;
+}ExecPool;
+
+int         rdata_ready(Conn *conn, char *data, int datalen);
 
+ExecPool*   execpool_create(int thread_num);
+int         execpool_add(ExecPool *ep, Conn *conn, char *data, int datalen);
+
+#endif
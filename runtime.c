@@ -406,7 +406,12 @@ runtime_create_common(char *pgname)
         }
     }
 
-    ret = pthread_mutex_init(&rt->mutex, NULL);
+    // readers take the write lock to read back cold keys, writers already hold it
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE);
+    ret = pthread_mutex_init(&rt->mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
     if (ret != 0) {
         char errbuf[1024];
         strerror_r(errno, errbuf, 1024);
@@ -416,24 +421,23 @@ runtime_create_common(char *pgname)
     }
     DINFO("mutex init ok!\n");
 
-    ret = pthread_mutex_init(&rt->mutex_mem, NULL);
-    if (ret != 0) {
-        char errbuf[1024];
-        strerror_r(errno, errbuf, 1024);
-        DERROR("pthread_mutex_init error: %s\n",  errbuf);
-        MEMLINK_EXIT;
-        return NULL;
-    }
-    DINFO("mutex_mem init ok!\n");
-
     rt->mpool = mempool_create();
     if (NULL == rt->mpool) {
         DERROR("mempool create error!\n");
         MEMLINK_EXIT;
         return NULL;
     }
+    rt->mpool->hugepage = g_cf->block_hugepage;
     DINFO("mempool create ok!\n");
 
+    rt->epoch = epoch_create();
+    if (NULL == rt->epoch) {
+        DERROR("epoch_create error!\n");
+        MEMLINK_EXIT;
+        return NULL;
+    }
+    DINFO("epoch create ok!\n");
+
     rt->ht = hashtable_create();
     if (NULL == rt->ht) {
         DERROR("hashtable_create error!\n");
@@ -441,6 +445,18 @@ runtime_create_common(char *pgname)
         return NULL;
     }
     DINFO("hashtable create ok!\n");
+
+    if (g_cf->cold_table_count > 0) {
+        char coldpath[PATH_MAX];
+        snprintf(coldpath, PATH_MAX, "%s/cold.seg", g_cf->datadir);
+        rt->coldstore = coldstore_create(coldpath);
+        if (NULL == rt->coldstore) {
+            DERROR("coldstore_create error!\n");
+            MEMLINK_EXIT;
+            return NULL;
+        }
+        DINFO("coldstore create ok!\n");
+    }
     
     rt->syncmem = syncmem_create();
     if (NULL == rt->syncmem) {
@@ -489,6 +505,11 @@ runtime_create_slave(char *pgname, char *conffile)
     }
     DINFO("load_data ok!\n");
     
+    if (g_cf->exec_thread_num > 0) {
+        rt->execpool = execpool_create(g_cf->exec_thread_num);
+        DINFO("exec threads create ok!\n");
+    }
+
     rt->server = mainserver_create();
     if (NULL == rt->server) {
         DERROR("mainserver_create error!\n");
@@ -520,7 +541,8 @@ runtime_create_slave(char *pgname, char *conffile)
     }
     DINFO("write thread create ok!\n");
 
-
+    rt->taskthread = taskthread_create();
+    DINFO("task thread create ok!\n");
  
     sslave_go(rt->slave);
     
@@ -546,6 +568,11 @@ runtime_create_master(char *pgname, char *conffile)
     }
     DINFO("load_data ok!\n");
 
+    if (g_cf->exec_thread_num > 0) {
+        rt->execpool = execpool_create(g_cf->exec_thread_num);
+        DINFO("exec threads create ok!\n");
+    }
+
     rt->server = mainserver_create();
     if (NULL == rt->server) {
         DERROR("mainserver_create error!\n");
@@ -569,6 +596,9 @@ runtime_create_master(char *pgname, char *conffile)
         return NULL;
     }
     DINFO("sync thread create ok!\n");
+
+    rt->taskthread = taskthread_create();
+    DINFO("task thread create ok!\n");
     DNOTE("create master Runtime ok!\n");
     return rt;
 }
@@ -579,6 +609,11 @@ runtime_destroy(Runtime *rt)
     if (NULL == rt)
         return;
 
+    // pending objects are freed to the pool and tables
+    epoch_destroy(rt->epoch);
+    if (rt->coldstore) {
+        coldstore_destroy(rt->coldstore);
+    }
     pthread_mutex_destroy(&rt->mutex);
     zz_free(rt);
 }
@@ -621,22 +656,42 @@ conn_check_max(Conn *conn)
 }
 
 
+/**
+ * memory of table nodes, keys and indexes. BlockIndex is changed by 
+ * read threads, so it is atomic
+ */
 int    
 mem_used_inc(long long size)
 {
-    pthread_mutex_lock(&g_runtime->mutex_mem);
-    g_runtime->mem_used += size;
-    pthread_mutex_unlock(&g_runtime->mutex_mem);
+    __sync_add_and_fetch(&g_runtime->mem_used, size);
     return 0;
 }
 
 int    
 mem_used_dec(long long size)
 {
-    pthread_mutex_lock(&g_runtime->mutex_mem);
-    g_runtime->mem_used -= size;
-    pthread_mutex_unlock(&g_runtime->mutex_mem);
+    __sync_sub_and_fetch(&g_runtime->mem_used, size);
     return 0;
 }
 
+/**
+ * bytes counted for max_mem: DataBlock pool, table nodes and indexes, 
+ * connection buffers
+ */
+long long
+mem_used_total()
+{
+    return g_runtime->mpool->mem + g_runtime->mem_used + conn_buffer_mem();
+}
+
+/**
+ * like mem_used_total, but only DataBlocks in use are counted, free blocks
+ * in pool are reused by writes. keys are evicted over max_mem by this
+ */
+long long
+mem_used_live()
+{
+    return g_runtime->mpool->blockmem + g_runtime->mem_used + conn_buffer_mem();
+}
+
 
@@ -12,10 +12,14 @@
 #include "mem.h"
 #include "wthread.h"
 #include "server.h"
+#include "rthread.h"
 #include "sslave.h"
 #include "sthread.h"
 #include "syncbuffer.h"
 #include "vote.h"
+#include "taskthread.h"
+#include "coldstore.h"
+#include "epoch.h"
 
 typedef struct _runtime
 {
@@ -28,21 +32,24 @@ typedef struct _runtime
     unsigned int    logver;  // synclog version
     SyncLog         *synclog;  // current synclog
     MemPool         *mpool; 
+    Epoch           *epoch; // blocks, nodes and tables freed after readers leave
     HashTable       *ht;
     SyncMem         *syncmem;
 	volatile int	inclean;
     //char			cleankey[255];
     WThread         *wthread;
+    TaskThread      *taskthread; // background clean
+    ColdStore       *coldstore; // NULL when no cold_table
     MainServer      *server;
+    ExecPool        *execpool; // heavy read commands, NULL when exec_thread_num is 0
     SSlave          *slave; // sync slave
     SThread         *sthread; // sync thread
     unsigned int    conn_num; // current conn count
 	time_t          last_dump;
 	unsigned int    memlink_start;
 
-	pthread_mutex_t	mutex_mem;
-	long long		mem_used;
-	unsigned int	mem_check_last;
+	volatile long long	mem_used; // bytes of table nodes, keys and indexes
+	unsigned int	evicted_keys; // keys evicted over max_mem
     uint64_t voteid;
     //unsigned char   role;
     //Host			*hosts;
@@ -58,6 +65,8 @@ void        runtime_destroy(Runtime *rt);
 int         conn_check_max(Conn *conn);
 int			mem_used_inc(long long size);	
 int			mem_used_dec(long long size);
+long long	mem_used_total();
+long long	mem_used_live();
 
 
 
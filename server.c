@@ -21,6 +21,7 @@
 #include "zzmalloc.h"
 #include "utils.h"
 #include "info.h"
+#include "runtime.h"
 
 
 #ifdef DEBUG
@@ -68,6 +69,23 @@ mainserver_create()
     memset(ms, 0, sizeof(MainServer));
     
     int i, ret;
+    for (i = 0; i < g_cf->thread_num; i++) {
+        ms->threads[i].sock = -1;
+    }
+    // every read thread listens on the port, or none does
+    if (g_cf->read_reuseport) {
+        for (i = 0; i < g_cf->thread_num; i++) {
+            ms->threads[i].sock = tcp_socket_server_reuseport(g_cf->host, g_cf->read_port);
+            if (ms->threads[i].sock < 0) {
+                DERROR("read thread listen error, accept on main thread\n");
+                while (i-- > 0) {
+                    close(ms->threads[i].sock);
+                    ms->threads[i].sock = -1;
+                }
+                break;
+            }
+        }
+    }
     for (i = 0; i < g_cf->thread_num; i++) {
         ret = thserver_init(&ms->threads[i]);
         if (ret < 0) {
@@ -76,13 +94,19 @@ mainserver_create()
         }
 
     }
+
+    ms->base = event_init(); 
+    if (g_cf->thread_num > 0 && ms->threads[0].sock >= 0) {
+        ms->sock = -1;
+        DINFO("read threads accept at port %d\n", g_cf->read_port);
+        return ms;
+    }
     ms->sock = tcp_socket_server(g_cf->host, g_cf->read_port);  
     if (ms->sock < 0) {
         DERROR("tcp_socket_server at port %d error: %d\n", g_cf->read_port, ms->sock);
         MEMLINK_EXIT;
     }
  
-    ms->base = event_init(); 
     event_set(&ms->event, ms->sock, EV_READ|EV_PERSIST, mainserver_read, ms);
     event_add(&ms->event, 0);
 
@@ -100,29 +124,79 @@ mainserver_destroy(MainServer *ms)
     zz_free(ms);
 }
 
+static int
+thserver_conn_limit()
+{
+    return g_cf->max_read_conn > 0 ? g_cf->max_read_conn : g_cf->max_conn;
+}
+
+/**
+ * index of the connection in rw_conn_info and slots of its read thread
+ * @return -1 if not found
+ */
+int
+thserver_conn_index(ThreadServer *ts, Conn *conn)
+{
+    int i, conn_limit = thserver_conn_limit();
+
+    for (i = 0; i < conn_limit; i++) {
+        if (conn->sock == ts->rw_conn_info[i].fd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * remove the connection from the stat of its read thread
+ */
+static void
+thserver_conn_remove(ThreadServer *ts, Conn *conn)
+{
+    int i = thserver_conn_index(ts, conn);
+
+    ts->conns--;
+    if (i >= 0) {
+        memset(&ts->rw_conn_info[i], 0x0, sizeof(RwConnInfo));
+        ts->slots[i].conn = NULL;
+    }
+}
+
 void
 rconn_destroy(Conn *conn)
 {
     ThreadServer *ts;
-    ConnInfo *conninfo = NULL;
 
     ts = (ThreadServer *)conn->thread;
     if (ts) {
-        conninfo = (ConnInfo *)ts->rw_conn_info;
-        ts->conns--;
+        thserver_conn_remove(ts, conn);
     }
 
-    int i;
-    if (conninfo) {
-        for (i = 0; i < g_cf->max_read_conn; i++) {
-            if (conn->sock == conninfo[i].fd) {
-                memset(&conninfo[i], 0x0, sizeof(ConnInfo));
-                break;
-            }
+    conn_destroy(conn);
+}
+
+/**
+ * read thread for a new connection: recent busy time plus READ_CONN_LOAD for
+ * each connection, the least one after lastth
+ */
+static int
+mainserver_pick(MainServer *ms)
+{
+    ThreadServer *ts;
+    uint64_t     score, best = 0;
+    int          i, k, n = ms->lastth;
+
+    for (k = 0; k < g_cf->thread_num; k++) {
+        i  = (ms->lastth + k) % g_cf->thread_num;
+        ts = &ms->threads[i];
+        score = ts->load + (uint64_t)ts->conns * READ_CONN_LOAD;
+        if (k == 0 || score < best) {
+            best = score;
+            n    = i;
         }
     }
-
-    conn_destroy(conn);
+    ms->lastth = (n + 1) % g_cf->thread_num;
+    return n;
 }
 
 /**
@@ -154,9 +228,8 @@ mainserver_read(int fd, short event, void *arg)
         return;
     }
 
-    int             n   = ms->lastth;
+    int             n   = mainserver_pick(ms);
     ThreadServer    *ts = &ms->threads[n];
-    ms->lastth = (ms->lastth + 1) % g_cf->thread_num;
     
     zz_check(ts->cq);
 
@@ -173,9 +246,165 @@ mainserver_read(int fd, short event, void *arg)
 void
 mainserver_loop(MainServer *ms)
 {
+    // read threads accept by themselves, nothing to do here
+    if (ms->sock < 0) {
+        while (1) {
+            pause();
+        }
+    }
     event_base_loop(ms->base, 0);
 }
 
+/**
+ * start reading a new connection in the read thread
+ */
+static void
+thserver_conn_add(ThreadServer *ts, Conn *conn)
+{
+    RwConnInfo  *coninfo;
+    int         conn_limit = thserver_conn_limit();
+    int         i, ret;
+
+    ts->conns++;
+    for (i = 0; i < conn_limit; i++) {
+        coninfo = &(ts->rw_conn_info[i]);
+        if (coninfo->fd == 0) {
+            coninfo->fd = conn->sock;
+            strcpy(coninfo->client_ip, conn->client_ip);
+            coninfo->port = conn->client_port;
+            memcpy(&coninfo->start, &conn->ctime, sizeof(struct timeval));
+            ts->slots[i].conn     = conn;
+            ts->slots[i].cmd_seen = 0;
+            break;
+        }
+    }
+    conn->thread = ts;
+    conn->base   = ts->base;
+    ret = change_event(conn, EV_READ|EV_PERSIST, g_cf->timeout, 1);
+    if (ret < 0) {
+        DERROR("change event error: %d, close conn\n", ret);
+        conn->destroy(conn);
+    }
+}
+
+/**
+ * Callback for the own listening socket of a read thread, the connection
+ * stays in this thread without a handoff.
+ */
+static void
+thserver_accept(int fd, short event, void *arg)
+{
+    ThreadServer *ts = (ThreadServer*)arg;
+    Conn         *conn;
+
+    conn = conn_create(fd, sizeof(Conn));
+    if (NULL == conn) {
+        return;
+    }
+    conn->port  = g_cf->read_port;
+    conn->ready = rdata_ready;
+    conn->destroy = rconn_destroy;
+
+    if (conn_check_max(conn) != MEMLINK_OK) {
+        DERROR("too many read conn.\n");
+        conn->destroy(conn);
+        return;
+    }
+    thserver_conn_add(ts, conn);
+}
+
+/**
+ * append the connection to a queue of the read thread and wake it up
+ */
+static void
+thserver_post(ThreadServer *ts, Queue *q, Conn *conn)
+{
+    queue_append(q, conn);
+    if (write(ts->notify_send_fd, "", 1) == -1) {
+        char errbuf[1024];
+        strerror_r(errno, errbuf, 1024);
+        DERROR("Writing to thread notify pipe error: %s\n", errbuf);
+    }
+}
+
+/**
+ * called by an executor thread, the reply in conn->wbuf is sent by the
+ * read thread owning the connection
+ */
+void
+thserver_exec_done(ThreadServer *ts, Conn *conn)
+{
+    thserver_post(ts, ts->dq, conn);
+}
+
+/**
+ * move connections without a command since the last tick and without
+ * buffered data to the lightest read thread, when this one is much busier
+ */
+static void
+thserver_migrate(ThreadServer *ts)
+{
+    MainServer   *ms = g_runtime->server;
+    ThreadServer *to = NULL, *t;
+    Conn         *conn;
+    int          conn_limit = thserver_conn_limit();
+    int          i, n = 0;
+
+    if (NULL == ms || ts->load < READ_MIGRATE_MIN_LOAD)
+        return;
+    for (i = 0; i < g_cf->thread_num; i++) {
+        t = &ms->threads[i];
+        if (t != ts && (NULL == to || t->load < to->load)) {
+            to = t;
+        }
+    }
+    if (NULL == to || ts->load < (uint64_t)to->load * READ_MIGRATE_RATIO)
+        return;
+
+    for (i = 0; i < conn_limit && n < READ_MIGRATE_MAX && ts->conns > 1; i++) {
+        conn = ts->slots[i].conn;
+        if (NULL == conn || ts->slots[i].executing ||
+            ts->rw_conn_info[i].cmd_count != ts->slots[i].cmd_seen ||
+            conn->rlen > 0 || conn->wlen > 0) {
+            continue;
+        }
+        event_del(&conn->evt);
+        thserver_conn_remove(ts, conn);
+        thserver_post(to, to->cq, conn);
+        n++;
+    }
+    if (n > 0) {
+        DNOTE("migrate %d idle conns, load:%u => %u\n", n, ts->load, to->load);
+    }
+}
+
+/**
+ * Timer of a read thread. Decaying average of busy time per second, then
+ * idle connections may move away.
+ */
+static void
+thserver_balance(int fd, short event, void *arg)
+{
+    ThreadServer    *ts = (ThreadServer*)arg;
+    uint64_t        busy = ts->busy_us;
+    struct timeval  tm;
+    int             i, conn_limit = thserver_conn_limit();
+
+    ts->load = (ts->load + (busy - ts->last_busy) / READ_LOAD_INTERVAL) / 2;
+    ts->last_busy = busy;
+
+    thserver_migrate(ts);
+    for (i = 0; i < conn_limit; i++) {
+        if (ts->slots[i].conn) {
+            ts->slots[i].cmd_seen = ts->rw_conn_info[i].cmd_count;
+        }
+    }
+
+    evutil_timerclear(&tm);
+    tm.tv_sec = READ_LOAD_INTERVAL;
+    event_add(&ts->balance_event, &tm);
+}
+
 /**
   * Callback for enqueue event. Read date from the pipe and add event for 
   * incoming data in client connection.
@@ -192,22 +421,10 @@ thserver_notify(int fd, short event, void *arg)
     QueueItem       *item = itemhead;
     int             items = 0;
     Conn            *conn;
-    int             ret;
-    int             conn_limit = 0; 
-
 
     DINFO("thserver_notify: %d\n", fd);
 
-    conn_limit = (g_cf->max_read_conn > 0 ? g_cf->max_read_conn : g_cf->max_conn);
- 
-
-    /*if (conn_limit <= 0) {
-        conn_limit = g_cf->max_conn;
-    }*/
-
     char buf[100];
-    int  i;
-    RwConnInfo *coninfo = ts->rw_conn_info;
 /*#ifdef DEBUG
     if (!item) {
         ts->null_dispatch++;
@@ -218,33 +435,33 @@ thserver_notify(int fd, short event, void *arg)
         items++;
         conn = item->conn; 
         DINFO("notify fd: %d\n", conn->sock);
-        ts->conns++;
-        for (i = 0; i < conn_limit; i++) {
-            coninfo = &(ts->rw_conn_info[i]);
-            if (coninfo->fd == 0) {
-                coninfo->fd = conn->sock;
-                strcpy(coninfo->client_ip, conn->client_ip);
-                coninfo->port = conn->client_port;
-                memcpy(&coninfo->start, &conn->ctime, sizeof(struct timeval));
-                break;
-            }
-        }
-        conn->thread = ts;
-        conn->base   = ts->base;
-        ret = change_event(conn, EV_READ|EV_PERSIST, g_cf->timeout, 1);
-        if (ret < 0) {
-            DERROR("change event error: %d, close conn\n", ret);
-            conn->destroy(conn);
-        }
+        thserver_conn_add(ts, conn);
         item = item->next;
     }
 
+    // replies of commands run by executor threads
+    QueueItem *donehead = queue_get(ts->dq);
+    for (item = donehead; item; item = item->next) {
+        items++;
+        conn = item->conn;
+        int i = thserver_conn_index(ts, conn);
+        if (i >= 0) {
+            ts->slots[i].executing = 0;
+        }
+        conn_send_buffer(conn);
+    }
+    if (donehead) {
+        queue_free(ts->dq, donehead);
+    }
+
     if (items > 100)
         items = 100;
     else if(items == 0)
         items = 1;
 
-    ret = read(ts->notify_recv_fd, &buf, items);
+    if (read(ts->notify_recv_fd, &buf, items) < 0) {
+        DERROR("read notify pipe error: %d\n", errno);
+    }
 
     if (itemhead) {
         /*QueueItem *qh = itemhead;
@@ -261,6 +478,7 @@ thserver_run(void *arg)
 {
     ThreadServer *ts = (ThreadServer*)arg;
     DINFO("thserver_run loop ...\n");
+    epoch_register(g_runtime->epoch);
     event_base_loop(ts->base, 0);
 
     return NULL;
@@ -278,12 +496,23 @@ thserver_init(ThreadServer *ts)
         MEMLINK_EXIT;
     }
     memset(ts->rw_conn_info, 0, sizeof(RwConnInfo) * conn_limit);
+    ts->slots = (ReadConnSlot *)zz_malloc(sizeof(ReadConnSlot) * conn_limit);
+    if (ts->slots == NULL) {
+        DERROR("memlink malloc read connect slots error.\n");
+        MEMLINK_EXIT;
+    }
+    memset(ts->slots, 0, sizeof(ReadConnSlot) * conn_limit);
 
     ts->cq = queue_create();
     if (NULL == ts->cq) {
         DERROR("queue_create error!\n");
         MEMLINK_EXIT;
     }
+    ts->dq = queue_create();
+    if (NULL == ts->dq) {
+        DERROR("queue_create error!\n");
+        MEMLINK_EXIT;
+    }
     
     int fds[2];     
     
@@ -301,6 +530,18 @@ thserver_init(ThreadServer *ts)
                 thserver_notify, ts);
     event_base_set(ts->base, &ts->notify_event);
     event_add(&ts->notify_event, 0);
+    struct timeval tm;
+    evtimer_set(&ts->balance_event, thserver_balance, ts);
+    event_base_set(ts->base, &ts->balance_event);
+    evutil_timerclear(&tm);
+    tm.tv_sec = READ_LOAD_INTERVAL;
+    event_add(&ts->balance_event, &tm);
+
+    if (ts->sock >= 0) {
+        event_set(&ts->accept_event, ts->sock, EV_READ|EV_PERSIST, thserver_accept, ts);
+        event_base_set(ts->base, &ts->accept_event);
+        event_add(&ts->accept_event, 0);
+    }
 
     pthread_attr_t  attr;
     int ret;
@@ -3,23 +3,40 @@
 
 #include <stdio.h>
 #include <pthread.h>
+#include <stdint.h>
 #include "queue.h"
 #include "info.h"
 
 #define MEMLINK_MAX_THREADS 16
 
+// connection of a read thread, same index as rw_conn_info
+typedef struct _read_conn_slot
+{
+    Conn                *conn;
+    int                 cmd_seen; // cmd_count at the last balance tick
+    int                 executing; // command given to an executor thread
+}ReadConnSlot;
+
 typedef struct _thread_server
 {
     pthread_t           threadid;
     struct event_base   *base;
     struct event        notify_event; 
+    int                 sock; // own SO_REUSEPORT listening socket, -1 if none
+    struct event        accept_event;
     int                 notify_recv_fd;
     int                 notify_send_fd;
     Queue               *cq;
+    Queue               *dq; // connections with a reply from executor threads
     int                 running;
     int                 complete;
 	unsigned short     	conns; 
 	RwConnInfo          *rw_conn_info;
+    ReadConnSlot        *slots;
+    struct event        balance_event; // load sample and connection migration
+    volatile uint64_t   busy_us;   // time spent in read commands
+    uint64_t            last_busy; // busy_us at the last balance tick
+    volatile uint32_t   load;      // recent busy microseconds per second
 #ifdef DEBUG
     int null_dispatch;
 #endif
@@ -27,7 +44,7 @@ typedef struct _thread_server
 
 typedef struct _main_server
 {
-    int                 sock; 
+    int                 sock; // -1 when read threads accept by themselves
     struct event_base   *base;
     struct event        event;
     ThreadServer        threads[MEMLINK_MAX_THREADS];
@@ -45,5 +62,7 @@ void            mainserver_loop(MainServer *ms);
 void            mainserver_read(int fd, short event, void *arg);
 
 int             thserver_init(ThreadServer *ts);
+int             thserver_conn_index(ThreadServer *ts, Conn *conn);
+void            thserver_exec_done(ThreadServer *ts, Conn *conn);
 
 #endif
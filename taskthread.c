@@ -6,17 +6,252 @@
 #include <unistd.h>
 #include <base/logfile.h>
 #include <base/zzmalloc.h>
+#include <base/utils.h>
+#include "myconfig.h"
+#include "runtime.h"
+#include "valuearena.h"
+
+/**
+ * 分步清理一个key, 每一步持有写锁不超过block_clean_time微秒, 
+ * 两步之间让出写锁给写线程
+ */
+static void
+task_clean(TaskClean *task)
+{
+    struct timeval start, end;
+    int ret, steps = 0;
+
+    DNOTE("start clean %s.%s ...\n", task->table, task->key);
+    gettimeofday(&start, NULL);
+    while (1) {
+        pthread_mutex_lock(&g_runtime->mutex);
+        g_runtime->inclean = TRUE;
+        ret = hashtable_clean_step(g_runtime->ht, task->table, task->key, 
+                                   g_cf->block_clean_num, g_cf->block_clean_time);
+        g_runtime->inclean = FALSE;
+        epoch_reclaim(g_runtime->epoch);
+        pthread_mutex_unlock(&g_runtime->mutex);
+        steps++;
+        if (ret != 1) {
+            break;
+        }
+        usleep(g_cf->block_clean_time);
+    }
+    gettimeofday(&end, NULL);
+    DNOTE("clean %s.%s complete, ret:%d, steps:%d, use %u us\n", task->table, task->key, 
+            ret, steps, timediff(&start, &end));
+}
+
+/**
+ * 把冷数据表中cold_time秒未访问的key写入冷数据文件, 压缩表中compress_time秒
+ * 未访问的key压缩后留在内存, 与清理一样分步持有写锁
+ */
+static void
+task_cold()
+{
+    ColdStore   *cs = g_runtime->coldstore;
+    HashTable   *ht = g_runtime->ht;
+    Table       *tb;
+    char        *names = NULL;
+    int         count = 0, i, k, ret;
+    uint32_t    bunk;
+    struct timeval start, end;
+
+    gettimeofday(&start, NULL);
+    pthread_mutex_lock(&g_runtime->mutex);
+    for (k = 0; k < HASHTABLE_MAX_TABLE; k++) {
+        for (tb = ht->tables[k]; tb; tb = tb->next) {
+            if (table_has_cold(tb)) 
+                count++;
+        }
+    }
+    if (count > 0) {
+        names = zz_malloc(count * HASHTABLE_TABLE_NAME_SIZE);
+        i = 0;
+        for (k = 0; k < HASHTABLE_MAX_TABLE; k++) {
+            for (tb = ht->tables[k]; tb && i < count; tb = tb->next) {
+                if (table_has_cold(tb)) {
+                    strcpy(names + i * HASHTABLE_TABLE_NAME_SIZE, tb->name);
+                    i++;
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_runtime->mutex);
+
+    for (i = 0; i < count; i++) {
+        bunk = 0;
+        while (1) {
+            pthread_mutex_lock(&g_runtime->mutex);
+            tb = hashtable_find_table(ht, names + i * HASHTABLE_TABLE_NAME_SIZE);
+            ret = 0;
+            if (tb) {
+                ret = coldstore_spill_step(cs, tb, &bunk, g_cf->block_clean_time);
+            }
+            epoch_reclaim(g_runtime->epoch);
+            pthread_mutex_unlock(&g_runtime->mutex);
+            if (ret != 1) {
+                break;
+            }
+            usleep(g_cf->block_clean_time);
+        }
+    }
+
+    if (NULL == cs) {
+        if (names) {
+            zz_free(names);
+        }
+        gettimeofday(&end, NULL);
+        DNOTE("compress tables:%d, use %u us\n", count, timediff(&start, &end));
+        return;
+    }
+    // records of the old file are moved in steps like the spill, readers 
+    // loading cold keys wait at most one step
+    pthread_mutex_lock(&g_runtime->mutex);
+    ret = coldstore_compact_start(cs);
+    pthread_mutex_unlock(&g_runtime->mutex);
+    for (i = 0; ret == 1 && i < count; i++) {
+        bunk = 0;
+        while (1) {
+            pthread_mutex_lock(&g_runtime->mutex);
+            tb = hashtable_find_table(ht, names + i * HASHTABLE_TABLE_NAME_SIZE);
+            k = 0;
+            if (tb) {
+                k = coldstore_compact_step(cs, tb, &bunk, g_cf->block_clean_time);
+            }
+            pthread_mutex_unlock(&g_runtime->mutex);
+            if (k != 1) {
+                break;
+            }
+            usleep(g_cf->block_clean_time);
+        }
+    }
+    if (ret == 1) {
+        pthread_mutex_lock(&g_runtime->mutex);
+        coldstore_compact_finish(cs);
+        pthread_mutex_unlock(&g_runtime->mutex);
+    }
+    if (names) {
+        zz_free(names);
+    }
+
+    gettimeofday(&end, NULL);
+    DNOTE("cold store tables:%d, keys:%u, live:%llu, end:%llu, use %u us\n", count, cs->keys,
+            (unsigned long long)cs->live, (unsigned long long)cs->end, timediff(&start, &end));
+}
+
+/**
+ * 整理变长值表的值内存区, 与清理一样分步持有写锁, 只有垃圾超过一半的表才搬移
+ */
+static void
+task_value()
+{
+    HashTable   *ht = g_runtime->ht;
+    Table       *tb;
+    char        *names = NULL;
+    int         count = 0, i, k, ret;
+
+    pthread_mutex_lock(&g_runtime->mutex);
+    for (k = 0; k < HASHTABLE_MAX_TABLE; k++) {
+        for (tb = ht->tables[k]; tb; tb = tb->next) {
+            if (table_is_vstring(tb)) 
+                count++;
+        }
+    }
+    if (count > 0) {
+        names = zz_malloc(count * HASHTABLE_TABLE_NAME_SIZE);
+        i = 0;
+        for (k = 0; k < HASHTABLE_MAX_TABLE; k++) {
+            for (tb = ht->tables[k]; tb && i < count; tb = tb->next) {
+                if (table_is_vstring(tb)) {
+                    strcpy(names + i * HASHTABLE_TABLE_NAME_SIZE, tb->name);
+                    i++;
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_runtime->mutex);
+
+    for (i = 0; i < count; i++) {
+        while (1) {
+            pthread_mutex_lock(&g_runtime->mutex);
+            tb = hashtable_find_table(ht, names + i * HASHTABLE_TABLE_NAME_SIZE);
+            ret = 0;
+            if (tb) {
+                ret = valuearena_compact_step(tb, g_cf->block_clean_time);
+            }
+            epoch_reclaim(g_runtime->epoch);
+            pthread_mutex_unlock(&g_runtime->mutex);
+            if (ret != 1) {
+                break;
+            }
+            usleep(g_cf->block_clean_time);
+        }
+    }
+    if (names) {
+        zz_free(names);
+    }
+}
 
 static void*
 taskthread_run(void *arg)
 {
     TaskThread  *tt = (TaskThread*)arg;
+    Task        *task;
+    time_t      coldtime = time(NULL);
+    time_t      valuetime = time(NULL);
     
     DINFO("task thread:%lu\n", (unsigned long)tt->tid);
+    while (1) {
+        task = taskthread_get_task(tt, 1);
+        if (NULL == task) {
+            // 空闲时定期扫描冷数据
+            if ((g_runtime->coldstore || g_cf->compress_table_count > 0) &&
+                time(NULL) - coldtime >= COLDSTORE_SCAN_INTERVAL) {
+                task_cold();
+                coldtime = time(NULL);
+            }
+            if (time(NULL) - valuetime >= VALUEARENA_SCAN_INTERVAL) {
+                task_value();
+                valuetime = time(NULL);
+            }
+            // objects of the last write commands, readers have left them by now
+            if (g_runtime->epoch && g_runtime->epoch->pending > 0) {
+                pthread_mutex_lock(&g_runtime->mutex);
+                epoch_reclaim(g_runtime->epoch);
+                pthread_mutex_unlock(&g_runtime->mutex);
+            }
+            continue;
+        }
+        switch (task->type) {
+            case TASK_CLEAN:
+                task_clean((TaskClean*)task);
+                break;
+            default:
+                DERROR("unknown task type: %d\n", task->type);
+                break;
+        }
+        zz_free(task);
+    }
 
     return NULL;
 }
 
+static int
+task_equal(Task *t1, Task *t2)
+{
+    if (t1->type != t2->type) {
+        return 0;
+    }
+    switch (t1->type) {
+        case TASK_CLEAN: {
+            TaskClean *c1 = (TaskClean*)t1, *c2 = (TaskClean*)t2;
+            return strcmp(c1->table, c2->table) == 0 && strcmp(c1->key, c2->key) == 0;
+        }
+    }
+    return 0;
+}
+
 TaskThread* 
 taskthread_create()
 {
@@ -24,27 +259,27 @@ taskthread_create()
     TaskThread  *tt = zz_malloc(sizeof(TaskThread));
     memset(tt, 0, sizeof(TaskThread));
 
-    ret = pthread_create(&tt->tid, NULL, taskthread_run, tt);
+    ret = pthread_mutex_init(&tt->locker, NULL);
     if (ret != 0) {
         char errbuf[1024];
         strerror_r(errno, errbuf, 1024);
-        DERROR("pthread_create error: %s\n",  errbuf);
+        DERROR("pthread_mutex_init error: %s\n",  errbuf);
         MEMLINK_EXIT;
     }
 
-    ret = pthread_mutex_init(&tt->locker, NULL);
+    ret = pthread_cond_init(&tt->cond, NULL);
     if (ret != 0) {
         char errbuf[1024];
         strerror_r(errno, errbuf, 1024);
-        DERROR("pthread_mutex_init error: %s\n",  errbuf);
+        DERROR("pthread_cond_init error: %s\n",  errbuf);
         MEMLINK_EXIT;
     }
 
-    ret = pthread_cond_init(&tt->cond, NULL);
+    ret = pthread_create(&tt->tid, NULL, taskthread_run, tt);
     if (ret != 0) {
         char errbuf[1024];
         strerror_r(errno, errbuf, 1024);
-        DERROR("pthread_cond_init error: %s\n",  errbuf);
+        DERROR("pthread_create error: %s\n",  errbuf);
         MEMLINK_EXIT;
     }
 
@@ -60,57 +295,73 @@ taskthread_create()
 }
 
 
+/**
+ * 添加任务, 成功后task由任务线程释放. 
+ * 已有相同的任务时只提升它的优先级, 释放task
+ */
 int 
 taskthread_add_task(TaskThread *tt, Task *task)
 {
     int retcode = MEMLINK_OK;
+    int i;
 
     pthread_mutex_lock(&tt->locker);
-    if ((tt->task_addi == tt->task_readi) && tt->tasks[tt->task_addi] != NULL) {
-        // full
+    for (i = 0; i < tt->count; i++) {
+        if (task_equal(tt->tasks[i], task)) {
+            if (task->priority > tt->tasks[i]->priority) {
+                tt->tasks[i]->priority = task->priority;
+            }
+            zz_free(task);
+            goto add_task_over;
+        }
+    }
+    if (tt->count == MAX_TASK) {
         retcode = MEMLINK_ERR_FULL;
         goto add_task_over;
     }
-    tt->tasks[tt->task_addi] = task; 
-    tt->task_addi++;
-
-    tt->task_addi = tt->task_addi % MAX_TASK;
+    tt->tasks[tt->count] = task; 
+    tt->count++;
 
     pthread_cond_signal(&tt->cond);
-    pthread_mutex_unlock(&tt->locker);
 
 add_task_over:
+    pthread_mutex_unlock(&tt->locker);
     return retcode;
 }
 
+/**
+ * 取优先级最高的任务, 没有任务时最多等待timeout秒
+ */
 Task*   
 taskthread_get_task(TaskThread *tt, int timeout)
 {
     Task *task = NULL;
     struct timespec ts;
-    int ret;
+    int i, k = 0;
 
     pthread_mutex_lock(&tt->locker);
-    while ((tt->task_addi == tt->task_readi) && tt->tasks[tt->task_addi] == NULL) {
-        // empty
-        if (timeout <= 0) {
-            goto get_task_over;
-        }
+    if (tt->count == 0 && timeout > 0) {
         ts.tv_sec = time(NULL) + timeout;
         ts.tv_nsec = 0;
- 
-        ret = pthread_cond_timedwait(&tt->cond, &tt->locker, &ts);
-        if (ret == ETIMEDOUT) 
-            return NULL;
+        while (tt->count == 0) {
+            if (pthread_cond_timedwait(&tt->cond, &tt->locker, &ts) == ETIMEDOUT) 
+                break;
+        }
     }
+    if (tt->count == 0) {
+        goto get_task_over;
+    }
+    for (i = 1; i < tt->count; i++) {
+        if (tt->tasks[i]->priority > tt->tasks[k]->priority) {
+            k = i;
+        }
+    }
+    task = tt->tasks[k]; 
+    tt->count--;
+    tt->tasks[k] = tt->tasks[tt->count];
+    tt->tasks[tt->count] = NULL;
 
-    task = tt->tasks[tt->task_readi]; 
-    tt->task_readi++;
-
-    tt->task_readi = tt->task_readi % MAX_TASK;
-    pthread_mutex_unlock(&tt->locker);
 get_task_over:
+    pthread_mutex_unlock(&tt->locker);
     return task;
 }
-    
-
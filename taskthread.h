@@ -3,23 +3,27 @@
 
 #include <stdio.h>
 #include <pthread.h>
+#include "common.h"
 
 #define MAX_TASK	1024
 
 #define TASK_CLEAN	1
 
 #define TASK_HEAD \
-	short	type;
+	short	type; \
+	int		priority; // bigger priority runs first
 
 typedef struct _memlink_task
 {
 	TASK_HEAD	 // task type:  clean, ...
 }Task;
 
+// background clean of a key, priority is removed rate * 10000
 typedef struct _memlink_task_clean
 {
 	TASK_HEAD
-	char	key[255];
+	char	table[HASHTABLE_TABLE_NAME_SIZE];
+	char	key[HASHTABLE_KEY_MAX + 1];
 }TaskClean;
 
 typedef struct _memlink_taskthread
@@ -27,9 +31,8 @@ typedef struct _memlink_taskthread
 	pthread_t		tid;
 	pthread_mutex_t	locker;
 	pthread_cond_t	cond;
-	Task		*tasks[MAX_TASK];  // cycle list
-	int			task_addi;
-	int			task_readi;
+	Task		*tasks[MAX_TASK];  // waiting tasks, not ordered
+	int			count;
 }TaskThread;
 
 TaskThread*	taskthread_create();
@@ -4,12 +4,12 @@ int
 find_value_in_block(Table *tb, HashNode *node, DataBlock *dbk, void *value)
 {
     int pos = 0;
-    int datalen = tb->valuesize + tb->attrsize;
+    int datalen = dataitem_step(tb);
     char *data = dbk->data; 
     int i;
     
     for (i = 0; i < dbk->data_count; i++) {
-        if (dataitem_have_data(tb, node, data, 0) && memcmp(value, data, tb->valuesize) == 0) {
+        if (dataitem_have_data(tb, dbk, data, 0) && memcmp(value, data, tb->valuesize) == 0) {
             if (pos == 0)
                 return 1;
             return pos;
@@ -0,0 +1,216 @@
+#include "hashtest.h"
+
+// values of node in list order compared with model
+static int
+check_node(Table *tb, HashNode *node, int *model, int count)
+{
+    DataBlock *dbk;
+    char      *itemdata;
+    int       i, n = 0, all = 0;
+
+    for (dbk = node->data; dbk; dbk = dbk->next) {
+        itemdata = dbk->data;
+        for (i = 0; i < dbk->data_count; i++) {
+            if (dataitem_check_data(tb, dbk, itemdata) != MEMLINK_VALUE_REMOVED) {
+                if (n >= count || memcmp(itemdata, &model[n], sizeof(int)) != 0) {
+                    DERROR("value error at %d\n", n);
+                    return -1;
+                }
+                n++;
+            }
+            itemdata += dataitem_step(tb);
+        }
+        all += dbk->data_count;
+    }
+    if (n != count || node->used != count || node->all != all) {
+        DERROR("count error: %d, used:%d, all:%d, %d, model:%d\n", n, node->used, node->all, all, count);
+        return -1;
+    }
+    return 0;
+}
+
+// positional lookup through the block index finds the value of model
+static int
+check_pos(Table *tb, HashNode *node, int *model, int count)
+{
+    DataBlock *dbk;
+    char      *itemdata;
+    int       pos, i, n;
+
+    for (pos = 0; pos < count; pos += 97) {
+        n = datablock_lookup_pos(tb, node, pos, MEMLINK_VALUE_ALL, &dbk);
+        if (n < 0) {
+            DERROR("lookup pos error at %d\n", pos);
+            return -1;
+        }
+        n = pos - n;
+        itemdata = dbk->data;
+        for (i = 0; i < dbk->data_count; i++, itemdata += dataitem_step(tb)) {
+            if (dataitem_check_data(tb, dbk, itemdata) != MEMLINK_VALUE_REMOVED && n-- == 0)
+                break;
+        }
+        if (i == dbk->data_count || memcmp(itemdata, &model[pos], sizeof(int)) != 0) {
+            DERROR("value error at pos %d\n", pos);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+block_max_count(HashNode *node)
+{
+    DataBlock *dbk;
+    int       max = 0;
+
+    for (dbk = node->data; dbk; dbk = dbk->next) {
+        if (dbk->data_count > max)
+            max = dbk->data_count;
+    }
+    return max;
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+#endif
+	HashTable   *ht;
+	unsigned int attrformat[1] = {1};
+    unsigned int attrarray[1]  = {1};
+    int  num = 20000;
+    int  *model;
+    int  count = 0;
+    int  i, k, ret;
+    int  sizes[] = {1, 2, 5, 10, 20, 40, 80, 160, 256};
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+
+    g_cf->block_table_count = 3;
+    strcpy(g_cf->block_table[0].table, "big");
+    g_cf->block_table[0].count = 256;
+    strcpy(g_cf->block_table[1].table, "small");
+    g_cf->block_table[1].count = 5;
+    strcpy(g_cf->block_table[2].table, "wide");
+    g_cf->block_table[2].count = MEMLINK_BLOCK_COUNT_MAX;
+
+	hashtable_create_table(ht, "big", 4, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+	hashtable_create_table(ht, "small", 4, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+	hashtable_create_table(ht, "def", 4, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    Table *big   = hashtable_find_table(ht, "big");
+    Table *small = hashtable_find_table(ht, "small");
+    Table *def   = hashtable_find_table(ht, "def");
+
+    // block_data_count of the test config is 10,5,2,1
+    if (big->block_count_items != 9 || big->block_count_base != 4) {
+        DERROR("big table sizes error: %d, %d\n", big->block_count_items, big->block_count_base);
+        return -1;
+    }
+    for (i = 0; i < 9; i++) {
+        if (big->block_count[i] != sizes[i]) {
+            DERROR("big table size %d error: %d\n", i, big->block_count[i]);
+            return -1;
+        }
+    }
+    if (small->block_count_items != 3 || small->block_count[2] != 5 ||
+        def->block_count_items != g_cf->block_data_count_items) {
+        DERROR("table sizes error: %d, %d\n", small->block_count_items, def->block_count_items);
+        return -1;
+    }
+    // blocks of wide values are cut to fit in a slab
+	hashtable_create_table(ht, "wide", 200, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    Table *wide = hashtable_find_table(ht, "wide");
+    int   widemax = wide->block_count[wide->block_count_items - 1];
+    if (sizeof(DataBlock) + widemax * (wide->valuesize + wide->attrsize) > MEMPOOL_BLOCK_MAX ||
+        sizeof(DataBlock) + (widemax + 1) * (wide->valuesize + wide->attrsize) <= MEMPOOL_BLOCK_MAX ||
+        wide->block_count[wide->block_count_items - 2] >= widemax) {
+        DERROR("wide table max size error: %d\n", widemax);
+        return -1;
+    }
+    // short lists never use sizes over block_data_count
+    if (datablock_max_size(big, 50) != 10 || datablock_max_size(big, 100) != 20 || 
+        datablock_max_size(big, 1000) != 160 || datablock_max_size(big, 1024) != 256 ||
+        datablock_max_size(small, 1000) != 5) {
+        DERROR("max size error\n");
+        return -1;
+    }
+
+    for (i = 0; i < num; i++) {
+        hashtable_insert(ht, "big", "key", &i, attrarray, 1, -1);
+        hashtable_insert(ht, "def", "key", &i, attrarray, 1, -1);
+        hashtable_insert(ht, "small", "key", &i, attrarray, 1, -1);
+    }
+    HashNode *node = table_find(big, "key");
+    DINFO("block_mem big:%llu, def:%llu, small:%llu, max block:%d\n",
+            (unsigned long long)big->block_mem, (unsigned long long)def->block_mem,
+            (unsigned long long)small->block_mem, block_max_count(node));
+    if (block_max_count(node) != 256 || block_max_count(table_find(small, "key")) != 5) {
+        DERROR("max block error: %d\n", block_max_count(node));
+        return -1;
+    }
+    if (big->block_mem * 10 > def->block_mem * 8 || def->block_mem >= small->block_mem) {
+        DERROR("block_mem error, big:%llu, def:%llu, small:%llu\n", (unsigned long long)big->block_mem,
+                (unsigned long long)def->block_mem, (unsigned long long)small->block_mem);
+        return -1;
+    }
+
+    // inserts and deletes inside big blocks keep the order
+    model = (int*)zz_malloc(sizeof(int) * num * 2);
+    for (i = 0; i < num; i++) {
+        model[i] = i;
+    }
+    count = num;
+    srand(1);
+    for (k = 0; k < 5000; k++) {
+        if (k % 3 == 2) {
+            int pos = rand() % count;
+            ret = hashtable_del(ht, "big", "key", &model[pos]);
+            if (ret != MEMLINK_OK) {
+                DERROR("del error: %d, %d\n", ret, model[pos]);
+                return -1;
+            }
+            memmove(&model[pos], &model[pos + 1], (count - pos - 1) * sizeof(int));
+            count--;
+        }else{
+            int pos = rand() % (count + 1);
+            int v   = num + k;
+            ret = hashtable_insert(ht, "big", "key", &v, attrarray, 1, pos);
+            if (ret != MEMLINK_OK) {
+                DERROR("insert error: %d, %d\n", ret, pos);
+                return -1;
+            }
+            memmove(&model[pos + 1], &model[pos], (count - pos) * sizeof(int));
+            model[pos] = v;
+            count++;
+        }
+        if (k % 500 == 0 && (check_node(big, node, model, count) < 0 || 
+                    check_pos(big, node, model, count) < 0)) {
+            DERROR("check error at %d\n", k);
+            return -1;
+        }
+    }
+    // the index is kept by the writes, not rebuilt for each of them
+    if (check_node(big, node, model, count) < 0 || check_pos(big, node, model, count) < 0 ||
+        NULL == node->bindex) {
+        DERROR("check error, bindex:%p\n", node->bindex);
+        return -1;
+    }
+
+    // the list gets short again, blocks over block_data_count are cut by clean
+    for (i = 0; i < count - 50; i++) {
+        hashtable_del(ht, "big", "key", &model[i]);
+    }
+    memmove(model, &model[count - 50], 50 * sizeof(int));
+    count = 50;
+    hashtable_clean(ht, "big", "key");
+    if (check_node(big, node, model, count) < 0 || block_max_count(node) > 10) {
+        DERROR("clean short list error, max block:%d\n", block_max_count(node));
+        return -1;
+    }
+    zz_free(model);
+
+	DINFO("hashtable block test end!\n");
+	return 0;
+}
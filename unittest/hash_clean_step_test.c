@@ -0,0 +1,166 @@
+#include "hashtest.h"
+
+static char values[20000][16];
+static int  values_count = 0;
+
+static int
+check_link(Table *tb, HashNode *node)
+{
+    DataBlock *dbk  = node->data;
+    DataBlock *prev = NULL;
+    int all = 0, used = 0, vi = 0;
+    int i;
+
+    while (dbk) {
+        int visible = 0, tagdel = 0;
+        if (dbk->prev != prev) {
+            DERROR("prev link error: %p, %p\n", dbk->prev, prev);
+            return -1;
+        }
+        for (i = 0; i < dbk->data_count; i++) {
+            char *itemdata = datablock_item(tb, dbk, i);
+            int ret = dataitem_check_data(tb, dbk, itemdata);
+            if (ret == MEMLINK_VALUE_REMOVED)
+                continue;
+            if (ret == MEMLINK_VALUE_VISIBLE) {
+                visible++;
+            }else{
+                tagdel++;
+            }
+            if (vi >= values_count || memcmp(values[vi], itemdata, tb->valuesize) != 0) {
+                DERROR("value error at %d: %s\n", vi, vi < values_count ? values[vi] : "");
+                return -1;
+            }
+            vi++;
+        }
+        if (visible != dbk->visible_count || tagdel != dbk->tagdel_count) {
+            DERROR("block count error, visible:%d/%d, tagdel:%d/%d\n",
+                    visible, dbk->visible_count, tagdel, dbk->tagdel_count);
+            return -1;
+        }
+        all  += dbk->data_count;
+        used += visible + tagdel;
+        prev = dbk;
+        dbk  = dbk->next;
+    }
+    if (node->data_tail != prev || vi != values_count) {
+        DERROR("link tail error, values:%d/%d\n", vi, values_count);
+        return -1;
+    }
+    if (node->all != all || node->used != used) {
+        DERROR("node count error, all:%d/%d, used:%d/%d\n", node->all, all, node->used, used);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+del_value(HashTable *ht, char *name, char *key, int i)
+{
+    int ret = hashtable_del(ht, name, key, values[i]);
+    if (ret < 0) {
+        DERROR("del error: %d, %s\n", ret, values[i]);
+        return ret;
+    }
+    memmove(values[i], values[i + 1], (values_count - i - 1) * sizeof(values[0]));
+    values_count--;
+    return 0;
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+	//logfile_create("stdout", 4);
+#endif
+	HashTable* ht;
+	char key[64] = "haha";
+	int  valuesize = 8;
+	unsigned int attrformat[2] = {4, 4};
+	unsigned int attrarray[2]  = {1, 2};
+	int  attrnum = 2;
+	int  ret;
+	int  i, steps;
+    char *name = "test";
+    int  num = 10000;
+    int  blockmax;
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+    blockmax = g_cf->block_data_count[g_cf->block_data_count_items - 1];
+
+	hashtable_create_table(ht, name, valuesize, attrformat, attrnum, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    Table *tb = hashtable_find_table(ht, name);
+
+	for (i = 0; i < num; i++) {
+		sprintf(values[values_count], "val%05d", i);
+		ret = hashtable_insert(ht, name, key, values[values_count], attrarray, attrnum, INT_MAX);
+		if (ret < 0) {
+			DERROR("add value err: %d, %s\n", ret, values[values_count]);
+			return ret;
+		}
+        values_count++;
+	}
+    for (i = 0; i < values_count; i += 2) {
+        if (del_value(ht, name, key, i) < 0)
+            return -1;
+    }
+    for (i = 0; i < values_count; i += 7) {
+        hashtable_tag(ht, name, key, values[i], MEMLINK_TAG_DEL);
+    }
+    HashNode *node = table_find(tb, key);
+    DINFO("before clean used:%d, all:%d\n", node->used, node->all);
+
+    // clean step by step, change the link between steps
+    steps = 0;
+    while ((ret = hashtable_clean_step(ht, name, key, 5, 1000000)) == 1) {
+        steps++;
+        if (steps % 3 == 0) {
+            if (del_value(ht, name, key, (steps * 37) % values_count) < 0)
+                return -1;
+        }
+        if (steps % 5 == 0) {
+            sprintf(values[values_count], "new%05d", steps);
+            ret = hashtable_insert(ht, name, key, values[values_count], attrarray, attrnum, INT_MAX);
+            if (ret < 0) {
+                DERROR("add value err: %d\n", ret);
+                return ret;
+            }
+            values_count++;
+        }
+        if (check_link(tb, node) < 0) {
+            DERROR("check link error at step %d\n", steps);
+            return -1;
+        }
+    }
+    if (ret != MEMLINK_OK) {
+        DERROR("clean step error: %d\n", ret);
+        return -1;
+    }
+    DINFO("clean steps:%d, used:%d, all:%d\n", steps, node->used, node->all);
+    if (steps < 2 || check_link(tb, node) < 0) {
+        return -1;
+    }
+
+    // clean again without writes, all blocks but the last are full
+    while ((ret = hashtable_clean_step(ht, name, key, 5, 1000000)) == 1);
+    if (ret != MEMLINK_OK || check_link(tb, node) < 0) {
+        return -1;
+    }
+    DataBlock *dbk;
+    for (dbk = node->data; dbk != node->data_tail; dbk = dbk->next) {
+        if (dbk->data_count != blockmax ||
+            dbk->visible_count + dbk->tagdel_count != blockmax) {
+            DERROR("block not full: %d, %d\n", dbk->data_count,
+                    dbk->visible_count + dbk->tagdel_count);
+            return -1;
+        }
+    }
+    if (tb->clean_node != NULL) {
+        DERROR("clean_node not reset\n");
+        return -1;
+    }
+	DINFO("hashtable clean step test end!\n");
+	return 0;
+}
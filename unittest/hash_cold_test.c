@@ -0,0 +1,181 @@
+#include <sys/stat.h>
+#include "hashtest.h"
+#include "memlink_client.h"
+
+static int
+check_key(HashTable *ht, char *name, char *key, int num)
+{
+    char val[16];
+    unsigned int attrarray[1] = {0};
+    int  i, ret;
+
+    Conn conn;
+    memset(&conn, 0, sizeof(Conn));
+    ret = hashtable_range(ht, name, key, MEMLINK_VALUE_VISIBLE, attrarray, 0, 0, num, &conn);
+    if (ret != MEMLINK_OK) {
+        DERROR("range error: %d, %s\n", ret, key);
+        return -1;
+    }
+    MemLinkResult result;
+    memlink_result_parse(conn.wbuf, &result);
+    if (result.count != num / 2) {
+        DERROR("range count error: %d, %d\n", result.count, num / 2);
+        return -1;
+    }
+    MemLinkItem *items = result.items;
+    for (i = 0; i < result.count; i++) {
+        // odd values were deleted, the newest is the first
+        sprintf(val, "val%05d", num - 2 - i * 2);
+        if (memcmp(items[i].value, val, result.valuesize) != 0) {
+            DERROR("value error at %d: %s, %s\n", i, items[i].value, val);
+            return -1;
+        }
+    }
+    memlink_result_free(&result);
+    return 0;
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+#endif
+	HashTable   *ht;
+	unsigned int attrformat[1] = {4};
+    unsigned int attrarray[1]  = {1};
+    int  num = 1000, keys = 20;
+    int  i, k, ret;
+    char key[64], val[16];
+    char *name = "cold";
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+
+    g_cf->cold_table_count = 1;
+    strcpy(g_cf->cold_table[0], name);
+    g_cf->cold_time = 3600;
+    if (myconfig_cold_table("hot") || !myconfig_cold_table(name)) {
+        DERROR("cold table config error\n");
+        return -1;
+    }
+    mkdir("data", 0755);
+    g_runtime->coldstore = coldstore_create("data/cold.seg");
+    ColdStore *cs = g_runtime->coldstore;
+    if (NULL == cs) {
+        DERROR("coldstore create error\n");
+        return -1;
+    }
+
+	hashtable_create_table(ht, name, 8, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    Table *tb = hashtable_find_table(ht, name);
+    if (!tb->cold) {
+        DERROR("table cold not set\n");
+        return -1;
+    }
+    for (k = 0; k < keys; k++) {
+        sprintf(key, "key%03d", k);
+        for (i = 0; i < num; i++) {
+            sprintf(val, "val%05d", i);
+            ret = hashtable_insert(ht, name, key, val, attrarray, 1, 0);
+            if (ret != MEMLINK_OK) {
+                DERROR("insert error: %d, %s\n", ret, key);
+                return -1;
+            }
+        }
+        for (i = 1; i < num; i += 2) {
+            sprintf(val, "val%05d", i);
+            hashtable_del(ht, name, key, val);
+        }
+    }
+
+    // recently accessed keys stay in memory
+    uint32_t bunk = 0;
+    while (coldstore_spill_step(cs, tb, &bunk, 1000) == 1);
+    if (cs->keys != 0) {
+        DERROR("spill hot keys: %u\n", cs->keys);
+        return -1;
+    }
+
+    // half of the keys are idle for two hours
+    for (k = 0; k < keys; k += 2) {
+        sprintf(key, "key%03d", k);
+        HashNode *node = table_find(tb, key);
+        node->access = (node->access - 7200) & 0xffffff;
+    }
+    uint64_t blockmem = tb->block_mem;
+    bunk = 0;
+    while (coldstore_spill_step(cs, tb, &bunk, 1000) == 1);
+    if (cs->keys != keys / 2 || tb->block_mem >= blockmem) {
+        DERROR("spill error, keys:%u, block_mem:%llu, %llu\n", cs->keys,
+                (unsigned long long)tb->block_mem, (unsigned long long)blockmem);
+        return -1;
+    }
+    DINFO("cold keys:%u, live:%llu, block_mem:%llu => %llu\n", cs->keys,
+            (unsigned long long)cs->live, (unsigned long long)blockmem,
+            (unsigned long long)tb->block_mem);
+    if (table_key_count(tb) != keys) {
+        DERROR("key count error: %d\n", table_key_count(tb));
+        return -1;
+    }
+    // a peek for the cost of a read command leaves the key cold
+    HashNode *cnode = table_peek(tb, "key000");
+    if (NULL == cnode || !hashnode_is_cold(cnode) || cnode->used != num / 2 || cs->keys != keys / 2) {
+        DERROR("peek cold key error\n");
+        return -1;
+    }
+
+    // read back by range, cold keys are loaded again
+    for (k = 0; k < keys; k++) {
+        sprintf(key, "key%03d", k);
+        if (check_key(ht, name, key, num) < 0)
+            return -1;
+    }
+    if (cs->keys != 0 || cs->live != 0) {
+        DERROR("cold store not empty: %u, %llu\n", cs->keys, (unsigned long long)cs->live);
+        return -1;
+    }
+
+    // remove a cold key, its record is dead
+    HashNode *node = table_find(tb, "key000");
+    coldstore_spill(cs, tb, node);
+    if (hashtable_remove_key(ht, name, "key000") != MEMLINK_OK || cs->keys != 0 || cs->live != 0) {
+        DERROR("remove cold key error: %u\n", cs->keys);
+        return -1;
+    }
+
+    // spill and load again until the file is compacted
+    node = table_find(tb, "key001");
+    coldstore_spill(cs, tb, table_find(tb, "key002"));
+    while (cs->end < COLDSTORE_COMPACT_MIN) {
+        coldstore_spill(cs, tb, node);
+        table_find(tb, "key001");
+    }
+    coldstore_spill(cs, tb, node);
+    if (coldstore_compact_start(cs) != 1) {
+        DERROR("compact not start, end:%llu, live:%llu\n", (unsigned long long)cs->end,
+                (unsigned long long)cs->live);
+        return -1;
+    }
+    // moved in steps, a key spilled while compacting goes to the new file
+    bunk = 0;
+    while (coldstore_compact_step(cs, tb, &bunk, 1000) == 1);
+    if (check_key(ht, name, "key003", num) < 0)
+        return -1;
+    coldstore_spill(cs, tb, table_find(tb, "key003"));
+    uint64_t live = cs->live;
+    if (coldstore_compact_finish(cs) != 0 || cs->next || cs->end != live || cs->keys != 3) {
+        DERROR("compact error, end:%llu, live:%llu, keys:%u\n", (unsigned long long)cs->end,
+                (unsigned long long)live, cs->keys);
+        return -1;
+    }
+    if (check_key(ht, name, "key001", num) < 0 || check_key(ht, name, "key002", num) < 0 ||
+        check_key(ht, name, "key003", num) < 0)
+        return -1;
+
+    coldstore_destroy(cs);
+    g_runtime->coldstore = NULL;
+
+	DINFO("hashtable cold test end!\n");
+	return 0;
+}
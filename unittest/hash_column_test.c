@@ -0,0 +1,180 @@
+#include "hashtest.h"
+#include "memlink_client.h"
+#include "synclog.h"
+#include "dumpfile.h"
+
+#define ATTR_NUM    3
+
+static unsigned int attrformat[ATTR_NUM] = {4, 3, 1};
+
+static void
+make_attr(int v, unsigned int *attr)
+{
+    attr[0] = v % 16;
+    attr[1] = v % 8;
+    attr[2] = v % 2;
+}
+
+/**
+ * range of key compared with model, items with attr0 of -1 are not filtered
+ */
+static int
+check_key(HashTable *ht, char *name, char *key, int *model, int count, int attr0)
+{
+    unsigned int attrarray[ATTR_NUM] = {UINT_MAX, UINT_MAX, UINT_MAX};
+    unsigned int attr[ATTR_NUM];
+    char val[64], attrstr[64];
+    int  i, n = 0, ret;
+
+    if (attr0 >= 0) {
+        attrarray[0] = attr0;
+    }
+    Conn conn;
+    memset(&conn, 0, sizeof(Conn));
+    ret = hashtable_range(ht, name, key, MEMLINK_VALUE_VISIBLE, attrarray, ATTR_NUM, 0, count + 10, &conn);
+    if (ret != MEMLINK_OK) {
+        DERROR("range error: %d, %s\n", ret, key);
+        return -1;
+    }
+    MemLinkResult result;
+    memlink_result_parse(conn.wbuf, &result);
+    MemLinkItem *item = result.items;
+    for (i = 0; i < count; i++) {
+        if (attr0 >= 0 && model[i] % 16 != attr0)
+            continue;
+        make_attr(model[i], attr);
+        sprintf(val, "%011d", model[i]);
+        sprintf(attrstr, "%u:%u:%u", attr[0], attr[1], attr[2]);
+        if (NULL == item || memcmp(item->value, val, 11) != 0 || strcmp(item->attr, attrstr) != 0) {
+            DERROR("value error at %d: %s, %s\n", n, val, item ? item->attr : "");
+            return -1;
+        }
+        item = item->next;
+        n++;
+    }
+    if (result.count != n) {
+        DERROR("range count error: %d, %d\n", result.count, n);
+        return -1;
+    }
+    memlink_result_free(&result);
+    zz_free(conn.wbuf);
+    return 0;
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+#endif
+	HashTable   *ht;
+    unsigned int attr[ATTR_NUM];
+    int  num = 5000;
+    int  *model, *sorted;
+    int  count = 0, scount = 0;
+    int  i, k, pos, ret;
+    char val[64];
+    char *name = "col";
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+
+    g_cf->block_layout = MEMLINK_LAYOUT_COLUMN;
+	hashtable_create_table(ht, name, 12, attrformat, ATTR_NUM, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+	hashtable_create_table(ht, "scol", 12, attrformat, ATTR_NUM, MEMLINK_SORTLIST, MEMLINK_VALUE_STRING);
+    Table *tb  = hashtable_find_table(ht, name);
+    Table *stb = hashtable_find_table(ht, "scol");
+    if (tb->layout != MEMLINK_LAYOUT_COLUMN || stb->layout != MEMLINK_LAYOUT_COLUMN) {
+        DERROR("table layout error: %d, %d\n", tb->layout, stb->layout);
+        return -1;
+    }
+
+    hashtable_create_node(ht, "scol", "key");
+    // insert at random positions, values of sortlist are in random order
+    model  = (int*)zz_malloc(sizeof(int) * num);
+    sorted = (int*)zz_malloc(sizeof(int) * num);
+    srand(1);
+    for (i = 0; i < num; i++) {
+        pos = rand() % (count + 1);
+        sprintf(val, "%011d", i);
+        make_attr(i, attr);
+        ret = hashtable_insert(ht, name, "key", val, attr, ATTR_NUM, pos);
+        if (ret != MEMLINK_OK) {
+            DERROR("insert error: %d, %d\n", ret, i);
+            return -1;
+        }
+        memmove(&model[pos + 1], &model[pos], (count - pos) * sizeof(int));
+        model[pos] = i;
+        count++;
+
+        k = (i * 7919) % num;
+        sprintf(val, "%011d", k);
+        make_attr(k, attr);
+        ret = hashtable_sortlist_insert(ht, "scol", "key", val, attr, ATTR_NUM);
+        if (ret != MEMLINK_OK) {
+            DERROR("sortlist insert error: %d, %d\n", ret, k);
+            return -1;
+        }
+    }
+    for (i = 0; i < num; i++) {
+        sorted[i] = i;
+    }
+    scount = num;
+    if (check_key(ht, name, "key", model, count, -1) < 0 ||
+        check_key(ht, "scol", "key", sorted, scount, -1) < 0) {
+        return -1;
+    }
+
+    // delete every third value, range with attr filter on the rest
+    for (i = 0; i < num; i += 3) {
+        sprintf(val, "%011d", i);
+        if (hashtable_del(ht, name, "key", val) != MEMLINK_OK ||
+            hashtable_del(ht, "scol", "key", val) != MEMLINK_OK) {
+            DERROR("del error: %d\n", i);
+            return -1;
+        }
+    }
+    for (i = 0, k = 0; i < count; i++) {
+        if (model[i] % 3 != 0)
+            model[k++] = model[i];
+    }
+    count = k;
+    for (i = 0, k = 0; i < scount; i++) {
+        if (sorted[i] % 3 != 0)
+            sorted[k++] = sorted[i];
+    }
+    scount = k;
+    if (check_key(ht, name, "key", model, count, -1) < 0 ||
+        check_key(ht, name, "key", model, count, 5) < 0 ||
+        check_key(ht, "scol", "key", sorted, scount, 7) < 0) {
+        return -1;
+    }
+
+    // dump writes value|attr of each item, a new hashtable loads it in column layout again
+    char dumpname[PATH_MAX + sizeof(DUMP_FILE_NAME) + 1];
+    g_runtime->synclog = (SyncLog*)zz_malloc(sizeof(SyncLog));
+    memset(g_runtime->synclog, 0, sizeof(SyncLog));
+    if (dumpfile(ht) < 0) {
+        DERROR("dumpfile error\n");
+        return -1;
+    }
+    snprintf(dumpname, sizeof(dumpname), "%s/%s", g_cf->datadir, DUMP_FILE_NAME);
+    HashTable *ht2 = hashtable_create();
+    if (dumpfile_load(ht2, dumpname, 0) != 0) {
+        DERROR("dumpfile_load error\n");
+        return -1;
+    }
+    if (hashtable_find_table(ht2, name)->layout != MEMLINK_LAYOUT_COLUMN ||
+        check_key(ht2, name, "key", model, count, -1) < 0 ||
+        check_key(ht2, name, "key", model, count, 5) < 0 ||
+        check_key(ht2, "scol", "key", sorted, scount, -1) < 0) {
+        DERROR("load dump error\n");
+        return -1;
+    }
+    hashtable_destroy(ht2);
+    zz_free(model);
+    zz_free(sorted);
+
+	DINFO("hashtable column test end!\n");
+	return 0;
+}
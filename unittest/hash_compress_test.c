@@ -0,0 +1,255 @@
+#include <sys/stat.h>
+#include "hashtest.h"
+#include "memlink_client.h"
+
+#define KEY_NUM     20
+#define ITEM_NUM    5000
+
+static int
+check_key(HashTable *ht, char *name, char *key, void *model, int valuesize, int count)
+{
+    unsigned int attrarray[1] = {0};
+    int  i, ret;
+
+    Conn conn;
+    memset(&conn, 0, sizeof(Conn));
+    ret = hashtable_range(ht, name, key, MEMLINK_VALUE_VISIBLE, attrarray, 0, 0, count + 10, &conn);
+    if (ret != MEMLINK_OK) {
+        DERROR("range error: %d, %s\n", ret, key);
+        return -1;
+    }
+    MemLinkResult result;
+    memlink_result_parse(conn.wbuf, &result);
+    if (result.count != count) {
+        DERROR("range count error: %d, %d\n", result.count, count);
+        return -1;
+    }
+    for (i = 0; i < result.count; i++) {
+        if (memcmp(result.items[i].value, (char*)model + i * valuesize, valuesize) != 0) {
+            DERROR("value error of %s.%s at %d\n", name, key, i);
+            return -1;
+        }
+        if (atoi(result.items[i].attr) != i % 8) {
+            DERROR("attr error of %s.%s at %d\n", name, key, i);
+            return -1;
+        }
+    }
+    memlink_result_free(&result);
+    zz_free(conn.wbuf);
+    return 0;
+}
+
+// keys not accessed for two hours
+static void
+make_idle(Table *tb)
+{
+    TableIter iter;
+    HashNode  *node;
+
+    table_iter_init(tb, &iter);
+    while ((node = table_iter_next(&iter)) != NULL) {
+        node->access = (node->access - 7200) & 0xffffff;
+    }
+}
+
+static void
+spill(ColdStore *cs, Table *tb)
+{
+    uint32_t bunk = 0;
+
+    while (coldstore_spill_step(cs, tb, &bunk, 1000) == 1);
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+#endif
+	HashTable   *ht;
+	unsigned int attrformat[1] = {4};
+    unsigned int attrarray[1];
+    int  i, k, ret;
+    char key[64];
+    static int  ints[KEY_NUM][ITEM_NUM], sints[ITEM_NUM];
+    static char strs[ITEM_NUM][12];
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+
+    g_cf->compress_table_count = 1;
+    strcpy(g_cf->compress_table[0], "*");
+    g_cf->cold_table_count = 1;
+    strcpy(g_cf->cold_table[0], "cold");
+    g_cf->compress_time = 600;
+    g_cf->cold_time = 3600;
+    if (!myconfig_compress_table("ids")) {
+        DERROR("compress_table config error\n");
+        return -1;
+    }
+    mkdir("data", 0755);
+    g_runtime->coldstore = coldstore_create("data/cold.seg");
+    ColdStore *cs = g_runtime->coldstore;
+    if (NULL == cs) {
+        DERROR("coldstore create error\n");
+        return -1;
+    }
+
+    // integer sortlist, delta coded; signed values around 0
+	hashtable_create_table(ht, "ids", 4, attrformat, 1, MEMLINK_SORTLIST, MEMLINK_VALUE_UINT);
+	hashtable_create_table(ht, "sints", 4, attrformat, 1, MEMLINK_SORTLIST, MEMLINK_VALUE_INT);
+	hashtable_create_table(ht, "strs", 12, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+	hashtable_create_table(ht, "cold", 4, attrformat, 1, MEMLINK_SORTLIST, MEMLINK_VALUE_UINT);
+    Table *ids  = hashtable_find_table(ht, "ids");
+    Table *tbs  = hashtable_find_table(ht, "sints");
+    Table *strt = hashtable_find_table(ht, "strs");
+    Table *cold = hashtable_find_table(ht, "cold");
+    if (!ids->compress || ids->cold || !cold->compress || !cold->cold) {
+        DERROR("table compress not set\n");
+        return -1;
+    }
+
+    for (k = 0; k < KEY_NUM; k++) {
+        sprintf(key, "key%03d", k);
+        hashtable_create_node(ht, "ids", key);
+        hashtable_create_node(ht, "cold", key);
+        for (i = 0; i < ITEM_NUM; i++) {
+            int v = k * 1000000 + i * 3 + i % 2;
+            attrarray[0] = i % 8;
+            ints[k][i] = v;
+            if ((ret = hashtable_sortlist_insert(ht, "ids", key, &v, attrarray, 1)) != MEMLINK_OK ||
+                (ret = hashtable_sortlist_insert(ht, "cold", key, &v, attrarray, 1)) != MEMLINK_OK) {
+                DERROR("insert error: %d, %s\n", ret, key);
+                return -1;
+            }
+        }
+    }
+    hashtable_create_node(ht, "sints", "key");
+    for (i = 0; i < ITEM_NUM; i++) {
+        int v = (i - ITEM_NUM / 2) * 7;
+        attrarray[0] = i % 8;
+        hashtable_sortlist_insert(ht, "sints", "key", &v, attrarray, 1);
+    }
+    // newest first
+    for (i = 0; i < ITEM_NUM; i++) {
+        memset(strs[ITEM_NUM - 1 - i], 0, 12);
+        sprintf(strs[ITEM_NUM - 1 - i], "val%06d", i);
+        attrarray[0] = (ITEM_NUM - 1 - i) % 8;
+        hashtable_insert(ht, "strs", "key", strs[ITEM_NUM - 1 - i], attrarray, 1, 0);
+    }
+
+    // recently accessed keys stay in blocks
+    spill(cs, ids);
+    if (ids->compress_keys != 0) {
+        DERROR("compress hot keys: %u\n", ids->compress_keys);
+        return -1;
+    }
+
+    uint64_t blockmem = ids->block_mem, mem = table_mem(ids);
+    make_idle(ids);
+    spill(cs, ids);
+    DINFO("ids compressed keys:%u, mem:%llu, block_mem:%llu, table mem:%llu => %llu\n",
+            ids->compress_keys, (unsigned long long)ids->compress_mem, (unsigned long long)blockmem,
+            (unsigned long long)mem, (unsigned long long)table_mem(ids));
+    if (ids->compress_keys != KEY_NUM || ids->block_mem != 0 || ids->compress_mem * 4 > blockmem ||
+        cs->keys != 0) {
+        DERROR("compress error, keys:%u, mem:%llu, block_mem:%llu\n", ids->compress_keys,
+                (unsigned long long)ids->compress_mem, (unsigned long long)blockmem);
+        return -1;
+    }
+    for (k = 0; k < KEY_NUM; k++) {
+        sprintf(key, "key%03d", k);
+        if (check_key(ht, "ids", key, ints[k], 4, ITEM_NUM) < 0)
+            return -1;
+    }
+    if (ids->compress_keys != 0 || ids->compress_mem != 0) {
+        DERROR("compressed keys left: %u\n", ids->compress_keys);
+        return -1;
+    }
+
+    blockmem = tbs->block_mem;
+    make_idle(tbs);
+    spill(cs, tbs);
+    DINFO("sints compressed:%llu, block_mem:%llu\n", (unsigned long long)tbs->compress_mem,
+            (unsigned long long)blockmem);
+    if (tbs->compress_keys != 1 || tbs->compress_mem * 3 > blockmem) {
+        DERROR("compress sints error: %llu\n", (unsigned long long)tbs->compress_mem);
+        return -1;
+    }
+    for (i = 0; i < ITEM_NUM; i++) {
+        sints[i] = (i - ITEM_NUM / 2) * 7;
+    }
+    if (check_key(ht, "sints", "key", sints, 4, ITEM_NUM) < 0)
+        return -1;
+
+    blockmem = strt->block_mem;
+    make_idle(strt);
+    spill(cs, strt);
+    DINFO("strs compressed:%llu, block_mem:%llu\n", (unsigned long long)strt->compress_mem,
+            (unsigned long long)blockmem);
+    if (strt->compress_keys != 1 || strt->compress_mem * 2 > blockmem) {
+        DERROR("compress strs error: %llu\n", (unsigned long long)strt->compress_mem);
+        return -1;
+    }
+    // write goes to the decompressed blocks
+    char val[12] = "val-new";
+    attrarray[0] = 0;
+    if (hashtable_del(ht, "strs", "key", strs[0]) != MEMLINK_OK || strt->compress_keys != 0) {
+        DERROR("del compressed error\n");
+        return -1;
+    }
+    hashtable_insert(ht, "strs", "key", val, attrarray, 1, 0);
+    memcpy(strs[0], val, 12);
+    if (check_key(ht, "strs", "key", strs[0], 12, ITEM_NUM) < 0)
+        return -1;
+
+    // random values are not smaller compressed, the key is not tried again
+    // until idle for another compress_time
+    hashtable_create_table(ht, "rnd", 4, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_UINT);
+    Table *rnd = hashtable_find_table(ht, "rnd");
+    static int rints[ITEM_NUM];
+    srand(1);
+    for (i = 0; i < 200; i++) {
+        rints[199 - i] = rand();
+        attrarray[0] = (199 - i) % 8;
+        hashtable_insert(ht, "rnd", "key", &rints[199 - i], attrarray, 1, 0);
+    }
+    make_idle(rnd);
+    spill(cs, rnd);
+    HashNode *rnode = table_find(rnd, "key");
+    if (rnd->compress_keys != 0 || hashnode_idle(rnd, rnode, time(NULL)) >= g_cf->compress_time) {
+        DERROR("compress random error, keys:%u\n", rnd->compress_keys);
+        return -1;
+    }
+    if (check_key(ht, "rnd", "key", rints, 4, 200) < 0)
+        return -1;
+
+    // compressed records of a cold table are in the cold store
+    make_idle(cold);
+    spill(cs, cold);
+    DINFO("cold keys:%u, live:%llu\n", cs->keys, (unsigned long long)cs->live);
+    if (cs->keys != KEY_NUM || cold->compress_keys != 0 || cs->live * 4 > (uint64_t)KEY_NUM * ITEM_NUM * 5) {
+        DERROR("compress cold error, keys:%u, live:%llu\n", cs->keys, (unsigned long long)cs->live);
+        return -1;
+    }
+    for (k = 0; k < KEY_NUM; k++) {
+        sprintf(key, "key%03d", k);
+        if (check_key(ht, "cold", key, ints[k], 4, ITEM_NUM) < 0)
+            return -1;
+    }
+
+    // removed compressed key frees its record
+    make_idle(ids);
+    spill(cs, ids);
+    if (hashtable_remove_key(ht, "ids", "key000") != MEMLINK_OK || ids->compress_keys != KEY_NUM - 1) {
+        DERROR("remove compressed key error: %u\n", ids->compress_keys);
+        return -1;
+    }
+    hashtable_remove_table(ht, "ids");
+
+    coldstore_destroy(cs);
+    g_runtime->coldstore = NULL;
+
+	DINFO("hashtable compress test end!\n");
+	return 0;
+}
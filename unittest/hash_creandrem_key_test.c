@@ -57,6 +57,8 @@ int main()
 		}
 	}
 
+	uint32_t size = tb->index[0]->size;
+	int k;
 	for (i = 0; i < num; i++) {
 		sprintf(key, "heihei%03d", i);
 		ret = hashtable_remove_key(ht, name, key);
@@ -64,6 +66,18 @@ int main()
 			DERROR("hashtable_remove_key error. %s\n", key);
 			return -1;
 		}
+		// the rest are found while the index shrinks
+		for (k = i + 1; k < num; k += 7) {
+			sprintf(key, "heihei%03d", k);
+			if (NULL == table_find(tb, key)) {
+				DERROR("table_find error after remove. can not find %s\n", key);
+				return -1;
+			}
+		}
+	}
+	if (tb->index[0]->size >= size || table_key_count(tb) != 0) {
+		DERROR("index not shrink: %u, %u\n", tb->index[0]->size, size);
+		return -1;
 	}
 	for (i = 0; i < num; i++) {
 		sprintf(key, "heihei%03d", i);
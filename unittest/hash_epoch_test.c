@@ -0,0 +1,309 @@
+#include <pthread.h>
+#include "hashtest.h"
+#include "epoch.h"
+
+#define ITEM_NUM    1000
+#define KEY_NUM     3
+#define ROUNDS      300
+
+static volatile int stop = 0;
+static volatile int reads = 0;
+static volatile int bad = 0;
+
+static int
+insert_key(HashTable *ht, char *name, char *key, int n)
+{
+    unsigned int attrarray[1] = {1};
+    char val[12];
+    int  i, ret;
+
+    for (i = 0; i < n; i++) {
+        memset(val, 0, sizeof(val));
+        snprintf(val, sizeof(val), "%s-%05d", key, i);
+        ret = hashtable_insert(ht, name, key, val, attrarray, 1, 0);
+        if (ret != MEMLINK_OK) {
+            DERROR("insert error: %d, %s\n", ret, key);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// every visible item of the key has the key as prefix
+static int
+walk_key(Table *tb, char *key)
+{
+    HashNode  *node;
+    DataBlock *dbk;
+    char      *itemdata;
+    int       i, n = 0, klen = strlen(key);
+
+    node = table_find(tb, key);
+    if (NULL == node)
+        return 0;
+    for (dbk = node->data; dbk; dbk = dbk->next) {
+        itemdata = dbk->data;
+        for (i = 0; i < dbk->data_count; i++) {
+            if (dataitem_have_data(tb, dbk, itemdata, 0)) {
+                if (memcmp(itemdata, key, klen) != 0 || itemdata[klen] != '-')
+                    return -1;
+                n++;
+            }
+            itemdata += dataitem_step(tb);
+        }
+    }
+    return n;
+}
+
+// a read thread walks the keys without lock like rdata_ready
+static void*
+reader(void *arg)
+{
+    Table *tb = (Table*)arg;
+    char  key[16];
+    int   k;
+
+    epoch_register(g_runtime->epoch);
+    while (!stop) {
+        epoch_enter(g_runtime->epoch);
+        for (k = 0; k < KEY_NUM; k++) {
+            sprintf(key, "key%d", k);
+            if (walk_key(tb, key) < 0) {
+                bad++;
+            }
+        }
+        epoch_exit(g_runtime->epoch);
+        reads++;
+    }
+    return NULL;
+}
+
+// a read thread looks up deep positions through the block index without lock
+static void*
+index_reader(void *arg)
+{
+    Table     *tb = (Table*)arg;
+    HashNode  *node;
+    DataBlock *dbk;
+    int       pos;
+
+    epoch_register(g_runtime->epoch);
+    while (!stop) {
+        epoch_enter(g_runtime->epoch);
+        node = table_find(tb, "long");
+        pos  = BLOCKINDEX_MIN_POS + rand() % BLOCKINDEX_MIN_POS;
+        if (node && datablock_lookup_pos(tb, node, pos, MEMLINK_VALUE_VISIBLE, &dbk) >= 0 &&
+            (dbk->visible_count == 0 || memcmp(dbk->data, "long-", 5) != 0)) {
+            bad++;
+        }
+        epoch_exit(g_runtime->epoch);
+        reads++;
+    }
+    return NULL;
+}
+
+// a read thread looks up keys that always exist while the index grows and shrinks
+static void*
+key_reader(void *arg)
+{
+    Table *tb = (Table*)arg;
+    char  key[16];
+    int   k;
+
+    epoch_register(g_runtime->epoch);
+    while (!stop) {
+        epoch_enter(g_runtime->epoch);
+        for (k = 0; k < 64; k++) {
+            sprintf(key, "fixed%d", k);
+            if (table_peek(tb, key) == NULL) {
+                bad++;
+            }
+        }
+        epoch_exit(g_runtime->epoch);
+        reads++;
+    }
+    return NULL;
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+#endif
+	HashTable   *ht;
+	unsigned int attrformat[1] = {4};
+    Epoch       *e;
+    DataBlock   *dbk;
+    HashNode    *node;
+    char        key[16];
+    int         i, k, n;
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+    e  = g_runtime->epoch;
+
+	hashtable_create_table(ht, "list", 12, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    Table *tb = hashtable_find_table(ht, "list");
+
+    // no read thread, blocks are put back at once
+    insert_key(ht, "list", "a", ITEM_NUM);
+    hashtable_remove_key(ht, "list", "a");
+    if (e->pending != 0 || g_runtime->mpool->blockmem != 0) {
+        DERROR("free without readers error: %llu\n", (unsigned long long)e->pending);
+        return -1;
+    }
+
+    // this thread reads the key, the writer removes it
+    epoch_register(e);
+    insert_key(ht, "list", "a", ITEM_NUM);
+    long long blockmem = g_runtime->mpool->blockmem;
+
+    epoch_enter(e);
+    node = table_find(tb, "a");
+    if (walk_key(tb, "a") != ITEM_NUM) {
+        DERROR("walk error\n");
+        return -1;
+    }
+    hashtable_remove_key(ht, "list", "a");
+    n = 0;
+    for (dbk = node->data; dbk; dbk = dbk->next) {
+        n += dbk->visible_count;
+    }
+    if (n != ITEM_NUM || e->pending == 0 || g_runtime->mpool->blockmem != blockmem) {
+        DERROR("removed blocks freed under reader: %d, %llu\n", n, (unsigned long long)e->pending);
+        return -1;
+    }
+    // new blocks do not reuse the retired ones
+    insert_key(ht, "list", "b", ITEM_NUM);
+    if (epoch_reclaim(e) != 0 || walk_key(tb, "b") != ITEM_NUM) {
+        DERROR("reclaim under reader\n");
+        return -1;
+    }
+    for (dbk = node->data; dbk; dbk = dbk->next) {
+        n -= dbk->visible_count;
+    }
+    if (n != 0) {
+        DERROR("retired blocks changed: %d\n", n);
+        return -1;
+    }
+    hashtable_remove_table(ht, "list");
+    if (strcmp(tb->name, "list") != 0 || hashtable_find_table(ht, "list") != NULL) {
+        DERROR("table freed under reader\n");
+        return -1;
+    }
+    epoch_exit(e);
+
+    if (epoch_reclaim(e) == 0 || e->pending != 0 || g_runtime->mpool->blockmem != 0) {
+        DERROR("reclaim error, pending:%llu, blockmem:%lld\n", (unsigned long long)e->pending,
+                g_runtime->mpool->blockmem);
+        return -1;
+    }
+
+    // removes fill batches while the reader stays, nothing is freed
+    hashtable_create_table(ht, "list", 12, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    tb = hashtable_find_table(ht, "list");
+    for (k = 0; k < 10; k++) {
+        sprintf(key, "key%d", k);
+        insert_key(ht, "list", key, ITEM_NUM);
+    }
+    epoch_enter(e);
+    for (k = 0; k < 10; k++) {
+        sprintf(key, "key%d", k);
+        hashtable_remove_key(ht, "list", key);
+    }
+    if (e->pending <= EPOCH_BATCH_SIZE || e->sealed == NULL || g_runtime->mpool->blockmem == 0) {
+        DERROR("batch error, pending:%llu\n", (unsigned long long)e->pending);
+        return -1;
+    }
+    epoch_exit(e);
+    epoch_reclaim(e);
+    if (e->pending != 0 || g_runtime->mpool->blockmem != 0) {
+        DERROR("batch reclaim error, pending:%llu\n", (unsigned long long)e->pending);
+        return -1;
+    }
+
+    // a read thread walks keys the writer removes and inserts again
+    pthread_t tid;
+    pthread_create(&tid, NULL, reader, tb);
+    for (i = 0; i < ROUNDS; i++) {
+        pthread_mutex_lock(&g_runtime->mutex);
+        k = i % KEY_NUM;
+        sprintf(key, "key%d", k);
+        hashtable_remove_key(ht, "list", key);
+        insert_key(ht, "list", key, 200 + i % 100);
+        epoch_reclaim(e);
+        pthread_mutex_unlock(&g_runtime->mutex);
+    }
+    stop = 1;
+    pthread_join(tid, NULL);
+    DINFO("reads:%d, bad:%d, pending:%llu\n", reads, bad, (unsigned long long)e->pending);
+    if (bad != 0) {
+        DERROR("reader saw freed blocks: %d\n", bad);
+        return -1;
+    }
+
+    // the writer changes a long list while a read thread searches its block index
+    unsigned int attrarray[1] = {1};
+    char val[12];
+    insert_key(ht, "list", "long", BLOCKINDEX_MIN_POS * 3);
+    stop  = 0;
+    reads = 0;
+    pthread_create(&tid, NULL, index_reader, tb);
+    for (i = 0; i < ROUNDS * 10; i++) {
+        pthread_mutex_lock(&g_runtime->mutex);
+        snprintf(val, sizeof(val), "long-%05d", i % (BLOCKINDEX_MIN_POS * 3));
+        hashtable_del(ht, "list", "long", val);
+        hashtable_insert(ht, "list", "long", val, attrarray, 1, rand() % (BLOCKINDEX_MIN_POS * 3));
+        epoch_reclaim(e);
+        pthread_mutex_unlock(&g_runtime->mutex);
+    }
+    stop = 1;
+    pthread_join(tid, NULL);
+    node = table_find(tb, "long");
+    DINFO("index reads:%d, bad:%d, bindex:%p\n", reads, bad, node->bindex);
+    if (bad != 0 || NULL == node->bindex || node->used != BLOCKINDEX_MIN_POS * 3) {
+        DERROR("index reader error: %d, used:%d\n", bad, node->used);
+        return -1;
+    }
+
+    // rehash steps relink the chains a lookup may stand on
+    hashtable_create_table(ht, "keys", 4, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_INT);
+    Table *ktb = hashtable_find_table(ht, "keys");
+    for (k = 0; k < 64; k++) {
+        sprintf(key, "fixed%d", k);
+        hashtable_create_node(ht, "keys", key);
+    }
+    uint32_t rehashes = ktb->rehashes;
+    stop  = 0;
+    reads = 0;
+    pthread_create(&tid, NULL, key_reader, ktb);
+    for (i = 0; i < 20000; i++) {
+        pthread_mutex_lock(&g_runtime->mutex);
+        sprintf(key, "tmp%d", i);
+        hashtable_create_node(ht, "keys", key);
+        epoch_reclaim(e);
+        pthread_mutex_unlock(&g_runtime->mutex);
+    }
+    for (i = 0; i < 20000; i++) {
+        pthread_mutex_lock(&g_runtime->mutex);
+        sprintf(key, "tmp%d", i);
+        hashtable_remove_key(ht, "keys", key);
+        epoch_reclaim(e);
+        pthread_mutex_unlock(&g_runtime->mutex);
+    }
+    stop = 1;
+    pthread_join(tid, NULL);
+    DINFO("key reads:%d, bad:%d, rehashes:%u\n", reads, bad, ktb->rehashes - rehashes);
+    if (bad != 0 || ktb->rehashes - rehashes < 4 || ktb->index[0]->size > 64 * 8) {
+        DERROR("key reader error: %d, rehashes:%u\n", bad, ktb->rehashes - rehashes);
+        return -1;
+    }
+
+    hashtable_remove_table(ht, "keys");
+    hashtable_remove_table(ht, "list");
+    epoch_reclaim(e);
+
+	DINFO("hashtable epoch test end!\n");
+	return 0;
+}
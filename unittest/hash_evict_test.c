@@ -0,0 +1,146 @@
+#include "hashtest.h"
+
+static int
+evict_keys(HashTable *ht, int num, int *cold, char *notable)
+{
+    char tbname[HASHTABLE_TABLE_NAME_SIZE];
+    char key[HASHTABLE_KEY_MAX + 1];
+    int  i, ret;
+
+    for (i = 0; i < num; i++) {
+        ret = hashtable_evict_key(ht, tbname, key);
+        if (ret != MEMLINK_OK) {
+            return ret;
+        }
+        if (strcmp(tbname, notable) == 0) {
+            DERROR("evict key of table without eviction: %s.%s\n", tbname, key);
+            return -1;
+        }
+        if (strncmp(key, "cold", 4) == 0) {
+            (*cold)++;
+        }
+        ret = hashtable_remove_key(ht, tbname, key);
+        if (ret != MEMLINK_OK) {
+            DERROR("remove evicted key error: %d, %s.%s\n", ret, tbname, key);
+            return -1;
+        }
+    }
+    return MEMLINK_OK;
+}
+
+static int
+create_keys(HashTable *ht, char *name, int num)
+{
+    char key[64];
+    char val[16];
+    unsigned int attrarray[1] = {1};
+    int  i, ret;
+
+    for (i = 0; i < num; i++) {
+        sprintf(key, "%s%04d", i % 2 ? "cold" : "hot", i);
+        sprintf(val, "val%05d", i);
+        ret = hashtable_insert(ht, name, key, val, attrarray, 1, 0);
+        if (ret != MEMLINK_OK) {
+            DERROR("insert error: %d, %s\n", ret, key);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+#endif
+	HashTable   *ht;
+	unsigned int attrformat[1] = {4};
+    int  num = 1000, evicts = 100;
+    int  cold, ret, i;
+    char key[64];
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+
+    g_cf->evict_table_count = 2;
+    strcpy(g_cf->evict_table[0].table, "lru");
+    g_cf->evict_table[0].mode = MEMLINK_EVICT_LRU;
+    strcpy(g_cf->evict_table[1].table, "lfu");
+    g_cf->evict_table[1].mode = MEMLINK_EVICT_LFU;
+    if (myconfig_evict_mode("keep") != MEMLINK_EVICT_NONE) {
+        DERROR("evict mode of table not set error\n");
+        return -1;
+    }
+
+	hashtable_create_table(ht, "keep", 8, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    if (hashtable_evict_key(ht, key, key) != MEMLINK_ERR_NOKEY) {
+        DERROR("evict key without eviction table\n");
+        return -1;
+    }
+    if (create_keys(ht, "keep", 100) < 0)
+        return -1;
+
+    // lru: cold keys are not accessed for an hour
+	hashtable_create_table(ht, "lru", 8, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    Table *tb = hashtable_find_table(ht, "lru");
+    if (tb->evict != MEMLINK_EVICT_LRU) {
+        DERROR("lru table evict mode error: %d\n", tb->evict);
+        return -1;
+    }
+    if (create_keys(ht, "lru", num) < 0)
+        return -1;
+    for (i = 1; i < num; i += 2) {
+        sprintf(key, "cold%04d", i);
+        HashNode *node = table_find(tb, key);
+        node->access = (node->access - 3600) & 0xffffff;
+    }
+    cold = 0;
+    if (evict_keys(ht, evicts, &cold, "keep") != MEMLINK_OK)
+        return -1;
+    DINFO("lru evict cold keys: %d/%d\n", cold, evicts);
+    if (cold < evicts * 8 / 10) {
+        DERROR("lru evict too few cold keys: %d/%d\n", cold, evicts);
+        return -1;
+    }
+    // all keys of lru table can be evicted, keep table is never touched
+    while ((ret = evict_keys(ht, 1, &cold, "keep")) == MEMLINK_OK);
+    if (ret != MEMLINK_ERR_NOKEY || table_key_count(tb) != 0) {
+        DERROR("evict all keys error: %d, %d\n", ret, table_key_count(tb));
+        return -1;
+    }
+    if (table_key_count(hashtable_find_table(ht, "keep")) != 100) {
+        DERROR("keys of keep table evicted\n");
+        return -1;
+    }
+
+    // lfu: hot keys are read many times
+	hashtable_create_table(ht, "lfu", 8, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    tb = hashtable_find_table(ht, "lfu");
+    if (create_keys(ht, "lfu", num) < 0)
+        return -1;
+    HashNode *node = table_find(tb, "hot0000");
+    int  counter = node->access & 0xff;
+    for (i = 0; i < num; i += 2) {
+        int j;
+        sprintf(key, "hot%04d", i);
+        for (j = 0; j < 50; j++) {
+            table_find(tb, key);
+        }
+    }
+    if ((node->access & 0xff) <= counter) {
+        DERROR("lfu counter not increased: %d, %d\n", node->access & 0xff, counter);
+        return -1;
+    }
+    cold = 0;
+    if (evict_keys(ht, evicts, &cold, "keep") != MEMLINK_OK)
+        return -1;
+    DINFO("lfu evict cold keys: %d/%d\n", cold, evicts);
+    if (cold < evicts * 8 / 10) {
+        DERROR("lfu evict too few cold keys: %d/%d\n", cold, evicts);
+        return -1;
+    }
+
+	DINFO("hashtable evict test end!\n");
+	return 0;
+}
@@ -0,0 +1,263 @@
+#include "hashtest.h"
+#include "memlink_client.h"
+#include "valuearena.h"
+
+#define KEY_NUM     1000
+#define SHARED_NUM  200
+#define ITEM_NUM    32
+
+static int model[KEY_NUM][ITEM_NUM];
+static int count[KEY_NUM];
+
+// shared value id has about 40 bytes, the id is at the head
+static void
+make_value(int id, char *val)
+{
+    sprintf(val, "%d-shared-value-of-many-keys-%06d", id, id * 7);
+}
+
+static char*
+valbuf(int id)
+{
+    static char val[256];
+
+    make_value(id, val);
+    return val;
+}
+
+static int
+insert(HashTable *ht, char *name, int k, int id)
+{
+    unsigned int attrarray[1] = {1};
+    char key[64], val[256];
+    int  ret;
+
+    sprintf(key, "key%d", k);
+    make_value(id, val);
+    ret = hashtable_insert(ht, name, key, val, attrarray, 1, 0);
+    if (ret != MEMLINK_OK) {
+        DERROR("insert error: %d, %s\n", ret, key);
+        return -1;
+    }
+    memmove(&model[k][1], &model[k][0], count[k] * sizeof(int));
+    model[k][0] = id;
+    count[k]++;
+    return 0;
+}
+
+static int
+check_key(HashTable *ht, char *name, int k)
+{
+    char key[64], val[256];
+    unsigned int attrarray[1] = {0};
+    int  i, ret;
+
+    sprintf(key, "key%d", k);
+    Conn conn;
+    memset(&conn, 0, sizeof(Conn));
+    ret = hashtable_range(ht, name, key, MEMLINK_VALUE_VISIBLE, attrarray, 0, 0, ITEM_NUM + 10, &conn);
+    if (ret != MEMLINK_OK) {
+        DERROR("range error: %d, %s\n", ret, key);
+        return -1;
+    }
+    MemLinkResult result;
+    memlink_result_parse(conn.wbuf, &result);
+    if (result.count != count[k]) {
+        DERROR("range count error: %d, %d\n", result.count, count[k]);
+        return -1;
+    }
+    for (i = 0; i < result.count; i++) {
+        make_value(model[k][i], val);
+        if (result.items[i].valuesize != strlen(val) ||
+            memcmp(result.items[i].value, val, result.items[i].valuesize) != 0) {
+            DERROR("value error of %s at %d: %s\n", key, i, val);
+            return -1;
+        }
+    }
+    memlink_result_free(&result);
+    zz_free(conn.wbuf);
+    return 0;
+}
+
+// items of equal values point to the same string
+static int
+check_shared(Table *tb)
+{
+    unsigned char *ptrs[SHARED_NUM * 2] = {0};
+    TableIter iter;
+    HashNode  *node;
+    DataBlock *dbk;
+    char      *itemdata;
+    int       i;
+
+    table_iter_init(tb, &iter);
+    while ((node = table_iter_next(&iter)) != NULL) {
+        if (strcmp(hashnode_key(node), "uniq") == 0)
+            continue;
+        for (dbk = node->data; dbk; dbk = dbk->next) {
+            itemdata = dbk->data;
+            for (i = 0; i < dbk->data_count; i++) {
+                if (dataitem_have_data(tb, dbk, itemdata, 0)) {
+                    unsigned char *v = valuearena_value(itemdata);
+                    int id = atoi((char*)v + 1);
+                    if (ptrs[id] == NULL) {
+                        ptrs[id] = v;
+                    }else if (ptrs[id] != v) {
+                        DERROR("value %d not shared\n", id);
+                        return -1;
+                    }
+                }
+                itemdata += dataitem_step(tb);
+            }
+        }
+    }
+    return 0;
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+#endif
+	HashTable   *ht;
+	unsigned int attrformat[1] = {4};
+    unsigned int attrarray[1]  = {1};
+    int  i, j, k, ret;
+    char val[256];
+    char *name = "tags";
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+
+    g_cf->intern_table_count = 1;
+    strcpy(g_cf->intern_table[0], name);
+    if (myconfig_intern_table("plain") || !myconfig_intern_table(name)) {
+        DERROR("intern_table config error\n");
+        return -1;
+    }
+	hashtable_create_table(ht, name, 120, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_VSTRING);
+	hashtable_create_table(ht, "plain", 120, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_VSTRING);
+    Table *tb    = hashtable_find_table(ht, name);
+    Table *plain = hashtable_find_table(ht, "plain");
+    if (!tb->varena.intern || plain->varena.intern) {
+        DERROR("intern flag error\n");
+        return -1;
+    }
+
+    // many keys share a few values
+    for (k = 0; k < KEY_NUM; k++) {
+        for (j = 0; j < 20; j++) {
+            if (insert(ht, name, k, (k * 7 + j) % SHARED_NUM) < 0)
+                return -1;
+            sprintf(val, "key%d", k);
+            hashtable_insert(ht, "plain", val, valbuf(model[k][0]), attrarray, 1, 0);
+        }
+    }
+    DINFO("arena mem intern:%llu, plain:%llu\n", (unsigned long long)valuearena_mem(&tb->varena),
+            (unsigned long long)valuearena_mem(&plain->varena));
+    if (valuearena_mem(&tb->varena) * 10 > valuearena_mem(&plain->varena) ||
+        tb->varena.dict_used != SHARED_NUM) {
+        DERROR("intern mem error: %llu, %llu, dict:%u\n", (unsigned long long)valuearena_mem(&tb->varena),
+                (unsigned long long)valuearena_mem(&plain->varena), tb->varena.dict_used);
+        return -1;
+    }
+    for (k = 0; k < KEY_NUM; k++) {
+        if (check_key(ht, name, k) < 0)
+            return -1;
+    }
+    if (check_shared(tb) < 0)
+        return -1;
+
+    // new shared values are stored between unique values of a big key
+    for (k = 0; k < KEY_NUM; k++) {
+        for (i = 0; i < 100; i++) {
+            sprintf(val, "%d-unique-%d", SHARED_NUM * 2 + k * 100 + i, i);
+            ret = hashtable_insert(ht, name, "uniq", val, attrarray, 1, 0);
+            if (ret != MEMLINK_OK) {
+                DERROR("insert uniq error: %d\n", ret);
+                return -1;
+            }
+        }
+        for (j = 0; j < 5; j++) {
+            if (insert(ht, name, k, SHARED_NUM + (k * 3 + j) % SHARED_NUM) < 0)
+                return -1;
+        }
+    }
+    // a deleted value is still shared by the other keys
+    make_value(model[0][0], val);
+    if (hashtable_del(ht, name, "key0", val) != MEMLINK_OK) {
+        DERROR("del error\n");
+        return -1;
+    }
+    memmove(&model[0][0], &model[0][1], --count[0] * sizeof(int));
+
+    // the shared values are moved out of the chunks of unique values
+    hashtable_remove_key(ht, name, "uniq");
+    // values are put between the steps of the pass, moved values are interned again
+    uint64_t mem = tb->varena.mem;
+    for (i = 0; valuearena_compact_step(tb, 0) == 1; i++) {
+        k = i % KEY_NUM;
+        if (count[k] < ITEM_NUM - 2 && insert(ht, name, k, (i * 7) % (SHARED_NUM * 2)) < 0)
+            return -1;
+    }
+    ret = tb->varena.moves;
+    if (ret < SHARED_NUM / 2 || ret > SHARED_NUM * 2) {
+        DERROR("compact error: %d\n", ret);
+        return -1;
+    }
+    for (k = 0; k < KEY_NUM; k++) {
+        if (check_key(ht, name, k) < 0)
+            return -1;
+    }
+    if (check_shared(tb) < 0)
+        return -1;
+    while (valuearena_compact_step(tb, 1000) == 1);
+    DINFO("compact moved:%d, arena mem:%llu => %llu, dict:%u\n", ret, (unsigned long long)mem,
+            (unsigned long long)tb->varena.mem, tb->varena.dict_used);
+    if (tb->varena.mem * 10 > mem || tb->varena.dict_used != SHARED_NUM * 2) {
+        DERROR("arena mem error: %llu, %llu\n", (unsigned long long)tb->varena.mem, (unsigned long long)mem);
+        return -1;
+    }
+
+    // the dict finds the moved values
+    uint64_t used = tb->varena.chunks->used;
+    for (k = 0; k < 10; k++) {
+        if (insert(ht, name, k, SHARED_NUM + 1) < 0 || insert(ht, name, k, 1) < 0)
+            return -1;
+    }
+    if (tb->varena.chunks->used != used || check_shared(tb) < 0) {
+        DERROR("moved value not interned\n");
+        return -1;
+    }
+    for (k = 0; k < KEY_NUM; k++) {
+        if (check_key(ht, name, k) < 0)
+            return -1;
+    }
+
+    // dead values are purged from dict in place, new values take their slots
+    uint32_t dsize = tb->varena.dict_size, dead = tb->varena.dict_dead;
+    if (dead == 0) {
+        DERROR("dead values not purged\n");
+        return -1;
+    }
+    for (i = 0; i < (int)dead && count[i % KEY_NUM] < ITEM_NUM; i++) {
+        if (insert(ht, name, i % KEY_NUM, SHARED_NUM * 3 + i) < 0)
+            return -1;
+    }
+    if (tb->varena.dict_size != dsize || tb->varena.dict_used != SHARED_NUM * 2 + i ||
+        tb->varena.dict_dead + i < dead) {
+        DERROR("dict error: %u, %u, %u\n", tb->varena.dict_size, tb->varena.dict_used, tb->varena.dict_dead);
+        return -1;
+    }
+    for (k = 0; k < KEY_NUM; k++) {
+        if (check_key(ht, name, k) < 0)
+            return -1;
+    }
+
+    hashtable_remove_table(ht, name);
+    hashtable_remove_table(ht, "plain");
+
+	DINFO("hashtable intern test end!\n");
+	return 0;
+}
@@ -101,7 +101,7 @@ int main()
 		ret = attr_array2binary(charattrformat, attrarray[k], attrnum, data); //to binary
 		attr_array2flag(charattrformat, attrarray[k], attrnum, flag);   //to flag
 		char attr[HASHTABLE_ATTR_MAX_ITEM * HASHTABLE_ATTR_MAX_BYTE] = {0};
-		char *mdata = item + tb->valuesize;
+		char *mdata = dataitem_attr(tb, dbk, item);
 		int j = 0;
 
 		memcpy(attr, mdata, tb->attrsize); 
@@ -0,0 +1,186 @@
+#include "hashtest.h"
+#include "memlink_client.h"
+
+#define MODEL_SIZE  100000
+
+static int model[MODEL_SIZE];
+static int head = MODEL_SIZE / 2, tail = MODEL_SIZE / 2;
+
+// values of node in list order compared with model
+static int
+check_node(Table *tb, HashNode *node)
+{
+    DataBlock *dbk;
+    char      *itemdata;
+    int       i, n = head, all = 0;
+
+    for (dbk = node ? node->data : NULL; dbk; dbk = dbk->next) {
+        if (dbk->visible_count + dbk->tagdel_count == 0) {
+            DERROR("empty block left\n");
+            return -1;
+        }
+        itemdata = dbk->data;
+        for (i = 0; i < dbk->data_count; i++) {
+            if (dataitem_check_data(tb, dbk, itemdata) != MEMLINK_VALUE_REMOVED) {
+                if (n >= tail || memcmp(itemdata, &model[n], sizeof(int)) != 0) {
+                    DERROR("value error at %d\n", n - head);
+                    return -1;
+                }
+                n++;
+            }
+            itemdata += dataitem_step(tb);
+        }
+        all += dbk->data_count;
+    }
+    if (n != tail || (node && (node->used != tail - head || node->all != all))) {
+        DERROR("count error: %d, model:%d\n", n - head, tail - head);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+pop(HashTable *ht, char *name, int num, int left)
+{
+    static Conn conn;
+    MemLinkResult result;
+    int  i, ret;
+
+    if (left) {
+        ret = hashtable_lpop(ht, name, "key", num, &conn);
+    }else{
+        ret = hashtable_rpop(ht, name, "key", num, &conn);
+    }
+    if (ret == MEMLINK_ERR_NOKEY && tail == head) {
+        return 0;
+    }
+    if (ret != MEMLINK_OK) {
+        DERROR("pop error: %d\n", ret);
+        return -1;
+    }
+    memlink_result_parse(conn.wbuf, &result);
+    if (result.count != (num < tail - head ? num : tail - head)) {
+        DERROR("pop count error: %d, %d\n", result.count, num);
+        return -1;
+    }
+    for (i = 0; i < result.count; i++) {
+        int *v = left ? &model[head++] : &model[--tail];
+        if (memcmp(result.items[i].value, v, sizeof(int)) != 0) {
+            DERROR("pop value error at %d\n", i);
+            return -1;
+        }
+    }
+    memlink_result_free(&result);
+    return 0;
+}
+
+static int
+queue_test(HashTable *ht, char *name, int listtype)
+{
+	unsigned int attrformat[1] = {1};
+    unsigned int attrarray[1]  = {1};
+    int  i, k, v = 0, ret;
+
+    head = tail = MODEL_SIZE / 2;
+    srand(1);
+	hashtable_create_table(ht, name, 4, attrformat, 1, listtype, MEMLINK_VALUE_STRING);
+    Table *tb = hashtable_find_table(ht, name);
+
+    for (k = 0; k < 20000; k++) {
+        int op = rand() % 4;
+        int num = rand() % 8 + 1;
+        if (op < 2) {
+            for (i = 0; i < num; i++, v++) {
+                if (op == 0) {
+                    ret = hashtable_lpush(ht, name, "key", &v, attrarray, 1);
+                    model[--head] = v;
+                }else{
+                    ret = hashtable_rpush(ht, name, "key", &v, attrarray, 1);
+                    model[tail++] = v;
+                }
+                if (ret != MEMLINK_OK) {
+                    DERROR("push error: %d\n", ret);
+                    return -1;
+                }
+            }
+        }else{
+            // pop a little less than push, the queue grows slowly
+            if (pop(ht, name, num - 1 > 0 ? num - 1 : 1, op == 2) < 0)
+                return -1;
+        }
+        if (head < 100 || tail > MODEL_SIZE - 100) {
+            DERROR("model overflow\n");
+            return -1;
+        }
+        HashNode *node = table_find(tb, "key");
+        if (k % 1000 == 0 && check_node(tb, node) < 0) {
+            DERROR("check error at %d\n", k);
+            return -1;
+        }
+        // dead slots are only in the head and tail blocks of a queue
+        if (listtype == MEMLINK_QUEUE && node &&
+            node->all - node->used > 2 * datablock_max_size(tb, node->all)) {
+            DERROR("queue garbage: used:%d, all:%d\n", node->used, node->all);
+            return -1;
+        }
+    }
+    if (check_node(tb, table_find(tb, "key")) < 0)
+        return -1;
+    // values deleted at both ends, push goes on outside of the items left
+    for (k = 0; k < 30; k++) {
+        int *dv = (k % 2) ? &model[head++] : &model[--tail];
+        if (hashtable_del(ht, name, "key", (char*)dv) != MEMLINK_OK) {
+            DERROR("del error: %d\n", *dv);
+            return -1;
+        }
+        if (k % 3 == 0) {
+            ret = hashtable_lpush(ht, name, "key", &v, attrarray, 1);
+            model[--head] = v++;
+        }else{
+            ret = hashtable_rpush(ht, name, "key", &v, attrarray, 1);
+            model[tail++] = v++;
+        }
+        if (ret != MEMLINK_OK || check_node(tb, table_find(tb, "key")) < 0) {
+            DERROR("push after del error: %d\n", ret);
+            return -1;
+        }
+    }
+    DINFO("%s used:%d, all:%d, block_mem:%llu\n", name, table_find(tb, "key")->used,
+            table_find(tb, "key")->all, (unsigned long long)tb->block_mem);
+
+    // pop all, blocks are released
+    while (tail > head) {
+        if (pop(ht, name, 100, tail % 2) < 0)
+            return -1;
+    }
+    if (pop(ht, name, 10, 1) < 0 || check_node(tb, table_find(tb, "key")) < 0)
+        return -1;
+    if (tb->block_mem != 0) {
+        DERROR("block_mem not released: %llu\n", (unsigned long long)tb->block_mem);
+        return -1;
+    }
+    return 0;
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+#endif
+	HashTable   *ht;
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+
+    if (queue_test(ht, "queue", MEMLINK_QUEUE) < 0) {
+        return -1;
+    }
+    // pop of list tables shares the code
+    if (queue_test(ht, "list", MEMLINK_LIST) < 0) {
+        return -1;
+    }
+
+	DINFO("hashtable queue test end!\n");
+	return 0;
+}
@@ -108,27 +108,21 @@ int main(int argc, char **argv)
     }
 
     HashNode *node;
-    int size = 0;
+    TableIter iter;
+    int size = table_index_mem(tb) + table_node_mem(tb);
     int blocks = 0;
-    for (i = 0; i < HASHTABLE_BUNKNUM; i++) {
-        node = tb->nodes[i];
-        if (node) {
-            size += strlen(node->key) + 1 + tb->attrnum;
-        }
-        while (node) {
-            DataBlock *dbk = node->data;
-
-            while(dbk) {
-                size += sizeof(DataBlock);
-                //DNOTE("sizeof(DataBlock): %d\n", sizeof(DataBlock));
-                //DNOTE("data_count: %d\n", dbk->data_count);
-                //DNOTE("node->attrsize + node->valuesize: %d\n", node->attrsize + node->valuesize);
-                size += (tb->attrsize + tb->valuesize) * (dbk->data_count);
-                dbk = dbk->next;
-                blocks++;
-            }
-            size += sizeof(HashNode);
-            node = node->next;
+    table_iter_init(tb, &iter);
+    while ((node = table_iter_next(&iter)) != NULL) {
+        DataBlock *dbk = node->data;
+
+        while(dbk) {
+            size += sizeof(DataBlock);
+            //DNOTE("sizeof(DataBlock): %d\n", sizeof(DataBlock));
+            //DNOTE("data_count: %d\n", dbk->data_count);
+            //DNOTE("node->attrsize + node->valuesize: %d\n", node->attrsize + node->valuesize);
+            size += (tb->attrsize + tb->valuesize) * (dbk->data_count);
+            dbk = dbk->next;
+            blocks++;
         }
     }
     ret = check_blocks(&stat, blocks);
@@ -146,5 +140,24 @@ int main(int argc, char **argv)
         DERROR("check_ht_mem: %d\n", ret);
         return ret;
     }
+
+    // counted memory of the table is the same as walking it
+    uint64_t blockmem = size - table_index_mem(tb) - table_node_mem(tb);
+    if (tb->block_mem != blockmem ||
+        g_runtime->mem_used != table_index_mem(tb) + table_node_mem(tb) + tb->bindex_mem) {
+        DERROR("table mem error, block_mem:%llu, mem_used:%lld\n", 
+                (unsigned long long)tb->block_mem, g_runtime->mem_used);
+        return -1;
+    }
+    for (i = 0; i < keys; i += 2) {
+        sprintf(key, "test%03d", i);
+        hashtable_remove_key(ht, name, key);
+    }
+    if (tb->block_mem * 2 != blockmem ||
+        g_runtime->mem_used != table_index_mem(tb) + table_node_mem(tb) + tb->bindex_mem) {
+        DERROR("table mem error after remove, block_mem:%llu, mem_used:%lld\n", 
+                (unsigned long long)tb->block_mem, g_runtime->mem_used);
+        return -1;
+    }
     return 0;
 }
@@ -89,7 +89,7 @@ int main()
 			return ret;
 		}
 		char attr[HASHTABLE_ATTR_MAX_ITEM * HASHTABLE_ATTR_MAX_BYTE] = {0};
-		char *mdata = item + tb->valuesize;
+		char *mdata = dataitem_attr(tb, dbk, item);
 		memcpy(attr, mdata, tb->attrsize); 
 
 		char flag = *(attr + 0) & 0x02;
@@ -0,0 +1,187 @@
+#include "hashtest.h"
+#include "memlink_client.h"
+#include "valuearena.h"
+
+// value i has 2 to 120 bytes, about 20 bytes on average
+static void
+make_value(int i, char *val)
+{
+    int len = sprintf(val, "%d:", i);
+    int n   = (i % 7 == 0) ? i % 114 : i % 16;
+
+    memset(val + len, 'a' + i % 26, n);
+    val[len + n] = 0;
+}
+
+static int
+check_key(HashTable *ht, char *name, char *key, int *model, int count)
+{
+    char val[256];
+    unsigned int attrarray[1] = {0};
+    int  i, ret;
+
+    Conn conn;
+    memset(&conn, 0, sizeof(Conn));
+    ret = hashtable_range(ht, name, key, MEMLINK_VALUE_VISIBLE, attrarray, 0, 0, count + 10, &conn);
+    if (ret != MEMLINK_OK) {
+        DERROR("range error: %d, %s\n", ret, key);
+        return -1;
+    }
+    MemLinkResult result;
+    memlink_result_parse(conn.wbuf, &result);
+    if (result.count != count || result.valuesize != 0) {
+        DERROR("range count error: %d, %d, valuesize:%d\n", result.count, count, result.valuesize);
+        return -1;
+    }
+    MemLinkItem *items = result.items;
+    for (i = 0; i < result.count; i++) {
+        make_value(model[i], val);
+        if (items[i].valuesize != strlen(val) || memcmp(items[i].value, val, items[i].valuesize) != 0) {
+            DERROR("value error at %d: %d, %s\n", i, items[i].valuesize, val);
+            return -1;
+        }
+    }
+    memlink_result_free(&result);
+    zz_free(conn.wbuf);
+    return 0;
+}
+
+int main()
+{
+#ifdef DEBUG
+	logfile_create("test.log", 3);
+#endif
+	HashTable   *ht;
+	unsigned int attrformat[1] = {4};
+    unsigned int attrarray[1]  = {1};
+    int  num = 100000;
+    int  *model;
+    int  count = 0;
+    int  i, ret;
+    char val[256];
+    char *name = "vstr";
+
+	myconfig_create("memlink.conf");
+	my_runtime_create_common("memlink");
+	ht = g_runtime->ht;
+
+    ret = hashtable_create_table(ht, "vsort", 120, attrformat, 1, MEMLINK_SORTLIST, MEMLINK_VALUE_VSTRING);
+    if (ret != MEMLINK_ERR_PARAM) {
+        DERROR("create vstring sortlist: %d\n", ret);
+        return -1;
+    }
+	hashtable_create_table(ht, name, 120, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_VSTRING);
+	hashtable_create_table(ht, "fixed", 120, attrformat, 1, MEMLINK_LIST, MEMLINK_VALUE_STRING);
+    Table *tb    = hashtable_find_table(ht, name);
+    Table *fixed = hashtable_find_table(ht, "fixed");
+    if (tb->valuesize != sizeof(char*) || tb->varena.maxsize != 120) {
+        DERROR("vstring table error: %d, %d\n", tb->valuesize, tb->varena.maxsize);
+        return -1;
+    }
+
+    // newest is the first
+    model = (int*)zz_malloc(sizeof(int) * num);
+    for (i = 0; i < num; i++) {
+        make_value(i, val);
+        ret = hashtable_insert(ht, name, "key", val, attrarray, 1, 0);
+        if (ret != MEMLINK_OK) {
+            DERROR("insert error: %d\n", ret);
+            return -1;
+        }
+        hashtable_insert(ht, "fixed", "key", val, attrarray, 1, 0);
+        model[num - 1 - i] = i;
+    }
+    count = num;
+    DINFO("mem vstring:%llu, fixed:%llu\n", (unsigned long long)table_mem(tb),
+            (unsigned long long)table_mem(fixed));
+    if (table_mem(tb) * 2 > table_mem(fixed)) {
+        DERROR("vstring mem error: %llu, %llu\n", (unsigned long long)table_mem(tb),
+                (unsigned long long)table_mem(fixed));
+        return -1;
+    }
+    if (check_key(ht, name, "key", model, count) < 0)
+        return -1;
+
+    // lookup by value, a prefix is another value
+    make_value(50, val);
+    val[strlen(val) - 1] = 0;
+    if (hashtable_del(ht, name, "key", val) != MEMLINK_ERR_NOVAL) {
+        DERROR("del prefix error\n");
+        return -1;
+    }
+    make_value(num - 1, val);
+    if (hashtable_move(ht, name, "key", val, 100) != MEMLINK_OK) {
+        DERROR("move error\n");
+        return -1;
+    }
+    memmove(&model[0], &model[1], 100 * sizeof(int));
+    model[100] = num - 1;
+
+    // most values are deleted, the arena is compacted
+    int n = 0;
+    for (i = 0; i < count; i++) {
+        if (i % 10 != 0) {
+            make_value(model[i], val);
+            ret = hashtable_del(ht, name, "key", val);
+            if (ret != MEMLINK_OK) {
+                DERROR("del error: %d, %s\n", ret, val);
+                return -1;
+            }
+        }else{
+            model[n++] = model[i];
+        }
+    }
+    count = n;
+    hashtable_clean(ht, name, "key");
+
+    uint64_t mem = tb->varena.mem;
+    while (valuearena_compact_step(tb, 1000) == 1);
+    ret = tb->varena.moves;
+    if (ret <= 0 || ret > count) {
+        DERROR("compact error: %d\n", ret);
+        return -1;
+    }
+    if (check_key(ht, name, "key", model, count) < 0)
+        return -1;
+    // moved chunks are freed when retired, no reader is registered
+    while (valuearena_compact_step(tb, 1000) == 1);
+    DINFO("compact moved:%d, arena mem:%llu => %llu, live:%llu\n", ret, (unsigned long long)mem,
+            (unsigned long long)tb->varena.mem, (unsigned long long)tb->varena.live);
+    if (tb->varena.mem * 2 > mem || tb->varena.mem > 2 * tb->varena.live + VALUEARENA_COMPACT_MIN) {
+        DERROR("arena mem error: %llu, %llu\n", (unsigned long long)tb->varena.mem, (unsigned long long)mem);
+        return -1;
+    }
+    if (check_key(ht, name, "key", model, count) < 0)
+        return -1;
+
+    // queue push and pop
+    hashtable_create_table(ht, "vqueue", 120, attrformat, 1, MEMLINK_QUEUE, MEMLINK_VALUE_VSTRING);
+    for (i = 0; i < 1000; i++) {
+        make_value(i, val);
+        hashtable_rpush(ht, "vqueue", "key", val, attrarray, 1);
+    }
+    Conn conn;
+    MemLinkResult result;
+    memset(&conn, 0, sizeof(Conn));
+    hashtable_lpop(ht, "vqueue", "key", 10, &conn);
+    memlink_result_parse(conn.wbuf, &result);
+    for (i = 0; i < result.count; i++) {
+        make_value(i, val);
+        if (result.items[i].valuesize != strlen(val) || memcmp(result.items[i].value, val, strlen(val)) != 0) {
+            DERROR("pop value error at %d\n", i);
+            return -1;
+        }
+    }
+    if (result.count != 10) {
+        DERROR("pop count error: %d\n", result.count);
+        return -1;
+    }
+    memlink_result_free(&result);
+    zz_free(conn.wbuf);
+
+    hashtable_remove_table(ht, name);
+    zz_free(model);
+
+	DINFO("hashtable vstring test end!\n");
+	return 0;
+}
@@ -71,6 +71,13 @@ my_runtime_create_common(char *pgname)
     }
     DINFO("mempool create ok!\n");
 
+    rt->epoch = epoch_create();
+    if (NULL == rt->epoch) {
+        DERROR("epoch_create error!\n");
+        MEMLINK_EXIT;
+        return NULL;
+    }
+
     rt->ht = hashtable_create();
     if (NULL == rt->ht) {
         DERROR("hashtable_create error!\n");
@@ -46,5 +46,52 @@ int main(int argc, char **argv)
         return -1;
     }
 
+#ifndef DEBUGMEM
+    // slabs of a MemPool with huge page arena, unused slabs give back after put
+    int hugepage;
+    for (hugepage = MEMLINK_HUGEPAGE_NO; hugepage <= MEMLINK_HUGEPAGE_THP; hugepage++) {
+        MemPool *hmp = mempool_create();
+        DataBlock *list = NULL;
+        int count = MEMPOOL_SLAB_SIZE / 200 * 3;
+
+        hmp->hugepage = hugepage;
+        for (i = 0; i < count; i++) {
+            dbk = mempool_get(hmp, 200);
+            if (dbk->data_count != 0 || dbk->next != NULL) {
+                DERROR("block not zero\n");
+                return -1;
+            }
+            dbk->next = list;
+            list = dbk;
+        }
+        if (hugepage == MEMLINK_HUGEPAGE_THP && 
+            ((uintptr_t)list & ~((uintptr_t)MEMPOOL_ARENA_SIZE - 1)) != 
+            ((uintptr_t)hmp->slablist & ~((uintptr_t)MEMPOOL_ARENA_SIZE - 1))) {
+            DERROR("slab not in arena: %p, %p\n", list, hmp->slablist);
+            return -1;
+        }
+        while (list) {
+            dbk = list;
+            list = list->next;
+            mempool_put(hmp, dbk, 200);
+        }
+        if (hugepage == MEMLINK_HUGEPAGE_NO && mempool_hugepage_mem(hmp) != 0) {
+            DERROR("hugepage mem error: %u\n", mempool_hugepage_mem(hmp));
+            return -1;
+        }
+        if (mempool_hugepage_mem(hmp) > hmp->mem / 1024) {
+            DERROR("hugepage mem bigger than mem: %u\n", mempool_hugepage_mem(hmp));
+            return -1;
+        }
+        // one slab kept for the size
+        if (hmp->slabs < 3 || hmp->empty_slabs != hmp->slabs - 1 ||
+            hmp->freemem[0].total - hmp->freemem[0].block_count != 0) {
+            DERROR("slab release error, slabs:%u, empty:%u\n", hmp->slabs, hmp->empty_slabs);
+            return -1;
+        }
+        mempool_destroy(hmp);
+    }
+#endif
+
     return 0;
 }
@@ -11,11 +11,11 @@ int check_values(int *values, int values_count, HashNode *node, Table *tb)
     DataBlock *dbk = node->data;
 
     int i, vi = 0;
-    int datalen = tb->valuesize + tb->attrsize;
+    int datalen = dataitem_step(tb);
     while (dbk) {
         char *itemdata = dbk->data;
         for (i = 0; i < dbk->data_count; i++) {
-            if (dataitem_have_data(tb, node, itemdata, MEMLINK_VALUE_VISIBLE)){
+            if (dataitem_have_data(tb, dbk, itemdata, MEMLINK_VALUE_VISIBLE)){
                 DINFO("value cmp: %d, %d\n", values[vi], *(int*)itemdata);
                 assert(values[vi] == *(int*)itemdata);
                 vi++;
@@ -116,5 +116,36 @@ int main()
     DINFO("add value:%d\n", value);
     add_one_value(ht, node, name, key, value, attr, values, &values_count);
 
+    // int64 values, difference of them do not fit in int
+    char *name8 = "test8";
+    long long values8[] = {1300000000000LL, -5, LLONG_MAX, 0, LLONG_MIN,
+                           1300000000001LL, 4294967296LL, -4294967296LL};
+    int count8 = sizeof(values8) / sizeof(long long);
+
+    hashtable_create_table(ht, name8, 8, attrformat, attrnum,
+                              MEMLINK_SORTLIST, MEMLINK_VALUE_INT8);
+    tb = hashtable_find_table(ht, name8);
+    for (i = 0; i < count8; i++) {
+        ret = hashtable_sortlist_insert_binattr(ht, name8, key, &values8[i], attr);
+        assert(ret == MEMLINK_OK);
+    }
+    node = table_find(tb, key);
+    assert(node->used == count8);
+
+    DataBlock *dbk;
+    long long last = LLONG_MIN;
+    for (dbk = node->data; dbk; dbk = dbk->next) {
+        for (i = 0; i < dbk->data_count; i++) {
+            char *itemdata = datablock_item(tb, dbk, i);
+            if (dataitem_have_data(tb, dbk, itemdata, MEMLINK_VALUE_VISIBLE)) {
+                long long v;
+                memcpy(&v, itemdata, sizeof(v));
+                assert(last <= v);
+                last = v;
+            }
+        }
+    }
+    assert(last == LLONG_MAX);
+
     return 0;
 }
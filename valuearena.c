@@ -0,0 +1,540 @@
+/**
+ * 变长值内存区
+ * MEMLINK_VALUE_VSTRING表的数据项只存一个指针, 值以len|bytes追加写入按块分配的内存区,
+ * 删除的值由后台整理回收. intern的表相同的值只存一份, 由哈希字典查找
+ * @file valuearena.c
+ * @ingroup memlink
+ * @{
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "logfile.h"
+#include "zzmalloc.h"
+#include "utils.h"
+#include "valuearena.h"
+#include "datablock.h"
+#include "runtime.h"
+#include "common.h"
+
+// dict slot of a value purged by compact, probing goes on over it
+#define VALUE_DELETED   ((unsigned char*)1)
+
+void
+valuearena_init(ValueArena *va, int maxsize, int intern)
+{
+    memset(va, 0, sizeof(ValueArena));
+    va->maxsize = maxsize;
+    va->intern  = intern;
+}
+
+/**
+ * bytes of chunks and dict
+ */
+uint64_t
+valuearena_mem(ValueArena *va)
+{
+    return va->mem + (uint64_t)va->dict_size * sizeof(unsigned char*);
+}
+
+static void
+valuearena_dict_free(ValueArena *va)
+{
+    if (va->dict) {
+        zz_free(va->dict);
+        mem_used_dec(va->dict_size * sizeof(unsigned char*));
+    }
+    va->dict      = NULL;
+    va->dict_size = 0;
+    va->dict_used = 0;
+    va->dict_dead = 0;
+}
+
+static void
+valuearena_dict_init(ValueArena *va, uint32_t size)
+{
+    va->dict = (unsigned char**)zz_malloc(size * sizeof(unsigned char*));
+    if (NULL == va->dict) {
+        DERROR("malloc value dict error!\n");
+        MEMLINK_EXIT;
+    }
+    memset(va->dict, 0, size * sizeof(unsigned char*));
+    mem_used_inc(size * sizeof(unsigned char*));
+    va->dict_size = size;
+    va->dict_used = 0;
+    va->dict_dead = 0;
+}
+
+/**
+ * slot of the value in dict, or the empty slot to put it
+ */
+static uint32_t
+valuearena_dict_find(ValueArena *va, void *bytes, int len)
+{
+    uint32_t mask = va->dict_size - 1;
+    uint32_t i    = hashtable_node_hash(bytes, len) & mask;
+    unsigned char *v;
+
+    while ((v = va->dict[i]) != NULL) {
+        if (v != VALUE_DELETED && v[0] == len && memcmp(v + 1, bytes, len) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static void
+valuearena_dict_add(ValueArena *va, unsigned char *v)
+{
+    if ((va->dict_used + va->dict_dead) * 2 >= va->dict_size) {
+        unsigned char **old = va->dict;
+        uint32_t      oldsize = va->dict_size, size = oldsize, i;
+
+        // purged slots are dropped, the dict only grows when values fill it
+        if (0 == size) {
+            size = VALUEARENA_DICT_INIT_SIZE;
+        }else if (va->dict_used * 4 >= oldsize) {
+            size *= 2;
+        }
+        va->dict = NULL;
+        valuearena_dict_init(va, size);
+        for (i = 0; i < oldsize; i++) {
+            if (old[i] && old[i] != VALUE_DELETED) {
+                va->dict[valuearena_dict_find(va, old[i] + 1, old[i][0])] = old[i];
+                va->dict_used++;
+            }
+        }
+        if (old) {
+            zz_free(old);
+            mem_used_dec(oldsize * sizeof(unsigned char*));
+        }
+        // values are in other slots now
+        if (va->phase == VALUEARENA_PURGE) {
+            va->cursor = 0;
+        }
+    }
+    // the first purged slot on the probe is taken again
+    uint32_t mask = va->dict_size - 1;
+    uint32_t i    = hashtable_node_hash((char*)v + 1, v[0]) & mask;
+
+    while (va->dict[i] != NULL && va->dict[i] != VALUE_DELETED) {
+        i = (i + 1) & mask;
+    }
+    if (va->dict[i] == VALUE_DELETED) {
+        va->dict_dead--;
+    }
+    va->dict[i] = v;
+    va->dict_used++;
+}
+
+static void
+valuearena_free_chunks(ValueArena *va, ValueChunk *chunk)
+{
+    ValueChunk *tmp;
+
+    while (chunk) {
+        tmp   = chunk;
+        chunk = chunk->next;
+        zz_free_align(tmp);
+        va->mem -= VALUEARENA_CHUNK_SIZE;
+        mem_used_dec(VALUEARENA_CHUNK_SIZE);
+    }
+}
+
+void
+valuearena_clear(ValueArena *va)
+{
+    valuearena_free_chunks(va, va->chunks);
+    valuearena_dict_free(va);
+    va->chunks  = NULL;
+    va->live    = 0;
+    va->phase   = VALUEARENA_IDLE;
+    va->carve   = NULL;
+}
+
+static void
+valuearena_chunk_free(void *ptr, void *owner, uint32_t arg)
+{
+    zz_free_align(ptr);
+}
+
+// bytes of a value in the chunk, the mark byte of interned values included
+#define value_record_size(va, v)   (((va)->intern ? 2 : 1) + (v)[0])
+
+/**
+ * an interned value is referenced by one more item, a running compact
+ * pass keeps it in dict and counts it if the mark walk is not over
+ */
+static void
+valuearena_ref(ValueArena *va, unsigned char *v)
+{
+    if (va->phase == VALUEARENA_IDLE || v[-1] == va->mark) {
+        return;
+    }
+    v[-1] = va->mark;
+    if (va->phase == VALUEARENA_MARK) {
+        valuearena_chunk(v)->live += value_record_size(va, v);
+        va->counted += value_record_size(va, v);
+    }
+}
+
+/**
+ * copy len bytes to the arena, the item points to the copy
+ */
+static unsigned char*
+valuearena_add(ValueArena *va, void *bytes, int len, char *itemdata)
+{
+    ValueChunk    *chunk = va->chunks;
+    unsigned char *v;
+    int           size = (va->intern ? 2 : 1) + len;
+
+    if (NULL == chunk || chunk->used + size > VALUEARENA_CHUNK_SIZE) {
+        // aligned chunk, compact finds it from a value address
+        chunk = (ValueChunk*)zz_memalign(VALUEARENA_CHUNK_SIZE, VALUEARENA_CHUNK_SIZE);
+        chunk->used  = sizeof(ValueChunk);
+        chunk->live  = 0;
+        chunk->moved = 0;
+        chunk->next  = va->chunks;
+        va->chunks   = chunk;
+        va->mem     += VALUEARENA_CHUNK_SIZE;
+        mem_used_inc(VALUEARENA_CHUNK_SIZE);
+    }
+    v = (unsigned char*)chunk + chunk->used;
+    if (va->intern) {
+        // marked as referenced in the running pass
+        *v++ = va->mark;
+    }
+    v[0] = len;
+    memcpy(v + 1, bytes, len);
+    chunk->used += size;
+    if (va->phase == VALUEARENA_MARK) {
+        va->counted += size;
+    }
+    memcpy(itemdata, &v, sizeof(unsigned char*));
+
+    return v;
+}
+
+/**
+ * copy a zero padded value of a command to the arena, an interned value
+ * already stored is only referenced. call it only when the item is sure to
+ * be inserted, a value put is not taken back
+ * @param itemdata  the pointer is written here, valuesize of the table bytes
+ */
+int
+valuearena_put(ValueArena *va, void *value, char *itemdata)
+{
+    int           len = strnlen(value, va->maxsize);
+    unsigned char *v;
+
+    if (va->intern && va->dict) {
+        uint32_t i = valuearena_dict_find(va, value, len);
+        v = va->dict[i];
+        if (v && !valuearena_chunk(v)->moved) {
+            valuearena_ref(va, v);
+            memcpy(itemdata, &v, sizeof(unsigned char*));
+            return MEMLINK_OK;
+        }
+        if (v) {
+            // the chunk of the value is moved out, the copy takes its slot
+            va->dict[i] = valuearena_add(va, value, len, itemdata);
+            return MEMLINK_OK;
+        }
+    }
+    v = valuearena_add(va, value, len, itemdata);
+    if (va->intern) {
+        valuearena_dict_add(va, v);
+    }
+    return MEMLINK_OK;
+}
+
+/**
+ * the item points to the same string as the zero padded value
+ */
+int
+valuearena_equal(ValueArena *va, char *itemdata, void *value)
+{
+    unsigned char *v = valuearena_value(itemdata);
+
+    return v[0] == strnlen(value, va->maxsize) && memcmp(v + 1, value, v[0]) == 0;
+}
+
+/**
+ * copy len|bytes of the item to buf, the format of reply and dump file
+ * @return bytes copied
+ */
+int
+valuearena_pack(char *itemdata, char *buf)
+{
+    unsigned char *v = valuearena_value(itemdata);
+
+    memcpy(buf, v, 1 + v[0]);
+    return 1 + v[0];
+}
+
+/**
+ * a new compact pass, values are counted again from the first bunk
+ */
+static void
+valuearena_pass_start(Table *tb, ValueArena *va)
+{
+    ValueChunk *chunk;
+
+    for (chunk = va->chunks; chunk; chunk = chunk->next) {
+        chunk->live  = 0;
+        chunk->moved = 0;
+    }
+    va->mark     = va->mark % 255 + 1;
+    va->phase    = VALUEARENA_MARK;
+    va->cursor   = 0;
+    va->rehashes = tb->rehashes;
+    va->carve    = va->chunks;
+    va->counted  = 0;
+    va->moves    = 0;
+}
+
+/**
+ * count values of the items of node in their chunks, an interned value once
+ */
+static void
+valuearena_mark_node(Table *tb, ValueArena *va, HashNode *node)
+{
+    DataBlock     *dbk;
+    unsigned char *v;
+    char          *itemdata;
+    int           i;
+
+    for (dbk = node->data; dbk; dbk = dbk->next) {
+        itemdata = dbk->data;
+        for (i = 0; i < dbk->data_count; i++) {
+            if (dataitem_have_data(tb, dbk, itemdata, 0)) {
+                v = valuearena_value(itemdata);
+                if (!va->intern || v[-1] != va->mark) {
+                    if (va->intern) {
+                        v[-1] = va->mark;
+                    }
+                    valuearena_chunk(v)->live += value_record_size(va, v);
+                    va->counted += value_record_size(va, v);
+                }
+            }
+            itemdata += dataitem_step(tb);
+        }
+    }
+}
+
+/**
+ * chunks older than the one carved from when the pass started and less 
+ * than half live are moved out
+ * @return chunks to move
+ */
+static int
+valuearena_pick_chunks(ValueArena *va)
+{
+    ValueChunk  *chunk;
+    int         n = 0;
+
+    for (chunk = va->carve ? va->carve->next : NULL; chunk; chunk = chunk->next) {
+        if (chunk->live * 2 < chunk->used) {
+            chunk->moved = 1;
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * blocks of node with values in moved chunks are copied, the copy points 
+ * to new copies of the values and takes the place of the block in the link.
+ * items in the link are never changed, readers in the old block go on
+ * in it until it is retired. an interned value is copied once, the dict 
+ * finds the copy for the other items
+ */
+static void
+valuearena_move_node(Table *tb, ValueArena *va, HashNode *node)
+{
+    DataBlock     *dbk, *newbk, *next;
+    unsigned char *v, *nv;
+    char          *itemdata;
+    uint16_t      qhead = node->qhead, qtail = node->qtail;
+    uint32_t      k;
+    int           i, moved = 0;
+
+    for (dbk = node->data; dbk; dbk = next) {
+        next = dbk->next;
+        itemdata = dbk->data;
+        for (i = 0; i < dbk->data_count; i++) {
+            if (dataitem_have_data(tb, dbk, itemdata, 0) && 
+                valuearena_chunk(valuearena_value(itemdata))->moved) 
+                break;
+            itemdata += dataitem_step(tb);
+        }
+        if (i == dbk->data_count) {
+            continue;
+        }
+
+        newbk = datablock_get(tb, dbk->data_count);
+        datablock_copy(newbk, dbk, tb->valuesize + tb->attrsize);
+        newbk->index_slot = 0;
+        itemdata = newbk->data;
+        for (i = 0; i < newbk->data_count; i++, itemdata += dataitem_step(tb)) {
+            if (!dataitem_have_data(tb, newbk, itemdata, 0))
+                continue;
+            v = valuearena_value(itemdata);
+            if (!valuearena_chunk(v)->moved)
+                continue;
+            if (!va->intern) {
+                valuearena_add(va, v + 1, v[0], itemdata);
+                va->moves++;
+                continue;
+            }
+            k  = valuearena_dict_find(va, v + 1, v[0]);
+            nv = va->dict[k];
+            if (nv && !valuearena_chunk(nv)->moved) {
+                valuearena_ref(va, nv);
+                memcpy(itemdata, &nv, sizeof(unsigned char*));
+                continue;
+            }
+            nv = valuearena_add(va, v + 1, v[0], itemdata);
+            if (va->dict[k]) {
+                va->dict[k] = nv;
+            }else{
+                valuearena_dict_add(va, nv);
+            }
+            va->moves++;
+        }
+
+        datablock_link_both(node, dbk, newbk);
+        hashnode_index_release(tb, node, dbk);
+        datablock_put(tb, dbk);
+        moved = 1;
+    }
+    if (moved) {
+        // items keep their positions in the copies
+        node->qhead = qhead;
+        node->qtail = qtail;
+        hashnode_index_update(tb, node);
+    }
+}
+
+/**
+ * chunks moved out are freed after readers leave them
+ */
+static void
+valuearena_free_moved(ValueArena *va)
+{
+    ValueChunk  **last = &va->chunks;
+    ValueChunk  *chunk;
+
+    while ((chunk = *last) != NULL) {
+        if (chunk->moved) {
+            *last = chunk->next;
+            va->mem -= VALUEARENA_CHUNK_SIZE;
+            mem_used_dec(VALUEARENA_CHUNK_SIZE);
+            epoch_retire(g_runtime->epoch, chunk, NULL, 0, valuearena_chunk_free);
+        }else{
+            last = &chunk->next;
+        }
+    }
+}
+
+/**
+ * one step of the compact pass of a table, stop after maxtime us.
+ * a pass counts live bytes of each chunk by walking the bunks, copies the 
+ * blocks pointing to values in chunks less than half live, drops dead values
+ * from the intern dict, then frees the chunks moved out. a pass starts when
+ * the arena is over VALUEARENA_COMPACT_MIN, live is counted again by every
+ * pass because deleted values are not tracked. caller holds g_runtime->mutex
+ * @return 1 when the pass goes on, 0 when it is over or not needed
+ */
+int
+valuearena_compact_step(Table *tb, int maxtime)
+{
+    ValueArena      *va = &tb->varena;
+    HashIndex       *hi = tb->index[0];
+    HashNode        *node;
+    unsigned char   *v;
+    struct timeval  start, end;
+    uint64_t        mem;
+
+    if (va->phase == VALUEARENA_IDLE) {
+        if (va->mem < VALUEARENA_COMPACT_MIN) {
+            return 0;
+        }
+        valuearena_pass_start(tb, va);
+    }
+    // nodes moved by rehash may be missed, bunks are walked again
+    if (va->phase != VALUEARENA_PURGE && (tb->rehashidx >= 0 || tb->rehashes != va->rehashes)) {
+        if (va->phase == VALUEARENA_MARK) {
+            valuearena_pass_start(tb, va);
+        }
+        va->cursor   = 0;
+        va->rehashes = tb->rehashes;
+        if (tb->rehashidx >= 0) {
+            return 1;
+        }
+    }
+    gettimeofday(&start, NULL);
+
+    if (va->phase == VALUEARENA_MARK || va->phase == VALUEARENA_MOVE) {
+        while (va->cursor < hi->size) {
+            for (node = hi->bunks[va->cursor]; node; node = node->next) {
+                if (va->phase == VALUEARENA_MARK) {
+                    valuearena_mark_node(tb, va, node);
+                }else{
+                    valuearena_move_node(tb, va, node);
+                }
+            }
+            va->cursor++;
+            if ((va->cursor & 63) == 0) {
+                gettimeofday(&end, NULL);
+                if (timediff(&start, &end) >= maxtime) {
+                    return 1;
+                }
+            }
+        }
+        va->cursor = 0;
+        if (va->phase == VALUEARENA_MARK) {
+            va->live = va->counted;
+            if (va->mem < 2 * va->live + VALUEARENA_COMPACT_MIN || valuearena_pick_chunks(va) == 0) {
+                va->phase = VALUEARENA_IDLE;
+                return 0;
+            }
+            va->phase = VALUEARENA_MOVE;
+            return 1;
+        }
+        if (va->intern) {
+            va->phase = VALUEARENA_PURGE;
+            return 1;
+        }
+    }
+
+    if (va->phase == VALUEARENA_PURGE) {
+        // values not referenced in this pass are dead, the moved ones are copied
+        while (va->cursor < va->dict_size) {
+            v = va->dict[va->cursor];
+            if (v && v != VALUE_DELETED && (valuearena_chunk(v)->moved || v[-1] != va->mark)) {
+                va->dict[va->cursor] = VALUE_DELETED;
+                va->dict_used--;
+                va->dict_dead++;
+            }
+            va->cursor++;
+            if ((va->cursor & 1023) == 0) {
+                gettimeofday(&end, NULL);
+                if (timediff(&start, &end) >= maxtime) {
+                    return 1;
+                }
+            }
+        }
+    }
+
+    mem = va->mem;
+    valuearena_free_moved(va);
+    va->phase = VALUEARENA_IDLE;
+    DNOTE("compact values of %s, moved:%u, live:%llu, mem:%llu => %llu\n", tb->name, va->moves,
+            (unsigned long long)va->live, (unsigned long long)mem, (unsigned long long)va->mem);
+    return 0;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,36 @@
+#ifndef MEMLINK_VALUEARENA_H
+#define MEMLINK_VALUEARENA_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "hashtable.h"
+
+// phase of a compact pass
+#define VALUEARENA_IDLE     0
+#define VALUEARENA_MARK     1  // count live bytes of each chunk
+#define VALUEARENA_MOVE     2  // copy blocks with values in chunks moved out
+#define VALUEARENA_PURGE    3  // drop dead values from the intern dict
+
+#define valuearena_chunk(v)	((ValueChunk*)((uintptr_t)(v) & ~((uintptr_t)VALUEARENA_CHUNK_SIZE - 1)))
+
+/**
+ * len|bytes of the value an item points to, item address may be unaligned
+ */
+static inline unsigned char*
+valuearena_value(char *itemdata)
+{
+	unsigned char *v;
+	memcpy(&v, itemdata, sizeof(unsigned char*));
+	return v;
+}
+
+void		valuearena_init(ValueArena *va, int maxsize, int intern);
+uint64_t	valuearena_mem(ValueArena *va);
+void		valuearena_clear(ValueArena *va);
+int			valuearena_put(ValueArena *va, void *value, char *itemdata);
+int			valuearena_equal(ValueArena *va, char *itemdata, void *value);
+int			valuearena_pack(char *itemdata, char *buf);
+int			valuearena_compact_step(Table *tb, int maxtime);
+
+#endif
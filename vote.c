@@ -73,8 +73,10 @@ vote_destroy(Conn *conn)
 {
     VoteConn *vconn = (VoteConn *)conn;
 
-    if (conn->rbuf)
+    if (conn->rbuf) {
         zz_free(conn->rbuf);
+        conn_buffer_mem_add(-conn->rsize);
+    }
     event_del(&conn->evt);
     set_linger(conn->sock);
     close(conn->sock);
@@ -430,6 +432,7 @@ request_vote(uint64_t id, unsigned char idflag, uint64_t voteid, unsigned short
     conn->wbuf = conn->rbuf;
     conn->rsize = CONN_MAX_READ_LEN;
     conn->wsize = CONN_MAX_READ_LEN;
+    conn_buffer_mem_add(CONN_MAX_READ_LEN);
     conn->sock = fd;
     conn->destroy = vote_destroy;
     conn->wrote = conn_wrote;
@@ -78,11 +78,6 @@ is_clean_cond(HashNode *node)
         return 0;
     }
 
-    if (g_runtime->inclean) {
-        //DNOTE("no clean, other inclean ...\n");
-        return 0;
-    }
-
     double rate = 1.0 - (double)node->used / node->all;
     DINFO("check clean rate: %f\n", rate);
 
@@ -95,40 +90,10 @@ is_clean_cond(HashNode *node)
     return 1;
 }
 
-/*
-void*
-wdata_do_clean(void *args)
-{
-    HashNode    *node = (HashNode*)args;
-    int            ret;
-    struct timeval start, end;
-
-    g_runtime->inclean = TRUE;
-    pthread_mutex_lock(&g_runtime->mutex);
-    //snprintf(g_runtime->cleankey, 512, "%s", node->key);
-    
-    if (is_clean_cond(node) == 0) {
-        //DNOTE("thread check not need clean %s\n", node->key);
-        goto wdata_do_clean_over;
-    }
-
-    DNOTE("start clean %s ...\n", node->key);
-    gettimeofday(&start, NULL);
-    ret = hashtable_clean(g_runtime->ht, node->key);
-    if (ret != 0) {
-        DERROR("wdata_do_clean error: %d\n", ret);
-    }
-    gettimeofday(&end, NULL);
-    DNOTE("clean %s complete, use %u us\n", node->key, timediff(&start, &end));
-    //g_runtime->cleankey[0] = 0;
-
-wdata_do_clean_over:
-    g_runtime->inclean = FALSE;
-    pthread_mutex_unlock(&g_runtime->mutex);
-
-    return NULL;
-}
-*/
+/**
+ * 数据项删除比例达到block_clean_cond的key交给任务线程在后台分步清理,
+ * 删除比例高的先清理
+ */
 void
 wdata_check_clean(char *tbname, char *key)
 {
@@ -143,7 +108,8 @@ wdata_check_clean(char *tbname, char *key)
         return;
     }
     tb = hashtable_find_table(g_runtime->ht, tbname);
-    if (NULL == tb)
+    // queue blocks are reused by push and released by pop, nothing to clean
+    if (NULL == tb || tb->listtype == MEMLINK_QUEUE)
         return;
 
     node = table_find(tb, key);
@@ -153,38 +119,20 @@ wdata_check_clean(char *tbname, char *key)
     if (is_clean_cond(node) == 0) {
         return;
     }
-    
-    
-    /*
-    pthread_t       threadid;
-    pthread_attr_t  attr;
-    int             ret;
-    
-    DNOTE("create clean thread ..\n");
-    ret = pthread_attr_init(&attr);
-    if (ret != 0) {
-        char errbuf[1024];
-        strerror_r(errno, errbuf, 1024);
-        DERROR("pthread_attr_init error: %s\n",  errbuf);
-        MEMLINK_EXIT;
-    }
-
-    ret = pthread_create(&threadid, &attr, wdata_do_clean, node);
-    if (ret != 0) {
-        char errbuf[1024];
-        strerror_r(errno, errbuf, 1024);
-        DERROR("pthread_create error: %s\n",  errbuf);
-        MEMLINK_EXIT;
+    if (NULL == g_runtime->taskthread || tb->clean_node == node) {
+        return;
     }
-
-    ret = pthread_detach(threadid);
-    if (ret != 0) {
-        char errbuf[1024];
-        strerror_r(errno, errbuf, 1024);
-        DERROR("pthread_detach error; %s\n",  errbuf);
-        MEMLINK_EXIT;
+    
+    TaskClean *task = (TaskClean*)zz_malloc(sizeof(TaskClean));
+    memset(task, 0, sizeof(TaskClean));
+    task->type     = TASK_CLEAN;
+    task->priority = (1.0 - (double)node->used / node->all) * 10000;
+    snprintf(task->table, HASHTABLE_TABLE_NAME_SIZE, "%s", tbname);
+    snprintf(task->key, HASHTABLE_KEY_MAX + 1, "%s", key);
+    if (taskthread_add_task(g_runtime->taskthread, (Task*)task) != MEMLINK_OK) {
+        DWARNING("add clean task error, %s.%s\n", tbname, key);
+        zz_free(task);
     }
-    */
 }
 
 /**
@@ -738,6 +686,8 @@ wdata_apply(char *data, int datalen, int writelog, Conn *conn)
                 g_cf->sync_check_interval = atoi(value);
             } else if (strcmp(key, "block_clean_num") == 0) {
                 g_cf->block_clean_num = atoi(value);
+            } else if (strcmp(key, "block_clean_time") == 0) {
+                g_cf->block_clean_time = atoi(value);
             } else if (strcmp(key, "timeout") == 0) {
                 g_cf->timeout = atoi(value);
             } else if (strcmp(key, "log_level") == 0) {
@@ -827,9 +777,45 @@ wdata_apply(char *data, int datalen, int writelog, Conn *conn)
         wdata_check_clean(tbname, key);
     }
 wdata_apply_over:
+    // free blocks removed by earlier commands that readers have left
+    epoch_reclaim(g_runtime->epoch);
     return ret;
 }
 
+/**
+ * Evict keys of tables set in evict_table until live memory is under 
+ * max_mem. Every eviction runs as a RMKEY command, so it goes to the sync
+ * log and slaves remove the same key. Called with g_runtime->mutex held.
+ *
+ * @return 0 when memory is under max_mem, otherwise MEMLINK_ERR_MEM
+ */
+static int
+wdata_evict()
+{
+    char tbname[HASHTABLE_TABLE_NAME_SIZE];
+    char key[HASHTABLE_KEY_MAX + 1];
+    char data[HASHTABLE_TABLE_NAME_SIZE + HASHTABLE_KEY_MAX + 16];
+    int  datalen, ret;
+    int  n = 0;
+
+    while (mem_used_live() >= g_cf->max_mem) {
+        if (n >= MEMLINK_EVICT_MAX_KEYS || 
+            hashtable_evict_key(g_runtime->ht, tbname, key) != MEMLINK_OK) {
+            return MEMLINK_ERR_MEM;
+        }
+        datalen = cmd_rmkey_pack(data, tbname, key);
+        ret = wdata_apply(data, datalen, MEMLINK_WRITE_LOG, NULL);
+        if (ret < 0) {
+            DERROR("evict key error: %d, %s.%s\n", ret, tbname, key);
+            return MEMLINK_ERR_MEM;
+        }
+        DNOTE("evict key %s.%s, live memory:%lld\n", tbname, key, mem_used_live());
+        g_runtime->evicted_keys++;
+        n++;
+    }
+    return 0;
+}
+
 /**
  * Execute the write command and send response to client.
  *
@@ -865,16 +851,21 @@ wdata_ready(Conn *conn, char *data, int datalen)
 
     gettimeofday(&start, NULL);
     // check max memory
-    if (start.tv_sec - g_runtime->mem_check_last > MEM_CHECK_INTERVAL) {
-        g_runtime->mem_used = get_process_mem(getpid());
-        g_runtime->mem_check_last = start.tv_sec;
-    }
-    
-    //DNOTE("check mem, used:%lld, max:%lld\n", g_runtime->mem_used, g_cf->max_mem);
-    if (g_cf->max_mem > 0 && g_runtime->mem_used > g_cf->max_mem) {
-        DERROR("memory used/max: %lld/%lld\n", g_runtime->mem_used, g_cf->max_mem);
-        conn_send_buffer_reply(conn, MEMLINK_ERR_MEM, NULL, 0);
-        return 0;
+    long long memused = mem_used_total();
+    //DNOTE("check mem, used:%lld, max:%lld\n", memused, g_cf->max_mem);
+    if (g_cf->max_mem > 0 && memused >= g_cf->max_mem) {
+        // backups of master-backup get commands from master_ready only
+        ret = MEMLINK_ERR_MEM;
+        if (g_cf->evict_table_count > 0 && g_cf->sync_mode != MODE_MASTER_BACKUP) {
+            pthread_mutex_lock(&g_runtime->mutex);
+            ret = wdata_evict();
+            pthread_mutex_unlock(&g_runtime->mutex);
+        }
+        if (ret < 0) {
+            DERROR("memory used/max: %lld/%lld\n", memused, g_cf->max_mem);
+            conn_send_buffer_reply(conn, MEMLINK_ERR_MEM, NULL, 0);
+            return 0;
+        }
     }
     
     DINFO("mode:%d, role:%d\n", g_cf->sync_mode, g_cf->role);
@@ -1041,6 +1032,7 @@ client_read(int fd, short event, void *arg)
             char *newbuf = (char *)zz_malloc(rlen + conn->rsize);
             memcpy(newbuf, conn->rbuf, conn->rlen);
             conn->rsize += rlen;
+            conn_buffer_mem_add(rlen);
             zz_free(conn->rbuf);
             conn->rbuf = newbuf;
         }